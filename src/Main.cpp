@@ -1,31 +1,128 @@
 #include "apps/SceneEditorApp.hpp"
 #include "apps/RMResearchApp.hpp"
+#include "apps/common/AppSettings.hpp"
+#include "apps/common/BvhBenchmark.hpp"
+#include "apps/common/DepthSortBenchmark.hpp"
+#include "apps/common/FrameBenchmark.hpp"
+#include "apps/common/SceneBenchmark.hpp"
+#include "apps/common/TransformBenchmark.hpp"
 
 // std
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
 #include <stdexcept>
+#include <string>
 
+// Usage: VulkanRenderer [--scene N | --rmresearch N] [--pipeline-threads N] [--record-threads N] [--no-pipeline-prewarm]
+//                       [--validate-gpu-culling] [--frames-in-flight N] [--frames N]
+//        VulkanRenderer --headless [--frames N] [--capture frame.png] [...]
+//                                            (renders offscreen without a window, 100 frames by default)
+//        VulkanRenderer --headless --validate-gpu-culling --frames N
+//                                            (the GPU culling test: compares the culled draws of every frame with
+//                                             a CPU reference, fails with a non-zero exit code on a mismatch)
+//        VulkanRenderer --bench script.json [--headless] [...]
+//                                            (replays the script's camera path and writes the frame times, see
+//                                             FrameBenchmark; offscreen if there is no display)
+//        VulkanRenderer --bvh-benchmark N    (runs the benchmark of the scene BVH over N objects without a window)
+//        VulkanRenderer --transform-benchmark N    (runs the benchmark of the transform update over N objects)
+//        VulkanRenderer --scene-benchmark N    (runs the benchmark of the scene storage over N entities)
+//        VulkanRenderer --depth-sort-benchmark N    (runs the benchmark of sorting N light billboards back to front)
 int main(int argc, char* argv[])
 {
     try
     {
-        if (argc > 1) {
-            std::string argument_str(argv[1]);
-            int argument_number = atoi(argv[2]);
+        AppSettings settings{};
+        bool rmResearch = false;
+
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string argument_str(argv[i]);
+            auto nextNumber = [&]() {
+                if (i + 1 >= argc) throw std::runtime_error("Missing value for " + argument_str);
+                return atoi(argv[++i]);
+            };
 
             if (argument_str == "--scene") {
-                SceneEditorApp app{argument_number};
-                app.run();
+                settings.preloadScene = nextNumber();
             }
             else if (argument_str == "--rmresearch") {
-                RMResearchApp app{argument_number};
-                app.run();
+                rmResearch = true;
+                settings.preloadScene = nextNumber();
+            }
+            else if (argument_str == "--pipeline-threads") {
+                settings.pipelineThreads = static_cast<unsigned int>(std::max(0, nextNumber()));
+            }
+            else if (argument_str == "--record-threads") {
+                settings.recordThreads = static_cast<unsigned int>(std::max(0, nextNumber()));
+            }
+            else if (argument_str == "--frames-in-flight") {
+                // the range is checked by WrpRenderer
+                settings.framesInFlight = static_cast<uint32_t>(std::max(0, nextNumber()));
+            }
+            else if (argument_str == "--headless") {
+                settings.headless = true;
+            }
+            else if (argument_str == "--frames") {
+                settings.frames = static_cast<uint32_t>(std::max(0, nextNumber()));
+            }
+            else if (argument_str == "--bench") {
+                if (i + 1 >= argc) throw std::runtime_error("Missing value for " + argument_str);
+                settings.benchmark = std::make_shared<BenchmarkScript>(BenchmarkScript::load(argv[++i]));
+            }
+            else if (argument_str == "--capture") {
+                if (i + 1 >= argc) throw std::runtime_error("Missing value for " + argument_str);
+                settings.capturePath = argv[++i];
+            }
+            else if (argument_str == "--no-pipeline-prewarm") {
+                settings.prewarmPipelineVariants = false;
+            }
+            else if (argument_str == "--bvh-benchmark") {
+                return runBvhBenchmark(static_cast<uint32_t>(std::max(1, nextNumber()))) ? EXIT_SUCCESS : EXIT_FAILURE;
+            }
+            else if (argument_str == "--transform-benchmark") {
+                return runTransformBenchmark(static_cast<uint32_t>(std::max(1, nextNumber()))) ? EXIT_SUCCESS : EXIT_FAILURE;
             }
+            else if (argument_str == "--scene-benchmark") {
+                return runSceneBenchmark(static_cast<uint32_t>(std::max(1, nextNumber()))) ? EXIT_SUCCESS : EXIT_FAILURE;
+            }
+            else if (argument_str == "--depth-sort-benchmark") {
+                return runDepthSortBenchmark(static_cast<uint32_t>(std::max(1, nextNumber()))) ? EXIT_SUCCESS : EXIT_FAILURE;
+            }
+            else if (argument_str == "--validate-gpu-culling") {
+                settings.validateGpuCulling = true;
+            }
+            else {
+                throw std::runtime_error("Unknown argument: " + argument_str);
+            }
+        }
+
+        if (settings.benchmark)
+        {
+            if (rmResearch) throw std::runtime_error("--bench is supported only by the scene editor");
+            settings.preloadScene = settings.benchmark->scene;
+            // background pipeline compilation would disturb the measured frames
+            settings.prewarmPipelineVariants = false;
+            if (!settings.headless && !WrpWindow::isDisplayAvailable())
+            {
+                std::cout << "No display available, the benchmark is rendered offscreen." << std::endl;
+                settings.headless = true;
+            }
+        }
+        if (settings.headless && settings.frames == 0 && !settings.benchmark) {
+            settings.frames = 100; // there is no window to close
+        }
+        if (!settings.capturePath.empty() && !settings.headless) {
+            throw std::runtime_error("--capture is supported only with --headless");
+        }
+
+        if (rmResearch) {
+            RMResearchApp app{settings};
+            return app.run() ? EXIT_SUCCESS : EXIT_FAILURE;
         }
         else {
-            SceneEditorApp app{};
-            app.run();
+            SceneEditorApp app{settings};
+            return app.run() ? EXIT_SUCCESS : EXIT_FAILURE;
         }
     }
     catch (const std::exception& ex)
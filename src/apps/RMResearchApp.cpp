@@ -6,7 +6,13 @@
 #include "../renderer/systems/PointLightSystem.hpp"
 #include "../renderer/Buffer.hpp"
 #include "../renderer/Camera.hpp"
+#include "../renderer/RenderQueue.hpp"
+#include "../renderer/ClusteredLighting.hpp"
+#include "../renderer/TransformUpdater.hpp"
+#include "../renderer/ShaderModule.hpp"
+#include "../renderer/UniformRing.hpp"
 #include "./common/KeyboardMovementController.hpp"
+#include "./common/CullingValidation.hpp"
 
 // libs
 #define GLM_FORCE_RADIANS
@@ -20,55 +26,71 @@
 // std
 #include <stdexcept>
 #include <cassert>
+#include <algorithm>
 #include <array>
 #include <chrono>
+#include <iostream>
 #include <numeric>
 
 #define MAX_FRAME_TIME 0.5f
+#define CAMERA_NEAR 0.1f
+#define CAMERA_FAR 100.f
+#define UNIFORM_RING_FRAME_CAPACITY (64 * 1024) // bytes of uniform data a frame can allocate
 
-RMResearchApp::RMResearchApp(int preloadScene)
+RMResearchApp::RMResearchApp(const AppSettings& settings) : appSettings{settings}
 {
-    // global descriptor pool designed for the entire app 
-    globalPool = WrpDescriptorPool::Builder(wrpDevice)
-        .setMaxSets(wrpRenderer.getSwapChainImageCount())
-        .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, wrpRenderer.getSwapChainImageCount())
+    // global descriptor allocator designed for the entire app, it grows with new pools when needed
+    globalDescriptorAllocator = WrpDescriptorAllocator::Builder(wrpDevice)
+        .setInitialSetsPerPool(wrpRenderer.getFramesInFlight())
+        .addPoolSizeRatio(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.f)
+        .addPoolSizeRatio(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.f)
+        .addPoolSizeRatio(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3.f)
         .build();
+    globalDescriptorSetCache = std::make_unique<WrpDescriptorSetCache>(*globalDescriptorAllocator);
 
     loadScene();
 }
 
 RMResearchApp::~RMResearchApp() {}
 
-void RMResearchApp::run()
+bool RMResearchApp::run()
 {
-    // Uniform Buffers creation
-    std::vector<std::unique_ptr<WrpBuffer>> uboBuffers(wrpRenderer.getSwapChainImageCount());
-    for (int i = 0; i < uboBuffers.size(); ++i)
-    {
-        uboBuffers[i] = std::make_unique<WrpBuffer>(
-            wrpDevice,
-            sizeof(GlobalUbo),
-            1,
-            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-        );
-        uboBuffers[i]->map();
-    }
+    // startup time (pipelines creation included) is printed after the first frame,
+    // to compare cold and warm pipeline cache runs
+    auto startupBegin = std::chrono::high_resolution_clock::now();
+    bool firstFrameRendered = false;
+
+    // per-frame uniform data (GlobalUbo first) is sub-allocated from one persistently mapped buffer
+    // and bound by dynamic offsets
+    WrpUniformRing uniformRing{wrpDevice, wrpRenderer.getFramesInFlight(),
+        UNIFORM_RING_FRAME_CAPACITY};
 
     // Global Descriptor Set Layout for the entire app
     auto globalDescriptorSetLayout = WrpDescriptorSetLayout::Builder(wrpDevice)
-        .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS, 1)
+        .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT, 1)
+        // point lights and their clusters, see WrpClusteredLighting
+        .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 1)
+        .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 1)
+        .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 1)
         .build();
+    WrpClusteredLighting clusteredLighting{wrpDevice, wrpRenderer.getFramesInFlight(),
+        globalDescriptorSetLayout->getDescriptorSetLayout()};
 
-    // Getting Descriptor Sets from pool
-    std::vector<VkDescriptorSet> globalDescriptorSets(wrpRenderer.getSwapChainImageCount());
+    // Getting Descriptor Sets from the cache (identical sets are allocated once)
+    std::vector<VkDescriptorSet> globalDescriptorSets(wrpRenderer.getFramesInFlight());
     for (int i = 0; i < globalDescriptorSets.size(); ++i)
     {
-        VkDescriptorBufferInfo bufferInfo = uboBuffers[i]->descriptorInfo(); // инфа о буфере для дескриптора
+        VkDescriptorBufferInfo bufferInfo = uniformRing.descriptorInfo(sizeof(GlobalUbo)); // инфа о буфере для дескриптора
+        VkDescriptorBufferInfo lightsInfo = clusteredLighting.getLightBufferInfo(i);
+        VkDescriptorBufferInfo clustersInfo = clusteredLighting.getClusterBufferInfo(i);
+        VkDescriptorBufferInfo lightIndicesInfo = clusteredLighting.getLightIndexBufferInfo(i);
 
-        WrpDescriptorWriter(*globalDescriptorSetLayout, *globalPool)
+        WrpDescriptorWriter(*globalDescriptorSetLayout, *globalDescriptorAllocator)
             .writeBuffer(0, &bufferInfo)
-            .build(globalDescriptorSets[i]);
+            .writeBuffer(1, &lightsInfo)
+            .writeBuffer(2, &clustersInfo)
+            .writeBuffer(3, &lightIndicesInfo)
+            .build(globalDescriptorSets[i], *globalDescriptorSetCache);
     }
 
     WrpCamera camera{};
@@ -76,50 +98,73 @@ void RMResearchApp::run()
     //camera.setViewDirection(glm::vec3{0.f}, glm::vec3{0.5f, 0.f, 1.f});
     //camera.setViewTarget(glm::vec3{-3.f, -3.f, 23.f}, {.0f, .0f, 1.5f});
 
-    // SceneObject for the editor camera 
-    auto cameraObject = SceneObject::createSceneObject("Camera");
-    cameraObject.transform.translation = {0.f, 0.f, -4.f};
-    cameraObject.transform.rotation = {.0f, .0f, .0f};
-    sceneObjects.emplace(cameraObject.getId(), std::move(cameraObject));
+    // entity for the editor camera
+    WrpEntity cameraObject = scene.createEntity("Camera");
+    scene.getTransform(cameraObject).translation = {0.f, 0.f, -4.f};
+    scene.getTransform(cameraObject).rotation = {.0f, .0f, .0f};
     KeyboardMovementController cameraController{};
 
     RenderingSettings renderingSettings{1, 0};
-    FrameInfo frameInfo{0, 0, nullptr, camera, nullptr, sceneObjects, renderingSettings};
+    FrameInfo frameInfo{0, 0, nullptr, camera, nullptr, scene, renderingSettings};
 
     SimpleRenderSystem simpleRenderSystem{
         wrpDevice,
         wrpRenderer,
+        pipelineVariantCache,
         globalDescriptorSetLayout->getDescriptorSetLayout(),
     };
     TextureRenderSystem textureRenderSystem{
         wrpDevice,
         wrpRenderer,
+        pipelineVariantCache,
         globalDescriptorSetLayout->getDescriptorSetLayout(),
         frameInfo
     };
+    simpleRenderSystem.setCullingValidation(appSettings.validateGpuCulling);
+    textureRenderSystem.setCullingValidation(appSettings.validateGpuCulling);
     PointLightSystem pointLightSystem{
         wrpDevice,
+        pipelineVariantCache,
+        wrpRenderer.getFramesInFlight(),
         wrpRenderer.getSwapChainRenderPass(),
         globalDescriptorSetLayout->getDescriptorSetLayout()
     };
+    WrpRenderQueue renderQueue{};
+    WrpTransformUpdater transformUpdater{};
 
     RMResearchGUI appGUI{
         wrpWindow,
         wrpDevice,
         wrpRenderer.getSwapChainRenderPass(),
-        wrpRenderer.getSwapChainImageCount(),
+        // imgui rotates its vertex buffers by this count, it must cover the frames in flight
+        std::max(wrpRenderer.getSwapChainImageCount(), wrpRenderer.getFramesInFlight()),
         camera,
         cameraController,
-        sceneObjects,
+        scene,
         renderingSettings
     };
 
+    // systems request their pipelines asynchronously; wait for all of them before the first frame
+    pipelineCompiler.waitIdle();
+    simpleRenderSystem.awaitPipelines();
+    textureRenderSystem.awaitPipelines();
+    pointLightSystem.awaitPipelines();
+
+    // variants for the other rendering settings are compiled in background while the first frames are rendered
+    if (appSettings.prewarmPipelineVariants) {
+        simpleRenderSystem.prewarmPipelineVariants();
+        textureRenderSystem.prewarmPipelineVariants();
+    }
+
     auto currentTime = std::chrono::high_resolution_clock::now();
+    uint32_t renderedFrames = 0;
 
     // MAIN LOOP
-    while (!wrpWindow.shouldClose())
+    while (!wrpWindow.shouldClose() && (appSettings.frames == 0 || renderedFrames < appSettings.frames))
     {
-        glfwPollEvents(); // Process glfw events from queue
+        if (!wrpWindow.isHeadless()) {
+            glfwPollEvents(); // Process glfw events from queue
+        }
 
         // calculating frameTime and currentTime 
         auto newTime = std::chrono::high_resolution_clock::now();
@@ -130,21 +175,28 @@ void RMResearchApp::run()
         frameTime = glm::min(frameTime, MAX_FRAME_TIME);
 
         // Move/rotate camera corresponding to the input
-        cameraController.moveInPlaneXZ(wrpWindow.getGLFWwindow(), frameTime, cameraObject);
-        camera.setViewYXZ(cameraObject.transform.translation, cameraObject.transform.rotation);
+        // the reference isn't kept between frames, the GUI can add entities and move the transforms
+        TransformComponent& cameraTransform = scene.getTransform(cameraObject);
+        if (!wrpWindow.isHeadless()) {
+            cameraController.moveInPlaneXZ(wrpWindow.getGLFWwindow(), frameTime, cameraTransform);
+        }
+        camera.setViewYXZ(cameraTransform.translation, cameraTransform.rotation);
 
         float aspect = wrpRenderer.getAspectRatio();
         //camera.setOrthographicProjection(-aspect, aspect, -1, 1, -1, 1);
-        camera.setPerspectiveProjection(glm::radians(50.f), aspect, 0.1f, 100.f);
+        camera.setPerspectiveProjection(glm::radians(50.f), aspect, CAMERA_NEAR, CAMERA_FAR);
 
         // frame rendering
         if (auto commandBuffer = wrpRenderer.beginFrame()) // beginFrame() will return nullptr if SwapChain recreation is needed
         {
             appGUI.newFrame(); // tell imgui that we're starting a new frame
 
+            pipelineVariantCache.nextFrame();
+
             int frameIndex = wrpRenderer.getFrameIndex();
+            uniformRing.beginFrame(frameIndex); // the frame's fence is waited by beginFrame()
             FrameInfo frameInfo{frameIndex, frameTime, commandBuffer, camera,
-                globalDescriptorSets[frameIndex], sceneObjects, renderingSettings};
+                globalDescriptorSets[frameIndex], scene, renderingSettings};
 
             // UPDATE SECTION
             GlobalUbo ubo{};
@@ -156,39 +208,75 @@ void RMResearchApp::run()
             ubo.diffuseProportion = appGUI.diffuseProportion;
             ubo.roughness = appGUI.roughness;
             ubo.indexOfRefraction = appGUI.indexOfRefraction;
-            pointLightSystem.update(frameInfo, ubo);
-            uboBuffers[frameIndex]->writeToBuffer(&ubo);
+            auto frustumPlanes = camera.getFrustumPlanes();
+            std::copy(frustumPlanes.begin(), frustumPlanes.end(), ubo.frustumPlanes);
+            pointLightSystem.moveCarousel(frameInfo);
+            transformUpdater.update(scene); // the matrices of the moved objects are rebuilt in one batch
+            pointLightSystem.update(frameInfo);
+            clusteredLighting.update(frameIndex, pointLightSystem.getLights(), ubo, wrpRenderer.getSwapChainExtent(),
+                CAMERA_NEAR, CAMERA_FAR, renderingSettings.clusteredLighting);
+            frameInfo.globalUboOffset = uniformRing.push(ubo);
+            uniformRing.flush();
 
             // RENDER SECTION
+            // the objects are uploaded and culled by compute passes, which can't be recorded inside a render pass
+            clusteredLighting.cull(commandBuffer, globalDescriptorSets[frameIndex], frameInfo.globalUboOffset);
+            simpleRenderSystem.prepareSceneObjects(frameInfo);
+            textureRenderSystem.prepareSceneObjects(frameInfo);
+
             wrpRenderer.beginSwapChainRenderPass(commandBuffer, appGUI.clearColor);
 
             // Order of objects render is matter, because we need to ensure that we rendered
             // fully opaque objects (like textured models) before rendering translucent objects (like point lights)
-            simpleRenderSystem.renderSceneObjects(frameInfo);
-            textureRenderSystem.renderSceneObjects(frameInfo);
-            pointLightSystem.render(frameInfo);
+            // draws are sorted by the queue to skip the redundant binds: opaque ones by state, then the translucent ones
+            simpleRenderSystem.renderSceneObjects(frameInfo, renderQueue);
+            textureRenderSystem.renderSceneObjects(frameInfo, renderQueue);
+            pointLightSystem.render(frameInfo, renderQueue);
+            renderQueue.sort();
+            renderQueue.record(commandBuffer);
+            renderQueue.clear();
             appGUI.setupGUI();
             appGUI.render(commandBuffer);
 
             wrpRenderer.endSwapChainRenderPass(commandBuffer);
             wrpRenderer.endFrame();
+            renderedFrames++;
+
+            if (!firstFrameRendered)
+            {
+                firstFrameRendered = true;
+                float startupMs = std::chrono::duration<float, std::chrono::milliseconds::period>(
+                    std::chrono::high_resolution_clock::now() - startupBegin).count();
+                std::cout << "Startup to first frame: " << startupMs << " ms (pipeline cache "
+                          << (wrpDevice.isPipelineCacheWarm() ? "warm" : "cold") << ", "
+                          << pipelineCompiler.getThreadCount() << " pipeline threads)" << std::endl;
+                ShaderModule::printCacheStatistics();
+            }
         }
     }
 
     vkDeviceWaitIdle(wrpDevice.device());
+    if (!appSettings.capturePath.empty()) {
+        wrpRenderer.saveLastFrame(appSettings.capturePath);
+    }
+    bool passed = true;
+    if (appSettings.validateGpuCulling) {
+        passed = finishCullingValidation(simpleRenderSystem, textureRenderSystem);
+    }
+    globalDescriptorSetCache->clear(); // the cached sets reference the layout and buffers of this run
+    return passed;
 }
 
 void RMResearchApp::loadScene()
 {
     std::shared_ptr<WrpModel> sphere = WrpModel::createModelFromObjMtl(wrpDevice, ENGINE_DIR"models/Sphere_64x32.obj");
-    auto sphereObj = SceneObject::createSceneObject("Sphere_64x32");
-    sphereObj.model = sphere;
-    sphereObj.transform.translation = {0.f, 0.f, 0.f};
-    sphereObj.transform.scale = glm::vec3(1.f, 1.f, 1.f);
-    sphereObj.transform.rotation = glm::vec3(0.f, 0.f, 0.f);
-    sceneObjects.emplace(sphereObj.getId(), std::move(sphereObj));
-
-    SceneObject pointLight = SceneObject::makePointLight(80.f, 0.001f, glm::vec3{1.f, 1.f, 1.f});
-    pointLight.transform.translation = {2.f, 0.f, 0.f};
-    sceneObjects.emplace(pointLight.getId(), std::move(pointLight));
+    WrpEntity sphereObj = scene.createEntity("Sphere_64x32");
+    TransformComponent& sphereTransform = scene.getTransform(sphereObj);
+    scene.setModel(sphereObj, sphere);
+    sphereTransform.translation = {0.f, 0.f, 0.f};
+    sphereTransform.scale = glm::vec3(1.f, 1.f, 1.f);
+    sphereTransform.rotation = glm::vec3(0.f, 0.f, 0.f);
+
+    WrpEntity pointLight = scene.createPointLight(80.f, 0.001f, glm::vec3{1.f, 1.f, 1.f});
+    scene.getTransform(pointLight).translation = {2.f, 0.f, 0.f};
 }
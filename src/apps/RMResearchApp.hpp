@@ -4,7 +4,10 @@
 #include "../renderer/Device.hpp"
 #include "../renderer/Renderer.hpp"
 #include "../renderer/Descriptors.hpp"
-#include "../renderer/SceneObject.hpp"
+#include "../renderer/Scene.hpp"
+#include "../renderer/PipelineCompiler.hpp"
+#include "../renderer/PipelineVariantCache.hpp"
+#include "./common/AppSettings.hpp"
 
 // std
 #include <memory>
@@ -17,21 +20,26 @@ public:
     static constexpr int WIDTH = 1600;
     static constexpr int HEIGHT = 1000;
 
-    RMResearchApp(int preloadScene = 0);
+    RMResearchApp(const AppSettings& settings = {});
     ~RMResearchApp();
 
     RMResearchApp(const RMResearchApp&) = delete;
     RMResearchApp& operator=(const RMResearchApp&) = delete;
 
-    void run();
+    // returns false if a check requested by the settings failed (--validate-gpu-culling)
+    bool run();
 
 private:
     void loadScene();
 
-    WrpWindow wrpWindow{ WIDTH, HEIGHT, "Vulkan Renderer" };
+    AppSettings appSettings;
+    WrpWindow wrpWindow{ WIDTH, HEIGHT, "Vulkan Renderer", appSettings.headless };
     WrpDevice wrpDevice{ wrpWindow };
-    WrpRenderer wrpRenderer{ wrpWindow, wrpDevice };
+    WrpRenderer wrpRenderer{ wrpWindow, wrpDevice, appSettings.framesInFlight };
+    WrpPipelineCompiler pipelineCompiler{ wrpDevice, appSettings.pipelineThreads };
+    WrpPipelineVariantCache pipelineVariantCache{ wrpDevice, pipelineCompiler, wrpRenderer.getFramesInFlight() };
 
-    std::unique_ptr<WrpDescriptorPool> globalPool{};
-    SceneObject::Map sceneObjects;
+    std::unique_ptr<WrpDescriptorAllocator> globalDescriptorAllocator{};
+    std::unique_ptr<WrpDescriptorSetCache> globalDescriptorSetCache{};
+    WrpScene scene;
 };
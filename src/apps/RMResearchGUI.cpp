@@ -13,6 +13,7 @@
 #include <glm/gtc/type_ptr.hpp>
 
 // std
+#include <cassert>
 #include <stdexcept>
 #include <fstream>
 #include <filesystem>
@@ -20,10 +21,13 @@
 RMResearchGUI::RMResearchGUI(
     WrpWindow& window, WrpDevice& device, VkRenderPass renderPass,
     uint32_t imageCount, WrpCamera& camera, KeyboardMovementController& kmc,
-    SceneObject::Map& sceneObjects, RenderingSettings& renderingSettings)
-    : wrpDevice{device}, camera{camera}, kmc{kmc}, sceneObjects{sceneObjects},
-    renderingSettings{renderingSettings}
+    WrpScene& scene, RenderingSettings& renderingSettings)
+    : wrpDevice{device}, camera{camera}, kmc{kmc}, scene{scene},
+    renderingSettings{renderingSettings}, headless{window.isHeadless()}
 {
+    // the tool fields keep their default values, the scene is rendered without the GUI
+    if (headless) return;
+
     VkInstance instance = device.getInstance();
     // custom vulkan function loader to support volk library
     ImGui_ImplVulkan_LoadFunctions([](const char* functionName, void* vulkanInstance) {
@@ -81,7 +85,7 @@ RMResearchGUI::RMResearchGUI(
     init_info.MinImageCount = 2;
     init_info.ImageCount = imageCount;
     init_info.MSAASamples = wrpDevice.getMaxUsableMSAASampleCount();
-    init_info.PipelineCache = VK_NULL_HANDLE;
+    init_info.PipelineCache = device.getPipelineCache();
     init_info.Allocator = VK_NULL_HANDLE;
     init_info.CheckVkResultFn = check_vk_result;
     ImGui_ImplVulkan_Init(&init_info);
@@ -90,6 +94,8 @@ RMResearchGUI::RMResearchGUI(
 
 RMResearchGUI::~RMResearchGUI()
 {
+    if (headless) return;
+
     ImGui_ImplVulkan_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -98,6 +104,8 @@ RMResearchGUI::~RMResearchGUI()
 
 void RMResearchGUI::newFrame()
 {
+    if (headless) return;
+
     ImGui_ImplVulkan_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
@@ -108,6 +116,8 @@ void RMResearchGUI::newFrame()
 // command buffer the necessary draw commands
 void RMResearchGUI::render(VkCommandBuffer commandBuffer)
 {
+    if (headless) return;
+
     ImGui::Render();
     ImDrawData* drawdata = ImGui::GetDrawData();
     ImGui_ImplVulkan_RenderDrawData(drawdata, commandBuffer);
@@ -115,6 +125,8 @@ void RMResearchGUI::render(VkCommandBuffer commandBuffer)
 
 void RMResearchGUI::setupGUI()
 {
+    if (headless) return;
+
     // Show the demo ImGui window (browse its code for better understanding of functionality)
     if (showImGuiDemoWindow) { ImGui::ShowDemoWindow(&showImGuiDemoWindow); }
 
@@ -174,17 +186,20 @@ void RMResearchGUI::setupMainSettingsPanel()
         // 2 collapsing header
         if (ImGui::CollapsingHeader("Point Light position", ImGuiTreeNodeFlags_DefaultOpen))
         {
+            // the research scene has a single point light, see RMResearchApp::loadScene()
+            assert(!scene.pointLights.empty() && "The scene has no point light");
+            TransformComponent& lightTransform = scene.getTransform(scene.pointLights.entities().front());
             ImGui::Dummy(ImVec2(40.0f, 0.0f)); ImGui::SameLine();
             if (ImGui::Button("Behind"))
-                sceneObjects.at(1).transform.translation = {0.0f, 0.0f, 2.0f};
+                lightTransform.translation = {0.0f, 0.0f, 2.0f};
             if (ImGui::Button("Left"))
-                sceneObjects.at(1).transform.translation = {-2.0f, 0.0f, 0.0f}; ImGui::SameLine();
+                lightTransform.translation = {-2.0f, 0.0f, 0.0f}; ImGui::SameLine();
             ImGui::Dummy(ImVec2(50.0f, 0.0f)); ImGui::SameLine();
             if (ImGui::Button("Right"))
-                sceneObjects.at(1).transform.translation = {2.0f, 0.0f, 0.0f};
+                lightTransform.translation = {2.0f, 0.0f, 0.0f};
             ImGui::Dummy(ImVec2(40.0f, 0.0f)); ImGui::SameLine();
             if (ImGui::Button("Front"))
-                sceneObjects.at(1).transform.translation = {0.0f, 0.0f, -2.0f};
+                lightTransform.translation = {0.0f, 0.0f, -2.0f};
         }
 
         // 3 collapsing header
@@ -212,11 +227,11 @@ void RMResearchGUI::enumerateObjectsInTheScene()
     if (ImGui::Begin("All Objects")) {
         if (ImGui::BeginListBox("All Objects", ImVec2(-FLT_MIN, 10 * ImGui::GetTextLineHeightWithSpacing())))
         {
-            for (auto& obj : sceneObjects)
+            for (WrpEntity entity : scene.getEntities())
             {
-                const bool isSelected = (pickedItemSceneObjectsList == obj.second.getId());
-                if (ImGui::Selectable(obj.second.getName().c_str(), isSelected)) {
-                    pickedItemSceneObjectsList = obj.second.getId();
+                const bool isSelected = (pickedItemSceneObjectsList == entity);
+                if (ImGui::Selectable(scene.getName(entity).c_str(), isSelected)) {
+                    pickedItemSceneObjectsList = entity;
                 }
 
                 if (isSelected) { ImGui::SetItemDefaultFocus(); }
@@ -225,36 +240,36 @@ void RMResearchGUI::enumerateObjectsInTheScene()
         }
 
         // Create "Inspect Object" window for chosed type of scene object
-        if (sceneObjects[pickedItemSceneObjectsList].pointLight != nullptr) {
-            inspectObject(sceneObjects[pickedItemSceneObjectsList], true);
-        }
-        else {
-            inspectObject(sceneObjects[pickedItemSceneObjectsList], false);
+        if (scene.isAlive(pickedItemSceneObjectsList)) {
+            inspectObject(pickedItemSceneObjectsList);
         }
     }
     ImGui::End();
 }
 
-void RMResearchGUI::inspectObject(SceneObject& object, bool isPointLight)
+void RMResearchGUI::inspectObject(WrpEntity entity)
 {
+    TransformComponent& transform = scene.getTransform(entity);
+    PointLightComponent* pointLight = scene.pointLights.find(entity);
+
     ImGui::SetNextWindowPos(ImVec2{5, 510}, ImGuiCond_FirstUseEver);
     ImGui::SetNextWindowSize(ImVec2{350, 315}, ImGuiCond_FirstUseEver);
 
     if (ImGui::Begin("Inspector")) {
         if (ImGui::CollapsingHeader("Transform Component", ImGuiTreeNodeFlags_DefaultOpen)) {
-            ImGui::DragFloat3("Position", glm::value_ptr(object.transform.translation), 0.02f);
-            ImGui::DragFloat3("Scale", glm::value_ptr(object.transform.scale), 0.02f);
-            ImGui::DragFloat3("Rotation", glm::value_ptr(object.transform.rotation), 0.02f);
+            ImGui::DragFloat3("Position", glm::value_ptr(transform.translation), 0.02f);
+            ImGui::DragFloat3("Scale", glm::value_ptr(transform.scale), 0.02f);
+            ImGui::DragFloat3("Rotation", glm::value_ptr(transform.rotation), 0.02f);
         }
 
-        renderTransformGizmo(object.transform); // render object's gizmo along with its inspector tool
+        renderTransformGizmo(transform); // render object's gizmo along with its inspector tool
 
-        if (isPointLight) {
+        if (pointLight != nullptr) {
             if (ImGui::CollapsingHeader("PointLight Component", ImGuiTreeNodeFlags_DefaultOpen)) {
-                ImGui::SliderFloat("Light intensity", &object.pointLight->lightIntensity, .0f, 100.0f);
-                ImGui::SliderFloat("Light radius", &object.transform.scale.x, 0.01f, 5.0f);
-                ImGui::ColorEdit3("Light color", (float*)&object.color);
-                ImGui::Checkbox("Demo Carousel Enabled", &object.pointLight->carouselEnabled);
+                ImGui::SliderFloat("Light intensity", &pointLight->lightIntensity, .0f, 100.0f);
+                ImGui::SliderFloat("Light radius", &transform.scale.x, 0.01f, 5.0f);
+                ImGui::ColorEdit3("Light color", (float*)&pointLight->color);
+                ImGui::Checkbox("Demo Carousel Enabled", &pointLight->carouselEnabled);
             }
         }
     }
@@ -311,8 +326,10 @@ void RMResearchGUI::renderTransformGizmo(TransformComponent& transform)
 
     ImGuiIO& io = ImGui::GetIO();
     ImGuizmo::SetRect(0, 0, io.DisplaySize.x, io.DisplaySize.y);
-    ImGuizmo::Manipulate(glm::value_ptr(camera.getView()), glm::value_ptr(guizmoProj), currentGizmoOperation,
-        currentGizmoMode, glm::value_ptr(modelMat), glm::value_ptr(deltaMat), nullptr);
-
-    transform.fromModelMatrix(modelMat);
+    // the angles are extracted back only when the gizmo has moved the object
+    if (ImGuizmo::Manipulate(glm::value_ptr(camera.getView()), glm::value_ptr(guizmoProj), currentGizmoOperation,
+        currentGizmoMode, glm::value_ptr(modelMat), glm::value_ptr(deltaMat), nullptr))
+    {
+        transform.fromModelMatrix(modelMat);
+    }
 }
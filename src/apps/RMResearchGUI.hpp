@@ -2,7 +2,7 @@
 
 #include "../src/renderer/Device.hpp"
 #include "../src/renderer/Window.hpp"
-#include "../src/renderer/SceneObject.hpp"
+#include "../src/renderer/Scene.hpp"
 #include "../src/renderer/Camera.hpp"
 #include "./common/KeyboardMovementController.hpp"
 #include "../src/renderer/FrameInfo.hpp"
@@ -28,7 +28,7 @@ class RMResearchGUI {
 public:
     RMResearchGUI(WrpWindow& window, WrpDevice& device, VkRenderPass renderPass,
         uint32_t imageCount, WrpCamera& camera, KeyboardMovementController& kmc,
-        SceneObject::Map& sceneObjects, RenderingSettings& renderingSettings);
+        WrpScene& scene, RenderingSettings& renderingSettings);
     ~RMResearchGUI();
 
     RMResearchGUI() = default;
@@ -54,10 +54,10 @@ public:
 private:
     void setupMainSettingsPanel();
     void enumerateObjectsInTheScene();
-    void inspectObject(SceneObject& object, bool isPointLight);
+    void inspectObject(WrpEntity entity);
     void renderTransformGizmo(TransformComponent& transform);
 
-    int pickedItemSceneObjectsList = 1;
+    WrpEntity pickedItemSceneObjectsList = 1;
 
     bool showImGuiDemoWindow = false;
     bool enableGizmo = true;
@@ -65,8 +65,9 @@ private:
     WrpDevice& wrpDevice;
     WrpCamera& camera;
     KeyboardMovementController& kmc;
-    SceneObject::Map& sceneObjects;
+    WrpScene& scene;
     RenderingSettings& renderingSettings;
 
     VkDescriptorPool descriptorPool; // ImGui's descriptor pool
+    bool headless = false;           // no window: ImGui isn't initialized, the GUI isn't drawn
 };
@@ -6,7 +6,17 @@
 #include "../renderer/systems/PointLightSystem.hpp"
 #include "../renderer/Buffer.hpp"
 #include "../renderer/Camera.hpp"
+#include "../renderer/RenderQueue.hpp"
+#include "../renderer/ParallelRecorder.hpp"
+#include "../renderer/DepthPyramid.hpp"
+#include "../renderer/GpuTimer.hpp"
+#include "../renderer/ClusteredLighting.hpp"
+#include "../renderer/TransformUpdater.hpp"
+#include "../renderer/ShaderModule.hpp"
+#include "../renderer/UniformRing.hpp"
 #include "./common/KeyboardMovementController.hpp"
+#include "./common/CullingValidation.hpp"
+#include "./common/FrameBenchmark.hpp"
 
 // libs
 #define GLM_FORCE_RADIANS
@@ -20,60 +30,81 @@
 // std
 #include <stdexcept>
 #include <cassert>
+#include <algorithm>
 #include <array>
 #include <chrono>
+#include <iostream>
 #include <numeric>
 
 #define MAX_FRAME_TIME 0.5f
+#define CAMERA_NEAR 0.1f
+#define CAMERA_FAR 100.f
+#define UNIFORM_RING_FRAME_CAPACITY (64 * 1024) // bytes of uniform data a frame can allocate
 
-SceneEditorApp::SceneEditorApp(int preloadScene)
+SceneEditorApp::SceneEditorApp(const AppSettings& settings) : appSettings{settings}
 {
-    // global descriptor pool designed for the entire app 
-    globalPool = WrpDescriptorPool::Builder(wrpDevice)
-        .setMaxSets(wrpRenderer.getSwapChainImageCount())
-        .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, wrpRenderer.getSwapChainImageCount())
+    // global descriptor allocator designed for the entire app, it grows with new pools when needed
+    globalDescriptorAllocator = WrpDescriptorAllocator::Builder(wrpDevice)
+        .setInitialSetsPerPool(wrpRenderer.getFramesInFlight())
+        .addPoolSizeRatio(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.f)
+        .addPoolSizeRatio(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.f)
+        .addPoolSizeRatio(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3.f)
         .build();
+    globalDescriptorSetCache = std::make_unique<WrpDescriptorSetCache>(*globalDescriptorAllocator);
 
-    if (preloadScene == 1) {
+    if (appSettings.preloadScene == 1) {
         loadScene1();
-    } else if (preloadScene == 2) {
+    } else if (appSettings.preloadScene == 2) {
         loadScene2();
+    } else if (appSettings.preloadScene == 3) {
+        loadScene3();
+    } else if (appSettings.preloadScene == 4) {
+        loadScene4();
+    } else if (appSettings.preloadScene == 5) {
+        loadScene5();
     }
 }
 
 SceneEditorApp::~SceneEditorApp() {}
 
-void SceneEditorApp::run()
+bool SceneEditorApp::run()
 {
-    // Uniform Buffers creation
-    std::vector<std::unique_ptr<WrpBuffer>> uboBuffers(wrpRenderer.getSwapChainImageCount());
-    for (int i = 0; i < uboBuffers.size(); ++i)
-    {
-        uboBuffers[i] = std::make_unique<WrpBuffer>(
-            wrpDevice,
-            sizeof(GlobalUbo),
-            1,
-            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            // PROPERTY_HOST_COHERENT is not used to demonstrate explicit memory flush to device
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
-        );
-        uboBuffers[i]->map();
-    }
+    // startup time (pipelines creation included) is printed after the first frame,
+    // to compare cold and warm pipeline cache runs
+    auto startupBegin = std::chrono::high_resolution_clock::now();
+    bool firstFrameRendered = false;
+
+    // per-frame uniform data (GlobalUbo first) is sub-allocated from one persistently mapped buffer
+    // and bound by dynamic offsets
+    WrpUniformRing uniformRing{wrpDevice, wrpRenderer.getFramesInFlight(),
+        UNIFORM_RING_FRAME_CAPACITY};
 
     // Global Descriptor Set Layout for the entire app
     auto globalDescriptorSetLayout = WrpDescriptorSetLayout::Builder(wrpDevice)
-        .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS, 1)
+        .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT, 1)
+        // point lights and their clusters, see WrpClusteredLighting
+        .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 1)
+        .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 1)
+        .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 1)
         .build();
+    WrpClusteredLighting clusteredLighting{wrpDevice, wrpRenderer.getFramesInFlight(),
+        globalDescriptorSetLayout->getDescriptorSetLayout()};
 
-    // Getting Descriptor Sets from pool
-    std::vector<VkDescriptorSet> globalDescriptorSets(wrpRenderer.getSwapChainImageCount());
+    // Getting Descriptor Sets from the cache (identical sets are allocated once)
+    std::vector<VkDescriptorSet> globalDescriptorSets(wrpRenderer.getFramesInFlight());
     for (int i = 0; i < globalDescriptorSets.size(); ++i)
     {
-        VkDescriptorBufferInfo bufferInfo = uboBuffers[i]->descriptorInfo(); // инфа о буфере для дескриптора
+        VkDescriptorBufferInfo bufferInfo = uniformRing.descriptorInfo(sizeof(GlobalUbo)); // инфа о буфере для дескриптора
+        VkDescriptorBufferInfo lightsInfo = clusteredLighting.getLightBufferInfo(i);
+        VkDescriptorBufferInfo clustersInfo = clusteredLighting.getClusterBufferInfo(i);
+        VkDescriptorBufferInfo lightIndicesInfo = clusteredLighting.getLightIndexBufferInfo(i);
 
-        WrpDescriptorWriter(*globalDescriptorSetLayout, *globalPool)
+        WrpDescriptorWriter(*globalDescriptorSetLayout, *globalDescriptorAllocator)
             .writeBuffer(0, &bufferInfo)
-            .build(globalDescriptorSets[i]);
+            .writeBuffer(1, &lightsInfo)
+            .writeBuffer(2, &clustersInfo)
+            .writeBuffer(3, &lightIndicesInfo)
+            .build(globalDescriptorSets[i], *globalDescriptorSetCache);
     }
 
     WrpCamera camera{};
@@ -81,28 +112,49 @@ void SceneEditorApp::run()
     //camera.setViewDirection(glm::vec3{0.f}, glm::vec3{0.5f, 0.f, 1.f});
     //camera.setViewTarget(glm::vec3{-3.f, -3.f, 23.f}, {.0f, .0f, 1.5f});
 
-    // SceneObject for the editor camera 
-    auto cameraObject = SceneObject::createSceneObject("Camera");
-    cameraObject.transform.rotation = {.0f, .0f, .0f};
-    sceneObjects.emplace(cameraObject.getId(), std::move(cameraObject));
+    // entity for the editor camera
+    WrpEntity cameraObject = scene.createEntity("Camera");
+    scene.getTransform(cameraObject).rotation = {.0f, .0f, .0f};
     KeyboardMovementController cameraController{};
 
     RenderingSettings renderingSettings{1, 0};
-    FrameInfo frameInfo{0, 0, nullptr, camera, nullptr, sceneObjects, renderingSettings};
+    FrameInfo frameInfo{0, 0, nullptr, camera, nullptr, scene, renderingSettings};
 
     SimpleRenderSystem simpleRenderSystem{
         wrpDevice,
         wrpRenderer,
+        pipelineVariantCache,
         globalDescriptorSetLayout->getDescriptorSetLayout(),
     };
     TextureRenderSystem textureRenderSystem{
         wrpDevice,
         wrpRenderer,
+        pipelineVariantCache,
         globalDescriptorSetLayout->getDescriptorSetLayout(),
         frameInfo
     };
+    simpleRenderSystem.setCullingValidation(appSettings.validateGpuCulling);
+    textureRenderSystem.setCullingValidation(appSettings.validateGpuCulling);
+    WrpDepthPyramid depthPyramid{wrpDevice, wrpRenderer}; // occluders of the late culling pass
+    WrpGpuTimer gpuTimer{wrpDevice, wrpRenderer.getFramesInFlight()};
+    WrpGpuTimer lightCullingTimer{wrpDevice, wrpRenderer.getFramesInFlight()};
+    // --bench: the camera follows the script's path with a fixed timestep and the frame times are collected
+    std::unique_ptr<FrameBenchmark> benchmark;
+    if (appSettings.benchmark)
+    {
+        benchmark = std::make_unique<FrameBenchmark>(*appSettings.benchmark);
+        gpuTimer.setResultCallback([&benchmark](float ms) { benchmark->addGpuTime(ms); });
+    }
+    WrpRenderQueue renderQueue{};
+    WrpTransformUpdater transformUpdater{};
+    WrpParallelRecorder parallelRecorder{wrpDevice, wrpRenderer, appSettings.recordThreads};
+    if (appSettings.recordThreads > 0) {
+        renderingSettings.recordThreads = static_cast<int>(parallelRecorder.getThreadCount());
+    }
     PointLightSystem pointLightSystem{
         wrpDevice,
+        pipelineVariantCache,
+        wrpRenderer.getFramesInFlight(),
         wrpRenderer.getSwapChainRenderPass(),
         globalDescriptorSetLayout->getDescriptorSetLayout()
     };
@@ -111,19 +163,38 @@ void SceneEditorApp::run()
         wrpWindow,
         wrpDevice,
         wrpRenderer.getSwapChainRenderPass(),
-        wrpRenderer.getSwapChainImageCount(),
+        // imgui rotates its vertex buffers by this count, it must cover the frames in flight
+        std::max(wrpRenderer.getSwapChainImageCount(), wrpRenderer.getFramesInFlight()),
         camera,
         cameraController,
-        sceneObjects,
+        scene,
         renderingSettings
     };
+    appGUI.maxRecordThreads = static_cast<int>(parallelRecorder.getThreadCount());
+
+    // systems request their pipelines asynchronously; wait for all of them before the first frame
+    pipelineCompiler.waitIdle();
+    simpleRenderSystem.awaitPipelines();
+    textureRenderSystem.awaitPipelines();
+    pointLightSystem.awaitPipelines();
+
+    // variants for the other rendering settings are compiled in background while the first frames are rendered
+    if (appSettings.prewarmPipelineVariants) {
+        simpleRenderSystem.prewarmPipelineVariants();
+        textureRenderSystem.prewarmPipelineVariants();
+    }
 
     auto currentTime = std::chrono::high_resolution_clock::now();
+    uint32_t renderedFrames = 0;
+    int nextFrameIndex = 0;
 
     // MAIN LOOP
-    while (!wrpWindow.shouldClose())
+    while (!wrpWindow.shouldClose() && (appSettings.frames == 0 || renderedFrames < appSettings.frames)
+        && !(benchmark && benchmark->isFinished()))
     {
-        glfwPollEvents(); // Process glfw events from queue
+        if (!wrpWindow.isHeadless()) {
+            glfwPollEvents(); // Process glfw events from queue
+        }
 
         // calculating frameTime and currentTime 
         auto newTime = std::chrono::high_resolution_clock::now();
@@ -132,23 +203,39 @@ void SceneEditorApp::run()
 
         // Max frame time bound. For example, frameTime can become too long when window are in resizing mode.
         frameTime = glm::min(frameTime, MAX_FRAME_TIME);
+        if (benchmark) {
+            frameTime = benchmark->getTimestep(); // the animations are the same in every run
+        }
 
         // Move/rotate camera corresponding to the input
-        cameraController.moveInPlaneXZ(wrpWindow.getGLFWwindow(), frameTime, cameraObject);
-        camera.setViewYXZ(cameraObject.transform.translation, cameraObject.transform.rotation);
+        // the reference isn't kept between frames, the GUI can add entities and move the transforms
+        TransformComponent& cameraTransform = scene.getTransform(cameraObject);
+        if (benchmark) {
+            benchmark->placeCamera(cameraTransform);
+        }
+        else if (!wrpWindow.isHeadless()) {
+            cameraController.moveInPlaneXZ(wrpWindow.getGLFWwindow(), frameTime, cameraTransform);
+        }
+        camera.setViewYXZ(cameraTransform.translation, cameraTransform.rotation);
 
         float aspect = wrpRenderer.getAspectRatio();
         //camera.setOrthographicProjection(-aspect, aspect, -1, 1, -1, 1);
-        camera.setPerspectiveProjection(glm::radians(50.f), aspect, 0.1f, 100.f);
+        camera.setPerspectiveProjection(glm::radians(50.f), aspect, CAMERA_NEAR, CAMERA_FAR);
 
         // frame rendering
         if (auto commandBuffer = wrpRenderer.beginFrame()) // beginFrame() will return nullptr if SwapChain recreation is needed
         {
+            if (benchmark) {
+                benchmark->beginFrame();
+            }
             appGUI.newFrame(); // tell imgui that we're starting a new frame
 
+            pipelineVariantCache.nextFrame();
+
             int frameIndex = wrpRenderer.getFrameIndex();
+            uniformRing.beginFrame(frameIndex); // the frame's fence is waited by beginFrame()
             FrameInfo frameInfo{frameIndex, frameTime, commandBuffer, camera,
-                globalDescriptorSets[frameIndex], sceneObjects, renderingSettings};
+                globalDescriptorSets[frameIndex], scene, renderingSettings};
 
             // UPDATE SECTION
             GlobalUbo ubo{};
@@ -160,27 +247,145 @@ void SceneEditorApp::run()
             ubo.diffuseProportion = appGUI.diffuseProportion;
             ubo.roughness = appGUI.roughness;
             ubo.indexOfRefraction = appGUI.indexOfRefraction;
-            pointLightSystem.update(frameInfo, ubo);
-            uboBuffers[frameIndex]->writeToBuffer(&ubo);
-            uboBuffers[frameIndex]->flush();
+            auto frustumPlanes = camera.getFrustumPlanes();
+            std::copy(frustumPlanes.begin(), frustumPlanes.end(), ubo.frustumPlanes);
+            pointLightSystem.moveCarousel(frameInfo);
+            // the matrices of the objects moved by the GUI, controllers and systems are rebuilt in one batch
+            auto transformUpdateBegin = std::chrono::high_resolution_clock::now();
+            appGUI.renderStats.updatedTransforms = transformUpdater.update(scene);
+            appGUI.renderStats.transformUpdateCpuMs = std::chrono::duration<float, std::chrono::milliseconds::period>(
+                std::chrono::high_resolution_clock::now() - transformUpdateBegin).count();
+            pointLightSystem.update(frameInfo);
+            clusteredLighting.update(frameIndex, pointLightSystem.getLights(), ubo, wrpRenderer.getSwapChainExtent(),
+                CAMERA_NEAR, CAMERA_FAR, renderingSettings.clusteredLighting);
+            frameInfo.globalUboOffset = uniformRing.push(ubo);
+            uniformRing.flush();
 
             // RENDER SECTION
-            wrpRenderer.beginSwapChainRenderPass(commandBuffer, appGUI.clearColor);
+            gpuTimer.begin(commandBuffer, frameIndex);
+            lightCullingTimer.begin(commandBuffer, frameIndex);
+            clusteredLighting.cull(commandBuffer, globalDescriptorSets[frameIndex], frameInfo.globalUboOffset);
+            lightCullingTimer.end(commandBuffer, frameIndex);
+            // the objects are uploaded and culled by compute passes, which can't be recorded inside a render pass
+            auto recordBegin = std::chrono::high_resolution_clock::now();
+            sceneBvh.sync(scene); // the objects could be moved, added or removed by the GUI
+            frameInfo.sceneBvh = &sceneBvh.getBvh();
+            bool occlusionCulling = renderingSettings.occlusionCulling && renderingSettings.gpuCulling
+                && renderingSettings.instancing;
+            frameInfo.depthPyramid = occlusionCulling ? &depthPyramid : nullptr;
+            simpleRenderSystem.prepareSceneObjects(frameInfo);
+            textureRenderSystem.prepareSceneObjects(frameInfo);
+
+            // with recording threads the render pass consists of secondary command buffers only
+            bool parallelRecording = renderingSettings.recordThreads > 0;
+            VkSubpassContents subpassContents = parallelRecording
+                ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE;
+            if (parallelRecording) {
+                parallelRecorder.beginFrame(frameIndex);
+            }
+
+            wrpRenderer.beginSwapChainRenderPass(commandBuffer, appGUI.clearColor, subpassContents);
 
             // Order of objects render is matter, because we need to ensure that we rendered
             // fully opaque objects (like textured models) before rendering translucent objects (like point lights)
-            simpleRenderSystem.renderSceneObjects(frameInfo);
-            textureRenderSystem.renderSceneObjects(frameInfo);
-            pointLightSystem.render(frameInfo);
+            // draws are sorted by the queue to skip the redundant binds: opaque ones by state, then the translucent ones
+            renderQueue.resetStatistics();
+            auto recordRenderQueue = [&]() {
+                renderQueue.sort();
+                if (parallelRecording) {
+                    parallelRecorder.record(commandBuffer, renderQueue, static_cast<unsigned int>(renderingSettings.recordThreads));
+                }
+                else {
+                    renderQueue.record(commandBuffer);
+                }
+                renderQueue.clear();
+            };
+            simpleRenderSystem.renderSceneObjects(frameInfo, renderQueue);
+            textureRenderSystem.renderSceneObjects(frameInfo, renderQueue);
+            if (occlusionCulling)
+            {
+                // the objects visible in the previous frame are drawn, the depth pyramid is built from their depth
+                // and the rest of the objects are culled against it
+                recordRenderQueue();
+                wrpRenderer.endSwapChainRenderPass(commandBuffer);
+                depthPyramid.build(commandBuffer, frameIndex);
+                simpleRenderSystem.prepareLateSceneObjects(frameInfo);
+                textureRenderSystem.prepareLateSceneObjects(frameInfo);
+
+                wrpRenderer.resumeSwapChainRenderPass(commandBuffer, subpassContents);
+                simpleRenderSystem.renderSceneObjects(frameInfo, renderQueue);
+                textureRenderSystem.renderSceneObjects(frameInfo, renderQueue);
+            }
+            pointLightSystem.render(frameInfo, renderQueue);
+            recordRenderQueue();
+            appGUI.renderStats.recordCpuMs = std::chrono::duration<float, std::chrono::milliseconds::period>(
+                std::chrono::high_resolution_clock::now() - recordBegin).count();
+            appGUI.renderStats.drawCalls = simpleRenderSystem.getDrawCallCount() + textureRenderSystem.getDrawCallCount();
+            appGUI.renderStats.instances = simpleRenderSystem.getInstanceCount() + textureRenderSystem.getInstanceCount();
+            appGUI.renderStats.gpuFrameMs = gpuTimer.getLastMs();
+            appGUI.renderStats.binds = renderQueue.getBindCount();
+            appGUI.renderStats.skippedBinds = renderQueue.getSkippedBindCount();
+            appGUI.renderStats.visibleSubMeshes = simpleRenderSystem.getVisibleSubMeshCount() + textureRenderSystem.getVisibleSubMeshCount();
+            appGUI.renderStats.culledSubMeshes = simpleRenderSystem.getCulledSubMeshCount() + textureRenderSystem.getCulledSubMeshCount();
+            appGUI.renderStats.cullingCpuMs = simpleRenderSystem.getCullingCpuMs() + textureRenderSystem.getCullingCpuMs();
+            appGUI.renderStats.earlyVisibleSubMeshes = simpleRenderSystem.getEarlyVisibleSubMeshCount()
+                + textureRenderSystem.getEarlyVisibleSubMeshCount();
+            appGUI.renderStats.lateVisibleSubMeshes = simpleRenderSystem.getLateVisibleSubMeshCount()
+                + textureRenderSystem.getLateVisibleSubMeshCount();
+            appGUI.renderStats.occludedSubMeshes = simpleRenderSystem.getOccludedSubMeshCount()
+                + textureRenderSystem.getOccludedSubMeshCount();
+            appGUI.renderStats.pointLights = static_cast<uint32_t>(pointLightSystem.getLights().size());
+            appGUI.renderStats.lightCullingGpuMs = lightCullingTimer.getLastMs();
             appGUI.setupGUI();
-            appGUI.render(commandBuffer);
+            if (parallelRecording)
+            {
+                parallelRecorder.recordOnMainThread(commandBuffer,
+                    [&](VkCommandBuffer guiCommandBuffer) { appGUI.render(guiCommandBuffer); });
+            }
+            else {
+                appGUI.render(commandBuffer);
+            }
 
             wrpRenderer.endSwapChainRenderPass(commandBuffer);
+            gpuTimer.end(commandBuffer, frameIndex);
             wrpRenderer.endFrame();
+            renderedFrames++;
+            nextFrameIndex = (frameIndex + 1) % static_cast<int>(wrpRenderer.getFramesInFlight());
+            if (benchmark)
+            {
+                benchmark->submitFrame({
+                    simpleRenderSystem.getDrawCallCount() + textureRenderSystem.getDrawCallCount(),
+                    simpleRenderSystem.getTriangleCount() + textureRenderSystem.getTriangleCount()});
+            }
+
+            if (!firstFrameRendered)
+            {
+                firstFrameRendered = true;
+                float startupMs = std::chrono::duration<float, std::chrono::milliseconds::period>(
+                    std::chrono::high_resolution_clock::now() - startupBegin).count();
+                std::cout << "Startup to first frame: " << startupMs << " ms (pipeline cache "
+                          << (wrpDevice.isPipelineCacheWarm() ? "warm" : "cold") << ", "
+                          << pipelineCompiler.getThreadCount() << " pipeline threads)" << std::endl;
+                ShaderModule::printCacheStatistics();
+            }
         }
     }
 
     vkDeviceWaitIdle(wrpDevice.device());
+    if (benchmark)
+    {
+        gpuTimer.readRemainingResults(nextFrameIndex); // the times of the last frames in flight
+        benchmark->writeResults(wrpDevice.getMemoryUsage(), getPeakHostMemoryUsage());
+    }
+    if (!appSettings.capturePath.empty()) {
+        wrpRenderer.saveLastFrame(appSettings.capturePath);
+    }
+    bool passed = true;
+    if (appSettings.validateGpuCulling) {
+        passed = finishCullingValidation(simpleRenderSystem, textureRenderSystem);
+    }
+    globalDescriptorSetCache->clear(); // the cached sets reference the layout and buffers of this run
+    return passed;
 }
 
 void SceneEditorApp::loadScene1()
@@ -188,38 +393,44 @@ void SceneEditorApp::loadScene1()
     // Viking Room model
     std::shared_ptr<WrpModel> vikingRoom = WrpModel::createModelFromObjTexture(
         wrpDevice, ENGINE_DIR"models/viking_room.obj", MODELS_DIR"textures/viking_room.png");
-    auto vikingRoomObj = SceneObject::createSceneObject("VikingRoom");
-    vikingRoomObj.model = vikingRoom;
-    vikingRoomObj.transform.translation = {.0f, .0f, 0.f};
-    vikingRoomObj.transform.scale = glm::vec3(1.f, 1.f, 1.f);
-    vikingRoomObj.transform.rotation = glm::vec3(1.57f, 2.f, 0.f);
-    sceneObjects.emplace(vikingRoomObj.getId(), std::move(vikingRoomObj));
+    WrpEntity vikingRoomObj = scene.createEntity("VikingRoom");
+    TransformComponent& vikingRoomTransform = scene.getTransform(vikingRoomObj);
+    scene.setModel(vikingRoomObj, vikingRoom);
+    vikingRoomTransform.translation = {.0f, .0f, 0.f};
+    vikingRoomTransform.scale = glm::vec3(1.f, 1.f, 1.f);
+    vikingRoomTransform.rotation = glm::vec3(1.57f, 2.f, 0.f);
 
     // Sponza model
     std::shared_ptr<WrpModel> sponza = WrpModel::createModelFromObjMtl(wrpDevice, "../../../models/sponza.obj");
-    auto sponzaObj = SceneObject::createSceneObject("Sponza");
-    sponzaObj.model = sponza;
-    sponzaObj.transform.translation = {-3.f, 1.0f, -2.f};
-    sponzaObj.transform.scale = glm::vec3(0.01f, 0.01f, 0.01f);
-    sponzaObj.transform.rotation = glm::vec3(3.15f, 0.f, 0.f);
-    sceneObjects.emplace(sponzaObj.getId(), std::move(sponzaObj));
+    WrpEntity sponzaObj = scene.createEntity("Sponza");
+    TransformComponent& sponzaTransform = scene.getTransform(sponzaObj);
+    scene.setModel(sponzaObj, sponza);
+    sponzaTransform.translation = {-3.f, 1.0f, -2.f};
+    sponzaTransform.scale = glm::vec3(0.01f, 0.01f, 0.01f);
+    sponzaTransform.rotation = glm::vec3(3.15f, 0.f, 0.f);
 }
 
 void SceneEditorApp::loadScene2()
 {
     std::shared_ptr<WrpModel> bunny = WrpModel::createModelFromObjMtl(wrpDevice, "../../../models/bunny.obj");
-    auto bunnyObj = SceneObject::createSceneObject();
-    bunnyObj.model = bunny;
-    bunnyObj.transform.translation = {0.f, 0.f, 0.f};
-    bunnyObj.transform.scale = glm::vec3(0.4f, 0.4f, 0.4f);
-    bunnyObj.transform.rotation = glm::vec3(3.15f, 0.f, 0.f);
-    sceneObjects.emplace(bunnyObj.getId(), std::move(bunnyObj));
+    WrpEntity bunnyObj = scene.createEntity();
+    TransformComponent& bunnyTransform = scene.getTransform(bunnyObj);
+    scene.setModel(bunnyObj, bunny);
+    bunnyTransform.translation = {0.f, 0.f, 0.f};
+    bunnyTransform.scale = glm::vec3(0.4f, 0.4f, 0.4f);
+    bunnyTransform.rotation = glm::vec3(3.15f, 0.f, 0.f);
 
     const int gridX = 5;
     const int gridY = 5;
     const int pointLightNumber = 5;
     constexpr int modelsToPlacePointLight = gridX * gridY / pointLightNumber;
 
+    // the lights are the children of a rig, moving the rig moves all of them
+    WrpEntity lightRig = scene.createEntity("LightRig");
+    TransformComponent& lightRigTransform = scene.getTransform(lightRig);
+    lightRigTransform.scale = glm::vec3(1.f, 1.f, 1.f);
+    lightRigTransform.rotation = glm::vec3(0.f, 0.f, 0.f);
+
     int count = 0;
     for (int i = 0; i < gridX; i++)
     {
@@ -227,20 +438,118 @@ void SceneEditorApp::loadScene2()
         {
             if (count == modelsToPlacePointLight)
             {
-                auto pointLight = SceneObject::makePointLight();
-                pointLight.pointLight->carouselEnabled = true;
-                pointLight.transform.translation = {i, -1.5f, j};
-                sceneObjects.emplace(pointLight.getId(), std::move(pointLight));
+                WrpEntity pointLight = scene.createPointLight();
+                scene.pointLights.get(pointLight).carouselEnabled = true;
+                scene.getTransform(pointLight).translation = {i, -1.5f, j};
+                scene.setParent(pointLight, lightRig);
                 count = 0;
             }
-            bunnyObj = SceneObject::createSceneObject();
-            bunnyObj.model = bunny;
-            bunnyObj.transform.translation = {i, 0.f, j};
-            bunnyObj.transform.scale = glm::vec3(0.4f, 0.4f, 0.4f);
-            bunnyObj.transform.rotation = glm::vec3(3.15f, 0.f, 0.f);
-            sceneObjects.emplace(bunnyObj.getId(), std::move(bunnyObj));
+            bunnyObj = scene.createEntity();
+            TransformComponent& gridBunnyTransform = scene.getTransform(bunnyObj);
+            scene.setModel(bunnyObj, bunny);
+            gridBunnyTransform.translation = {i, 0.f, j};
+            gridBunnyTransform.scale = glm::vec3(0.4f, 0.4f, 0.4f);
+            gridBunnyTransform.rotation = glm::vec3(3.15f, 0.f, 0.f);
 
             ++count;
         }
     }
 }
+
+// Stress scene for instancing: 10k copies of one model drawn by SimpleRenderSystem
+void SceneEditorApp::loadScene3()
+{
+    std::shared_ptr<WrpModel> bunny = WrpModel::createModelFromObjMtl(wrpDevice, "../../../models/bunny.obj");
+
+    const int gridX = 100;
+    const int gridZ = 100;
+    const float spacing = 0.5f;
+    for (int i = 0; i < gridX; i++)
+    {
+        for (int j = 0; j < gridZ; j++)
+        {
+            WrpEntity bunnyObj = scene.createEntity();
+            TransformComponent& bunnyTransform = scene.getTransform(bunnyObj);
+            scene.setModel(bunnyObj, bunny);
+            bunnyTransform.translation = {(i - gridX / 2) * spacing, 0.f, (j - gridZ / 2) * spacing};
+            bunnyTransform.scale = glm::vec3(0.2f, 0.2f, 0.2f);
+            bunnyTransform.rotation = glm::vec3(3.15f, 0.f, 0.f);
+        }
+    }
+
+    WrpEntity pointLight = scene.createPointLight();
+    scene.getTransform(pointLight).translation = {0.f, -2.f, 0.f};
+}
+
+// Occlusion culling test scene: a wall in front of the camera hides a grid of cubes, a few of them stick out
+// at the sides and stay visible. Drawn by TextureRenderSystem.
+void SceneEditorApp::loadScene4()
+{
+    std::shared_ptr<WrpModel> cube = WrpModel::createModelFromObjTexture(
+        wrpDevice, ENGINE_DIR"models/cube.obj", MODELS_DIR"default.png");
+
+    WrpEntity wallObj = scene.createEntity("Wall");
+    TransformComponent& wallTransform = scene.getTransform(wallObj);
+    scene.setModel(wallObj, cube);
+    wallTransform.translation = {0.f, 0.f, 5.f};
+    wallTransform.scale = glm::vec3(6.f, 4.f, 0.4f);
+
+    const int gridX = 21;
+    const int gridZ = 20;
+    const float spacing = 0.5f;
+    for (int i = 0; i < gridX; i++)
+    {
+        for (int j = 0; j < gridZ; j++)
+        {
+            WrpEntity cubeObj = scene.createEntity();
+            TransformComponent& cubeTransform = scene.getTransform(cubeObj);
+            scene.setModel(cubeObj, cube);
+            cubeTransform.translation = {(i - gridX / 2) * spacing, 0.f, 10.f + j};
+            cubeTransform.scale = glm::vec3(0.2f, 0.2f, 0.2f);
+        }
+    }
+
+    WrpEntity pointLight = scene.createPointLight();
+    scene.getTransform(pointLight).translation = {0.f, -2.f, 2.f};
+}
+
+// Clustered lighting stress scene: a floor of cubes lit by 2048 small coloured point lights moving in the carousel
+void SceneEditorApp::loadScene5()
+{
+    std::shared_ptr<WrpModel> cube = WrpModel::createModelFromObjTexture(
+        wrpDevice, ENGINE_DIR"models/cube.obj", MODELS_DIR"default.png");
+
+    const int gridX = 64;
+    const int gridZ = 64;
+    const float spacing = 0.5f;
+    for (int i = 0; i < gridX; i++)
+    {
+        for (int j = 0; j < gridZ; j++)
+        {
+            WrpEntity cubeObj = scene.createEntity();
+            TransformComponent& cubeTransform = scene.getTransform(cubeObj);
+            scene.setModel(cubeObj, cube);
+            cubeTransform.translation = {(i - gridX / 2) * spacing, 0.f, (j - gridZ / 2) * spacing};
+            cubeTransform.scale = glm::vec3(0.24f, 0.1f, 0.24f);
+        }
+    }
+
+    const std::array<glm::vec3, 6> colors{
+        glm::vec3{1.f, .1f, .1f}, glm::vec3{.1f, 1.f, .1f}, glm::vec3{.1f, .1f, 1.f},
+        glm::vec3{1.f, 1.f, .1f}, glm::vec3{.1f, 1.f, 1.f}, glm::vec3{1.f, .1f, 1.f}};
+    const int lightsX = 64;
+    const int lightsZ = 32;
+    const float lightSpacingX = gridX * spacing / lightsX;
+    const float lightSpacingZ = gridZ * spacing / lightsZ;
+    for (int i = 0; i < lightsX; i++)
+    {
+        for (int j = 0; j < lightsZ; j++)
+        {
+            // intensity 0.05 gives the radius of about 2.2 units, a light reaches a few cubes around it
+            WrpEntity pointLight = scene.createPointLight(0.05f, 0.03f, colors[(i + j) % colors.size()]);
+            scene.pointLights.get(pointLight).carouselEnabled = true;
+            scene.getTransform(pointLight).translation =
+                {(i - lightsX / 2) * lightSpacingX, -0.4f, (j - lightsZ / 2) * lightSpacingZ};
+        }
+    }
+}
@@ -4,7 +4,11 @@
 #include "../renderer/Device.hpp"
 #include "../renderer/Renderer.hpp"
 #include "../renderer/Descriptors.hpp"
-#include "../renderer/SceneObject.hpp"
+#include "../renderer/Scene.hpp"
+#include "../renderer/SceneBvh.hpp"
+#include "../renderer/PipelineCompiler.hpp"
+#include "../renderer/PipelineVariantCache.hpp"
+#include "./common/AppSettings.hpp"
 
 // std
 #include <memory>
@@ -16,24 +20,33 @@ public:
     static constexpr int WIDTH = 1600;
     static constexpr int HEIGHT = 1000;
 
-    SceneEditorApp(int preloadScene = 0);
+    SceneEditorApp(const AppSettings& settings = {});
     ~SceneEditorApp();
 
     // RAII
     SceneEditorApp(const SceneEditorApp&) = delete;
     SceneEditorApp& operator=(const SceneEditorApp&) = delete;
 
-    void run();
+    // returns false if a check requested by the settings failed (--validate-gpu-culling)
+    bool run();
 
 private:
     void loadScene1();
     void loadScene2();
+    void loadScene3();
+    void loadScene4();
+    void loadScene5();
 
     // Fields are initializing from top to bottom and destroying from bottom to top
-    WrpWindow wrpWindow{ WIDTH, HEIGHT, "Vulkan Renderer" };
+    AppSettings appSettings;
+    WrpWindow wrpWindow{ WIDTH, HEIGHT, "Vulkan Renderer", appSettings.headless };
     WrpDevice wrpDevice{ wrpWindow };
-    WrpRenderer wrpRenderer{ wrpWindow, wrpDevice };
-
-    std::unique_ptr<WrpDescriptorPool> globalPool{};
-    SceneObject::Map sceneObjects;
+    WrpRenderer wrpRenderer{ wrpWindow, wrpDevice, appSettings.framesInFlight };
+    WrpPipelineCompiler pipelineCompiler{ wrpDevice, appSettings.pipelineThreads };
+    WrpPipelineVariantCache pipelineVariantCache{ wrpDevice, pipelineCompiler, wrpRenderer.getFramesInFlight() };
+
+    std::unique_ptr<WrpDescriptorAllocator> globalDescriptorAllocator{};
+    std::unique_ptr<WrpDescriptorSetCache> globalDescriptorSetCache{};
+    WrpScene scene;
+    WrpSceneBvh sceneBvh;
 };
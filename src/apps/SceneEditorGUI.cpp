@@ -13,6 +13,8 @@
 #include <glm/gtc/type_ptr.hpp>
 
 // std
+#include <algorithm>
+#include <cfloat>
 #include <stdexcept>
 #include <fstream>
 #include <filesystem>
@@ -20,10 +22,13 @@
 SceneEditorGUI::SceneEditorGUI(
     WrpWindow& window, WrpDevice& device, VkRenderPass renderPass,
     uint32_t imageCount, WrpCamera& camera, KeyboardMovementController& kmc,
-    SceneObject::Map& sceneObjects, RenderingSettings& renderingSettings)
-    : wrpDevice{device}, camera{camera}, kmc{kmc}, sceneObjects{sceneObjects},
-    renderingSettings{renderingSettings}
+    WrpScene& scene, RenderingSettings& renderingSettings)
+    : wrpDevice{device}, camera{camera}, kmc{kmc}, scene{scene},
+    renderingSettings{renderingSettings}, headless{window.isHeadless()}
 {
+    // the tool fields keep their default values, the scene is rendered without the GUI
+    if (headless) return;
+
     VkInstance instance = device.getInstance();
     // custom vulkan function loader to support volk library
     ImGui_ImplVulkan_LoadFunctions([](const char* functionName, void* vulkanInstance) {
@@ -81,7 +86,7 @@ SceneEditorGUI::SceneEditorGUI(
     init_info.MinImageCount = 2;
     init_info.ImageCount = imageCount;
     init_info.MSAASamples = wrpDevice.getMaxUsableMSAASampleCount();
-    init_info.PipelineCache = VK_NULL_HANDLE;
+    init_info.PipelineCache = device.getPipelineCache();
     init_info.Allocator = VK_NULL_HANDLE;
     init_info.CheckVkResultFn = check_vk_result;
     ImGui_ImplVulkan_Init(&init_info);
@@ -90,6 +95,8 @@ SceneEditorGUI::SceneEditorGUI(
 
 SceneEditorGUI::~SceneEditorGUI()
 {
+    if (headless) return;
+
     ImGui_ImplVulkan_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -98,6 +105,8 @@ SceneEditorGUI::~SceneEditorGUI()
 
 void SceneEditorGUI::newFrame()
 {
+    if (headless) return;
+
     ImGui_ImplVulkan_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
@@ -108,6 +117,8 @@ void SceneEditorGUI::newFrame()
 // command buffer the necessary draw commands
 void SceneEditorGUI::render(VkCommandBuffer commandBuffer)
 {
+    if (headless) return;
+
     ImGui::Render();
     ImDrawData* drawdata = ImGui::GetDrawData();
     ImGui_ImplVulkan_RenderDrawData(drawdata, commandBuffer);
@@ -115,6 +126,8 @@ void SceneEditorGUI::render(VkCommandBuffer commandBuffer)
 
 void SceneEditorGUI::setupGUI()
 {
+    if (headless) return;
+
     // this function may include DockSpace layout creation in the future
     setupAllWindows();
 }
@@ -129,6 +142,29 @@ void SceneEditorGUI::setupAllWindows()
     setupObjectCreationPanel();
 }
 
+void SceneEditorGUI::showRecordingScaling()
+{
+    size_t threads = static_cast<size_t>(std::max(renderingSettings.recordThreads, 0));
+    if (recordCpuMsByThreads.size() <= threads) {
+        recordCpuMsByThreads.resize(threads + 1, 0.f);
+    }
+    // экспоненциальное сглаживание, чтобы значения не скакали от кадра к кадру
+    float& smoothedMs = recordCpuMsByThreads[threads];
+    smoothedMs = smoothedMs == 0.f ? renderStats.recordCpuMs : smoothedMs + (renderStats.recordCpuMs - smoothedMs) * 0.05f;
+
+    ImGui::PlotHistogram("##Recording Scaling", recordCpuMsByThreads.data(), static_cast<int>(recordCpuMsByThreads.size()),
+        0, "recording ms by threads (0 = inline)", 0.f, FLT_MAX, ImVec2(0, 60));
+}
+
+void SceneEditorGUI::showGpuFrameTime()
+{
+    float& smoothedMs = gpuFrameMsByDepthPrepass[renderingSettings.depthPrepass ? 1 : 0];
+    smoothedMs = smoothedMs == 0.f ? renderStats.gpuFrameMs : smoothedMs + (renderStats.gpuFrameMs - smoothedMs) * 0.05f;
+
+    ImGui::Text("GPU frame: %.3f ms (depth pre-pass off: %.3f ms, on: %.3f ms)",
+        renderStats.gpuFrameMs, gpuFrameMsByDepthPrepass[0], gpuFrameMsByDepthPrepass[1]);
+}
+
 void SceneEditorGUI::setupMainSettingsPanel()
 {
     ImGui::SetNextWindowPos(ImVec2{.0f, .0f}, ImGuiCond_FirstUseEver);
@@ -174,6 +210,27 @@ void SceneEditorGUI::setupMainSettingsPanel()
             ImGui::RadioButton("Wireframe", &renderingSettings.polygonFillMode, 1); ImGui::SameLine();
             ImGui::RadioButton("Point", &renderingSettings.polygonFillMode, 2);
 
+            ImGui::Checkbox("Instanced Indirect Draws", &renderingSettings.instancing);
+            ImGui::Checkbox("CPU Frustum Culling", &renderingSettings.cpuCulling);
+            ImGui::Checkbox("GPU Frustum Culling", &renderingSettings.gpuCulling);
+            ImGui::Checkbox("Occlusion Culling", &renderingSettings.occlusionCulling);
+            ImGui::Checkbox("Depth Pre-pass", &renderingSettings.depthPrepass);
+            ImGui::Checkbox("Clustered Lighting", &renderingSettings.clusteredLighting);
+            ImGui::SliderInt("Recording Threads", &renderingSettings.recordThreads, 0, maxRecordThreads);
+            ImGui::Text("Draw calls: %u, instances: %u, recording: %.3f ms",
+                renderStats.drawCalls, renderStats.instances, renderStats.recordCpuMs);
+            ImGui::Text("Transforms: %u updated, %.3f ms",
+                renderStats.updatedTransforms, renderStats.transformUpdateCpuMs);
+            showRecordingScaling();
+            showGpuFrameTime();
+            ImGui::Text("Binds: %u recorded, %u skipped as redundant", renderStats.binds, renderStats.skippedBinds);
+            ImGui::Text("CPU culling: %u visible, %u culled submeshes, %.3f ms",
+                renderStats.visibleSubMeshes, renderStats.culledSubMeshes, renderStats.cullingCpuMs);
+            ImGui::Text("Occlusion culling: %u early, %u late, %u occluded submeshes",
+                renderStats.earlyVisibleSubMeshes, renderStats.lateVisibleSubMeshes, renderStats.occludedSubMeshes);
+            ImGui::Text("Point lights: %u, binning into clusters: %.3f ms GPU",
+                renderStats.pointLights, renderStats.lightCullingGpuMs);
+
             ImGui::Text("Clear Color");
             ImGui::ColorEdit3("##Clear Color", (float*)&clearColor);
         }
@@ -203,49 +260,115 @@ void SceneEditorGUI::enumerateObjectsInTheScene()
     if (ImGui::Begin("All Objects")) {
         if (ImGui::BeginListBox("All Objects", ImVec2(-FLT_MIN, 10 * ImGui::GetTextLineHeightWithSpacing())))
         {
-            for (auto& obj : sceneObjects)
+            // the roots, the children are shown in their parents' tree nodes
+            for (WrpEntity entity : scene.getEntities())
             {
-                const bool isSelected = (pickedItemSceneObjectsList == obj.second.getId());
-                if (ImGui::Selectable(obj.second.getName().c_str(), isSelected)) {
-                    pickedItemSceneObjectsList = obj.second.getId();
+                if (scene.getParent(entity) == NULL_ENTITY) {
+                    showEntityNode(entity);
                 }
-
-                if (isSelected) { ImGui::SetItemDefaultFocus(); }
             }
             ImGui::EndListBox();
         }
+        ImGui::TextDisabled("Drop an object onto another one to make it a child");
 
-        // Create "Inspect Object" window for chosed type of scene object
-        if (sceneObjects[pickedItemSceneObjectsList].pointLight != nullptr) {
-            inspectObject(sceneObjects[pickedItemSceneObjectsList], true);
+        // the hierarchy isn't changed while the tree is drawn from it
+        if (droppedEntity != NULL_ENTITY)
+        {
+            scene.setParent(droppedEntity, dropParent, true);
+            droppedEntity = NULL_ENTITY;
+            dropParent = NULL_ENTITY;
         }
-        else {
-            inspectObject(sceneObjects[pickedItemSceneObjectsList], false);
+
+        // Create "Inspect Object" window for chosed type of scene object
+        if (scene.isAlive(pickedItemSceneObjectsList)) {
+            inspectObject(pickedItemSceneObjectsList);
         }
     }
     ImGui::End();
 }
 
-void SceneEditorGUI::inspectObject(SceneObject& object, bool isPointLight)
+void SceneEditorGUI::showEntityNode(WrpEntity entity)
 {
+    WrpEntity firstChild = scene.getFirstChild(entity);
+    ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_OpenOnArrow | ImGuiTreeNodeFlags_SpanAvailWidth;
+    if (firstChild == NULL_ENTITY) {
+        flags |= ImGuiTreeNodeFlags_Leaf | ImGuiTreeNodeFlags_NoTreePushOnOpen;
+    }
+    if (pickedItemSceneObjectsList == entity) {
+        flags |= ImGuiTreeNodeFlags_Selected;
+    }
+
+    const bool isOpen = ImGui::TreeNodeEx(reinterpret_cast<void*>(static_cast<uintptr_t>(entity)), flags,
+        "%s", scene.getName(entity).c_str());
+    if (ImGui::IsItemClicked() && !ImGui::IsItemToggledOpen()) {
+        pickedItemSceneObjectsList = entity;
+    }
+
+    if (ImGui::BeginDragDropSource())
+    {
+        ImGui::SetDragDropPayload("SCENE_ENTITY", &entity, sizeof(WrpEntity));
+        ImGui::Text("%s", scene.getName(entity).c_str());
+        ImGui::EndDragDropSource();
+    }
+    if (ImGui::BeginDragDropTarget())
+    {
+        if (const ImGuiPayload* payload = ImGui::AcceptDragDropPayload("SCENE_ENTITY"))
+        {
+            // an object can't become a child of its own descendant
+            WrpEntity dropped = *static_cast<const WrpEntity*>(payload->Data);
+            if (dropped != entity && !scene.isAncestor(dropped, entity))
+            {
+                droppedEntity = dropped;
+                dropParent = entity;
+            }
+        }
+        ImGui::EndDragDropTarget();
+    }
+
+    if (isOpen && firstChild != NULL_ENTITY)
+    {
+        for (WrpEntity child = firstChild; child != NULL_ENTITY; child = scene.getNextSibling(child)) {
+            showEntityNode(child);
+        }
+        ImGui::TreePop();
+    }
+}
+
+void SceneEditorGUI::inspectObject(WrpEntity entity)
+{
+    TransformComponent& transform = scene.getTransform(entity);
+    PointLightComponent* pointLight = scene.pointLights.find(entity);
+    WrpEntity parent = scene.getParent(entity);
+
     ImGui::SetNextWindowPos(ImVec2{0, 510}, ImGuiCond_FirstUseEver);
     ImGui::SetNextWindowSize(ImVec2{350, 290}, ImGuiCond_FirstUseEver);
 
     if (ImGui::Begin("Inspector")) {
+        if (parent != NULL_ENTITY)
+        {
+            ImGui::Text("Parent: %s", scene.getName(parent).c_str());
+            ImGui::SameLine();
+            // the object stays where it is, its transform becomes the world one
+            if (ImGui::Button("Detach")) {
+                scene.setParent(entity, NULL_ENTITY, true);
+            }
+        }
+
         if (ImGui::CollapsingHeader("Transform Component", ImGuiTreeNodeFlags_DefaultOpen)) {
-            ImGui::DragFloat3("Position", glm::value_ptr(object.transform.translation), 0.02f);
-            ImGui::DragFloat3("Scale", glm::value_ptr(object.transform.scale), 0.02f);
-            ImGui::DragFloat3("Rotation", glm::value_ptr(object.transform.rotation), 0.02f);
+            // relative to the parent for the children
+            ImGui::DragFloat3("Position", glm::value_ptr(transform.translation), 0.02f);
+            ImGui::DragFloat3("Scale", glm::value_ptr(transform.scale), 0.02f);
+            ImGui::DragFloat3("Rotation", glm::value_ptr(transform.rotation), 0.02f);
         }
 
-        renderTransformGizmo(object.transform); // render object's gizmo along with its inspector tool
+        renderTransformGizmo(entity); // render object's gizmo along with its inspector tool
 
-        if (isPointLight) {
+        if (pointLight != nullptr) {
             if (ImGui::CollapsingHeader("PointLight Component", ImGuiTreeNodeFlags_DefaultOpen)) {
-                ImGui::SliderFloat("Light intensity", &object.pointLight->lightIntensity, .0f, 100.0f);
-                ImGui::SliderFloat("Light radius", &object.transform.scale.x, 0.01f, 5.0f);
-                ImGui::ColorEdit3("Light color", (float*)&object.color);
-                ImGui::Checkbox("Demo Carousel Enabled", &object.pointLight->carouselEnabled);
+                ImGui::SliderFloat("Light intensity", &pointLight->lightIntensity, .0f, 100.0f);
+                ImGui::SliderFloat("Light radius", &transform.scale.x, 0.01f, 5.0f);
+                ImGui::ColorEdit3("Light color", (float*)&pointLight->color);
+                ImGui::Checkbox("Demo Carousel Enabled", &pointLight->carouselEnabled);
             }
         }
     }
@@ -315,10 +438,9 @@ void SceneEditorGUI::showModelsFromDirectory()
 
     if (ImGui::Button("Add to the scene")) {
         std::shared_ptr<WrpModel> model = WrpModel::createModelFromObjMtl(wrpDevice, objectsPaths.at(pickedItemModelsList));
-        auto newObj = SceneObject::createSceneObject();
-        newObj.model = model;
-        sceneObjects.emplace(newObj.getId(), std::move(newObj));
-        pickedItemSceneObjectsList = newObj.getId();
+        WrpEntity newObj = scene.createEntity();
+        scene.setModel(newObj, model);
+        pickedItemSceneObjectsList = newObj;
     }
 }
 
@@ -337,16 +459,17 @@ void SceneEditorGUI::showPointLightCreator()
 
     if (ImGui::Button("Add Point Light"))
     {
-        SceneObject pointLight = SceneObject::makePointLight(pointLightIntensity, pointLightRadius, pointLightColor);
-        sceneObjects.emplace(pointLight.getId(), std::move(pointLight));
-        pickedItemSceneObjectsList = pointLight.getId();
+        pickedItemSceneObjectsList = scene.createPointLight(pointLightIntensity, pointLightRadius, pointLightColor);
     }
 
     ImGui::PopItemWidth();
 }
 
-void SceneEditorGUI::renderTransformGizmo(TransformComponent& transform)
+void SceneEditorGUI::renderTransformGizmo(WrpEntity entity)
 {
+    TransformComponent& transform = scene.getTransform(entity);
+    WrpEntity parent = scene.getParent(entity);
+
     ImGuizmo::BeginFrame();
     static ImGuizmo::OPERATION currentGizmoOperation = ImGuizmo::TRANSLATE;
     static ImGuizmo::MODE currentGizmoMode = ImGuizmo::WORLD;
@@ -385,6 +508,7 @@ void SceneEditorGUI::renderTransformGizmo(TransformComponent& transform)
         currentGizmoMode = ImGuizmo::LOCAL;
     }
 
+    // the world matrix, the children's ones are built by the transform update at the start of the frame
     glm::mat4 modelMat = transform.modelMatrix();
     glm::mat4 deltaMat{};
     glm::mat4 guizmoProj(camera.getProjection());
@@ -392,8 +516,14 @@ void SceneEditorGUI::renderTransformGizmo(TransformComponent& transform)
 
     ImGuiIO& io = ImGui::GetIO();
     ImGuizmo::SetRect(0, 0, io.DisplaySize.x, io.DisplaySize.y);
-    ImGuizmo::Manipulate(glm::value_ptr(camera.getView()), glm::value_ptr(guizmoProj), currentGizmoOperation,
-        currentGizmoMode, glm::value_ptr(modelMat), glm::value_ptr(deltaMat), nullptr);
-
-    transform.fromModelMatrix(modelMat);
+    // the angles are extracted back only when the gizmo has moved the object
+    if (ImGuizmo::Manipulate(glm::value_ptr(camera.getView()), glm::value_ptr(guizmoProj), currentGizmoOperation,
+        currentGizmoMode, glm::value_ptr(modelMat), glm::value_ptr(deltaMat), nullptr))
+    {
+        // the transform of a child is relative to its parent
+        if (parent != NULL_ENTITY) {
+            modelMat = glm::inverse(scene.getTransform(parent).modelMatrix()) * modelMat;
+        }
+        transform.fromModelMatrix(modelMat);
+    }
 }
@@ -2,7 +2,7 @@
 
 #include "../src/renderer/Device.hpp"
 #include "../src/renderer/Window.hpp"
-#include "../src/renderer/SceneObject.hpp"
+#include "../src/renderer/Scene.hpp"
 #include "../src/renderer/Camera.hpp"
 #include "./common/KeyboardMovementController.hpp"
 #include "../src/renderer/FrameInfo.hpp"
@@ -15,6 +15,7 @@
 #include <ImGuizmo.h>
 
 // std
+#include <array>
 #include <stdexcept>
 #include <string>
 
@@ -28,7 +29,7 @@ class SceneEditorGUI {
 public:
     SceneEditorGUI(WrpWindow& window, WrpDevice& device, VkRenderPass renderPass,
         uint32_t imageCount, WrpCamera& camera, KeyboardMovementController& kmc,
-        SceneObject::Map& sceneObjects, RenderingSettings& renderingSettings);
+        WrpScene& scene, RenderingSettings& renderingSettings);
     ~SceneEditorGUI();
 
     SceneEditorGUI() = default;
@@ -51,29 +52,45 @@ public:
     std::vector<std::string> objectsNames;
     std::string selectedObjPath = "";
     int pickedItemModelsList = 0;
-    int pickedItemSceneObjectsList = 0;
+    WrpEntity pickedItemSceneObjectsList = 0;
 
     float pointLightIntensity = 1.0f;
     float pointLightRadius = .22f;
     glm::vec3 pointLightColor{1, 1, 1};
 
+    RenderStats renderStats{}; // filled by the app each frame
+    int maxRecordThreads = 0; // upper bound of renderingSettings.recordThreads, set by the app
+
 private:
     void setupAllWindows();
     void setupMainSettingsPanel();    // presented as "Vulkan Renderer" window
+    void showRecordingScaling();      // recording time by the number of recording threads
+    void showGpuFrameTime();          // GPU time with the depth pre-pass on and off
     void setupObjectCreationPanel();
     void showPointLightCreator();
     void showModelsFromDirectory();
     void enumerateObjectsInTheScene();
-    void inspectObject(SceneObject& object, bool isPointLight);
-    void renderTransformGizmo(TransformComponent& transform);
+    void showEntityNode(WrpEntity entity); // the entity's tree node with its children
+    void inspectObject(WrpEntity entity);
+    void renderTransformGizmo(WrpEntity entity);
 
     bool showImGuiDemoWindow = false; // controllable by UI checkbox
 
+    // the object dropped onto another one in the objects tree and its new parent, applied after the tree is drawn
+    WrpEntity droppedEntity = NULL_ENTITY;
+    WrpEntity dropParent = NULL_ENTITY;
+
+    // smoothed recording time for every number of recording threads seen so far, index 0 - inline recording
+    std::vector<float> recordCpuMsByThreads;
+    // smoothed GPU frame time without and with the depth pre-pass
+    std::array<float, 2> gpuFrameMsByDepthPrepass{};
+
     WrpDevice& wrpDevice;
     WrpCamera& camera;
     KeyboardMovementController& kmc;
-    SceneObject::Map& sceneObjects;
+    WrpScene& scene;
     RenderingSettings& renderingSettings;
 
     VkDescriptorPool descriptorPool; // ImGui's descriptor pool
+    bool headless = false;           // no window: ImGui isn't initialized, the GUI isn't drawn
 };
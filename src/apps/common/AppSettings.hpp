@@ -0,0 +1,40 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <memory>
+#include <string>
+
+struct BenchmarkScript;
+
+// Startup settings of the applications, parsed from the command line in Main.cpp
+struct AppSettings
+{
+    int preloadScene = 0;
+
+    // frames recorded by the CPU while the GPU executes the previous ones, 1-3 (see WrpRenderer);
+    // fewer frames lower the input latency and the memory of the per-frame resources
+    uint32_t framesInFlight = 2;
+
+    // threads creating pipelines at startup and on rendering settings change; 0 = one per hardware thread
+    unsigned int pipelineThreads = 0;
+
+    // worker threads available for recording the draws into secondary command buffers; 0 = one per hardware thread
+    unsigned int recordThreads = 0;
+
+    // compile the pipeline variants for all rendering settings in background after startup
+    bool prewarmPipelineVariants = true;
+
+    // render without a window into offscreen images; the GUI and the keyboard controls are off
+    bool headless = false;
+    // the application quits after this number of frames; 0 = until the window is closed
+    uint32_t frames = 0;
+    // PNG file the last rendered frame is saved to at exit, headless mode only
+    std::string capturePath;
+    // the script of --bench (see FrameBenchmark); the application quits when it's finished
+    std::shared_ptr<const BenchmarkScript> benchmark;
+
+    // read back the GPU frustum culling results and compare them with a CPU reference (slow, for debugging);
+    // the application fails at exit if they don't match
+    bool validateGpuCulling = false;
+};
@@ -0,0 +1,14 @@
+#include "BenchmarkUtils.hpp"
+
+// std
+#include <cstdio>
+
+void printBenchmarkResult(const char* operation, float ms, const char* baseline, float baselineMs)
+{
+    if (baseline != nullptr && baselineMs > 0.f) {
+        std::printf("  %-36s %10.3f ms   %s %10.3f ms   x%.1f\n", operation, ms, baseline, baselineMs, baselineMs / ms);
+    }
+    else {
+        std::printf("  %-36s %10.3f ms\n", operation, ms);
+    }
+}
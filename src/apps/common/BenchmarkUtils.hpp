@@ -0,0 +1,50 @@
+#pragma once
+
+// std
+#include <chrono>
+#include <cstdint>
+
+// Helpers of the CPU benchmarks run from the command line (--bvh-benchmark, --transform-benchmark, ...)
+
+// measures the time since its construction
+class BenchmarkTimer
+{
+public:
+    float elapsedMs() const
+    {
+        return std::chrono::duration<float, std::chrono::milliseconds::period>(
+            std::chrono::high_resolution_clock::now() - begin).count();
+    }
+private:
+    std::chrono::high_resolution_clock::time_point begin = std::chrono::high_resolution_clock::now();
+};
+
+// average time of frame(frameIndex) over frameCount frames
+template <typename Frame>
+float measureFrames(uint32_t frameCount, Frame frame)
+{
+    BenchmarkTimer timer;
+    for (uint32_t i = 0; i < frameCount; ++i) {
+        frame(i);
+    }
+    return timer.elapsedMs() / frameCount;
+}
+
+// the same, prepare(frameIndex) is called before each frame and isn't measured
+template <typename Prepare, typename Frame>
+float measureFrames(uint32_t frameCount, Prepare prepare, Frame frame)
+{
+    float totalMs = 0.f;
+    for (uint32_t i = 0; i < frameCount; ++i)
+    {
+        prepare(i);
+        BenchmarkTimer timer;
+        frame(i);
+        totalMs += timer.elapsedMs();
+    }
+    return totalMs / frameCount;
+}
+
+// one line of the results: the time of the operation and, if baselineMs > 0, the time of the baseline
+// it's compared to and the speedup over it
+void printBenchmarkResult(const char* operation, float ms, const char* baseline = nullptr, float baselineMs = 0.f);
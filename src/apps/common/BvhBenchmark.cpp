@@ -0,0 +1,254 @@
+#include "BvhBenchmark.hpp"
+#include "BenchmarkUtils.hpp"
+
+#include "../../renderer/Bvh.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+// std
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+    constexpr float WORLD_SIZE = 1000.f;
+    constexpr uint32_t QUERY_COUNT = 100;
+    constexpr uint32_t NEAREST_COUNT = 16;
+
+    // frustum planes of a camera at the position looking along the direction, extracted the same way as in WrpCamera
+    std::array<glm::vec4, 6> frustumPlanes(const glm::vec3& position, const glm::vec3& direction)
+    {
+        glm::mat4 projection = glm::perspective(glm::radians(50.f), 16.f / 9.f, 0.1f, 200.f);
+        glm::mat4 view = glm::lookAt(position, position + direction, glm::vec3(0.f, -1.f, 0.f));
+        glm::mat4 m = glm::transpose(projection * view);
+        std::array<glm::vec4, 6> planes{ m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[2], m[3] - m[2] };
+        for (glm::vec4& plane : planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+        return planes;
+    }
+
+    bool isOutside(const std::array<glm::vec4, 6>& planes, const WrpAabb& box)
+    {
+        for (const glm::vec4& plane : planes)
+        {
+            glm::vec3 farCorner = glm::mix(box.min, box.max, glm::greaterThan(glm::vec3(plane), glm::vec3(0.f)));
+            if (glm::dot(glm::vec3(plane), farCorner) + plane.w < 0.f) return true;
+        }
+        return false;
+    }
+
+    bool sameObjects(std::vector<uint64_t>& a, std::vector<uint64_t>& b)
+    {
+        std::sort(a.begin(), a.end());
+        std::sort(b.begin(), b.end());
+        return a == b;
+    }
+}
+
+bool runBvhBenchmark(uint32_t objectCount)
+{
+    std::mt19937 random{42};
+    std::uniform_real_distribution<float> position{-WORLD_SIZE * 0.5f, WORLD_SIZE * 0.5f};
+    std::uniform_real_distribution<float> size{0.5f, 4.f};
+    std::uniform_real_distribution<float> unit{-1.f, 1.f};
+
+    std::vector<WrpAabb> boxes(objectCount);
+    for (WrpAabb& box : boxes)
+    {
+        glm::vec3 center{position(random), position(random), position(random)};
+        glm::vec3 extent{size(random), size(random), size(random)};
+        box = {center - extent * 0.5f, center + extent * 0.5f};
+    }
+
+    std::printf("BVH benchmark, %u objects\n", objectCount);
+    bool valid = true;
+    WrpBvh bvh{};
+    std::vector<WrpBvh::ProxyId> proxies(objectCount);
+
+    {
+        BenchmarkTimer timer;
+        for (uint32_t i = 0; i < objectCount; ++i) {
+            proxies[i] = bvh.insert(boxes[i], i);
+        }
+        printBenchmarkResult("incremental insert", timer.elapsedMs());
+        std::printf("    height %d, SAH cost %.1f\n", bvh.getHeight(), bvh.getCost());
+    }
+    {
+        BenchmarkTimer timer;
+        bvh.rebuild();
+        printBenchmarkResult("rebuild", timer.elapsedMs());
+        std::printf("    height %d, SAH cost %.1f\n", bvh.getHeight(), bvh.getCost());
+    }
+    {
+        // small movements stay inside the fat boxes and don't touch the tree
+        BenchmarkTimer timer;
+        uint32_t changed = 0;
+        for (uint32_t i = 0; i < objectCount; ++i)
+        {
+            glm::vec3 offset = glm::vec3(unit(random), unit(random), unit(random)) * 0.05f;
+            boxes[i] = {boxes[i].min + offset, boxes[i].max + offset};
+            changed += bvh.update(proxies[i], boxes[i]);
+        }
+        printBenchmarkResult("update, small movements", timer.elapsedMs());
+        std::printf("    %u refits, SAH cost %.1f\n", changed, bvh.getCost());
+    }
+    {
+        // a tenth of the objects is moved far away, the refits degrade the tree until the next rebuild
+        BenchmarkTimer timer;
+        for (uint32_t i = 0; i < objectCount; i += 10)
+        {
+            glm::vec3 offset = glm::vec3(unit(random), unit(random), unit(random)) * (WORLD_SIZE * 0.25f);
+            boxes[i] = {boxes[i].min + offset, boxes[i].max + offset};
+            bvh.update(proxies[i], boxes[i]);
+        }
+        printBenchmarkResult("update, large movements", timer.elapsedMs());
+        std::printf("    SAH cost %.1f\n", bvh.getCost());
+        BenchmarkTimer rebuildTimer;
+        bvh.rebuild();
+        printBenchmarkResult("rebuild", rebuildTimer.elapsedMs());
+        std::printf("    SAH cost %.1f\n", bvh.getCost());
+    }
+
+    std::vector<std::array<glm::vec4, 6>> frustums(QUERY_COUNT);
+    std::vector<glm::vec3> points(QUERY_COUNT);
+    std::vector<glm::vec3> directions(QUERY_COUNT);
+    for (uint32_t q = 0; q < QUERY_COUNT; ++q)
+    {
+        points[q] = {position(random), position(random), position(random)};
+        directions[q] = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(1e-3f));
+        frustums[q] = frustumPlanes(points[q], directions[q]);
+    }
+
+    std::vector<uint64_t> found;
+    std::vector<uint64_t> expected;
+    auto collect = [&found](uint64_t userData) { found.push_back(userData); };
+    {
+        float bvhMs = 0.f;
+        float linearMs = 0.f;
+        size_t visible = 0;
+        for (const auto& planes : frustums)
+        {
+            found.clear();
+            BenchmarkTimer timer;
+            bvh.queryFrustum(planes, collect);
+            bvhMs += timer.elapsedMs();
+
+            expected.clear();
+            BenchmarkTimer linearTimer;
+            for (uint32_t i = 0; i < objectCount; ++i) {
+                if (!isOutside(planes, boxes[i])) expected.push_back(i);
+            }
+            linearMs += linearTimer.elapsedMs();
+            visible += expected.size();
+            valid = valid && sameObjects(found, expected);
+        }
+        printBenchmarkResult("frustum query", bvhMs / QUERY_COUNT, "linear", linearMs / QUERY_COUNT);
+        std::printf("    %.1f objects on average\n", static_cast<float>(visible) / QUERY_COUNT);
+    }
+    {
+        float bvhMs = 0.f;
+        float linearMs = 0.f;
+        float radius = 25.f;
+        for (const glm::vec3& center : points)
+        {
+            found.clear();
+            BenchmarkTimer timer;
+            bvh.querySphere(center, radius, collect);
+            bvhMs += timer.elapsedMs();
+
+            expected.clear();
+            BenchmarkTimer linearTimer;
+            for (uint32_t i = 0; i < objectCount; ++i) {
+                if (boxes[i].distanceSquared(center) <= radius * radius) expected.push_back(i);
+            }
+            linearMs += linearTimer.elapsedMs();
+            valid = valid && sameObjects(found, expected);
+        }
+        printBenchmarkResult("sphere query", bvhMs / QUERY_COUNT, "linear", linearMs / QUERY_COUNT);
+    }
+    {
+        // the nearest hit of the box, the callback shortens the ray to the hit distance
+        float bvhMs = 0.f;
+        float linearMs = 0.f;
+        for (uint32_t q = 0; q < QUERY_COUNT; ++q)
+        {
+            float bvhHit = WORLD_SIZE;
+            BenchmarkTimer timer;
+            bvh.queryRay(points[q], directions[q], WORLD_SIZE, [&bvhHit](uint64_t, float distance) {
+                bvhHit = std::min(bvhHit, distance);
+                return bvhHit;
+            });
+            bvhMs += timer.elapsedMs();
+
+            float linearHit = WORLD_SIZE;
+            glm::vec3 inverseDirection = 1.f / directions[q];
+            BenchmarkTimer linearTimer;
+            for (uint32_t i = 0; i < objectCount; ++i)
+            {
+                glm::vec3 t0 = (boxes[i].min - points[q]) * inverseDirection;
+                glm::vec3 t1 = (boxes[i].max - points[q]) * inverseDirection;
+                glm::vec3 tMin = glm::min(t0, t1);
+                glm::vec3 tMax = glm::max(t0, t1);
+                float enter = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.f));
+                float exit = std::min(std::min(tMax.x, tMax.y), tMax.z);
+                if (enter <= exit) linearHit = std::min(linearHit, enter);
+            }
+            linearMs += linearTimer.elapsedMs();
+            valid = valid && bvhHit == linearHit;
+        }
+        printBenchmarkResult("ray query, nearest hit", bvhMs / QUERY_COUNT, "linear", linearMs / QUERY_COUNT);
+    }
+    {
+        float bvhMs = 0.f;
+        float linearMs = 0.f;
+        std::vector<std::pair<float, uint64_t>> distances(objectCount);
+        for (const glm::vec3& point : points)
+        {
+            BenchmarkTimer timer;
+            bvh.queryNearest(point, NEAREST_COUNT, found);
+            bvhMs += timer.elapsedMs();
+
+            BenchmarkTimer linearTimer;
+            for (uint32_t i = 0; i < objectCount; ++i) {
+                distances[i] = {boxes[i].distanceSquared(point), i};
+            }
+            uint32_t count = std::min(NEAREST_COUNT, objectCount);
+            std::partial_sort(distances.begin(), distances.begin() + count, distances.end());
+            linearMs += linearTimer.elapsedMs();
+
+            // the objects at the same distance can be found in any order, so the distances are compared
+            valid = valid && found.size() == count;
+            for (uint32_t i = 0; valid && i < count; ++i) {
+                valid = boxes[found[i]].distanceSquared(point) == distances[i].first;
+            }
+        }
+        printBenchmarkResult("nearest query", bvhMs / QUERY_COUNT, "linear", linearMs / QUERY_COUNT);
+    }
+    {
+        // removal of a half of the objects keeps the rest findable
+        BenchmarkTimer timer;
+        for (uint32_t i = 0; i < objectCount; i += 2) {
+            bvh.remove(proxies[i]);
+        }
+        printBenchmarkResult("remove a half", timer.elapsedMs());
+
+        found.clear();
+        bvh.querySphere(glm::vec3(0.f), WORLD_SIZE * 2.f, collect);
+        expected.clear();
+        for (uint32_t i = 1; i < objectCount; i += 2) {
+            expected.push_back(i);
+        }
+        valid = valid && bvh.getProxyCount() == expected.size() && sameObjects(found, expected);
+    }
+
+    std::printf(valid ? "All queries match the linear search\n" : "ERROR: the queries don't match the linear search\n");
+    return valid;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+// std
+#include <cstdint>
+
+// Benchmark of WrpBvh over randomly placed boxes, it doesn't need a window or a GPU.
+// Prints the time of the tree operations and of the queries compared to the linear search, and checks that
+// the queries find the same objects as the linear search. Returns false if they don't.
+bool runBvhBenchmark(uint32_t objectCount);
@@ -0,0 +1,24 @@
+#include "CullingValidation.hpp"
+
+// std
+#include <cstdio>
+
+bool finishCullingValidation(SimpleRenderSystem& simpleRenderSystem, TextureRenderSystem& textureRenderSystem)
+{
+    simpleRenderSystem.finishCullingValidation();
+    textureRenderSystem.finishCullingValidation();
+
+    uint64_t validatedFrames = simpleRenderSystem.getValidatedCullingFrameCount()
+        + textureRenderSystem.getValidatedCullingFrameCount();
+    uint64_t mismatches = simpleRenderSystem.getCullingMismatchCount() + textureRenderSystem.getCullingMismatchCount();
+    std::printf("GPU culling validation: %llu culled frames of the render systems checked, %llu mismatched draws\n",
+        static_cast<unsigned long long>(validatedFrames), static_cast<unsigned long long>(mismatches));
+
+    if (validatedFrames == 0) {
+        std::printf("ERROR: no frame was culled on GPU, the culling wasn't tested\n");
+        return false;
+    }
+    std::printf(mismatches == 0 ? "GPU culling matches the CPU reference\n"
+        : "ERROR: GPU culling doesn't match the CPU reference\n");
+    return mismatches == 0;
+}
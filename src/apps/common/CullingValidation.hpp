@@ -0,0 +1,9 @@
+#pragma once
+
+#include "../../renderer/systems/SimpleRenderSystem.hpp"
+#include "../../renderer/systems/TextureRenderSystem.hpp"
+
+// The GPU culling test of --validate-gpu-culling, called after the main loop when the GPU is idle.
+// Compares the culling results still in flight with the CPU reference and prints the total over the run.
+// Returns false if a GPU culled frame didn't match the reference or no frame was culled on GPU.
+bool finishCullingValidation(SimpleRenderSystem& simpleRenderSystem, TextureRenderSystem& textureRenderSystem);
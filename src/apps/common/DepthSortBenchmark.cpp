@@ -0,0 +1,119 @@
+#include "DepthSortBenchmark.hpp"
+#include "BenchmarkUtils.hpp"
+
+#include "../../renderer/DepthSorter.hpp"
+#include "../../renderer/FrameInfo.hpp"
+#include "../../renderer/RenderQueue.hpp"
+
+// std
+#include <algorithm>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace
+{
+    constexpr uint32_t FRAME_COUNT = 20;
+    constexpr uint32_t DUPLICATE_DISTANCES = 64; // distinct distances of the test with many equal ones
+
+    // the billboard push constants of the draw per light
+    struct BillboardPushConstants
+    {
+        glm::vec4 position{};
+        glm::vec4 color{};
+        float radius{};
+    };
+
+    // the radix order must be the stable order by descending distance, every index exactly once
+    bool checkOrder(WrpDepthSorter& sorter, const std::vector<float>& distances, const char* name)
+    {
+        uint32_t count = static_cast<uint32_t>(distances.size());
+        sorter.sortBackToFront(distances.data(), count);
+
+        std::vector<uint32_t> reference(count);
+        std::iota(reference.begin(), reference.end(), 0u);
+        std::stable_sort(reference.begin(), reference.end(), [&](uint32_t a, uint32_t b) {
+            return distances[a] > distances[b];
+        });
+
+        bool valid = sorter.getOrder() == reference;
+        std::printf("  %-36s %s\n", name, valid ? "ok" : "WRONG ORDER");
+        return valid;
+    }
+}
+
+bool runDepthSortBenchmark(uint32_t lightCount)
+{
+    std::mt19937 random{7};
+    std::uniform_real_distribution<float> distance{0.1f, 200.f};
+    std::uniform_int_distribution<uint32_t> duplicate{0, DUPLICATE_DISTANCES - 1};
+
+    std::vector<float> distances(lightCount);
+    WrpDepthSorter sorter;
+
+    std::printf("Billboard depth sort benchmark, %u billboards, %u frames\n", lightCount, FRAME_COUNT);
+    for (float& value : distances) {
+        value = static_cast<float>(duplicate(random)) * 0.5f;
+    }
+    bool valid = checkOrder(sorter, distances, "equal distances of 64 values");
+    std::fill(distances.begin(), distances.end(), 3.f);
+    valid = checkOrder(sorter, distances, "all distances equal") && valid;
+    for (float& value : distances) {
+        value = distance(random);
+    }
+    valid = checkOrder(sorter, distances, "random distances") && valid;
+
+    std::vector<PointLightBillboard> lights(lightCount);
+    for (uint32_t i = 0; i < lightCount; ++i)
+    {
+        lights[i].position = glm::vec4(distances[i], 0.f, 0.f, 0.1f);
+        lights[i].color = glm::vec4(1.f, 0.5f, 0.25f, 1.f);
+    }
+
+    // a draw with its push constants per billboard, ordered by the render queue's keys
+    WrpRenderQueue renderQueue;
+    WrpDrawItem item{};
+    item.pushConstantSize = sizeof(BillboardPushConstants);
+    item.command = WrpDrawItem::Command::Draw;
+    item.count = 6;
+    float queueMs = measureFrames(FRAME_COUNT, [&](uint32_t) {
+        renderQueue.clear();
+        for (uint32_t i = 0; i < lightCount; ++i)
+        {
+            item.sortKey = WrpRenderQueue::makeSortKey(WrpRenderQueue::PASS_TRANSLUCENT, 0, 0, 0,
+                WrpRenderQueue::backToFrontDepth(distances[i]));
+            BillboardPushConstants push{lights[i].position, lights[i].color, lights[i].position.w};
+            renderQueue.submit(item, &push);
+        }
+        renderQueue.sort();
+    });
+
+    // one instanced draw: the instances are written in the radix order
+    std::vector<PointLightBillboard> instances(lightCount);
+    float radixMs = measureFrames(FRAME_COUNT, [&](uint32_t) {
+        sorter.sortBackToFront(distances.data(), lightCount);
+        const std::vector<uint32_t>& order = sorter.getOrder();
+        for (uint32_t i = 0; i < lightCount; ++i) {
+            instances[i] = lights[order[i]];
+        }
+    });
+
+    std::vector<uint32_t> comparisonOrder(lightCount);
+    float comparisonMs = measureFrames(FRAME_COUNT, [&](uint32_t) {
+        std::iota(comparisonOrder.begin(), comparisonOrder.end(), 0u);
+        std::stable_sort(comparisonOrder.begin(), comparisonOrder.end(), [&](uint32_t a, uint32_t b) {
+            return distances[a] > distances[b];
+        });
+        for (uint32_t i = 0; i < lightCount; ++i) {
+            instances[i] = lights[comparisonOrder[i]];
+        }
+    });
+
+    printBenchmarkResult("draw per billboard, queue sort", queueMs);
+    printBenchmarkResult("instanced, radix sort", radixMs, "queue", queueMs);
+    printBenchmarkResult("instanced, std::stable_sort", comparisonMs, "queue", queueMs);
+    std::printf("    %u draws submitted per frame instead of 1, radix order %s\n",
+        renderQueue.size(), valid ? "matches" : "DIFFERS");
+    return valid && renderQueue.size() == lightCount;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+// std
+#include <cstdint>
+
+// Benchmark of ordering lightCount point-light billboards back to front, it doesn't need a window or a GPU.
+// Compares the draw per billboard sorted by the render queue with the radix sort of the instanced billboards,
+// and checks the radix order against std::stable_sort for random distances, many equal distances and all equal.
+// Returns false if the orders differ or a billboard is lost.
+bool runDepthSortBenchmark(uint32_t lightCount);
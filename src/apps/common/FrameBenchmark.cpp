@@ -0,0 +1,491 @@
+#include "FrameBenchmark.hpp"
+
+// std
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+    // Just enough JSON for the scripts: objects, arrays, numbers, strings without \u escapes, true/false/null
+    struct JsonValue
+    {
+        enum class Type { Null, Boolean, Number, String, Array, Object };
+
+        Type type = Type::Null;
+        bool boolean = false;
+        double number = 0.0;
+        std::string string;
+        std::vector<JsonValue> array;
+        std::map<std::string, JsonValue> object;
+
+        const JsonValue* find(const std::string& key) const
+        {
+            auto it = object.find(key);
+            return it != object.end() ? &it->second : nullptr;
+        }
+    };
+
+    class JsonParser
+    {
+    public:
+        JsonParser(const std::string& text, const std::string& path) : text{text}, path{path} {}
+
+        JsonValue parseDocument()
+        {
+            JsonValue value = parseValue();
+            skipWhitespace();
+            if (position != text.size()) fail("unexpected data after the document");
+            return value;
+        }
+
+    private:
+        [[noreturn]] void fail(const std::string& message) const
+        {
+            throw std::runtime_error("Invalid JSON in " + path + " at offset " + std::to_string(position) + ": " + message);
+        }
+
+        void skipWhitespace()
+        {
+            while (position < text.size() && std::isspace(static_cast<unsigned char>(text[position]))) ++position;
+        }
+
+        bool consume(char c)
+        {
+            skipWhitespace();
+            if (position < text.size() && text[position] == c) {
+                ++position;
+                return true;
+            }
+            return false;
+        }
+
+        void expect(char c)
+        {
+            if (!consume(c)) fail(std::string("expected '") + c + "'");
+        }
+
+        bool consumeWord(const char* word)
+        {
+            size_t length = std::char_traits<char>::length(word);
+            if (text.compare(position, length, word) != 0) return false;
+            position += length;
+            return true;
+        }
+
+        JsonValue parseValue()
+        {
+            skipWhitespace();
+            if (position >= text.size()) fail("unexpected end of the document");
+
+            JsonValue value;
+            char c = text[position];
+            if (c == '{')
+            {
+                ++position;
+                value.type = JsonValue::Type::Object;
+                if (consume('}')) return value;
+                do
+                {
+                    skipWhitespace();
+                    std::string key = parseString();
+                    expect(':');
+                    value.object[key] = parseValue();
+                } while (consume(','));
+                expect('}');
+            }
+            else if (c == '[')
+            {
+                ++position;
+                value.type = JsonValue::Type::Array;
+                if (consume(']')) return value;
+                do {
+                    value.array.push_back(parseValue());
+                } while (consume(','));
+                expect(']');
+            }
+            else if (c == '"')
+            {
+                value.type = JsonValue::Type::String;
+                value.string = parseString();
+            }
+            else if (consumeWord("true") || consumeWord("false"))
+            {
+                value.type = JsonValue::Type::Boolean;
+                value.boolean = c == 't';
+            }
+            else if (consumeWord("null"))
+            {
+                value.type = JsonValue::Type::Null;
+            }
+            else
+            {
+                const char* begin = text.c_str() + position;
+                char* end = nullptr;
+                value.type = JsonValue::Type::Number;
+                value.number = std::strtod(begin, &end);
+                if (end == begin) fail("unexpected character");
+                position += static_cast<size_t>(end - begin);
+            }
+            return value;
+        }
+
+        std::string parseString()
+        {
+            if (position >= text.size() || text[position] != '"') fail("expected a string");
+            ++position;
+
+            std::string result;
+            while (position < text.size() && text[position] != '"')
+            {
+                char c = text[position++];
+                if (c == '\\')
+                {
+                    if (position >= text.size()) break;
+                    char escaped = text[position++];
+                    switch (escaped)
+                    {
+                        case 'n': result += '\n'; break;
+                        case 't': result += '\t'; break;
+                        case 'r': result += '\r'; break;
+                        case 'b': result += '\b'; break;
+                        case 'f': result += '\f'; break;
+                        case '"': case '\\': case '/': result += escaped; break;
+                        default: fail("unsupported escape sequence");
+                    }
+                }
+                else {
+                    result += c;
+                }
+            }
+            if (position >= text.size()) fail("unterminated string");
+            ++position;
+            return result;
+        }
+
+        const std::string& text;
+        const std::string& path;
+        size_t position = 0;
+    };
+
+    double getNumber(const JsonValue& object, const char* key, double defaultValue, const std::string& path)
+    {
+        const JsonValue* value = object.find(key);
+        if (value == nullptr) return defaultValue;
+        if (value->type != JsonValue::Type::Number) {
+            throw std::runtime_error(std::string("\"") + key + "\" must be a number in " + path);
+        }
+        return value->number;
+    }
+
+    glm::vec3 getVec3(const JsonValue& object, const char* key, const std::string& path)
+    {
+        const JsonValue* value = object.find(key);
+        if (value == nullptr) return glm::vec3{0.f};
+        if (value->type != JsonValue::Type::Array || value->array.size() != 3
+            || std::any_of(value->array.begin(), value->array.end(),
+                [](const JsonValue& v) { return v.type != JsonValue::Type::Number; }))
+        {
+            throw std::runtime_error(std::string("\"") + key + "\" must be an array of 3 numbers in " + path);
+        }
+        return glm::vec3{value->array[0].number, value->array[1].number, value->array[2].number};
+    }
+
+    // uniform Catmull-Rom spline through p1 and p2, u in [0, 1]
+    glm::vec3 catmullRom(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float u)
+    {
+        float u2 = u * u;
+        float u3 = u2 * u;
+        return 0.5f * (2.f * p1 + (p2 - p0) * u + (2.f * p0 - 5.f * p1 + 4.f * p2 - p3) * u2
+            + (3.f * p1 - p0 - 3.f * p2 + p3) * u3);
+    }
+
+    // nearest-rank percentile
+    float percentile(const std::vector<float>& sorted, float p)
+    {
+        if (sorted.empty()) return 0.f;
+        size_t rank = static_cast<size_t>(std::ceil(p / 100.f * static_cast<float>(sorted.size())));
+        return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+    }
+
+    struct Summary
+    {
+        float p50 = 0.f;
+        float p95 = 0.f;
+        float p99 = 0.f;
+        float max = 0.f;
+        float mean = 0.f;
+    };
+
+    Summary summarize(std::vector<float> values)
+    {
+        Summary summary;
+        if (values.empty()) return summary;
+        std::sort(values.begin(), values.end());
+        summary.p50 = percentile(values, 50.f);
+        summary.p95 = percentile(values, 95.f);
+        summary.p99 = percentile(values, 99.f);
+        summary.max = values.back();
+        double sum = 0.0;
+        for (float value : values) sum += value;
+        summary.mean = static_cast<float>(sum / static_cast<double>(values.size()));
+        return summary;
+    }
+
+    void writeSummary(FILE* file, const char* name, const Summary& summary, bool last)
+    {
+        std::fprintf(file, "    \"%s\": {\"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f, \"mean\": %.4f}%s\n",
+            name, summary.p50, summary.p95, summary.p99, summary.max, summary.mean, last ? "" : ",");
+    }
+
+    float elapsedMs(std::chrono::high_resolution_clock::time_point from, std::chrono::high_resolution_clock::time_point to)
+    {
+        return std::chrono::duration<float, std::chrono::milliseconds::period>(to - from).count();
+    }
+}
+
+BenchmarkScript BenchmarkScript::load(const std::string& path)
+{
+    std::ifstream file{path};
+    if (!file) {
+        throw std::runtime_error("Failed to open benchmark script: " + path);
+    }
+    std::string text{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    JsonValue root = JsonParser{text, path}.parseDocument();
+    if (root.type != JsonValue::Type::Object) {
+        throw std::runtime_error("Benchmark script must be a JSON object: " + path);
+    }
+
+    BenchmarkScript script;
+    script.scene = static_cast<int>(getNumber(root, "scene", script.scene, path));
+    script.warmupFrames = static_cast<uint32_t>(std::max(0.0, getNumber(root, "warmupFrames", script.warmupFrames, path)));
+    script.frames = static_cast<uint32_t>(std::max(0.0, getNumber(root, "frames", script.frames, path)));
+    script.timestep = static_cast<float>(getNumber(root, "timestep", script.timestep, path));
+    if (!(script.timestep > 0.f)) {
+        throw std::runtime_error("\"timestep\" must be positive in " + path);
+    }
+    if (const JsonValue* output = root.find("output"))
+    {
+        if (output->type != JsonValue::Type::String || output->string.empty()) {
+            throw std::runtime_error("\"output\" must be a file name without extension in " + path);
+        }
+        script.output = output->string;
+    }
+
+    if (const JsonValue* camera = root.find("camera"))
+    {
+        if (camera->type != JsonValue::Type::Array) {
+            throw std::runtime_error("\"camera\" must be an array of keys in " + path);
+        }
+        for (const JsonValue& keyValue : camera->array)
+        {
+            if (keyValue.type != JsonValue::Type::Object) {
+                throw std::runtime_error("Camera key must be an object in " + path);
+            }
+            CameraKey key;
+            key.time = static_cast<float>(getNumber(keyValue, "time", 0.0, path));
+            key.position = getVec3(keyValue, "position", path);
+            key.rotation = getVec3(keyValue, "rotation", path);
+            if (!script.camera.empty() && key.time <= script.camera.back().time) {
+                throw std::runtime_error("Camera keys must be sorted by increasing time in " + path);
+            }
+            script.camera.push_back(key);
+        }
+    }
+
+    if (script.frames == 0 && script.camera.size() < 2) {
+        throw std::runtime_error("Benchmark script needs \"frames\" or a camera path with 2 keys or more: " + path);
+    }
+    return script;
+}
+
+FrameBenchmark::FrameBenchmark(const BenchmarkScript& script) : script{script}
+{
+    measuredFrameCount = script.frames;
+    if (measuredFrameCount == 0)
+    {
+        // the path from its first key to the last one
+        float duration = script.camera.back().time - script.camera.front().time;
+        measuredFrameCount = static_cast<uint32_t>(std::floor(duration / script.timestep)) + 1;
+    }
+    samples.reserve(measuredFrameCount);
+    gpuMs.reserve(measuredFrameCount);
+}
+
+float FrameBenchmark::pathTime() const
+{
+    uint32_t measuredFrame = renderedFrames > script.warmupFrames ? renderedFrames - script.warmupFrames : 0;
+    float startTime = script.camera.empty() ? 0.f : script.camera.front().time;
+    return startTime + static_cast<float>(measuredFrame) * script.timestep;
+}
+
+void FrameBenchmark::placeCamera(TransformComponent& cameraTransform) const
+{
+    const auto& keys = script.camera;
+    if (keys.empty()) return; // the camera of the scene stays where it is
+
+    float time = pathTime();
+    if (keys.size() == 1 || time <= keys.front().time)
+    {
+        cameraTransform.translation = keys.front().position;
+        cameraTransform.rotation = keys.front().rotation;
+        return;
+    }
+    if (time >= keys.back().time)
+    {
+        cameraTransform.translation = keys.back().position;
+        cameraTransform.rotation = keys.back().rotation;
+        return;
+    }
+
+    // the segment [keys[i], keys[i + 1]] containing the time, the end keys are repeated to close the spline
+    size_t i = static_cast<size_t>(std::upper_bound(keys.begin(), keys.end(), time,
+        [](float t, const BenchmarkScript::CameraKey& key) { return t < key.time; }) - keys.begin()) - 1;
+    const auto& k0 = keys[i > 0 ? i - 1 : i];
+    const auto& k1 = keys[i];
+    const auto& k2 = keys[i + 1];
+    const auto& k3 = keys[std::min(i + 2, keys.size() - 1)];
+    float u = (time - k1.time) / (k2.time - k1.time);
+
+    cameraTransform.translation = catmullRom(k0.position, k1.position, k2.position, k3.position, u);
+    cameraTransform.rotation = catmullRom(k0.rotation, k1.rotation, k2.rotation, k3.rotation, u);
+}
+
+void FrameBenchmark::beginFrame()
+{
+    frameBegin = std::chrono::high_resolution_clock::now();
+    frameStarted = true;
+}
+
+void FrameBenchmark::submitFrame(const FrameStats& stats)
+{
+    if (!frameStarted) {
+        throw std::logic_error("FrameBenchmark::submitFrame() without beginFrame()");
+    }
+    frameStarted = false;
+
+    auto now = std::chrono::high_resolution_clock::now();
+    bool firstFrame = renderedFrames == 0;
+    if (renderedFrames++ >= script.warmupFrames)
+    {
+        FrameSample sample;
+        sample.cpuMs = elapsedMs(frameBegin, now);
+        sample.frameMs = elapsedMs(firstFrame ? frameBegin : lastSubmit, now);
+        sample.stats = stats;
+        samples.push_back(sample);
+    }
+    lastSubmit = now;
+}
+
+void FrameBenchmark::addGpuTime(float ms)
+{
+    // the results of the warm-up frames come first
+    if (gpuResults++ >= script.warmupFrames && gpuMs.size() < measuredFrameCount) {
+        gpuMs.push_back(ms);
+    }
+}
+
+void FrameBenchmark::writeResults(uint64_t deviceMemory, uint64_t hostMemory)
+{
+    std::vector<float> frameMs;
+    std::vector<float> cpuMs;
+    uint64_t maxDrawCalls = 0;
+    uint64_t maxTriangles = 0;
+    double drawCallSum = 0.0;
+    double triangleSum = 0.0;
+    for (const FrameSample& sample : samples)
+    {
+        frameMs.push_back(sample.frameMs);
+        cpuMs.push_back(sample.cpuMs);
+        maxDrawCalls = std::max<uint64_t>(maxDrawCalls, sample.stats.drawCalls);
+        maxTriangles = std::max(maxTriangles, sample.stats.triangles);
+        drawCallSum += sample.stats.drawCalls;
+        triangleSum += static_cast<double>(sample.stats.triangles);
+    }
+    double frameCount = std::max<double>(1.0, static_cast<double>(samples.size()));
+    Summary frameSummary = summarize(frameMs);
+    Summary cpuSummary = summarize(cpuMs);
+    Summary gpuSummary = summarize(gpuMs);
+
+    std::string csvPath = script.output + ".csv";
+    std::unique_ptr<FILE, int (*)(FILE*)> csv{std::fopen(csvPath.c_str(), "w"), &std::fclose};
+    if (!csv) {
+        throw std::runtime_error("Failed to write benchmark results: " + csvPath);
+    }
+    std::fprintf(csv.get(), "frame,frame_ms,cpu_ms,gpu_ms,draw_calls,triangles\n");
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        const FrameSample& sample = samples[i];
+        std::fprintf(csv.get(), "%zu,%.4f,%.4f,", i, sample.frameMs, sample.cpuMs);
+        if (i < gpuMs.size()) { // empty if the timer isn't supported
+            std::fprintf(csv.get(), "%.4f", gpuMs[i]);
+        }
+        std::fprintf(csv.get(), ",%u,%llu\n", sample.stats.drawCalls, static_cast<unsigned long long>(sample.stats.triangles));
+    }
+
+    std::string jsonPath = script.output + ".json";
+    std::unique_ptr<FILE, int (*)(FILE*)> json{std::fopen(jsonPath.c_str(), "w"), &std::fclose};
+    if (!json) {
+        throw std::runtime_error("Failed to write benchmark results: " + jsonPath);
+    }
+    std::fprintf(json.get(), "{\n");
+    std::fprintf(json.get(), "    \"scene\": %d,\n", script.scene);
+    std::fprintf(json.get(), "    \"warmupFrames\": %u,\n", script.warmupFrames);
+    std::fprintf(json.get(), "    \"frames\": %zu,\n", samples.size());
+    std::fprintf(json.get(), "    \"gpuFrames\": %zu,\n", gpuMs.size());
+    std::fprintf(json.get(), "    \"timestep\": %.6f,\n", script.timestep);
+    writeSummary(json.get(), "frameMs", frameSummary, false);
+    writeSummary(json.get(), "cpuMs", cpuSummary, false);
+    writeSummary(json.get(), "gpuMs", gpuSummary, false);
+    std::fprintf(json.get(), "    \"drawCalls\": {\"mean\": %.1f, \"max\": %llu},\n",
+        drawCallSum / frameCount, static_cast<unsigned long long>(maxDrawCalls));
+    std::fprintf(json.get(), "    \"triangles\": {\"mean\": %.1f, \"max\": %llu},\n",
+        triangleSum / frameCount, static_cast<unsigned long long>(maxTriangles));
+    std::fprintf(json.get(), "    \"deviceMemoryBytes\": %llu,\n", static_cast<unsigned long long>(deviceMemory));
+    std::fprintf(json.get(), "    \"peakHostMemoryBytes\": %llu\n", static_cast<unsigned long long>(hostMemory));
+    std::fprintf(json.get(), "}\n");
+
+    std::printf("Benchmark: %zu frames after %u warm-up frames, timestep %.4f s\n",
+        samples.size(), script.warmupFrames, script.timestep);
+    std::printf("%-6s %10s %10s %10s %10s\n", "ms", "p50", "p95", "p99", "max");
+    std::printf("%-6s %10.3f %10.3f %10.3f %10.3f\n", "frame", frameSummary.p50, frameSummary.p95, frameSummary.p99, frameSummary.max);
+    std::printf("%-6s %10.3f %10.3f %10.3f %10.3f\n", "cpu", cpuSummary.p50, cpuSummary.p95, cpuSummary.p99, cpuSummary.max);
+    if (!gpuMs.empty()) {
+        std::printf("%-6s %10.3f %10.3f %10.3f %10.3f\n", "gpu", gpuSummary.p50, gpuSummary.p95, gpuSummary.p99, gpuSummary.max);
+    }
+    std::printf("draw calls %.1f, triangles %.0f per frame; device memory %.1f MB, peak host memory %.1f MB\n",
+        drawCallSum / frameCount, triangleSum / frameCount,
+        static_cast<double>(deviceMemory) / (1024.0 * 1024.0), static_cast<double>(hostMemory) / (1024.0 * 1024.0));
+    std::printf("Results are written to %s and %s\n", csvPath.c_str(), jsonPath.c_str());
+}
+
+uint64_t getPeakHostMemoryUsage()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return static_cast<uint64_t>(counters.PeakWorkingSetSize);
+#else
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return static_cast<uint64_t>(usage.ru_maxrss);        // bytes
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024; // kilobytes
+#endif
+#endif
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "../../renderer/Components.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Benchmark script, a JSON file:
+// {
+//     "scene": 1,                  // scene preloaded by SceneEditorApp (--scene N)
+//     "warmupFrames": 60,          // rendered before the measured frames, at the start of the camera path
+//     "frames": 600,               // measured frames; by default enough to cover the camera path
+//     "timestep": 0.016667,        // fixed frame time in seconds for the camera path and the animations
+//     "output": "benchmark",       // writes benchmark.csv (per frame) and benchmark.json (summary)
+//     "camera": [                  // camera path, keys sorted by time; rotation in radians (YXZ, as the editor camera)
+//         {"time": 0.0, "position": [0, -1, -5], "rotation": [0, 0, 0]},
+//         {"time": 5.0, "position": [3, -1, -2], "rotation": [0, -1.2, 0]}
+//     ]
+// }
+struct BenchmarkScript
+{
+    struct CameraKey
+    {
+        float time = 0.f;
+        glm::vec3 position{0.f};
+        glm::vec3 rotation{0.f};
+    };
+
+    int scene = 0;
+    uint32_t warmupFrames = 60;
+    uint32_t frames = 0;
+    float timestep = 1.f / 60.f;
+    std::string output = "benchmark";
+    std::vector<CameraKey> camera;
+
+    // throws std::runtime_error if the file can't be read or isn't a valid script
+    static BenchmarkScript load(const std::string& path);
+};
+
+// Replays the camera path of a script with a fixed timestep and collects the frame times: the whole frame
+// (from submit to submit, the waits for the GPU included), its CPU part (update, recording and submit) and
+// the GPU time. The results go to a per-frame CSV file and a JSON summary with p50/p95/p99/max of each time,
+// for the CI to compare between runs. The warm-up frames are rendered with the camera at the start of the path
+// and aren't measured.
+class FrameBenchmark
+{
+public:
+    // scene statistics of a frame
+    struct FrameStats
+    {
+        uint32_t drawCalls = 0;
+        uint64_t triangles = 0;
+    };
+
+    explicit FrameBenchmark(const BenchmarkScript& script);
+
+    FrameBenchmark(const FrameBenchmark&) = delete;
+    FrameBenchmark& operator=(const FrameBenchmark&) = delete;
+
+    bool isFinished() const { return renderedFrames >= script.warmupFrames + measuredFrameCount; }
+    float getTimestep() const { return script.timestep; }
+    // moves the camera to the point of the path of the frame about to be rendered
+    void placeCamera(TransformComponent& cameraTransform) const;
+
+    // the frame's CPU time is measured from beginFrame(), called after WrpRenderer::beginFrame(), to submitFrame()
+    void beginFrame();
+    void submitFrame(const FrameStats& stats);
+    // GPU times are received in the order of the frames (WrpGpuTimer::setResultCallback()), a few frames late
+    void addGpuTime(float ms);
+
+    // writes the CSV and JSON files and prints the summary; the memory usage is in bytes
+    void writeResults(uint64_t deviceMemory, uint64_t hostMemory);
+
+private:
+    struct FrameSample
+    {
+        float frameMs = 0.f;
+        float cpuMs = 0.f;
+        FrameStats stats;
+    };
+
+    float pathTime() const;
+
+    BenchmarkScript script;
+    uint32_t measuredFrameCount = 0;
+    uint32_t renderedFrames = 0;
+    uint32_t gpuResults = 0; // received so far, the warm-up frames included
+
+    std::chrono::high_resolution_clock::time_point frameBegin{};
+    std::chrono::high_resolution_clock::time_point lastSubmit{};
+    bool frameStarted = false;
+    std::vector<FrameSample> samples; // of the measured frames
+    std::vector<float> gpuMs;         // of the measured frames, shorter if the GPU timer isn't supported
+};
+
+// peak resident memory of the process in bytes, 0 if it can't be queried
+uint64_t getPeakHostMemoryUsage();
@@ -1,6 +1,6 @@
 #pragma once
 
-#include "./../../renderer/SceneObject.hpp"
+#include "./../../renderer/Components.hpp"
 #include "./../../renderer/Window.hpp"
 
 class KeyboardMovementController
@@ -21,8 +21,8 @@ public:
         int mouseCamera = GLFW_MOUSE_BUTTON_RIGHT;
     };
 
-    // sceneObject is controllable object 
-    void moveInPlaneXZ(GLFWwindow* window, float dt, SceneObject& sceneObject);
+    // transform is the transform of the controllable object
+    void moveInPlaneXZ(GLFWwindow* window, float dt, TransformComponent& transform);
 
     KeyMappings keys{};
     double halfWidth;
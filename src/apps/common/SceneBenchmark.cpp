@@ -0,0 +1,229 @@
+#include "SceneBenchmark.hpp"
+#include "BenchmarkUtils.hpp"
+
+#include "../../renderer/Scene.hpp"
+#include "../../renderer/TransformUpdater.hpp"
+
+// std
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    constexpr uint32_t FRAME_COUNT = 10;    // fewer than the other benchmarks, the map frames are slow
+    constexpr uint32_t MODEL_COUNT = 16;
+    constexpr uint32_t LIGHT_SHARE = 100;   // every 100th entity is a light, the others have models
+    constexpr uint32_t MOVED_SHARE = 10;    // every 10th entity moves in the update frames
+    constexpr uint32_t CHURN_SHARE = 100;   // every 100th entity is destroyed and created again
+
+    // the object layout replaced by WrpScene
+    struct MapObject
+    {
+        std::string name;
+        glm::vec3 color{};
+        TransformComponent transform{};
+        std::shared_ptr<WrpModel> model{};
+        std::unique_ptr<PointLightComponent> pointLight = nullptr;
+    };
+    using ObjectMap = std::unordered_map<uint32_t, MapObject>;
+
+    // what the render systems read each frame: the model and the matrices of the objects with models,
+    // the position and the colour of the lights
+    struct FrameChecksum
+    {
+        uint32_t models = 0;
+        uint32_t lights = 0;
+        double value = 0.0;
+
+        // the storages are iterated in different orders, so the sums are rounded differently
+        bool operator==(const FrameChecksum& other) const
+        {
+            return models == other.models && lights == other.lights
+                && std::abs(value - other.value) <= 1e-9 * (1.0 + std::abs(other.value));
+        }
+    };
+
+    void printResult(const char* operation, float mapMs, float sceneMs)
+    {
+        printBenchmarkResult(operation, sceneMs, "map", mapMs);
+    }
+
+    void accumulateModel(FrameChecksum& checksum, const WrpModel* model, TransformComponent& transform,
+        const WrpModel* firstModel)
+    {
+        const glm::mat4& modelMatrix = transform.modelMatrix();
+        checksum.value += modelMatrix[3].x + modelMatrix[0].y + static_cast<double>(model - firstModel);
+        ++checksum.models;
+    }
+
+    void accumulateLight(FrameChecksum& checksum, const PointLightComponent& pointLight, const TransformComponent& transform)
+    {
+        checksum.value += transform.translation.z + pointLight.color.r * pointLight.lightIntensity;
+        ++checksum.lights;
+    }
+}
+
+bool runSceneBenchmark(uint32_t entityCount)
+{
+    // The models are placeholders: creating WrpModel needs a device, and the storages only keep and compare
+    // the pointers. The aliasing constructor points the shared pointers into an array of the right alignment.
+    std::vector<std::max_align_t> modelStorage(MODEL_COUNT * (sizeof(WrpModel) / sizeof(std::max_align_t) + 1));
+    std::vector<std::shared_ptr<WrpModel>> models;
+    size_t modelStride = modelStorage.size() / MODEL_COUNT;
+    for (uint32_t i = 0; i < MODEL_COUNT; ++i) {
+        models.emplace_back(std::shared_ptr<void>{}, reinterpret_cast<WrpModel*>(&modelStorage[i * modelStride]));
+    }
+    const WrpModel* firstModel = models.front().get();
+
+    std::mt19937 random{7};
+    std::uniform_real_distribution<float> position{-500.f, 500.f};
+    std::uniform_real_distribution<float> angle{-3.f, 3.f};
+
+    ObjectMap objects;
+    WrpScene scene;
+    scene.reserve(entityCount);
+    std::vector<WrpEntity> entities;
+    entities.reserve(entityCount);
+    BenchmarkTimer createTimer;
+    for (uint32_t i = 0; i < entityCount; ++i)
+    {
+        glm::vec3 translation{position(random), position(random), position(random)};
+        glm::vec3 rotation{angle(random), angle(random), angle(random)};
+
+        MapObject object{"Object" + std::to_string(i)};
+        object.transform.translation = translation;
+        object.transform.rotation = rotation;
+        WrpEntity entity = scene.createEntity();
+        TransformComponent& transform = scene.getTransform(entity);
+        transform.translation = translation;
+        transform.rotation = rotation;
+        if (i % LIGHT_SHARE == 0)
+        {
+            object.color = glm::vec3(1.f, 0.5f, 0.25f);
+            object.pointLight = std::make_unique<PointLightComponent>();
+            PointLightComponent& pointLight = scene.pointLights.emplace(entity);
+            pointLight.color = object.color;
+        }
+        else
+        {
+            object.model = models[i % MODEL_COUNT];
+            scene.setModel(entity, models[i % MODEL_COUNT]);
+        }
+        objects.emplace(i, std::move(object));
+        entities.push_back(entity);
+    }
+    float createMs = createTimer.elapsedMs();
+
+    std::printf("Scene storage benchmark, %u entities (%zu with models, %zu lights), %u frames, created in %.1f ms\n",
+        entityCount, scene.models.size(), scene.pointLights.size(), FRAME_COUNT, createMs);
+
+    // the first update builds all matrices
+    WrpTransformUpdater mapUpdater{};
+    WrpTransformUpdater sceneUpdater{};
+    std::vector<TransformComponent*> mapTransforms;
+    auto updateMap = [&]() {
+        // the gathering of the pointers is what the update of the map did every frame
+        mapTransforms.clear();
+        for (auto& kv : objects) {
+            mapTransforms.push_back(&kv.second.transform);
+        }
+        return mapUpdater.update(mapTransforms);
+    };
+    updateMap();
+    sceneUpdater.update(scene);
+
+    FrameChecksum mapChecksum{};
+    float mapMs = measureFrames(FRAME_COUNT, [&](uint32_t) {
+        mapChecksum = {};
+        for (auto& kv : objects)
+        {
+            MapObject& object = kv.second;
+            if (object.model == nullptr) continue;
+            accumulateModel(mapChecksum, object.model.get(), object.transform, firstModel);
+        }
+    });
+    FrameChecksum sceneChecksum{};
+    float sceneMs = measureFrames(FRAME_COUNT, [&](uint32_t) {
+        sceneChecksum = {};
+        scene.each<ModelComponent>([&](WrpEntity, ModelComponent& component, TransformComponent& transform) {
+            accumulateModel(sceneChecksum, component.model.get(), transform, firstModel);
+        });
+    });
+    printResult("iterate models and matrices", mapMs, sceneMs);
+    bool valid = mapChecksum == sceneChecksum;
+
+    mapMs = measureFrames(FRAME_COUNT, [&](uint32_t) {
+        mapChecksum = {};
+        for (auto& kv : objects)
+        {
+            MapObject& object = kv.second;
+            if (object.pointLight == nullptr) continue;
+            accumulateLight(mapChecksum, *object.pointLight, object.transform);
+        }
+    });
+    sceneMs = measureFrames(FRAME_COUNT, [&](uint32_t) {
+        sceneChecksum = {};
+        scene.each<PointLightComponent>([&](WrpEntity, PointLightComponent& pointLight, TransformComponent& transform) {
+            accumulateLight(sceneChecksum, pointLight, transform);
+        });
+    });
+    printResult("iterate lights", mapMs, sceneMs);
+    valid = valid && mapChecksum == sceneChecksum;
+
+    uint32_t mapUpdated = 0;
+    uint32_t sceneUpdated = 0;
+    mapMs = measureFrames(FRAME_COUNT, [&](uint32_t frame) {
+        for (uint32_t i = frame % MOVED_SHARE; i < entityCount; i += MOVED_SHARE) {
+            objects.at(i).transform.rotation.y += 0.01f;
+        }
+        mapUpdated = updateMap();
+    });
+    sceneMs = measureFrames(FRAME_COUNT, [&](uint32_t frame) {
+        for (uint32_t i = frame % MOVED_SHARE; i < entityCount; i += MOVED_SHARE) {
+            scene.getTransform(entities[i]).rotation.y += 0.01f;
+        }
+        sceneUpdated = sceneUpdater.update(scene);
+    });
+    printResult("move 10% and update transforms", mapMs, sceneMs);
+    valid = valid && mapUpdated == sceneUpdated;
+
+    mapMs = measureFrames(FRAME_COUNT, [&](uint32_t) { mapUpdated = updateMap(); });
+    sceneMs = measureFrames(FRAME_COUNT, [&](uint32_t) { sceneUpdated = sceneUpdater.update(scene); });
+    printResult("update transforms, none moved", mapMs, sceneMs);
+    valid = valid && mapUpdated == 0 && sceneUpdated == 0;
+
+    // the destroyed objects get new ids, the entities reuse their slots with new generations
+    std::vector<uint32_t> ids(entityCount);
+    for (uint32_t i = 0; i < entityCount; ++i) {
+        ids[i] = i;
+    }
+    uint32_t nextId = entityCount;
+    mapMs = measureFrames(FRAME_COUNT, [&](uint32_t frame) {
+        for (uint32_t i = frame % CHURN_SHARE; i < entityCount; i += CHURN_SHARE)
+        {
+            objects.erase(ids[i]);
+            ids[i] = nextId++;
+            MapObject object{"Object" + std::to_string(ids[i])};
+            object.model = models[i % MODEL_COUNT];
+            objects.emplace(ids[i], std::move(object));
+        }
+    });
+    sceneMs = measureFrames(FRAME_COUNT, [&](uint32_t frame) {
+        for (uint32_t i = frame % CHURN_SHARE; i < entityCount; i += CHURN_SHARE)
+        {
+            scene.destroyEntity(entities[i]);
+            entities[i] = scene.createEntity();
+            scene.setModel(entities[i], models[i % MODEL_COUNT]);
+        }
+    });
+    printResult("destroy and create 1%", mapMs, sceneMs);
+    valid = valid && objects.size() == scene.getEntityCount();
+
+    std::printf("    results of the storages %s\n", valid ? "match" : "DIFFER");
+    return valid;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+// std
+#include <cstdint>
+
+// Benchmark of the scene storage over entityCount entities, it doesn't need a window or a GPU.
+// Compares WrpScene with the map of objects it replaced (each object a node with its name, transform,
+// model pointer and light pointer): iterating the models and the lights as the render systems do,
+// the per-frame transform update, and destroying and creating entities. Returns false if the two storages
+// give different results.
+bool runSceneBenchmark(uint32_t entityCount);
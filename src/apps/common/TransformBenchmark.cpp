@@ -0,0 +1,120 @@
+#include "TransformBenchmark.hpp"
+#include "BenchmarkUtils.hpp"
+
+#include "../../renderer/TransformUpdater.hpp"
+
+// libs
+#include <glm/gtc/constants.hpp>
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+    constexpr uint32_t FRAME_COUNT = 20;
+    constexpr float MAX_DIFFERENCE = 1e-4f; // between the SIMD and the scalar matrices, relative to the element
+
+    // average time of a frame, where change() moves the objects (not measured) and update() rebuilds their matrices
+    template <typename Change, typename Update>
+    float measureUpdates(Change change, Update update, uint32_t& updatedCount)
+    {
+        return measureFrames(FRAME_COUNT, change, [&](uint32_t) { updatedCount = update(); });
+    }
+
+    void printResult(const char* operation, float ms, uint32_t updatedCount)
+    {
+        printBenchmarkResult(operation, ms);
+        std::printf("    %u updated\n", updatedCount);
+    }
+
+    float maxDifference(std::vector<TransformComponent>& a, std::vector<TransformComponent>& b)
+    {
+        float difference = 0.f;
+        for (size_t i = 0; i < a.size(); ++i)
+        {
+            const glm::mat4& modelA = a[i].modelMatrix();
+            const glm::mat4& modelB = b[i].modelMatrix();
+            const glm::mat3& normalA = a[i].normalMatrix();
+            const glm::mat3& normalB = b[i].normalMatrix();
+            for (int column = 0; column < 3; ++column)
+            {
+                for (int row = 0; row < 3; ++row)
+                {
+                    difference = std::max(difference,
+                        std::abs(modelA[column][row] - modelB[column][row]) / (1.f + std::abs(modelB[column][row])));
+                    difference = std::max(difference,
+                        std::abs(normalA[column][row] - normalB[column][row]) / (1.f + std::abs(normalB[column][row])));
+                }
+            }
+        }
+        return difference;
+    }
+}
+
+bool runTransformBenchmark(uint32_t objectCount)
+{
+    std::mt19937 random{42};
+    std::uniform_real_distribution<float> position{-500.f, 500.f};
+    std::uniform_real_distribution<float> angle{-glm::pi<float>(), glm::pi<float>()};
+    std::uniform_real_distribution<float> size{0.1f, 4.f};
+
+    std::vector<TransformComponent> transforms(objectCount);
+    for (TransformComponent& transform : transforms)
+    {
+        transform.translation = {position(random), position(random), position(random)};
+        transform.rotation = {angle(random), angle(random), angle(random)};
+        transform.scale = {size(random), size(random), size(random)};
+    }
+    std::vector<TransformComponent> reference = transforms;
+
+    std::vector<TransformComponent*> pointers(objectCount);
+    std::vector<TransformComponent*> referencePointers(objectCount);
+    for (uint32_t i = 0; i < objectCount; ++i)
+    {
+        pointers[i] = &transforms[i];
+        referencePointers[i] = &reference[i];
+    }
+
+    std::printf("Transform update benchmark, %u objects, %u frames\n", objectCount, FRAME_COUNT);
+    WrpTransformUpdater updater{};
+    WrpTransformUpdater referenceUpdater{};
+    uint32_t updatedCount = 0;
+    auto rotateEvery = [&](uint32_t step) {
+        return [&, step](uint32_t frame) {
+            for (uint32_t i = frame % step; i < objectCount; i += step)
+            {
+                transforms[i].rotation.y += 0.01f;
+                reference[i].rotation.y += 0.01f;
+            }
+        };
+    };
+
+    // the matrices are rebuilt from scratch every frame, as the render systems did before the cache
+    float ms = measureUpdates(rotateEvery(1), [&]() { return referenceUpdater.updateScalar(referencePointers); }, updatedCount);
+    printResult("all rotated, scalar", ms, updatedCount);
+    ms = measureUpdates(rotateEvery(1), [&]() { return updater.update(pointers); }, updatedCount);
+    printResult("all rotated, SIMD batch", ms, updatedCount);
+
+    float difference = maxDifference(transforms, reference);
+    bool valid = difference <= MAX_DIFFERENCE;
+    std::printf("    max difference from the scalar matrices %.2e%s\n", difference, valid ? "" : " - MISMATCH");
+
+    ms = measureUpdates(rotateEvery(100), [&]() { return updater.update(pointers); }, updatedCount);
+    printResult("1% rotated, SIMD batch", ms, updatedCount);
+    ms = measureUpdates(
+        [&](uint32_t frame) {
+            for (uint32_t i = frame % 10; i < objectCount; i += 10) {
+                transforms[i].translation.x += 0.01f;
+            }
+        },
+        [&]() { return updater.update(pointers); }, updatedCount);
+    printResult("10% translated, SIMD batch", ms, updatedCount);
+    ms = measureUpdates([](uint32_t) {}, [&]() { return updater.update(pointers); }, updatedCount);
+    printResult("none changed (dirty checks only)", ms, updatedCount);
+
+    return valid;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+// std
+#include <cstdint>
+
+// Benchmark of the per-frame transform update over objectCount transforms, it doesn't need a window or a GPU.
+// Prints the time of rebuilding the cached matrices when all, a part or none of the transforms changed,
+// and checks the SIMD batch against the scalar update. Returns false if their matrices differ.
+bool runTransformBenchmark(uint32_t objectCount);
@@ -0,0 +1,481 @@
+#include "Bvh.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <queue>
+#include <utility>
+
+namespace
+{
+    constexpr uint32_t SAH_BINS = 12;
+    constexpr size_t MAX_LEAVES_PER_MEDIAN_SPLIT = 4; // smaller ranges are split at the median without binning
+}
+
+WrpAabb WrpAabb::transform(const WrpAabb& box, const glm::mat4& matrix)
+{
+    glm::vec3 translation{matrix[3]};
+    WrpAabb result{translation, translation};
+    for (int column = 0; column < 3; ++column)
+    {
+        glm::vec3 a = glm::vec3(matrix[column]) * box.min[column];
+        glm::vec3 b = glm::vec3(matrix[column]) * box.max[column];
+        result.min += glm::min(a, b);
+        result.max += glm::max(a, b);
+    }
+    return result;
+}
+
+WrpBvh::ProxyId WrpBvh::allocateNode()
+{
+    if (freeList == NULL_PROXY)
+    {
+        nodes.emplace_back();
+        return static_cast<ProxyId>(nodes.size() - 1);
+    }
+    ProxyId node = freeList;
+    freeList = nodes[node].parent;
+    nodes[node] = Node{};
+    return node;
+}
+
+void WrpBvh::freeNode(ProxyId node)
+{
+    nodes[node].parent = freeList;
+    nodes[node].height = -1;
+    freeList = node;
+}
+
+WrpBvh::ProxyId WrpBvh::insert(const WrpAabb& box, uint64_t userData)
+{
+    ProxyId leaf = allocateNode();
+    nodes[leaf].leafBox = box;
+    nodes[leaf].box = {box.min - glm::vec3(fatMargin), box.max + glm::vec3(fatMargin)};
+    nodes[leaf].userData = userData;
+    nodes[leaf].height = 0;
+    insertLeaf(leaf);
+    ++proxyCount;
+    return leaf;
+}
+
+void WrpBvh::remove(ProxyId proxy)
+{
+    assert(proxy >= 0 && proxy < static_cast<ProxyId>(nodes.size()) && nodes[proxy].isLeaf() && nodes[proxy].height == 0);
+    removeLeaf(proxy);
+    freeNode(proxy);
+    --proxyCount;
+}
+
+bool WrpBvh::update(ProxyId proxy, const WrpAabb& box)
+{
+    assert(nodes[proxy].isLeaf() && nodes[proxy].height == 0);
+    nodes[proxy].leafBox = box;
+    if (nodes[proxy].box.contains(box)) return false;
+
+    nodes[proxy].box = {box.min - glm::vec3(fatMargin), box.max + glm::vec3(fatMargin)};
+    refitAncestors(nodes[proxy].parent, false);
+    return true;
+}
+
+void WrpBvh::clear()
+{
+    nodes.clear();
+    root = NULL_PROXY;
+    freeList = NULL_PROXY;
+    proxyCount = 0;
+}
+
+void WrpBvh::insertLeaf(ProxyId leaf)
+{
+    if (root == NULL_PROXY)
+    {
+        root = leaf;
+        nodes[root].parent = NULL_PROXY;
+        return;
+    }
+
+    // Descends to the sibling with the smallest cost: the area of the new parent plus the area
+    // added to the ancestors. It stops at a node if going down can't be cheaper.
+    WrpAabb leafBox = nodes[leaf].box;
+    ProxyId index = root;
+    while (!nodes[index].isLeaf())
+    {
+        ProxyId left = nodes[index].left;
+        ProxyId right = nodes[index].right;
+
+        float area = nodes[index].box.surfaceArea();
+        float combinedArea = WrpAabb::merge(nodes[index].box, leafBox).surfaceArea();
+        float cost = 2.f * combinedArea;                     // new parent of this node and the leaf
+        float inheritanceCost = 2.f * (combinedArea - area); // minimal growth of the ancestors below this node
+
+        auto descendCost = [&](ProxyId child) {
+            float mergedArea = WrpAabb::merge(nodes[child].box, leafBox).surfaceArea();
+            if (nodes[child].isLeaf()) return mergedArea + inheritanceCost;
+            return mergedArea - nodes[child].box.surfaceArea() + inheritanceCost;
+        };
+        float leftCost = descendCost(left);
+        float rightCost = descendCost(right);
+
+        if (cost < leftCost && cost < rightCost) break;
+        index = leftCost < rightCost ? left : right;
+    }
+
+    ProxyId sibling = index;
+    ProxyId oldParent = nodes[sibling].parent;
+    ProxyId newParent = allocateNode();
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].box = WrpAabb::merge(leafBox, nodes[sibling].box);
+    nodes[newParent].height = nodes[sibling].height + 1;
+    nodes[newParent].left = sibling;
+    nodes[newParent].right = leaf;
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+
+    if (oldParent == NULL_PROXY) {
+        root = newParent;
+    }
+    else if (nodes[oldParent].left == sibling) {
+        nodes[oldParent].left = newParent;
+    }
+    else {
+        nodes[oldParent].right = newParent;
+    }
+
+    refitAncestors(nodes[leaf].parent, true);
+}
+
+void WrpBvh::removeLeaf(ProxyId leaf)
+{
+    if (leaf == root)
+    {
+        root = NULL_PROXY;
+        return;
+    }
+
+    ProxyId parent = nodes[leaf].parent;
+    ProxyId grandParent = nodes[parent].parent;
+    ProxyId sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+    // the sibling takes the place of the parent
+    if (grandParent == NULL_PROXY)
+    {
+        root = sibling;
+        nodes[sibling].parent = NULL_PROXY;
+        freeNode(parent);
+        return;
+    }
+    if (nodes[grandParent].left == parent) nodes[grandParent].left = sibling;
+    else nodes[grandParent].right = sibling;
+    nodes[sibling].parent = grandParent;
+    freeNode(parent);
+
+    refitAncestors(grandParent, true);
+}
+
+void WrpBvh::refitAncestors(ProxyId node, bool rebalance)
+{
+    while (node != NULL_PROXY)
+    {
+        if (rebalance) {
+            node = balance(node);
+        }
+        Node& n = nodes[node];
+        n.box = WrpAabb::merge(nodes[n.left].box, nodes[n.right].box);
+        n.height = 1 + std::max(nodes[n.left].height, nodes[n.right].height);
+        node = n.parent;
+    }
+}
+
+// Rotates the taller child of the node up if the children's heights differ by more than one.
+// Returns the node that has taken the place of the given one.
+WrpBvh::ProxyId WrpBvh::balance(ProxyId a)
+{
+    if (nodes[a].isLeaf() || nodes[a].height < 2) return a;
+
+    ProxyId b = nodes[a].left;
+    ProxyId c = nodes[a].right;
+    int heightDifference = nodes[c].height - nodes[b].height;
+    if (heightDifference >= -1 && heightDifference <= 1) return a;
+
+    // the taller child becomes the parent of the node, its taller child stays with it
+    bool rotateRight = heightDifference > 1;
+    ProxyId up = rotateRight ? c : b;
+    ProxyId other = rotateRight ? b : c;
+    ProxyId f = nodes[up].left;
+    ProxyId g = nodes[up].right;
+
+    nodes[up].left = a;
+    nodes[up].parent = nodes[a].parent;
+    nodes[a].parent = up;
+
+    ProxyId upParent = nodes[up].parent;
+    if (upParent == NULL_PROXY) {
+        root = up;
+    }
+    else if (nodes[upParent].left == a) {
+        nodes[upParent].left = up;
+    }
+    else {
+        nodes[upParent].right = up;
+    }
+
+    ProxyId keep = nodes[f].height > nodes[g].height ? f : g;
+    ProxyId give = keep == f ? g : f;
+    nodes[up].right = keep;
+    if (rotateRight) nodes[a].right = give;
+    else nodes[a].left = give;
+    nodes[give].parent = a;
+
+    nodes[a].box = WrpAabb::merge(nodes[other].box, nodes[give].box);
+    nodes[a].height = 1 + std::max(nodes[other].height, nodes[give].height);
+    nodes[up].box = WrpAabb::merge(nodes[a].box, nodes[keep].box);
+    nodes[up].height = 1 + std::max(nodes[a].height, nodes[keep].height);
+    return up;
+}
+
+void WrpBvh::rebuild()
+{
+    if (root == NULL_PROXY) return;
+
+    // the leaves keep their indices (proxy ids), the inner nodes are recreated
+    std::vector<ProxyId> leaves;
+    leaves.reserve(proxyCount);
+    for (ProxyId i = 0; i < static_cast<ProxyId>(nodes.size()); ++i)
+    {
+        if (nodes[i].height < 0) continue;
+        if (nodes[i].isLeaf()) leaves.push_back(i);
+        else freeNode(i);
+    }
+
+    root = buildRange(leaves, 0, leaves.size());
+    nodes[root].parent = NULL_PROXY;
+}
+
+// Splits the leaves by the plane with the smallest surface area heuristic cost among the bins
+// along the longest axis of their centers.
+WrpBvh::ProxyId WrpBvh::buildRange(std::vector<ProxyId>& leaves, size_t begin, size_t end)
+{
+    if (end - begin == 1) return leaves[begin];
+
+    WrpAabb centers{glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::lowest())};
+    for (size_t i = begin; i < end; ++i)
+    {
+        glm::vec3 center = nodes[leaves[i]].box.center();
+        centers.min = glm::min(centers.min, center);
+        centers.max = glm::max(centers.max, center);
+    }
+    glm::vec3 extent = centers.max - centers.min;
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+    size_t middle = begin + (end - begin) / 2;
+    bool binned = false;
+    if (end - begin > MAX_LEAVES_PER_MEDIAN_SPLIT && extent[axis] > 0.f)
+    {
+        struct Bin
+        {
+            WrpAabb box{glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::lowest())};
+            uint32_t count = 0;
+        };
+        std::array<Bin, SAH_BINS> bins{};
+        float binScale = SAH_BINS / extent[axis];
+        auto binIndex = [&](ProxyId leaf) {
+            float offset = (nodes[leaf].box.center()[axis] - centers.min[axis]) * binScale;
+            return std::min(static_cast<uint32_t>(offset), SAH_BINS - 1);
+        };
+        for (size_t i = begin; i < end; ++i)
+        {
+            Bin& bin = bins[binIndex(leaves[i])];
+            bin.box = WrpAabb::merge(bin.box, nodes[leaves[i]].box);
+            ++bin.count;
+        }
+
+        // cost of the split after bin i: area * count of both sides, swept from the right then from the left
+        std::array<float, SAH_BINS - 1> rightCosts{};
+        WrpAabb rightBox = bins[SAH_BINS - 1].box;
+        uint32_t rightCount = 0;
+        for (uint32_t i = SAH_BINS - 1; i > 0; --i)
+        {
+            rightBox = WrpAabb::merge(rightBox, bins[i].box);
+            rightCount += bins[i].count;
+            rightCosts[i - 1] = rightCount > 0 ? rightBox.surfaceArea() * rightCount : 0.f;
+        }
+        float bestCost = std::numeric_limits<float>::max();
+        uint32_t bestSplit = 0;
+        WrpAabb leftBox = bins[0].box;
+        uint32_t leftCount = 0;
+        for (uint32_t i = 0; i < SAH_BINS - 1; ++i)
+        {
+            leftBox = WrpAabb::merge(leftBox, bins[i].box);
+            leftCount += bins[i].count;
+            if (leftCount == 0 || leftCount == end - begin) continue;
+            float cost = leftBox.surfaceArea() * leftCount + rightCosts[i];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestSplit = i;
+            }
+        }
+
+        if (bestCost < std::numeric_limits<float>::max())
+        {
+            auto split = std::partition(leaves.begin() + begin, leaves.begin() + end,
+                [&](ProxyId leaf) { return binIndex(leaf) <= bestSplit; });
+            middle = static_cast<size_t>(split - leaves.begin());
+            binned = true;
+        }
+    }
+    if (!binned)
+    {
+        std::nth_element(leaves.begin() + begin, leaves.begin() + middle, leaves.begin() + end,
+            [&](ProxyId a, ProxyId b) { return nodes[a].box.center()[axis] < nodes[b].box.center()[axis]; });
+    }
+
+    ProxyId left = buildRange(leaves, begin, middle);
+    ProxyId right = buildRange(leaves, middle, end);
+    ProxyId node = allocateNode();
+    nodes[node].left = left;
+    nodes[node].right = right;
+    nodes[node].box = WrpAabb::merge(nodes[left].box, nodes[right].box);
+    nodes[node].height = 1 + std::max(nodes[left].height, nodes[right].height);
+    nodes[left].parent = node;
+    nodes[right].parent = node;
+    return node;
+}
+
+float WrpBvh::getCost() const
+{
+    if (root == NULL_PROXY || nodes[root].isLeaf()) return 0.f;
+
+    float innerArea = 0.f;
+    for (const Node& node : nodes)
+    {
+        if (node.height > 0) innerArea += node.box.surfaceArea();
+    }
+    return innerArea / nodes[root].box.surfaceArea();
+}
+
+void WrpBvh::queryFrustum(const std::array<glm::vec4, 6>& frustumPlanes, const std::function<void(uint64_t)>& callback) const
+{
+    if (root == NULL_PROXY) return;
+
+    // the box is outside if its corner farthest along the plane normal is behind the plane
+    auto isOutside = [&frustumPlanes](const WrpAabb& box) {
+        for (const glm::vec4& plane : frustumPlanes)
+        {
+            glm::vec3 farCorner = glm::mix(box.min, box.max, glm::greaterThan(glm::vec3(plane), glm::vec3(0.f)));
+            if (glm::dot(glm::vec3(plane), farCorner) + plane.w < 0.f) return true;
+        }
+        return false;
+    };
+
+    std::vector<ProxyId> stack{root};
+    while (!stack.empty())
+    {
+        ProxyId index = stack.back();
+        stack.pop_back();
+        const Node& node = nodes[index];
+        if (node.isLeaf())
+        {
+            if (!isOutside(node.leafBox)) callback(node.userData);
+            continue;
+        }
+        if (isOutside(node.box)) continue;
+        stack.push_back(node.left);
+        stack.push_back(node.right);
+    }
+}
+
+void WrpBvh::querySphere(const glm::vec3& center, float radius, const std::function<void(uint64_t)>& callback) const
+{
+    if (root == NULL_PROXY) return;
+
+    float radiusSquared = radius * radius;
+    std::vector<ProxyId> stack{root};
+    while (!stack.empty())
+    {
+        ProxyId index = stack.back();
+        stack.pop_back();
+        const Node& node = nodes[index];
+        if (node.isLeaf())
+        {
+            if (node.leafBox.distanceSquared(center) <= radiusSquared) callback(node.userData);
+            continue;
+        }
+        if (node.box.distanceSquared(center) > radiusSquared) continue;
+        stack.push_back(node.left);
+        stack.push_back(node.right);
+    }
+}
+
+void WrpBvh::queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+    const std::function<float(uint64_t, float)>& callback) const
+{
+    if (root == NULL_PROXY) return;
+
+    // slab test, returns the entry distance or a negative value if the box is missed
+    glm::vec3 inverseDirection = 1.f / direction;
+    auto intersect = [&](const WrpAabb& box) {
+        glm::vec3 t0 = (box.min - origin) * inverseDirection;
+        glm::vec3 t1 = (box.max - origin) * inverseDirection;
+        glm::vec3 tMin = glm::min(t0, t1);
+        glm::vec3 tMax = glm::max(t0, t1);
+        float enter = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.f));
+        float exit = std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, maxDistance));
+        return enter <= exit ? enter : -1.f;
+    };
+
+    std::vector<ProxyId> stack{root};
+    while (!stack.empty())
+    {
+        ProxyId index = stack.back();
+        stack.pop_back();
+        const Node& node = nodes[index];
+        if (node.isLeaf())
+        {
+            float distance = intersect(node.leafBox);
+            if (distance < 0.f) continue;
+            maxDistance = callback(node.userData, distance);
+            if (maxDistance <= 0.f) return;
+            continue;
+        }
+        if (intersect(node.box) < 0.f) continue;
+        stack.push_back(node.left);
+        stack.push_back(node.right);
+    }
+}
+
+void WrpBvh::queryNearest(const glm::vec3& point, uint32_t k, std::vector<uint64_t>& result) const
+{
+    result.clear();
+    if (root == NULL_PROXY || k == 0) return;
+
+    // best-first traversal: the nodes ordered by the distance to their boxes, the k best leaves in a max-heap
+    using Entry = std::pair<float, ProxyId>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+    std::priority_queue<Entry> best;
+    open.push({nodes[root].box.distanceSquared(point), root});
+    while (!open.empty())
+    {
+        auto [distance, index] = open.top();
+        open.pop();
+        if (best.size() == k && distance >= best.top().first) break;
+
+        const Node& node = nodes[index];
+        if (node.isLeaf())
+        {
+            best.push({node.leafBox.distanceSquared(point), index});
+            if (best.size() > k) best.pop();
+            continue;
+        }
+        open.push({nodes[node.left].isLeaf() ? nodes[node.left].leafBox.distanceSquared(point) : nodes[node.left].box.distanceSquared(point), node.left});
+        open.push({nodes[node.right].isLeaf() ? nodes[node.right].leafBox.distanceSquared(point) : nodes[node.right].box.distanceSquared(point), node.right});
+    }
+
+    result.resize(best.size());
+    for (size_t i = result.size(); i > 0; --i)
+    {
+        result[i - 1] = nodes[best.top().second].userData;
+        best.pop();
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+// libs
+#define GLM_FORCE_RADIANS			  // Функции GLM будут работать с радианами, а не градусами
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE   // GLM будет ожидать интервал нашего буфера глубины от 0 до 1 (например, для OpenGL используется интервал от -1 до 1)
+#include <glm/glm.hpp>
+
+// std
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+struct WrpAabb
+{
+    glm::vec3 min{0.f};
+    glm::vec3 max{0.f};
+
+    static WrpAabb merge(const WrpAabb& a, const WrpAabb& b) { return {glm::min(a.min, b.min), glm::max(a.max, b.max)}; }
+    // box around the transformed box (J. Arvo, "Transforming Axis-Aligned Bounding Boxes")
+    static WrpAabb transform(const WrpAabb& box, const glm::mat4& matrix);
+
+    bool contains(const WrpAabb& other) const { return glm::all(glm::lessThanEqual(min, other.min)) && glm::all(glm::lessThanEqual(other.max, max)); }
+    bool intersects(const WrpAabb& other) const { return glm::all(glm::lessThanEqual(min, other.max)) && glm::all(glm::lessThanEqual(other.min, max)); }
+    float surfaceArea() const { glm::vec3 d = max - min; return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x); }
+    float distanceSquared(const glm::vec3& point) const { glm::vec3 d = glm::max(glm::max(min - point, point - max), glm::vec3(0.f)); return glm::dot(d, d); }
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+};
+
+// Dynamic AABB tree (bounding volume hierarchy) over user objects identified by 64-bit user data.
+//
+// Leaves store the object's box and a "fat" box enlarged by a margin, so small movements don't change the tree:
+//  - insert() finds the sibling by the surface area cost of the enlarged ancestors and rebalances the path
+//    by rotations (like Box2D's b2DynamicTree);
+//  - update() does nothing while the new box fits into the fat one, otherwise it refits the leaf and its
+//    ancestors in place, which is cheap but degrades the tree if the objects move far;
+//  - rebuild() rebuilds the whole tree top-down by the binned surface area heuristic, it's meant to be
+//    called after many updates (getCost() grows when the tree degrades).
+// The queries test the fat boxes of the inner nodes and the exact boxes of the leaves.
+class WrpBvh
+{
+public:
+    using ProxyId = int32_t;
+    static constexpr ProxyId NULL_PROXY = -1;
+
+    explicit WrpBvh(float fatMargin = 0.1f) : fatMargin{fatMargin} {}
+
+    ProxyId insert(const WrpAabb& box, uint64_t userData);
+    void remove(ProxyId proxy);
+    // returns true if the tree was changed
+    bool update(ProxyId proxy, const WrpAabb& box);
+    void rebuild();
+    void clear();
+
+    uint64_t getUserData(ProxyId proxy) const { return nodes[proxy].userData; }
+    const WrpAabb& getBox(ProxyId proxy) const { return nodes[proxy].box; }
+    uint32_t getProxyCount() const { return proxyCount; }
+    int getHeight() const { return root == NULL_PROXY ? 0 : nodes[root].height; }
+    // sum of the inner nodes' surface areas relative to the root's one, the SAH cost of the traversal
+    float getCost() const;
+
+    // objects whose boxes intersect or are inside the frustum (planes from WrpCamera::getFrustumPlanes())
+    void queryFrustum(const std::array<glm::vec4, 6>& frustumPlanes, const std::function<void(uint64_t)>& callback) const;
+    void querySphere(const glm::vec3& center, float radius, const std::function<void(uint64_t)>& callback) const;
+    // Objects whose boxes are hit by the ray, in no particular order. The callback gets the distance where the ray
+    // enters the box and returns the new maximal distance: the exact hit distance to shorten the ray,
+    // maxDistance to keep it or 0 to stop the query.
+    void queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+        const std::function<float(uint64_t, float)>& callback) const;
+    // k objects with the nearest boxes, sorted by the distance
+    void queryNearest(const glm::vec3& point, uint32_t k, std::vector<uint64_t>& result) const;
+
+private:
+    struct Node
+    {
+        WrpAabb box;     // fat box for the leaves, box of the children for the inner nodes
+        WrpAabb leafBox; // exact box of the object
+        uint64_t userData = 0;
+        ProxyId parent = NULL_PROXY; // next free node for the nodes in the free list
+        ProxyId left = NULL_PROXY;
+        ProxyId right = NULL_PROXY;
+        int height = -1; // 0 for the leaves, -1 for the free nodes
+
+        bool isLeaf() const { return left == NULL_PROXY; }
+    };
+
+    ProxyId allocateNode();
+    void freeNode(ProxyId node);
+    void insertLeaf(ProxyId leaf);
+    void removeLeaf(ProxyId leaf);
+    void refitAncestors(ProxyId node, bool rebalance);
+    ProxyId balance(ProxyId node);
+    ProxyId buildRange(std::vector<ProxyId>& leaves, size_t begin, size_t end);
+
+    std::vector<Node> nodes;
+    ProxyId root = NULL_PROXY;
+    ProxyId freeList = NULL_PROXY;
+    uint32_t proxyCount = 0;
+    float fatMargin;
+};
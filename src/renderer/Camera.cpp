@@ -123,3 +123,24 @@ void WrpCamera::setViewYXZ(glm::vec3 position, glm::vec3 rotation)
     inverseViewMatrix[3][1] = position.y;
     inverseViewMatrix[3][2] = position.z;
 }
+
+// Плоскости извлекаются из строк матрицы projection * view (метод Gribb-Hartmann).
+// Глубина в clip space лежит в интервале [0, w] (GLM_FORCE_DEPTH_ZERO_TO_ONE), поэтому ближняя плоскость - это третья строка.
+std::array<glm::vec4, 6> WrpCamera::getFrustumPlanes() const
+{
+    glm::mat4 m = projectionMatrix * viewMatrix;
+    auto row = [&m](int i) { return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]); };
+
+    std::array<glm::vec4, 6> planes{
+        row(3) + row(0), // left
+        row(3) - row(0), // right
+        row(3) + row(1), // bottom
+        row(3) - row(1), // top
+        row(2),          // near
+        row(3) - row(2)  // far
+    };
+    for (glm::vec4& plane : planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return planes;
+}
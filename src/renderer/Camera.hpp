@@ -7,6 +7,9 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE   // GLM будет ожидать интервал нашего буфера глубины от 0 до 1 (например, для OpenGL используется интервал от -1 до 1)
 #include <glm/glm.hpp>
 
+// std
+#include <array>
+
 class WrpCamera
 {
 public:
@@ -31,6 +34,10 @@ public:
     const glm::mat4& getInverseView() const {return inverseViewMatrix;}
     const glm::vec3 getPosition() const {return glm::vec3(inverseViewMatrix[3]);}
 
+    // Плоскости пирамиды видимости в мировом пространстве (left, right, bottom, top, near, far).
+    // xyz - нормаль, направленная внутрь, w - расстояние; точка p видима, если dot(plane.xyz, p) + plane.w >= 0.
+    std::array<glm::vec4, 6> getFrustumPlanes() const;
+
 private:
     glm::mat4 projectionMatrix{1.f}; // матрица проекции перспективы
     glm::mat4 viewMatrix{1.f}; // матрица просмотра (камеры)
@@ -0,0 +1,141 @@
+#include "ClusteredLighting.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+
+namespace
+{
+    // irradiance below which a light is considered not to reach a surface
+    constexpr float LIGHT_CUTOFF = 0.01f;
+}
+
+WrpClusteredLighting::WrpClusteredLighting(WrpDevice& device, uint32_t framesInFlight, VkDescriptorSetLayout globalSetLayout)
+    : wrpDevice{device}
+{
+    frames.resize(framesInFlight);
+    for (FrameBuffers& frame : frames)
+    {
+        // PROPERTY_HOST_COHERENT is not used, the written lights are flushed like the UBO
+        frame.lightBuffer = std::make_unique<WrpBuffer>(
+            wrpDevice, sizeof(PointLight), MAX_LIGHTS,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        frame.lightBuffer->map();
+
+        // written and read only by the GPU
+        frame.clusterBuffer = std::make_unique<WrpBuffer>(
+            wrpDevice, 2 * sizeof(uint32_t), CLUSTER_COUNT,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        frame.lightIndexBuffer = std::make_unique<WrpBuffer>(
+            wrpDevice, sizeof(uint32_t), CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+
+    createPipeline(globalSetLayout);
+}
+
+WrpClusteredLighting::~WrpClusteredLighting()
+{
+    pipeline.reset();
+    vkDestroyPipelineLayout(wrpDevice.device(), pipelineLayout, nullptr);
+}
+
+void WrpClusteredLighting::createPipeline(VkDescriptorSetLayout globalSetLayout)
+{
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &globalSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(wrpDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create light culling pipeline layout!");
+    }
+
+    pipeline = std::make_unique<WrpComputePipeline>(wrpDevice, "LightCulling.comp", pipelineLayout);
+}
+
+float WrpClusteredLighting::lightRadius(glm::vec3 color, float intensity)
+{
+    // the irradiance of the brightest channel, intensity / d^2, equals the cutoff at the radius
+    float maxIntensity = std::max({color.r, color.g, color.b}) * intensity;
+    return std::sqrt(std::max(maxIntensity, 0.f) / LIGHT_CUTOFF);
+}
+
+void WrpClusteredLighting::update(int frameIndex, const std::vector<PointLight>& lights, GlobalUbo& ubo,
+    VkExtent2D extent, float near, float far, bool enabled)
+{
+    assert(frameIndex >= 0 && static_cast<size_t>(frameIndex) < frames.size() && "Invalid frame index");
+
+    // the buffer holds MAX_LIGHTS, the lights over it are dropped (PointLightSystem::update() doesn't collect them)
+    uint32_t lightCount = static_cast<uint32_t>(std::min<size_t>(lights.size(), MAX_LIGHTS));
+    clusteringEnabled = enabled;
+    if (lightCount > 0)
+    {
+        WrpBuffer& lightBuffer = *frames[frameIndex].lightBuffer;
+        lightBuffer.writeToBuffer(const_cast<PointLight*>(lights.data()), lightCount * sizeof(PointLight));
+        lightBuffer.flush();
+    }
+
+    ubo.numLights = static_cast<int>(lightCount);
+    ubo.clusterCount = glm::uvec4(CLUSTERS_X, CLUSTERS_Y, CLUSTERS_Z, enabled ? 1u : 0u);
+    ubo.clusterTileSize = glm::vec4(
+        std::ceil(static_cast<float>(extent.width) / CLUSTERS_X),
+        std::ceil(static_cast<float>(extent.height) / CLUSTERS_Y),
+        static_cast<float>(extent.width),
+        static_cast<float>(extent.height));
+
+    // slice = floor(log(z) * zScale - zBias) maps [near, far] to [0, CLUSTERS_Z) with exponentially growing slices
+    float logDepthRange = std::log(far / near);
+    ubo.clusterSlicing = glm::vec4(
+        CLUSTERS_Z / logDepthRange,
+        CLUSTERS_Z * std::log(near) / logDepthRange,
+        0.f, 0.f);
+}
+
+void WrpClusteredLighting::cull(VkCommandBuffer commandBuffer, VkDescriptorSet globalDescriptorSet, uint32_t globalUboOffset)
+{
+    if (!clusteringEnabled) return;
+
+    pipeline->bind(commandBuffer);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout,
+        0, 1, &globalDescriptorSet, 1, &globalUboOffset);
+
+    PushConstants push{};
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &push);
+    vkCmdDispatch(commandBuffer, (CLUSTER_COUNT + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+    // the fragment shaders of the frame read the cluster lists
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+VkDescriptorBufferInfo WrpClusteredLighting::getLightBufferInfo(int frameIndex) const
+{
+    return frames[frameIndex].lightBuffer->descriptorInfo();
+}
+
+VkDescriptorBufferInfo WrpClusteredLighting::getClusterBufferInfo(int frameIndex) const
+{
+    return frames[frameIndex].clusterBuffer->descriptorInfo();
+}
+
+VkDescriptorBufferInfo WrpClusteredLighting::getLightIndexBufferInfo(int frameIndex) const
+{
+    return frames[frameIndex].lightIndexBuffer->descriptorInfo();
+}
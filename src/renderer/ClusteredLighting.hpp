@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Buffer.hpp"
+#include "Device.hpp"
+#include "FrameInfo.hpp"
+#include "Pipeline.hpp"
+
+// libs
+#include <vulkan/vulkan.h>
+
+// std
+#include <memory>
+#include <vector>
+
+// Clustered forward lighting. The view frustum is split into CLUSTERS_X x CLUSTERS_Y screen tiles and CLUSTERS_Z
+// depth slices (exponential in the view depth), and LightCulling.comp bins the point lights into the clusters
+// their spheres of influence touch. The fragment shaders iterate only the lights of their cluster
+// (ClusteredLights.glsl), so the cost of a fragment depends on the lights near it, not on all lights of the scene.
+//
+// Every frame in flight has its buffers, bound to the global descriptor set:
+//  binding 1 - the point lights, written by the CPU every frame (up to MAX_LIGHTS);
+//  binding 2 - offset and count of every cluster's light list;
+//  binding 3 - the light indices of the clusters, MAX_LIGHTS_PER_CLUSTER per cluster.
+class WrpClusteredLighting
+{
+public:
+    static constexpr uint32_t CLUSTERS_X = 16;
+    static constexpr uint32_t CLUSTERS_Y = 9;
+    static constexpr uint32_t CLUSTERS_Z = 24;
+    static constexpr uint32_t CLUSTER_COUNT = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+    static constexpr uint32_t MAX_LIGHTS_PER_CLUSTER = 256; // the lights over it are dropped by the cluster
+
+    WrpClusteredLighting(WrpDevice& device, uint32_t framesInFlight, VkDescriptorSetLayout globalSetLayout);
+    ~WrpClusteredLighting();
+
+    WrpClusteredLighting(const WrpClusteredLighting&) = delete;
+    WrpClusteredLighting& operator=(const WrpClusteredLighting&) = delete;
+
+    // Distance at which the light's irradiance falls below the visible threshold, the attenuation reaches
+    // zero there (see lightAttenuation() in ClusteredLights.glsl).
+    static float lightRadius(glm::vec3 color, float intensity);
+
+    // Uploads the frame's lights, up to MAX_LIGHTS, and fills the cluster grid fields of the UBO. near and far are the clip planes
+    // of the camera's perspective projection; with enabled == false every fragment iterates all lights.
+    void update(int frameIndex, const std::vector<PointLight>& lights, GlobalUbo& ubo,
+        VkExtent2D extent, float near, float far, bool enabled);
+    // Records the binning of the lights, outside of a render pass. The fragment shader reads are synchronized with it.
+    void cull(VkCommandBuffer commandBuffer, VkDescriptorSet globalDescriptorSet, uint32_t globalUboOffset);
+
+    VkDescriptorBufferInfo getLightBufferInfo(int frameIndex) const;
+    VkDescriptorBufferInfo getClusterBufferInfo(int frameIndex) const;
+    VkDescriptorBufferInfo getLightIndexBufferInfo(int frameIndex) const;
+
+private:
+    static constexpr uint32_t WORKGROUP_SIZE = 128; // local_size_x of LightCulling.comp
+
+    struct PushConstants
+    {
+        uint32_t maxLightsPerCluster = MAX_LIGHTS_PER_CLUSTER;
+    };
+
+    struct FrameBuffers
+    {
+        std::unique_ptr<WrpBuffer> lightBuffer;
+        std::unique_ptr<WrpBuffer> clusterBuffer;
+        std::unique_ptr<WrpBuffer> lightIndexBuffer;
+    };
+
+    void createPipeline(VkDescriptorSetLayout globalSetLayout);
+
+    WrpDevice& wrpDevice;
+
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    std::unique_ptr<WrpComputePipeline> pipeline;
+
+    std::vector<FrameBuffers> frames; // indexed by frame index
+    bool clusteringEnabled = true;
+};
@@ -0,0 +1,110 @@
+#pragma once
+
+// std
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Handle of a scene entity: the index of its slot in the low ENTITY_INDEX_BITS bits and the slot's generation
+// in the high bits. The generation is incremented when the entity is destroyed, so the handles of destroyed entities
+// don't refer to the entities that reuse their slots (until the 8-bit generation wraps around).
+using WrpEntity = uint32_t;
+constexpr WrpEntity NULL_ENTITY = ~0u;
+constexpr uint32_t ENTITY_INDEX_BITS = 24;
+constexpr uint32_t ENTITY_INDEX_MASK = (1u << ENTITY_INDEX_BITS) - 1;
+
+inline uint32_t entityIndex(WrpEntity entity) { return entity & ENTITY_INDEX_MASK; }
+inline uint32_t entityGeneration(WrpEntity entity) { return entity >> ENTITY_INDEX_BITS; }
+
+// Sparse set of the components of one type. The components are stored contiguously in the order of the dense array
+// of their entities, so the systems iterate them linearly. The sparse array maps the entity's slot index
+// to the position of its component; a removed component is replaced by the last one, so the order isn't kept.
+// The references to the components are valid until the next emplace() or remove().
+template <typename T>
+class WrpComponentPool
+{
+public:
+    bool contains(WrpEntity entity) const
+    {
+        uint32_t index = entityIndex(entity);
+        return index < sparse.size() && sparse[index] != INVALID_POSITION && dense[sparse[index]] == entity;
+    }
+
+    T* find(WrpEntity entity) { return contains(entity) ? &components[sparse[entityIndex(entity)]] : nullptr; }
+    const T* find(WrpEntity entity) const { return contains(entity) ? &components[sparse[entityIndex(entity)]] : nullptr; }
+
+    T& get(WrpEntity entity)
+    {
+        assert(contains(entity) && "The entity has no such component");
+        return components[sparse[entityIndex(entity)]];
+    }
+    const T& get(WrpEntity entity) const
+    {
+        assert(contains(entity) && "The entity has no such component");
+        return components[sparse[entityIndex(entity)]];
+    }
+
+    // adds the component to the entity or replaces its existing one
+    template <typename... Args>
+    T& emplace(WrpEntity entity, Args&&... args)
+    {
+        if (T* component = find(entity)) {
+            return *component = T{std::forward<Args>(args)...};
+        }
+
+        uint32_t index = entityIndex(entity);
+        if (index >= sparse.size()) {
+            sparse.resize(index + 1, INVALID_POSITION);
+        }
+        sparse[index] = static_cast<uint32_t>(dense.size());
+        dense.push_back(entity);
+        return components.emplace_back(T{std::forward<Args>(args)...});
+    }
+
+    void remove(WrpEntity entity)
+    {
+        if (!contains(entity)) return;
+
+        uint32_t position = sparse[entityIndex(entity)];
+        uint32_t last = static_cast<uint32_t>(dense.size()) - 1;
+        if (position != last)
+        {
+            dense[position] = dense[last];
+            components[position] = std::move(components[last]);
+            sparse[entityIndex(dense[position])] = position;
+        }
+        dense.pop_back();
+        components.pop_back();
+        sparse[entityIndex(entity)] = INVALID_POSITION;
+    }
+
+    void clear()
+    {
+        sparse.clear();
+        dense.clear();
+        components.clear();
+    }
+
+    void reserve(size_t count)
+    {
+        dense.reserve(count);
+        components.reserve(count);
+    }
+
+    size_t size() const { return dense.size(); }
+    bool empty() const { return dense.empty(); }
+
+    // entities()[i] owns data()[i]
+    const std::vector<WrpEntity>& entities() const { return dense; }
+    std::vector<T>& data() { return components; }
+    const std::vector<T>& data() const { return components; }
+
+private:
+    static constexpr uint32_t INVALID_POSITION = ~0u;
+
+    std::vector<uint32_t> sparse;   // indexed by the entity index
+    std::vector<WrpEntity> dense;
+    std::vector<T> components;      // parallel to dense
+};
@@ -0,0 +1,132 @@
+#include "Components.hpp"
+
+const glm::mat4& TransformComponent::modelMatrix()
+{
+    if (isDirty()) updateMatrices();
+    return cachedModelMatrix;
+}
+
+const glm::mat3& TransformComponent::normalMatrix()
+{
+    if (isDirty()) updateMatrices();
+    return cachedNormalMatrix;
+}
+
+bool TransformComponent::isDirty() const
+{
+    return !cacheValid || translation != cachedTranslation || isRotationOrScaleDirty();
+}
+
+bool TransformComponent::isRotationOrScaleDirty() const
+{
+    return !cacheValid || rotation != cachedRotation || scale != cachedScale;
+}
+
+void TransformComponent::updateTranslation()
+{
+    cachedModelMatrix[3] = glm::vec4(translation, 1.f);
+    cachedTranslation = translation;
+    ++version;
+}
+
+void TransformComponent::updateMatrices()
+{
+    if (!isRotationOrScaleDirty() && !hasParent)
+    {
+        updateTranslation();
+        return;
+    }
+    updateMatrices(glm::sin(rotation), glm::cos(rotation));
+}
+
+void TransformComponent::updateMatrices(const glm::vec3& sinRotation, const glm::vec3& cosRotation)
+{
+    // Ниже представлено оптимизированное создание матрицы афинных преобразований.
+    // Она конструируется по столбцам. Первые три столбца это линейные преобразования,
+    // а четвёртый столбец - вектор для сдвига объекта (translation).
+    // Выражения для поворота по углам Эйлера (YXZ последовательность Тейта-Брайана)
+    // взяты из википедии. Эти выражения получены после перемножения матриц всех трёх элементарных вращений.
+    const float c3 = cosRotation.z;
+    const float s3 = sinRotation.z;
+    const float c2 = cosRotation.x;
+    const float s2 = sinRotation.x;
+    const float c1 = cosRotation.y;
+    const float s1 = sinRotation.y;
+    const glm::mat3 rotationMatrix{
+        {c1 * c3 + s1 * s2 * s3, c2 * s3, c1 * s2 * s3 - c3 * s1},
+        {c3 * s1 * s2 - c1 * s3, c2 * c3, c1 * c3 * s2 + s1 * s3},
+        {c2 * s1, -s2, c1 * c2}};
+
+    cachedModelMatrix = glm::mat4{
+        glm::vec4(rotationMatrix[0] * scale.x, 0.f),
+        glm::vec4(rotationMatrix[1] * scale.y, 0.f),
+        glm::vec4(rotationMatrix[2] * scale.z, 0.f),
+        glm::vec4(translation, 1.f)};
+
+    // Матрица нормали: тот же поворот, но масштабирование должно быть обратным.
+    // В отличие от матрицы преобр. для вершин, здесь нет операции сдвига, так как он
+    // не влияет на нормали. Следовательно, матрица сократилась до 3x3.
+    const glm::vec3 invScale = 1.0f / scale;
+    cachedNormalMatrix = glm::mat3{
+        rotationMatrix[0] * invScale.x,
+        rotationMatrix[1] * invScale.y,
+        rotationMatrix[2] * invScale.z};
+
+    cachedTranslation = translation;
+    cachedScale = scale;
+    cachedRotation = rotation;
+    cacheValid = true;
+    ++version;
+}
+
+void TransformComponent::fromModelMatrix(const glm::mat4& modelMatrix)
+{
+    // Extract translation directly from the model matrix
+    translation = glm::vec3(modelMatrix[3]);
+
+    // Extract scale factors by taking the length of each column vector
+    scale.x = glm::length(glm::vec3(modelMatrix[0]));
+    scale.y = glm::length(glm::vec3(modelMatrix[1]));
+    scale.z = glm::length(glm::vec3(modelMatrix[2]));
+
+    // Extract rotation component by converting the rotation matrix to Euler angles
+    glm::mat3 rotationMatrix = glm::mat3(modelMatrix);
+
+    // Normalize the rotation matrix
+    rotationMatrix[0] /= scale.x;
+    rotationMatrix[1] /= scale.y;
+    rotationMatrix[2] /= scale.z;
+
+    // Extract individual rotation matrix elements for convenience
+    const float m00 = rotationMatrix[0][0];
+    const float m01 = rotationMatrix[0][1];
+    const float m02 = rotationMatrix[0][2];
+    const float m10 = rotationMatrix[1][0];
+    const float m11 = rotationMatrix[1][1];
+    const float m12 = rotationMatrix[1][2];
+    const float m20 = rotationMatrix[2][0];
+    const float m21 = rotationMatrix[2][1];
+    const float m22 = rotationMatrix[2][2];
+
+    // Calculate yaw (rotation around Y-axis)
+    rotation.y = atan2f(m20, m22);
+
+    // Calculate pitch (rotation around X-axis)
+    rotation.x = atan2f(-m21, sqrtf(m20 * m20 + m22 * m22));
+
+    // Calculate roll (rotation around Z-axis)
+    rotation.z = atan2f(m01, m11);
+
+    // the matrix itself is cached, so it isn't rebuilt from the angles; the normal matrix columns are
+    // the rotation columns divided by the scale
+    cachedModelMatrix = modelMatrix;
+    cachedNormalMatrix = glm::mat3{
+        rotationMatrix[0] / scale.x,
+        rotationMatrix[1] / scale.y,
+        rotationMatrix[2] / scale.z};
+    cachedTranslation = translation;
+    cachedScale = scale;
+    cachedRotation = rotation;
+    cacheValid = true;
+    ++version;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "ComponentPool.hpp"
+#include "Model.hpp"
+
+// libs
+#include <glm/gtc/matrix_transform.hpp>
+
+// std
+#include <memory>
+
+class WrpScene;
+class WrpTransformUpdater;
+
+// translation, scale and rotation are written directly (GUI, controllers, systems). The matrices are cached
+// together with the values they were built from and rebuilt only when the values differ. WrpTransformUpdater
+// rebuilds all changed transforms of the scene at the start of the frame, computing the sines and cosines by SIMD.
+// The fields are relative to the parent of the entity (see WrpScene::setParent()); the cached matrices of
+// a child are its world matrices after WrpScene::updateWorldTransforms().
+struct TransformComponent
+{
+    glm::vec3 translation{};                  // отступ в позиции 
+    glm::vec3 scale{ .1f, .1f, .1f };         // масштабирование модели 
+    glm::vec3 rotation{3.15f, .0f, .0f};      // 3.15f в дефолт, потому что большинство моделей рендерятся перевёрнутыми при нуле (не флипнуты под Vulkan)
+
+    // Построение матрицы аффинного преобразования следующим произведением = translate * Ry * Rx * Rz * scale
+    // У произведения матриц нет коммутативного свойства, поэтому порядок множителей важен.
+    // Представить преобразование можно "прочитав" произведение справа налево (сначала выполнится изменение размеров,
+    // затем поворот поочерёдно по осям Z, X и Y, и в конце применится сдвиг).
+    const glm::mat4& modelMatrix();
+
+    // Построение матрицы нормали для приведения позиции нормалей вершин к мировому пространству (world space).
+    // Эта матрица очень похожа на матрицу преобразования для самих вершин, за исключением некоторых моментов.
+    const glm::mat3& normalMatrix();
+
+    // Sets translation, scale and rotation (Euler angles) from the matrix, which becomes the cached one
+    void fromModelMatrix(const glm::mat4& modelMatrix);
+
+    // the fields were changed since the matrices were built
+    bool isDirty() const;
+    // incremented every time the matrices change, so the users of the matrices can skip unchanged objects
+    uint32_t getVersion() const { return version; }
+
+private:
+    friend class WrpScene;
+    friend class WrpTransformUpdater;
+
+    // only the translation changed, the rotation and scale part of the matrices stays
+    bool isRotationOrScaleDirty() const;
+    void updateTranslation();
+    // builds the matrices from the sines and cosines of the rotation angles
+    void updateMatrices(const glm::vec3& sinRotation, const glm::vec3& cosRotation);
+    void updateMatrices();
+
+    glm::mat4 cachedModelMatrix{ 1.f };
+    glm::mat3 cachedNormalMatrix{ 1.f };
+    // the fields the cached matrices are built from
+    glm::vec3 cachedTranslation{};
+    glm::vec3 cachedScale{};
+    glm::vec3 cachedRotation{};
+    bool cacheValid = false;
+    // the cached matrices are world ones, so a change of the translation alone rebuilds them whole
+    bool hasParent = false;
+    uint32_t version = 0;
+};
+
+// links of an entity in the scene hierarchy, only the entities with a parent or children have it
+struct HierarchyComponent
+{
+    WrpEntity parent = NULL_ENTITY;
+    WrpEntity firstChild = NULL_ENTITY;
+    WrpEntity lastChild = NULL_ENTITY;
+    WrpEntity nextSibling = NULL_ENTITY;
+    WrpEntity previousSibling = NULL_ENTITY;
+};
+
+// reference to the shared model drawn by the entity
+struct ModelComponent
+{
+    std::shared_ptr<WrpModel> model{};
+};
+
+struct PointLightComponent
+{
+    glm::vec3 color{ 1.f };
+    float lightIntensity = 1.0f;
+    bool carouselEnabled = false;
+};
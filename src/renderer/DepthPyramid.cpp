@@ -0,0 +1,287 @@
+#include "DepthPyramid.hpp"
+
+// std
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+    constexpr uint32_t WORKGROUP_SIZE = 8; // local_size_x and local_size_y of DepthPyramid.comp
+
+    uint32_t previousPowerOfTwo(uint32_t value)
+    {
+        uint32_t result = 1;
+        while (result * 2 <= value) result *= 2;
+        return result;
+    }
+
+    bool hasStencilComponent(VkFormat format)
+    {
+        return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
+    }
+}
+
+WrpDepthPyramid::WrpDepthPyramid(WrpDevice& device, WrpRenderer& renderer) : wrpDevice{device}, wrpRenderer{renderer}
+{
+    setLayout = WrpDescriptorSetLayout::Builder(wrpDevice)
+        .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT) // depth attachment
+        .addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT) // previous level
+        .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)          // written level
+        .build();
+
+    // a set per level, up to 16 levels per frame
+    uint32_t framesInFlight = renderer.getFramesInFlight();
+    descriptorAllocator = WrpDescriptorAllocator::Builder(wrpDevice)
+        .setInitialSetsPerPool(framesInFlight * 16)
+        .addPoolSizeRatio(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.f)
+        .addPoolSizeRatio(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.f)
+        .build();
+
+    frames.resize(framesInFlight);
+    createPipeline();
+    createSampler();
+}
+
+WrpDepthPyramid::~WrpDepthPyramid()
+{
+    for (FramePyramid& pyramid : frames) {
+        destroyPyramid(pyramid);
+    }
+    vkDestroySampler(wrpDevice.device(), sampler, nullptr);
+    pipeline.reset();
+    vkDestroyPipelineLayout(wrpDevice.device(), pipelineLayout, nullptr);
+}
+
+void WrpDepthPyramid::createPipeline()
+{
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+
+    VkDescriptorSetLayout descriptorSetLayout = setLayout->getDescriptorSetLayout();
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(wrpDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create depth pyramid pipeline layout!");
+    }
+
+    pipeline = std::make_unique<WrpComputePipeline>(wrpDevice, "DepthPyramid.comp", pipelineLayout);
+}
+
+void WrpDepthPyramid::createSampler()
+{
+    // the levels are read by texelFetch, the sampler only has to be valid
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.minLod = 0.f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+    if (vkCreateSampler(wrpDevice.device(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create depth pyramid sampler!");
+    }
+}
+
+void WrpDepthPyramid::createPyramid(FramePyramid& pyramid, VkExtent2D depthExtent)
+{
+    pyramid.depthExtent = depthExtent;
+    pyramid.width = previousPowerOfTwo(depthExtent.width);
+    pyramid.height = previousPowerOfTwo(depthExtent.height);
+    pyramid.levelCount = 1;
+    while ((std::max(pyramid.width, pyramid.height) >> pyramid.levelCount) > 0) ++pyramid.levelCount;
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = {pyramid.width, pyramid.height, 1};
+    imageInfo.mipLevels = pyramid.levelCount;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = VK_FORMAT_R32_SFLOAT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    wrpDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pyramid.image, pyramid.memory);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = pyramid.image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = VK_FORMAT_R32_SFLOAT;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = pyramid.levelCount;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+    if (vkCreateImageView(wrpDevice.device(), &viewInfo, nullptr, &pyramid.view) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create depth pyramid image view!");
+    }
+
+    pyramid.levelViews.resize(pyramid.levelCount);
+    for (uint32_t level = 0; level < pyramid.levelCount; ++level)
+    {
+        viewInfo.subresourceRange.baseMipLevel = level;
+        viewInfo.subresourceRange.levelCount = 1;
+        if (vkCreateImageView(wrpDevice.device(), &viewInfo, nullptr, &pyramid.levelViews[level]) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create depth pyramid level view!");
+        }
+    }
+    pyramid.initialized = false;
+}
+
+void WrpDepthPyramid::destroyPyramid(FramePyramid& pyramid)
+{
+    for (VkImageView levelView : pyramid.levelViews) {
+        vkDestroyImageView(wrpDevice.device(), levelView, nullptr);
+    }
+    pyramid.levelViews.clear();
+    vkDestroyImageView(wrpDevice.device(), pyramid.view, nullptr);
+    vkDestroyImage(wrpDevice.device(), pyramid.image, nullptr);
+    vkFreeMemory(wrpDevice.device(), pyramid.memory, nullptr);
+    pyramid.view = VK_NULL_HANDLE;
+    pyramid.image = VK_NULL_HANDLE;
+    pyramid.memory = VK_NULL_HANDLE;
+}
+
+// The depth attachment differs from frame to frame (it belongs to the swap chain image), so the sets are
+// rewritten every build. The previous use of the frame's sets has completed when the frame index comes around.
+void WrpDepthPyramid::writeLevelSets(FramePyramid& pyramid, VkImageView depthView)
+{
+    while (pyramid.levelSets.size() < pyramid.levelCount)
+    {
+        VkDescriptorSet set;
+        if (!descriptorAllocator->allocateDescriptorSet(setLayout->getDescriptorSetLayout(), set)) {
+            throw std::runtime_error("Failed to allocate depth pyramid descriptor set!");
+        }
+        pyramid.levelSets.push_back(set);
+    }
+
+    VkDescriptorImageInfo depthInfo{sampler, depthView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+    for (uint32_t level = 0; level < pyramid.levelCount; ++level)
+    {
+        // level 0 doesn't read the previous level, its own view is written there to keep the set valid
+        VkDescriptorImageInfo srcInfo{sampler, pyramid.levelViews[level == 0 ? 0 : level - 1], VK_IMAGE_LAYOUT_GENERAL};
+        VkDescriptorImageInfo dstInfo{VK_NULL_HANDLE, pyramid.levelViews[level], VK_IMAGE_LAYOUT_GENERAL};
+        WrpDescriptorWriter(*setLayout, *descriptorAllocator)
+            .writeImage(0, &depthInfo)
+            .writeImage(1, &srcInfo)
+            .writeImage(2, &dstInfo)
+            .overwrite(pyramid.levelSets[level]);
+    }
+}
+
+void WrpDepthPyramid::build(VkCommandBuffer commandBuffer, int frameIndex)
+{
+    FramePyramid& pyramid = frames[frameIndex];
+    VkExtent2D extent = wrpRenderer.getSwapChainExtent();
+    if (pyramid.image == VK_NULL_HANDLE || pyramid.depthExtent.width != extent.width || pyramid.depthExtent.height != extent.height)
+    {
+        // the previous use of the frame's pyramid has completed, it can be destroyed right away
+        destroyPyramid(pyramid);
+        createPyramid(pyramid, extent);
+    }
+    writeLevelSets(pyramid, wrpRenderer.getCurrentDepthImageView());
+
+    VkImageMemoryBarrier depthBarrier{};
+    depthBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    depthBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    depthBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    depthBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    depthBarrier.image = wrpRenderer.getCurrentDepthImage();
+    depthBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if (hasStencilComponent(wrpRenderer.getDepthFormat())) {
+        depthBarrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+    depthBarrier.subresourceRange.levelCount = 1;
+    depthBarrier.subresourceRange.layerCount = 1;
+
+    // a new pyramid is transitioned to the general layout once, it stays in it
+    VkImageMemoryBarrier pyramidBarrier{};
+    pyramidBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    pyramidBarrier.srcAccessMask = 0;
+    pyramidBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    pyramidBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    pyramidBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    pyramidBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    pyramidBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    pyramidBarrier.image = pyramid.image;
+    pyramidBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    pyramidBarrier.subresourceRange.levelCount = pyramid.levelCount;
+    pyramidBarrier.subresourceRange.layerCount = 1;
+
+    std::vector<VkImageMemoryBarrier> barriers{depthBarrier};
+    if (!pyramid.initialized)
+    {
+        barriers.push_back(pyramidBarrier);
+        pyramid.initialized = true;
+    }
+    vkCmdPipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+    pipeline->bind(commandBuffer);
+
+    PushConstants push{};
+    push.srcWidth = static_cast<int32_t>(extent.width);
+    push.srcHeight = static_cast<int32_t>(extent.height);
+    push.fromDepth = 1;
+    push.sampleCount = static_cast<uint32_t>(wrpRenderer.getSampleCount());
+    for (uint32_t level = 0; level < pyramid.levelCount; ++level)
+    {
+        push.dstWidth = static_cast<int32_t>(std::max(pyramid.width >> level, 1u));
+        push.dstHeight = static_cast<int32_t>(std::max(pyramid.height >> level, 1u));
+
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout,
+            0, 1, &pyramid.levelSets[level], 0, nullptr);
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &push);
+        vkCmdDispatch(commandBuffer, (push.dstWidth + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE,
+            (push.dstHeight + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1);
+
+        // the next level (or the culling pass after the last one) reads the written level
+        VkMemoryBarrier levelBarrier{};
+        levelBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &levelBarrier, 0, nullptr, 0, nullptr);
+
+        push.srcWidth = push.dstWidth;
+        push.srcHeight = push.dstHeight;
+        push.fromDepth = 0;
+    }
+
+    // the depth is an attachment again for the rest of the frame
+    depthBarrier.srcAccessMask = 0; // only read, an execution dependency is enough
+    depthBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    vkCmdPipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &depthBarrier);
+}
+
+VkDescriptorImageInfo WrpDepthPyramid::getDescriptorInfo(int frameIndex) const
+{
+    return VkDescriptorImageInfo{sampler, frames[frameIndex].view, VK_IMAGE_LAYOUT_GENERAL};
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Device.hpp"
+#include "Descriptors.hpp"
+#include "Pipeline.hpp"
+#include "Renderer.hpp"
+
+// std
+#include <memory>
+#include <vector>
+
+// Hierarchical depth (Hi-Z) pyramid of the frame's depth buffer for occlusion culling.
+// Level 0 has the largest power of two size not exceeding the swap chain extent, every texel of a level holds
+// the farthest depth of the texels it covers in the previous level (of the pixels and samples for level 0),
+// so a bounding rectangle is occluded if its nearest depth is greater than the texels covering it at the level
+// where the rectangle spans at most 2x2 texels.
+//
+// The pyramid is an R32_SFLOAT image in VK_IMAGE_LAYOUT_GENERAL, one per frame in flight. It's built by
+// DepthPyramid.comp, a dispatch per level, and recreated when the swap chain extent changes.
+class WrpDepthPyramid
+{
+public:
+    WrpDepthPyramid(WrpDevice& device, WrpRenderer& renderer);
+    ~WrpDepthPyramid();
+
+    WrpDepthPyramid(const WrpDepthPyramid&) = delete;
+    WrpDepthPyramid& operator=(const WrpDepthPyramid&) = delete;
+
+    // Records the build from the depth drawn so far by the current frame. It must be called outside of a render
+    // pass; the depth attachment is read-only during the build and is returned to the attachment layout after it.
+    // The following compute shader reads of the pyramid are synchronized with the build.
+    void build(VkCommandBuffer commandBuffer, int frameIndex);
+
+    // all levels of the frame's pyramid as a combined image sampler (read by texelFetch), valid after build()
+    VkDescriptorImageInfo getDescriptorInfo(int frameIndex) const;
+
+private:
+    struct FramePyramid
+    {
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;  // all levels
+        std::vector<VkImageView> levelViews;
+        std::vector<VkDescriptorSet> levelSets; // kept when the pyramid is recreated, they're rewritten every build
+        VkExtent2D depthExtent{0, 0};
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t levelCount = 0;
+        bool initialized = false; // the image was transitioned to VK_IMAGE_LAYOUT_GENERAL
+    };
+
+    struct PushConstants
+    {
+        int32_t srcWidth = 0;
+        int32_t srcHeight = 0;
+        int32_t dstWidth = 0;
+        int32_t dstHeight = 0;
+        uint32_t fromDepth = 0;  // level 0 is reduced from the depth attachment
+        uint32_t sampleCount = 1;
+    };
+
+    void createPipeline();
+    void createSampler();
+    void createPyramid(FramePyramid& pyramid, VkExtent2D depthExtent);
+    void destroyPyramid(FramePyramid& pyramid);
+    void writeLevelSets(FramePyramid& pyramid, VkImageView depthView);
+
+    WrpDevice& wrpDevice;
+    WrpRenderer& wrpRenderer;
+
+    std::unique_ptr<WrpDescriptorSetLayout> setLayout;
+    std::unique_ptr<WrpDescriptorAllocator> descriptorAllocator;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    std::unique_ptr<WrpComputePipeline> pipeline;
+    VkSampler sampler = VK_NULL_HANDLE;
+
+    std::vector<FramePyramid> frames; // indexed by frame index
+};
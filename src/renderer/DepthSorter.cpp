@@ -0,0 +1,54 @@
+#include "DepthSorter.hpp"
+
+// std
+#include <algorithm>
+#include <cstring>
+
+void WrpDepthSorter::sortBackToFront(const float* distances, uint32_t count)
+{
+    keys.resize(count);
+    keysScratch.resize(count);
+    order.resize(count);
+    orderScratch.resize(count);
+    for (auto& histogram : histograms) {
+        histogram.fill(0);
+    }
+
+    // the inverted bits sort the farthest first; the histograms of all digits are counted in the same pass
+    constexpr uint32_t DIGIT_MASK = (1u << DIGIT_BITS) - 1;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint32_t bits = 0;
+        float distance = std::max(distances[i], 0.f);
+        std::memcpy(&bits, &distance, sizeof(bits));
+        keys[i] = ~bits;
+        order[i] = i;
+        for (uint32_t digit = 0; digit < DIGIT_COUNT; ++digit) {
+            ++histograms[digit][(keys[i] >> (digit * DIGIT_BITS)) & DIGIT_MASK];
+        }
+    }
+
+    for (uint32_t digit = 0; digit < DIGIT_COUNT; ++digit)
+    {
+        uint32_t shift = digit * DIGIT_BITS;
+        std::array<uint32_t, 1u << DIGIT_BITS>& offsets = histograms[digit];
+        // the passes where all keys have the same digit are skipped, the nearby distances share the upper bits
+        if (count == 0 || offsets[(keys[0] >> shift) & DIGIT_MASK] == count) continue;
+
+        uint32_t sum = 0;
+        for (uint32_t& offset : offsets)
+        {
+            uint32_t digitCount = offset;
+            offset = sum;
+            sum += digitCount;
+        }
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            uint32_t position = offsets[(keys[i] >> shift) & DIGIT_MASK]++;
+            keysScratch[position] = keys[i];
+            orderScratch[position] = order[i];
+        }
+        keys.swap(keysScratch);
+        order.swap(orderScratch);
+    }
+}
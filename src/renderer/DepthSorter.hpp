@@ -0,0 +1,29 @@
+#pragma once
+
+// std
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Stable LSD radix sort of indices by their distance to the camera, it orders the translucent billboards back
+// to front. The keys are the bit patterns of the distances (non-negative floats compare like their bits), so
+// the order is exact and the objects at equal distances keep the order of their indices, none of them is lost.
+// The buffers are kept between the calls.
+class WrpDepthSorter
+{
+public:
+    // fills getOrder() with the indices [0, count), from the farthest distance to the nearest
+    void sortBackToFront(const float* distances, uint32_t count);
+
+    const std::vector<uint32_t>& getOrder() const { return order; }
+
+private:
+    static constexpr uint32_t DIGIT_BITS = 8;
+    static constexpr uint32_t DIGIT_COUNT = 32 / DIGIT_BITS;
+
+    std::vector<uint32_t> keys;
+    std::vector<uint32_t> keysScratch;
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> orderScratch;
+    std::array<std::array<uint32_t, 1u << DIGIT_BITS>, DIGIT_COUNT> histograms{};
+};
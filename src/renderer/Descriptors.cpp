@@ -1,6 +1,8 @@
 #include "Descriptors.hpp"
+#include "Utils.hpp"
 
 // std
+#include <algorithm>
 #include <cassert>
 #include <stdexcept>
 #include <iostream>
@@ -11,7 +13,8 @@ WrpDescriptorSetLayout::Builder& WrpDescriptorSetLayout::Builder::addBinding(
 	uint32_t binding,
 	VkDescriptorType descriptorType,
 	VkShaderStageFlags stageFlags,
-	uint32_t count)
+	uint32_t count,
+	VkDescriptorBindingFlags bindingFlags)
 {
 	assert(bindings.count(binding) == 0 && "Binding already in use.");
 	VkDescriptorSetLayoutBinding layoutBinding{};
@@ -21,28 +24,52 @@ WrpDescriptorSetLayout::Builder& WrpDescriptorSetLayout::Builder::addBinding(
 	layoutBinding.stageFlags = stageFlags;
 	layoutBinding.pImmutableSamplers = nullptr; // Optional
 	bindings[binding] = layoutBinding;
+	bindingsFlags[binding] = bindingFlags;
+	return *this;
+}
+
+WrpDescriptorSetLayout::Builder& WrpDescriptorSetLayout::Builder::setLayoutFlags(
+	VkDescriptorSetLayoutCreateFlags flags)
+{
+	layoutFlags = flags;
 	return *this;
 }
 
 std::unique_ptr<WrpDescriptorSetLayout> WrpDescriptorSetLayout::Builder::build() const
 {
-	return std::make_unique<WrpDescriptorSetLayout>(wrpDevice, bindings);
+	return std::make_unique<WrpDescriptorSetLayout>(wrpDevice, bindings, bindingsFlags, layoutFlags);
 }
 
 // *************** Descriptor Set Layout *********************
 
 WrpDescriptorSetLayout::WrpDescriptorSetLayout(
-	WrpDevice& wrpDevice, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings)
+	WrpDevice& wrpDevice,
+	std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+	const std::unordered_map<uint32_t, VkDescriptorBindingFlags>& bindingsFlags,
+	VkDescriptorSetLayoutCreateFlags layoutFlags)
 	: wrpDevice{wrpDevice}, bindings{bindings}
 {
 	std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{};
+	std::vector<VkDescriptorBindingFlags> setLayoutBindingsFlags{}; // parallel to setLayoutBindings
+	bool hasBindingFlags = false;
 	for (auto& kv : bindings)
 	{
 		setLayoutBindings.push_back(kv.second);
+
+		auto flags = bindingsFlags.find(kv.first);
+		setLayoutBindingsFlags.push_back(flags != bindingsFlags.end() ? flags->second : 0);
+		hasBindingFlags |= setLayoutBindingsFlags.back() != 0;
 	}
 
+	VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+	bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	bindingFlagsInfo.bindingCount = static_cast<uint32_t>(setLayoutBindingsFlags.size());
+	bindingFlagsInfo.pBindingFlags = setLayoutBindingsFlags.data();
+
 	VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
 	descriptorSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	descriptorSetLayoutInfo.pNext = hasBindingFlags ? &bindingFlagsInfo : nullptr;
+	descriptorSetLayoutInfo.flags = layoutFlags;
 	descriptorSetLayoutInfo.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
 	descriptorSetLayoutInfo.pBindings = setLayoutBindings.data();
 
@@ -122,8 +149,7 @@ bool WrpDescriptorPool::allocateDescriptorSet(
 	allocInfo.pSetLayouts = &descriptorSetLayout; // в лэйауте обозначен тип и кол-во дескрипторов в наборе
 	allocInfo.descriptorSetCount = 1;
 
-	// todo: Might want to create a "DescriptorPoolManager" class that handles this case, and builds
-	// a new pool whenever an old pool fills up. But this is beyond our current scope
+	// a fixed pool fails when it's full, WrpDescriptorAllocator creates new pools in this case
 	if (vkAllocateDescriptorSets(wrpDevice.device(), &allocInfo, &descriptorSet) != VK_SUCCESS)
 	{
 		std::cerr << "Failed to allocate descriptor sets!" << std::endl;
@@ -146,10 +172,150 @@ void WrpDescriptorPool::resetPool()
 	vkResetDescriptorPool(wrpDevice.device(), descriptorPool, 0);
 }
 
+// *************** Descriptor Allocator Builder *********************
+
+WrpDescriptorAllocator::Builder& WrpDescriptorAllocator::Builder::addPoolSizeRatio(
+	VkDescriptorType descriptorType, float ratio)
+{
+	ratios.push_back({descriptorType, ratio});
+	return *this;
+}
+
+WrpDescriptorAllocator::Builder& WrpDescriptorAllocator::Builder::setPoolFlags(
+	VkDescriptorPoolCreateFlags flags)
+{
+	poolFlags = flags;
+	return *this;
+}
+
+WrpDescriptorAllocator::Builder& WrpDescriptorAllocator::Builder::setInitialSetsPerPool(uint32_t count)
+{
+	initialSetsPerPool = count;
+	return *this;
+}
+
+std::unique_ptr<WrpDescriptorAllocator> WrpDescriptorAllocator::Builder::build() const
+{
+	return std::make_unique<WrpDescriptorAllocator>(wrpDevice, ratios, initialSetsPerPool, poolFlags);
+}
+
+// *************** Descriptor Allocator *********************
+
+WrpDescriptorAllocator::WrpDescriptorAllocator(
+	WrpDevice& wrpDevice,
+	const std::vector<PoolSizeRatio>& ratios,
+	uint32_t initialSetsPerPool,
+	VkDescriptorPoolCreateFlags poolFlags)
+	: wrpDevice{wrpDevice}, ratios{ratios}, poolFlags{poolFlags},
+	setsPerPool{std::clamp(initialSetsPerPool, 1u, MAX_SETS_PER_POOL)}
+{
+	readyPools.push_back(createPool(setsPerPool));
+}
+
+WrpDescriptorAllocator::~WrpDescriptorAllocator()
+{
+	for (auto pool : fullPools) vkDestroyDescriptorPool(wrpDevice.device(), pool, nullptr);
+	for (auto pool : readyPools) vkDestroyDescriptorPool(wrpDevice.device(), pool, nullptr);
+}
+
+VkDescriptorPool WrpDescriptorAllocator::createPool(uint32_t setCount)
+{
+	std::vector<VkDescriptorPoolSize> poolSizes{};
+	for (auto& ratio : ratios)
+	{
+		uint32_t count = static_cast<uint32_t>(ratio.ratio * setCount);
+		poolSizes.push_back({ratio.descriptorType, std::max(count, 1u)});
+	}
+
+	VkDescriptorPoolCreateInfo descriptorPoolInfo{};
+	descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	descriptorPoolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	descriptorPoolInfo.pPoolSizes = poolSizes.data();
+	descriptorPoolInfo.maxSets = setCount;
+	descriptorPoolInfo.flags = poolFlags;
+
+	VkDescriptorPool pool;
+	if (vkCreateDescriptorPool(wrpDevice.device(), &descriptorPoolInfo, nullptr, &pool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create descriptor pool!");
+	}
+	return pool;
+}
+
+// Returns the current pool, or a new bigger one if all pools are full
+VkDescriptorPool WrpDescriptorAllocator::getPool()
+{
+	if (!readyPools.empty()) return readyPools.back();
+
+	setsPerPool = std::min(setsPerPool * 2, MAX_SETS_PER_POOL);
+	readyPools.push_back(createPool(setsPerPool));
+	return readyPools.back();
+}
+
+bool WrpDescriptorAllocator::allocateDescriptorSet(
+	const VkDescriptorSetLayout descriptorSetLayout, VkDescriptorSet& descriptorSet)
+{
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = getPool();
+	allocInfo.pSetLayouts = &descriptorSetLayout;
+	allocInfo.descriptorSetCount = 1;
+
+	VkResult result = vkAllocateDescriptorSets(wrpDevice.device(), &allocInfo, &descriptorSet);
+	if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+	{
+		// the current pool is full, the allocation is retried once in a new pool
+		fullPools.push_back(readyPools.back());
+		readyPools.pop_back();
+
+		allocInfo.descriptorPool = getPool();
+		result = vkAllocateDescriptorSets(wrpDevice.device(), &allocInfo, &descriptorSet);
+	}
+
+	if (result != VK_SUCCESS)
+	{
+		std::cerr << "Failed to allocate descriptor sets!" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void WrpDescriptorAllocator::resetPools()
+{
+	for (auto pool : readyPools) vkResetDescriptorPool(wrpDevice.device(), pool, 0);
+	for (auto pool : fullPools)
+	{
+		vkResetDescriptorPool(wrpDevice.device(), pool, 0);
+		readyPools.push_back(pool);
+	}
+	fullPools.clear();
+}
+
+// *************** Descriptor Set Cache *********************
+
+size_t WrpDescriptorSetCache::KeyHash::operator()(const Key& key) const
+{
+	size_t seed = 0;
+	hashCombine(seed, key.layout);
+	for (uint64_t word : key.bindings) hashCombine(seed, word);
+	return seed;
+}
+
+void WrpDescriptorSetCache::clear()
+{
+	sets.clear();
+	allocator.resetPools();
+}
+
 // *************** Descriptor Writer *********************
 
 WrpDescriptorWriter::WrpDescriptorWriter(WrpDescriptorSetLayout& setLayout, WrpDescriptorPool& pool)
-	: setLayout{setLayout}, pool{pool}
+	: setLayout{setLayout}, pool{&pool}
+{
+}
+
+WrpDescriptorWriter::WrpDescriptorWriter(WrpDescriptorSetLayout& setLayout, WrpDescriptorAllocator& allocator)
+	: setLayout{setLayout}, allocator{&allocator}
 {
 }
 
@@ -203,9 +369,15 @@ WrpDescriptorWriter& WrpDescriptorWriter::writeImage(
 	return *this;
 }
 
+bool WrpDescriptorWriter::allocateDescriptorSet(WrpDescriptorAllocator* setAllocator, VkDescriptorSet& set)
+{
+	if (setAllocator != nullptr) return setAllocator->allocateDescriptorSet(setLayout.getDescriptorSetLayout(), set);
+	return pool->allocateDescriptorSet(setLayout.getDescriptorSetLayout(), set);
+}
+
 bool WrpDescriptorWriter::build(VkDescriptorSet& set)
 {
-	bool success = pool.allocateDescriptorSet(setLayout.getDescriptorSetLayout(), set);
+	bool success = allocateDescriptorSet(allocator, set);
 	if (!success)
 	{
 		return false;
@@ -214,6 +386,53 @@ bool WrpDescriptorWriter::build(VkDescriptorSet& set)
 	return true;
 }
 
+bool WrpDescriptorWriter::build(VkDescriptorSet& set, WrpDescriptorSetCache& cache)
+{
+	// the key is built from the resources themselves, the pointers in the writes are not stable
+	WrpDescriptorSetCache::Key key{setLayout.getDescriptorSetLayout()};
+	for (auto& write : writes)
+	{
+		key.bindings.push_back(write.dstBinding);
+		key.bindings.push_back(write.dstArrayElement);
+		key.bindings.push_back(write.descriptorType);
+		key.bindings.push_back(write.descriptorCount);
+		for (uint32_t i = 0; i < write.descriptorCount; ++i)
+		{
+			if (write.pBufferInfo != nullptr)
+			{
+				const auto& info = write.pBufferInfo[i];
+				key.bindings.push_back(reinterpret_cast<uint64_t>(info.buffer));
+				key.bindings.push_back(info.offset);
+				key.bindings.push_back(info.range);
+			}
+			else if (write.pImageInfo != nullptr)
+			{
+				const auto& info = write.pImageInfo[i];
+				key.bindings.push_back(reinterpret_cast<uint64_t>(info.sampler));
+				key.bindings.push_back(reinterpret_cast<uint64_t>(info.imageView));
+				key.bindings.push_back(info.imageLayout);
+			}
+		}
+	}
+
+	auto it = cache.sets.find(key);
+	if (it != cache.sets.end())
+	{
+		++cache.hits;
+		set = it->second;
+		return true;
+	}
+
+	++cache.misses;
+	if (!allocateDescriptorSet(&cache.allocator, set))
+	{
+		return false;
+	}
+	overwrite(set);
+	cache.sets.emplace(std::move(key), set);
+	return true;
+}
+
 // Эта функция обновляет данные дескрипторов при выделении набора из пула,
 // либо её можно вызвать отдельно для обновления данных, связанных с дескрипторами данного набора.
 void WrpDescriptorWriter::overwrite(VkDescriptorSet& set)
@@ -222,5 +441,5 @@ void WrpDescriptorWriter::overwrite(VkDescriptorSet& set)
 	{
 		write.dstSet = set; // к структурам записей добавляется обновляемый набор
 	}
-	vkUpdateDescriptorSets(pool.wrpDevice.device(), writes.size(), writes.data(), 0, nullptr);
+	vkUpdateDescriptorSets(setLayout.wrpDevice.device(), writes.size(), writes.data(), 0, nullptr);
 }
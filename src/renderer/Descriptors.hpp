@@ -22,7 +22,9 @@ public:
             uint32_t binding,
             VkDescriptorType descriptorType,
             VkShaderStageFlags stageFlags,
-            uint32_t count = 1);
+            uint32_t count = 1,
+            VkDescriptorBindingFlags bindingFlags = 0); // descriptor indexing flags (partially bound, update after bind)
+        Builder& setLayoutFlags(VkDescriptorSetLayoutCreateFlags flags);
         // Создание экземпляра WrpDescriptorSetLayout на основе текущей мапы привязок
         std::unique_ptr<WrpDescriptorSetLayout> build() const;
 
@@ -30,9 +32,15 @@ public:
         WrpDevice& wrpDevice;
         // Мапа с информацией по каждой привязке. На основе этой мапы строится WrpDescriptorSetLayout
         std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings{};
+        std::unordered_map<uint32_t, VkDescriptorBindingFlags> bindingsFlags{};
+        VkDescriptorSetLayoutCreateFlags layoutFlags = 0;
     };
 
-    WrpDescriptorSetLayout(WrpDevice& wrpDevice, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings);
+    WrpDescriptorSetLayout(
+        WrpDevice& wrpDevice,
+        std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+        const std::unordered_map<uint32_t, VkDescriptorBindingFlags>& bindingsFlags = {},
+        VkDescriptorSetLayoutCreateFlags layoutFlags = 0);
     ~WrpDescriptorSetLayout();
     WrpDescriptorSetLayout(const WrpDescriptorSetLayout&) = delete;
     WrpDescriptorSetLayout& operator=(const WrpDescriptorSetLayout&) = delete;
@@ -95,12 +103,115 @@ private:
     friend class WrpDescriptorWriter;
 };
 
+// Growable descriptor allocator. It owns a list of pools and creates a new pool when the current one
+// runs out of memory, so the number of sets doesn't have to be known in advance. Pool sizes are given
+// per set (ratio * sets in pool). Each new pool is twice bigger than the previous one up to MAX_SETS_PER_POOL.
+// Per-frame allocators are reset in bulk with resetPools() once the frame's command buffer has completed.
+class WrpDescriptorAllocator
+{
+public:
+    static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+    struct PoolSizeRatio
+    {
+        VkDescriptorType descriptorType;
+        float ratio; // descriptors of the type per set
+    };
+
+    class Builder
+    {
+    public:
+        Builder(WrpDevice& wrpDevice) : wrpDevice{wrpDevice} {}
+
+        Builder& addPoolSizeRatio(VkDescriptorType descriptorType, float ratio);
+        Builder& setPoolFlags(VkDescriptorPoolCreateFlags flags);
+        Builder& setInitialSetsPerPool(uint32_t count);
+        std::unique_ptr<WrpDescriptorAllocator> build() const;
+
+    private:
+        WrpDevice& wrpDevice;
+        std::vector<PoolSizeRatio> ratios{};
+        uint32_t initialSetsPerPool = 64;
+        VkDescriptorPoolCreateFlags poolFlags = 0;
+    };
+
+    WrpDescriptorAllocator(
+        WrpDevice& wrpDevice,
+        const std::vector<PoolSizeRatio>& ratios,
+        uint32_t initialSetsPerPool,
+        VkDescriptorPoolCreateFlags poolFlags);
+    ~WrpDescriptorAllocator();
+    WrpDescriptorAllocator(const WrpDescriptorAllocator&) = delete;
+    WrpDescriptorAllocator& operator=(const WrpDescriptorAllocator&) = delete;
+
+    // Allocates a set from the current pool, switching to a new pool if the current one is full
+    bool allocateDescriptorSet(const VkDescriptorSetLayout descriptorSetLayout, VkDescriptorSet& descriptorSet);
+
+    // Resets all pools at once; the sets allocated from them become invalid
+    void resetPools();
+
+    size_t getPoolCount() const { return fullPools.size() + readyPools.size(); }
+
+private:
+    VkDescriptorPool getPool();
+    VkDescriptorPool createPool(uint32_t setCount);
+
+    WrpDevice& wrpDevice;
+    std::vector<PoolSizeRatio> ratios;
+    VkDescriptorPoolCreateFlags poolFlags;
+    uint32_t setsPerPool;
+
+    std::vector<VkDescriptorPool> fullPools{};
+    std::vector<VkDescriptorPool> readyPools{}; // the last one is the current pool
+};
+
+// Cache of descriptor sets keyed by the set layout and the resources written into the bindings.
+// WrpDescriptorWriter::build() with a cache returns an existing set with the same contents instead of
+// allocating and writing a new one. The cached sets are valid while the resources they reference are alive,
+// so the cache must be cleared (and its allocator reset) when such resources are destroyed.
+class WrpDescriptorSetCache
+{
+public:
+    WrpDescriptorSetCache(WrpDescriptorAllocator& allocator) : allocator{allocator} {}
+    WrpDescriptorSetCache(const WrpDescriptorSetCache&) = delete;
+    WrpDescriptorSetCache& operator=(const WrpDescriptorSetCache&) = delete;
+
+    // Drops all cached sets and resets the allocator they were allocated from
+    void clear();
+
+    size_t getSize() const { return sets.size(); }
+    uint32_t getHits() const { return hits; }
+    uint32_t getMisses() const { return misses; }
+
+private:
+    struct Key
+    {
+        VkDescriptorSetLayout layout;
+        std::vector<uint64_t> bindings; // serialized writes: binding, type, count and resource handles
+
+        bool operator==(const Key& other) const = default;
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const;
+    };
+
+    WrpDescriptorAllocator& allocator;
+    std::unordered_map<Key, VkDescriptorSet, KeyHash> sets{};
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+
+    friend class WrpDescriptorWriter;
+};
+
 // Класс для конфигурирования и создания наборов дескрипторов. Он выделяет набор
 // дескрипторов из пула и записывает необходимую информацию для дескрипторов набора.
 class WrpDescriptorWriter
 {
 public:
     WrpDescriptorWriter(WrpDescriptorSetLayout& setLayout, WrpDescriptorPool& pool);
+    WrpDescriptorWriter(WrpDescriptorSetLayout& setLayout, WrpDescriptorAllocator& allocator);
 
     // Готовит запись для информации о буфере дескриптора
     WrpDescriptorWriter& writeBuffer(uint32_t binding, VkDescriptorBufferInfo* bufferInfo);
@@ -110,10 +221,15 @@ public:
     // Выделяет набор из пула в переданный VkDescriptorSet
     // и конфигурирует его VkWriteDescriptorSet записями
     bool build(VkDescriptorSet& set);
+    // Returns the cached set with the same layout and resources, or builds a new one with the cache's allocator
+    bool build(VkDescriptorSet& set, WrpDescriptorSetCache& cache);
     void overwrite(VkDescriptorSet& set);
 
 private:
+    bool allocateDescriptorSet(WrpDescriptorAllocator* setAllocator, VkDescriptorSet& set);
+
     WrpDescriptorSetLayout& setLayout;
-    WrpDescriptorPool& pool;
+    WrpDescriptorPool* pool = nullptr;
+    WrpDescriptorAllocator* allocator = nullptr;
     std::vector<VkWriteDescriptorSet> writes; // структуры-записи для обновления информации о ресурсах дескрипторов
 };
@@ -1,6 +1,8 @@
 #include "Device.hpp"
 
 #include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <set>
 #include <unordered_set>
@@ -83,17 +85,22 @@ WrpDevice::WrpDevice(WrpWindow& window) : window{window}
 {
     createInstance();      // Vulkan API initialization
     setupDebugMessenger(); // to control output messages from validation layer during debug
-    createSurface();       // surface to present output images to (window <-> frame image)
+    createSurface();       // surface to present output images to (window <-> frame image), none if headless
     pickPhysicalDevice();
     createLogicalDevice();
     createCommandPool();
+    createPipelineCache(); // loaded from disk if a compatible cache was saved by the previous run
 }
 
 WrpDevice::~WrpDevice()
 {
+    savePipelineCache();
+    vkDestroyPipelineCache(device_, pipelineCache, nullptr);
     vkDestroyCommandPool(device_, commandPool, nullptr);
     vkDestroyDevice(device_, nullptr);
-    vkDestroySurfaceKHR(instance, surface_, nullptr);
+    if (surface_ != VK_NULL_HANDLE) {
+        vkDestroySurfaceKHR(instance, surface_, nullptr);
+    }
 
     if (enableValidationLayers)
     {
@@ -186,12 +193,16 @@ void WrpDevice::checkRequiredInstanceExtensionsAvailability()
 
 std::vector<const char*> WrpDevice::getRequiredInstanceExtensions()
 {
-    // GLFW required extensions
-    uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    std::vector<const char*> extensions;
 
-    std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    // GLFW required extensions, the headless mode has no surface and doesn't need them
+    if (!window.isHeadless())
+    {
+        uint32_t glfwExtensionCount = 0;
+        const char** glfwExtensions;
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    }
 
     // Add extensions for debug messanger (handling validation layers output)
     if (enableValidationLayers) {
@@ -284,6 +295,12 @@ void WrpDevice::pickPhysicalDevice()
 
     vkGetPhysicalDeviceProperties(physicalDevice_, &properties);
     std::cout << "Picked physical device: " << properties.deviceName << std::endl;
+
+    descriptorIndexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties2{};
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties2.pNext = &descriptorIndexingProperties;
+    vkGetPhysicalDeviceProperties2(physicalDevice_, &properties2);
 }
 
 // Проверка пригодности переданного физического ус-ва для исп. движком.
@@ -293,8 +310,9 @@ bool WrpDevice::isDeviceSuitable(VkPhysicalDevice physicalDevice)
 
     bool extensionsSupported = checkDeviceExtensionsSupport(physicalDevice);
 
-    bool isSwapChainAdequate = false;
-    if (extensionsSupported)
+    // the headless mode renders into offscreen images, the device doesn't have to present
+    bool isSwapChainAdequate = window.isHeadless();
+    if (extensionsSupported && !window.isHeadless())
     {
         SwapChainSupportDetails swapChainSupport = querySwapChainSupportDetails(physicalDevice);
         isSwapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
@@ -306,7 +324,63 @@ bool WrpDevice::isDeviceSuitable(VkPhysicalDevice physicalDevice)
 
     return indices.isComplete() && extensionsSupported && isSwapChainAdequate
         && supportedFeatures.samplerAnisotropy
-        && supportedFeatures.sampleRateShading;
+        && supportedFeatures.sampleRateShading
+        && supportedFeatures.drawIndirectFirstInstance
+        && checkDescriptorIndexingSupport(physicalDevice)
+        && checkDrawParametersSupport(physicalDevice);
+}
+
+// Descriptor indexing (core since Vulkan 1.2, VK_EXT_descriptor_indexing before) is required
+// for the bindless texture array: partially bound descriptors which are updated after binding.
+bool WrpDevice::checkDescriptorIndexingSupport(VkPhysicalDevice physicalDevice)
+{
+    if (isDescriptorIndexingExtensionRequired(physicalDevice))
+    {
+        uint32_t extensionCount;
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+        bool found = false;
+        for (const auto& extension : availableExtensions)
+        {
+            if (strcmp(extension.extensionName, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0) found = true;
+        }
+        if (!found) return false;
+    }
+
+    VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    VkPhysicalDeviceFeatures2 features2{};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &indexingFeatures;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+    return indexingFeatures.shaderSampledImageArrayNonUniformIndexing
+        && indexingFeatures.descriptorBindingSampledImageUpdateAfterBind
+        && indexingFeatures.descriptorBindingUpdateUnusedWhilePending
+        && indexingFeatures.descriptorBindingPartiallyBound;
+}
+
+// Shader draw parameters (core since Vulkan 1.1) give gl_DrawIDARB to the shaders,
+// which index the per-draw data of the indirect draws by it.
+bool WrpDevice::checkDrawParametersSupport(VkPhysicalDevice physicalDevice)
+{
+    VkPhysicalDeviceShaderDrawParametersFeatures drawParametersFeatures{};
+    drawParametersFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_DRAW_PARAMETERS_FEATURES;
+    VkPhysicalDeviceFeatures2 features2{};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &drawParametersFeatures;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+    return drawParametersFeatures.shaderDrawParameters;
+}
+
+bool WrpDevice::isDescriptorIndexingExtensionRequired(VkPhysicalDevice physicalDevice)
+{
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+    return deviceProperties.apiVersion < VK_API_VERSION_1_2;
 }
 
 // Функция для заполнения структуры, которая хранит индексы нужных нам семейств очередей.
@@ -329,9 +403,15 @@ QueueFamilyIndices WrpDevice::findQueueFamilies(VkPhysicalDevice physicalDevice)
             indices.graphicsFamily = i;
         }
 
-        // Добавление индекса семейства очередей, которое поддерживает команды отображения
+        // Добавление индекса семейства очередей, которое поддерживает команды отображения.
+        // Без поверхности (headless) отображения нет, очередью отображения считается графическая.
         VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface_, &presentSupport);
+        if (surface_ != VK_NULL_HANDLE) {
+            vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface_, &presentSupport);
+        }
+        else {
+            presentSupport = indices.graphicsFamily == static_cast<uint32_t>(i);
+        }
         if (queueFamily.queueCount > 0 && presentSupport)
         {
             indices.presentFamily = i;
@@ -370,14 +450,50 @@ void WrpDevice::createLogicalDevice()
     deviceFeatures.samplerAnisotropy = VK_TRUE;
     deviceFeatures.sampleRateShading = VK_TRUE;   // sample shading feature
     deviceFeatures.fillModeNonSolid = VK_TRUE;    // support point and wireframe fill modes
+    deviceFeatures.drawIndirectFirstInstance = VK_TRUE; // indirect draws select their instances range
+
+    // multi-draw indirect is optional, without it each indirect command is submitted by its own call
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice_, &supportedFeatures);
+    multiDrawIndirectSupported = supportedFeatures.multiDrawIndirect == VK_TRUE;
+    deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+
+    // descriptor indexing features used by the bindless texture array (support is checked in isDeviceSuitable())
+    VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+
+    VkPhysicalDeviceShaderDrawParametersFeatures drawParametersFeatures{};
+    drawParametersFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_DRAW_PARAMETERS_FEATURES;
+    drawParametersFeatures.shaderDrawParameters = VK_TRUE;
+    indexingFeatures.pNext = &drawParametersFeatures;
+
+    std::vector<const char*> enabledExtensions = getRequiredDeviceExtensions();
+    if (isDescriptorIndexingExtensionRequired(physicalDevice_)) {
+        enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+    }
+    // optional, the GPU culled draws are submitted without the count buffer if it's missing
+    drawIndirectCountSupported = isDeviceExtensionSupported(physicalDevice_, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    if (drawIndirectCountSupported) {
+        enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    }
+    // optional, only the memory usage of the benchmark reports is read by it
+    memoryBudgetSupported = isDeviceExtensionSupported(physicalDevice_, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (memoryBudgetSupported) {
+        enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
 
     VkDeviceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = &indexingFeatures;
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.pEnabledFeatures = &deviceFeatures;
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+    createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
     // Device validation layers is deprecated, but they are passed to the info struct to keep consistancy with older Vulkan implementations.
     if (enableValidationLayers)
@@ -417,7 +533,110 @@ void WrpDevice::createCommandPool()
     }
 }
 
-void WrpDevice::createSurface() { window.createWindowSurface(instance, &surface_); }
+static const char* PIPELINE_CACHE_FILE = CACHE_DIR "pipeline_cache.bin";
+
+// Создание кэша пайплайнов. Если на диске есть данные от прошлого запуска и они получены
+// на том же устройстве/драйвере, кэш инициализируется ими (warm start), иначе создаётся пустым (cold start).
+void WrpDevice::createPipelineCache()
+{
+    std::vector<char> cacheData;
+    std::ifstream file{PIPELINE_CACHE_FILE, std::ios::binary | std::ios::ate};
+    if (file.is_open())
+    {
+        cacheData.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(cacheData.data(), cacheData.size());
+        if (!file || !isPipelineCacheDataCompatible(cacheData))
+        {
+            std::cout << "Pipeline cache file is invalid or was produced by another device/driver, ignoring it" << std::endl;
+            cacheData.clear();
+        }
+    }
+
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = cacheData.size();
+    cacheInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+
+    if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create pipeline cache!");
+    }
+
+    pipelineCacheWarm = !cacheData.empty();
+    std::cout << "Pipeline cache: " << (pipelineCacheWarm ? "warm" : "cold") << " start ("
+              << cacheData.size() << " bytes loaded)" << std::endl;
+}
+
+// Сохранение содержимого кэша на диск. Ошибки записи не критичны: следующий запуск будет "холодным".
+void WrpDevice::savePipelineCache()
+{
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(device_, pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0)
+    {
+        return;
+    }
+    std::vector<char> cacheData(dataSize);
+    if (vkGetPipelineCacheData(device_, pipelineCache, &dataSize, cacheData.data()) != VK_SUCCESS)
+    {
+        return;
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(CACHE_DIR, ec);
+
+    // Запись во временный файл с последующим переименованием, чтобы не оставить на диске обрезанный кэш
+    const std::string tmpPath = std::string(PIPELINE_CACHE_FILE) + ".tmp";
+    {
+        std::ofstream file{tmpPath, std::ios::binary | std::ios::trunc};
+        if (!file.is_open())
+        {
+            std::cerr << "Failed to write pipeline cache to " << tmpPath << std::endl;
+            return;
+        }
+        file.write(cacheData.data(), dataSize);
+        if (!file)
+        {
+            std::cerr << "Failed to write pipeline cache to " << tmpPath << std::endl;
+            return;
+        }
+    }
+    std::filesystem::rename(tmpPath, PIPELINE_CACHE_FILE, ec);
+}
+
+// Проверка заголовка данных кэша (VkPipelineCacheHeaderVersionOne). Драйвер обязан сам отвергать
+// несовместимые данные, но не все драйверы делают это надёжно, поэтому проверяем явно.
+bool WrpDevice::isPipelineCacheDataCompatible(const std::vector<char>& cacheData)
+{
+    VkPipelineCacheHeaderVersionOne header{};
+    if (cacheData.size() < sizeof(header))
+    {
+        return false;
+    }
+    std::memcpy(&header, cacheData.data(), sizeof(header));
+
+    return header.headerSize >= sizeof(header) &&
+           header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == properties.vendorID &&
+           header.deviceID == properties.deviceID &&
+           std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void WrpDevice::createSurface()
+{
+    if (window.isHeadless()) {
+        surface_ = VK_NULL_HANDLE;
+        return;
+    }
+    window.createWindowSurface(instance, &surface_);
+}
+
+std::vector<const char*> WrpDevice::getRequiredDeviceExtensions()
+{
+    // the swap chain extension is needed only to present to the window's surface
+    if (window.isHeadless()) return {};
+    return deviceExtensions;
+}
 
 // Проверка есть ли требуемые слои проверки в списке доступных слоёв экземпляра.
 bool WrpDevice::checkValidationLayerSupport()
@@ -458,7 +677,8 @@ bool WrpDevice::checkDeviceExtensionsSupport(VkPhysicalDevice physicalDevice)
     std::vector<VkExtensionProperties> availableExtensions(extensionCount);
     vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
 
-    std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+    std::vector<const char*> extensions = getRequiredDeviceExtensions();
+    std::set<std::string> requiredExtensions(extensions.begin(), extensions.end());
 
     for (const auto &extension : availableExtensions)
     {
@@ -468,6 +688,21 @@ bool WrpDevice::checkDeviceExtensionsSupport(VkPhysicalDevice physicalDevice)
     return requiredExtensions.empty();
 }
 
+bool WrpDevice::isDeviceExtensionSupported(VkPhysicalDevice physicalDevice, const char* extensionName)
+{
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+    for (const auto& extension : availableExtensions)
+    {
+        if (strcmp(extension.extensionName, extensionName) == 0) return true;
+    }
+    return false;
+}
+
 SwapChainSupportDetails WrpDevice::querySwapChainSupportDetails(VkPhysicalDevice physicalDevice)
 {
     SwapChainSupportDetails details;
@@ -673,6 +908,24 @@ void WrpDevice::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width
     endSingleTimeCommands(commandBuffer);
 }
 
+VkDeviceSize WrpDevice::getMemoryUsage()
+{
+    if (!memoryBudgetSupported) return 0;
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+    budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    VkPhysicalDeviceMemoryProperties2 memoryProperties2{};
+    memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    memoryProperties2.pNext = &budgetProperties;
+    vkGetPhysicalDeviceMemoryProperties2(physicalDevice_, &memoryProperties2);
+
+    VkDeviceSize usage = 0;
+    for (uint32_t i = 0; i < memoryProperties2.memoryProperties.memoryHeapCount; ++i) {
+        usage += budgetProperties.heapUsage[i];
+    }
+    return usage;
+}
+
 void WrpDevice::createImageWithInfo(
     const VkImageCreateInfo& imageInfo,
     VkMemoryPropertyFlags properties,
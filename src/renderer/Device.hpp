@@ -42,11 +42,17 @@ const bool enableValidationLayers = true;
 
     VkCommandPool getCommandPool() { return commandPool; }
     VkDevice device() { return device_; }
-    VkSurfaceKHR surface() { return surface_; }
+    VkSurfaceKHR surface() { return surface_; } // VK_NULL_HANDLE if the window is headless
     VkQueue graphicsQueue() { return graphicsQueue_; }
     VkQueue presentQueue() { return presentQueue_; }
     VkInstance getInstance() { return instance; }
     VkPhysicalDevice getPhysicalDevice() { return physicalDevice_; }
+    VkPipelineCache getPipelineCache() { return pipelineCache; }
+    bool isPipelineCacheWarm() { return pipelineCacheWarm; }
+    bool isMultiDrawIndirectSupported() { return multiDrawIndirectSupported; }
+    bool isDrawIndirectCountSupported() { return drawIndirectCountSupported; }
+    // device memory allocated by the process in all heaps (VK_EXT_memory_budget), 0 if it isn't supported
+    VkDeviceSize getMemoryUsage();
     uint32_t getGraphicsQueueFamily() { return getQueueFamilies().graphicsFamily.value(); }
 
     SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupportDetails(physicalDevice_); }
@@ -76,6 +82,7 @@ const bool enableValidationLayers = true;
     bool setVkObjectName(void* object, VkObjectType objType, const char* name);
 
     VkPhysicalDeviceProperties properties;
+    VkPhysicalDeviceDescriptorIndexingProperties descriptorIndexingProperties{}; // limits for bindless descriptor arrays
 
 private:
     void createInstance();
@@ -84,15 +91,23 @@ private:
     void pickPhysicalDevice();
     void createLogicalDevice();
     void createCommandPool();
+    void createPipelineCache();
+    void savePipelineCache();
+    bool isPipelineCacheDataCompatible(const std::vector<char>& cacheData);
 
     bool isDeviceSuitable(VkPhysicalDevice device);
     std::vector<const char*> getRequiredInstanceExtensions();
+    std::vector<const char*> getRequiredDeviceExtensions();
     bool checkValidationLayerSupport();
     QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
     void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
     void populateDebugReportCallbackInfo(VkDebugReportCallbackCreateInfoEXT& createInfo);
     void checkRequiredInstanceExtensionsAvailability();
     bool checkDeviceExtensionsSupport(VkPhysicalDevice device);
+    bool checkDescriptorIndexingSupport(VkPhysicalDevice device);
+    bool checkDrawParametersSupport(VkPhysicalDevice device);
+    bool isDeviceExtensionSupported(VkPhysicalDevice device, const char* extensionName);
+    bool isDescriptorIndexingExtensionRequired(VkPhysicalDevice device);
     SwapChainSupportDetails querySwapChainSupportDetails(VkPhysicalDevice device);
 
     WrpWindow& window;
@@ -101,9 +116,14 @@ private:
     VkDebugReportCallbackEXT debugReportCallback;
     VkPhysicalDevice physicalDevice_ = VK_NULL_HANDLE;
     VkCommandPool commandPool;
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE; // shared by every pipeline, persisted between runs
+    bool pipelineCacheWarm = false;                 // true if valid cache data was loaded from disk
+    bool multiDrawIndirectSupported = false;        // drawCount > 1 in vkCmdDrawIndexedIndirect
+    bool drawIndirectCountSupported = false;        // vkCmdDrawIndexedIndirectCountKHR, draw count is read from a buffer
+    bool memoryBudgetSupported = false;             // heap usage can be queried by getMemoryUsage()
 
     VkDevice device_;
-    VkSurfaceKHR surface_;
+    VkSurfaceKHR surface_ = VK_NULL_HANDLE;
     VkQueue graphicsQueue_;
     VkQueue presentQueue_;
 
@@ -0,0 +1,656 @@
+#include "DrawBatcher.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+namespace
+{
+    constexpr uint32_t CULL_WORKGROUP_SIZE = 64; // local_size_x of FrustumCulling.comp
+
+    uint32_t workgroupCount(uint32_t threads)
+    {
+        return (threads + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE;
+    }
+}
+
+WrpDrawBatcher::WrpDrawBatcher(WrpDevice& device, uint32_t framesInFlight, VkDescriptorSetLayout globalSetLayout)
+    : wrpDevice{device}
+{
+    setLayout = WrpDescriptorSetLayout::Builder(wrpDevice)
+        .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+        .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+        .build();
+
+    cullSetLayout = WrpDescriptorSetLayout::Builder(wrpDevice)
+        .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // instances
+        .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // materials
+        .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // draw cull data
+        .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // cull items
+        .addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // visible counts
+        .addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // group draw counts
+        .addBinding(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // culled instances
+        .addBinding(7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // culled materials
+        .addBinding(8, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // culled commands
+        .build();
+
+    // per frame: the draw set, the culled draw set and the culling set, 13 storage buffers in total
+    descriptorAllocator = WrpDescriptorAllocator::Builder(wrpDevice)
+        .setInitialSetsPerPool(framesInFlight * 3)
+        .addPoolSizeRatio(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 13.f / 3.f)
+        .build();
+
+    frames.resize(framesInFlight);
+
+    // compaction needs multi-draw indirect as well, a model's commands are submitted by a single call
+    compactDraws = wrpDevice.isDrawIndirectCountSupported() && wrpDevice.isMultiDrawIndirectSupported();
+    createCullPipeline(globalSetLayout);
+}
+
+WrpDrawBatcher::~WrpDrawBatcher()
+{
+    cullPipeline.reset();
+    vkDestroyPipelineLayout(wrpDevice.device(), cullPipelineLayout, nullptr);
+}
+
+void WrpDrawBatcher::createCullPipeline(VkDescriptorSetLayout globalSetLayout)
+{
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(CullPushConstants);
+
+    std::array<VkDescriptorSetLayout, 2> descriptorSetLayouts{globalSetLayout, cullSetLayout->getDescriptorSetLayout()};
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(wrpDevice.device(), &pipelineLayoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create culling pipeline layout!");
+    }
+    cullPipeline = std::make_unique<WrpComputePipeline>(wrpDevice, "FrustumCulling.comp", cullPipelineLayout);
+}
+
+void WrpDrawBatcher::begin()
+{
+    for (auto& kv : groups) {
+        kv.second.entities.clear();
+        kv.second.transforms.clear();
+    }
+}
+
+void WrpDrawBatcher::add(WrpEntity entity, WrpModel& model, TransformComponent& transform)
+{
+    ModelGroup& group = groups[&model];
+    group.model = &model;
+    group.entities.push_back(entity);
+    group.transforms.push_back(&transform);
+}
+
+void WrpDrawBatcher::upload(int frameIndex, const MaterialFn& material, const std::array<glm::vec4, 6>* cullingFrustum)
+{
+    FrameBuffers& frame = frames[frameIndex];
+    frame.culled = false;
+    drawCallCount = 0;
+    // the GPU has finished the previous frame with this index, its culling result can be checked
+    if (frame.validationPending) {
+        validateCulling(frame);
+    }
+
+    // the upper bounds of the frame's data: every submesh of every object is visible
+    instanceCount = 0;
+    uint32_t maxDraws = 0;
+    uint32_t maxItems = 0;
+    uint32_t groupIndex = 0;
+    for (auto it = groups.begin(); it != groups.end();)
+    {
+        // the model could be destroyed, its address must not be used anymore
+        if (it->second.entities.empty()) {
+            it = groups.erase(it);
+            continue;
+        }
+        uint32_t groupSize = static_cast<uint32_t>(it->second.entities.size());
+        uint32_t groupDraws = static_cast<uint32_t>(it->second.model->getSubMeshesInfos().size());
+        it->second.index = groupIndex++;
+        instanceCount += groupSize;
+        maxDraws += groupDraws;
+        maxItems += groupSize * groupDraws;
+        ++it;
+    }
+
+    drawCount = 0;
+    itemCount = 0;
+    triangleCount = 0;
+    cpuCulledCount = 0;
+    cpuCullingMs = 0.f;
+    drawCommands.clear();
+    drawSpheres.clear();
+    drawSubMeshes.clear();
+    instanceTransforms.clear();
+    instanceEntities.clear();
+    if (instanceCount == 0) return;
+
+    // with CPU culling every draw has its own copies of the visible instances
+    if (reserve(frame, cullingFrustum ? maxItems : instanceCount, maxDraws, maxItems)) {
+        writeDescriptorSets(frame);
+    }
+
+    auto* instances = static_cast<DrawInstanceData*>(frame.instances->getMappedMemory());
+    auto* materials = static_cast<DrawMaterialData*>(frame.materials->getMappedMemory());
+    for (auto& kv : groups)
+    {
+        ModelGroup& group = kv.second;
+        auto& subMeshes = group.model->getSubMeshesInfos();
+        uint32_t groupSize = static_cast<uint32_t>(group.entities.size());
+        uint32_t groupDraws = static_cast<uint32_t>(subMeshes.size());
+        group.firstDraw = drawCount;
+
+        groupInstances.resize(groupSize);
+        for (uint32_t i = 0; i < groupSize; ++i)
+        {
+            TransformComponent& transform = *group.transforms[i];
+            groupInstances[i].modelMatrix = transform.modelMatrix();
+            groupInstances[i].normalMatrix = transform.normalMatrix();
+        }
+
+        if (cullingFrustum) {
+            cullGroup(group, *cullingFrustum);
+        }
+
+        uint32_t firstInstance = static_cast<uint32_t>(instanceTransforms.size());
+        if (!cullingFrustum)
+        {
+            // all submeshes draw the same instances
+            for (uint32_t i = 0; i < groupSize; ++i)
+            {
+                instances[firstInstance + i] = groupInstances[i];
+                instanceTransforms.push_back(group.transforms[i]);
+                instanceEntities.push_back(group.entities[i]);
+            }
+        }
+
+        for (uint32_t subMesh = 0; subMesh < groupDraws; ++subMesh)
+        {
+            VkDrawIndexedIndirectCommand command{};
+            command.indexCount = subMeshes[subMesh].indexCount;
+            command.instanceCount = groupSize;
+            command.firstIndex = subMeshes[subMesh].indexStart;
+            command.vertexOffset = 0;
+            command.firstInstance = firstInstance;
+
+            if (cullingFrustum)
+            {
+                // only the visible copies of the submesh are written, the draw is skipped if there are none
+                command.firstInstance = static_cast<uint32_t>(instanceTransforms.size());
+                command.instanceCount = 0;
+                for (uint32_t i = 0; i < groupSize; ++i)
+                {
+                    if (!sphereVisible[subMesh * groupSize + i]) continue;
+                    instances[instanceTransforms.size()] = groupInstances[i];
+                    instanceTransforms.push_back(group.transforms[i]);
+                    instanceEntities.push_back(group.entities[i]);
+                    ++command.instanceCount;
+                }
+                if (command.instanceCount == 0) continue;
+            }
+
+            materials[drawCount] = material(*group.model, subMesh);
+            drawCommands.push_back(command);
+            drawSpheres.push_back(subMeshes[subMesh].boundingSphere);
+            drawSubMeshes.push_back(subMesh);
+            itemCount += command.instanceCount;
+            triangleCount += static_cast<uint64_t>(command.indexCount / 3) * command.instanceCount;
+            ++drawCount;
+        }
+        group.drawCount = drawCount - group.firstDraw;
+    }
+
+    auto* commands = static_cast<VkDrawIndexedIndirectCommand*>(frame.commands->getMappedMemory());
+    auto* drawCullData = static_cast<DrawCullData*>(frame.drawCullData->getMappedMemory());
+    auto* cullItems = static_cast<CullItem*>(frame.cullItems->getMappedMemory());
+    uint32_t item = 0;
+    for (auto& kv : groups)
+    {
+        ModelGroup& group = kv.second;
+        for (uint32_t draw = group.firstDraw; draw < group.firstDraw + group.drawCount; ++draw)
+        {
+            const VkDrawIndexedIndirectCommand& command = drawCommands[draw];
+            commands[draw] = command;
+
+            // every draw gets as many slots for the GPU culled instances as it has instances
+            DrawCullData& cullData = drawCullData[draw];
+            cullData.boundingSphere = drawSpheres[draw];
+            cullData.indexCount = command.indexCount;
+            cullData.firstIndex = command.firstIndex;
+            cullData.culledFirstInstance = item;
+            cullData.groupIndex = group.index;
+            cullData.groupFirstDraw = group.firstDraw;
+
+            for (uint32_t i = command.firstInstance; i < command.firstInstance + command.instanceCount; ++i)
+            {
+                CullItem& cullItem = cullItems[item++];
+                cullItem.instance = i;
+                cullItem.draw = draw;
+            }
+        }
+    }
+    frame.instances->flush();
+    frame.materials->flush();
+    frame.commands->flush();
+    frame.drawCullData->flush();
+    frame.cullItems->flush();
+}
+
+// Tests the bounding spheres of all submeshes of all copies of the group; sphereVisible is indexed
+// by subMesh * groupSize + object.
+void WrpDrawBatcher::cullGroup(ModelGroup& group, const std::array<glm::vec4, 6>& frustumPlanes)
+{
+    auto cullingBegin = std::chrono::high_resolution_clock::now();
+
+    auto& subMeshes = group.model->getSubMeshesInfos();
+    sphereBounds.clear();
+    for (auto& subMesh : subMeshes)
+    {
+        for (const DrawInstanceData& instance : groupInstances)
+        {
+            const glm::mat4& modelMatrix = instance.modelMatrix;
+            float scale = glm::max(glm::max(glm::length(glm::vec3(modelMatrix[0])), glm::length(glm::vec3(modelMatrix[1]))),
+                glm::length(glm::vec3(modelMatrix[2])));
+            glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(glm::vec3(subMesh.boundingSphere), 1.f));
+            sphereBounds.add(center, subMesh.boundingSphere.w * scale);
+        }
+    }
+    uint32_t visibleCount = sphereBounds.cull(frustumPlanes, sphereVisible);
+    cpuCulledCount += sphereBounds.size() - visibleCount;
+
+    cpuCullingMs += std::chrono::duration<float, std::chrono::milliseconds::period>(
+        std::chrono::high_resolution_clock::now() - cullingBegin).count();
+}
+
+void WrpDrawBatcher::cull(VkCommandBuffer commandBuffer, VkDescriptorSet globalDescriptorSet, uint32_t globalUboOffset,
+    int frameIndex, const std::array<glm::vec4, 6>& frustumPlanes)
+{
+    if (drawCount == 0) return;
+
+    FrameBuffers& frame = frames[frameIndex];
+    beginCulling(commandBuffer, frameIndex);
+
+    // a thread per (object, submesh) pair appends the visible instance to the draw's slots
+    bindCullPipeline(commandBuffer, globalDescriptorSet, globalUboOffset, frame);
+    CullPushConstants push{};
+    push.count = itemCount;
+    push.phase = CULL_PHASE_FRUSTUM;
+    push.compactDraws = compactDraws ? 1 : 0;
+    vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants), &push);
+    vkCmdDispatch(commandBuffer, workgroupCount(itemCount), 1, 1);
+
+    endCulling(commandBuffer, globalDescriptorSet, globalUboOffset, frameIndex);
+
+    if (cullingValidation)
+    {
+        // the reference is computed now, the readback is compared when the frame index comes around again
+        cullReference(frustumPlanes, -1e-3f, frame.expectedMinVisible);
+        cullReference(frustumPlanes, 1e-3f, frame.expectedMaxVisible);
+        VkBufferCopy region{};
+        region.size = drawCount * sizeof(uint32_t);
+        vkCmdCopyBuffer(commandBuffer, frame.visibleCounts->getBuffer(), frame.visibleCountsReadback->getBuffer(), 1, &region);
+
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr);
+        frame.validationPending = true;
+    }
+}
+
+void WrpDrawBatcher::beginCulling(VkCommandBuffer commandBuffer, int frameIndex)
+{
+    if (drawCount == 0) return;
+
+    FrameBuffers& frame = frames[frameIndex];
+    frame.culled = true;
+
+    // counters are accumulated by atomics, so they're cleared first
+    vkCmdFillBuffer(commandBuffer, frame.visibleCounts->getBuffer(), 0, drawCount * sizeof(uint32_t), 0);
+    vkCmdFillBuffer(commandBuffer, frame.groupDrawCounts->getBuffer(), 0, groups.size() * sizeof(uint32_t), 0);
+
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+// Writes the commands of the draws from the visible instances appended since beginCulling(). The draws and
+// the validation copies of the culling passes are synchronized with the result.
+void WrpDrawBatcher::endCulling(VkCommandBuffer commandBuffer, VkDescriptorSet globalDescriptorSet,
+    uint32_t globalUboOffset, int frameIndex)
+{
+    if (drawCount == 0) return;
+
+    FrameBuffers& frame = frames[frameIndex];
+
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    // a thread per draw writes its command and material
+    bindCullPipeline(commandBuffer, globalDescriptorSet, globalUboOffset, frame);
+    CullPushConstants push{};
+    push.count = drawCount;
+    push.phase = CULL_PHASE_WRITE_COMMANDS;
+    push.compactDraws = compactDraws ? 1 : 0;
+    vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants), &push);
+    vkCmdDispatch(commandBuffer, workgroupCount(drawCount), 1, 1);
+
+    // the visible counts are copied by the validation of the culling passes
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void WrpDrawBatcher::bindCullPipeline(VkCommandBuffer commandBuffer, VkDescriptorSet globalDescriptorSet,
+    uint32_t globalUboOffset, const FrameBuffers& frame)
+{
+    cullPipeline->bind(commandBuffer);
+    std::array<VkDescriptorSet, 2> descriptorSets{globalDescriptorSet, frame.cullDescriptorSet};
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout,
+        0, static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(), 1, &globalUboOffset);
+}
+
+void WrpDrawBatcher::submit(WrpRenderQueue& renderQueue, const WrpDrawItem& state, int frameIndex, bool indirect,
+    const glm::vec3& cameraPosition, uint32_t pass)
+{
+    if (drawCount == 0) return;
+
+    FrameBuffers& frame = frames[frameIndex];
+    // objects drawn one by one aren't culled, they're read from the CPU written buffers
+    bool culled = frame.culled && indirect;
+    VkDescriptorSet descriptorSet = culled ? frame.culledDescriptorSet : frame.descriptorSet;
+    VkBuffer commandsBuffer = culled ? frame.culledCommands->getBuffer() : frame.commands->getBuffer();
+
+    const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    const uint32_t maxDrawCount = wrpDevice.isMultiDrawIndirectSupported()
+        ? wrpDevice.properties.limits.maxDrawIndirectCount : 1;
+
+    WrpDrawItem item = state;
+    item.descriptorSets[item.descriptorSetCount++] = descriptorSet;
+    item.pushConstantStages = VK_SHADER_STAGE_VERTEX_BIT;
+    item.pushConstantSize = sizeof(DrawPushConstants);
+    uint32_t pipelineId = renderQueue.pipelineId(state.pipeline);
+    // the materials are in the storage buffer, the descriptor set is the material state of the indirect draws
+    uint32_t materialId = renderQueue.materialId(descriptorSet);
+
+    for (auto& kv : groups)
+    {
+        ModelGroup& group = kv.second;
+        uint32_t groupDraws = group.drawCount;
+        if (groupDraws == 0) continue; // all copies are culled
+
+        item.model = group.model;
+        uint32_t modelId = renderQueue.modelId(group.model);
+        item.sortKey = WrpRenderQueue::makeSortKey(pass, pipelineId, materialId, modelId, 0);
+        DrawPushConstants push{};
+
+        if (culled && compactDraws)
+        {
+            // the number of the model's visible draws is known only to GPU
+            assert(groupDraws <= maxDrawCount && "Too many submeshes for a single indirect count draw");
+            push.drawBase = group.firstDraw;
+            item.command = WrpDrawItem::Command::DrawIndexedIndirectCount;
+            item.indirectBuffer = commandsBuffer;
+            item.indirectOffset = group.firstDraw * stride;
+            item.countBuffer = frame.groupDrawCounts->getBuffer();
+            item.countOffset = group.index * sizeof(uint32_t);
+            item.drawCount = groupDraws;
+            item.stride = stride;
+            renderQueue.submit(item, &push);
+            ++drawCallCount;
+        }
+        else if (indirect)
+        {
+            // gl_DrawIDARB starts from zero in every call, so the first draw of the call is pushed
+            for (uint32_t draw = 0; draw < groupDraws; draw += maxDrawCount)
+            {
+                push.drawBase = group.firstDraw + draw;
+                item.command = WrpDrawItem::Command::DrawIndexedIndirect;
+                item.indirectBuffer = commandsBuffer;
+                item.indirectOffset = (group.firstDraw + draw) * stride;
+                item.drawCount = std::min(maxDrawCount, groupDraws - draw);
+                item.stride = stride;
+                renderQueue.submit(item, &push);
+                ++drawCallCount;
+            }
+        }
+        else
+        {
+            // every draw has its own material, the copies of a draw follow each other and share the pushed index
+            item.command = WrpDrawItem::Command::DrawIndexed;
+            item.instanceCount = 1;
+            for (uint32_t draw = group.firstDraw; draw < group.firstDraw + groupDraws; ++draw)
+            {
+                const VkDrawIndexedIndirectCommand& command = drawCommands[draw];
+                push.drawBase = draw;
+                item.count = command.indexCount;
+                item.first = command.firstIndex;
+                for (uint32_t i = command.firstInstance; i < command.firstInstance + command.instanceCount; ++i)
+                {
+                    float distance = glm::length(glm::vec3(instanceTransforms[i]->modelMatrix()[3]) - cameraPosition);
+                    item.sortKey = WrpRenderQueue::makeSortKey(pass, pipelineId, draw, modelId,
+                        WrpRenderQueue::frontToBackDepth(distance));
+                    item.firstInstance = i;
+                    renderQueue.submit(item, &push);
+                }
+                drawCallCount += command.instanceCount;
+            }
+        }
+    }
+}
+
+// Grows the buffers of the frame. They aren't used by GPU anymore when the frame index comes around again,
+// so they can be recreated right away. Returns true if the descriptor sets must be rewritten.
+bool WrpDrawBatcher::reserve(FrameBuffers& frame, uint32_t instances, uint32_t draws, uint32_t items)
+{
+    bool recreated = false;
+    if (frame.instancesCapacity < instances)
+    {
+        frame.instancesCapacity = std::max(instances, frame.instancesCapacity * 2);
+        frame.instances = std::make_unique<WrpBuffer>(
+            wrpDevice,
+            sizeof(DrawInstanceData),
+            frame.instancesCapacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        frame.instances->map();
+        recreated = true;
+    }
+    if (frame.drawsCapacity < draws)
+    {
+        frame.drawsCapacity = std::max(draws, frame.drawsCapacity * 2);
+        frame.materials = std::make_unique<WrpBuffer>(
+            wrpDevice,
+            sizeof(DrawMaterialData),
+            frame.drawsCapacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        frame.materials->map();
+        frame.commands = std::make_unique<WrpBuffer>(
+            wrpDevice,
+            sizeof(VkDrawIndexedIndirectCommand),
+            frame.drawsCapacity,
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        frame.commands->map();
+        frame.drawCullData = std::make_unique<WrpBuffer>(
+            wrpDevice,
+            sizeof(DrawCullData),
+            frame.drawsCapacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        frame.drawCullData->map();
+
+        frame.culledMaterials = std::make_unique<WrpBuffer>(
+            wrpDevice,
+            sizeof(DrawMaterialData),
+            frame.drawsCapacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        frame.culledCommands = std::make_unique<WrpBuffer>(
+            wrpDevice,
+            sizeof(VkDrawIndexedIndirectCommand),
+            frame.drawsCapacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        frame.visibleCounts = std::make_unique<WrpBuffer>(
+            wrpDevice,
+            sizeof(uint32_t),
+            frame.drawsCapacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        // there are never more models than draws
+        frame.groupDrawCounts = std::make_unique<WrpBuffer>(
+            wrpDevice,
+            sizeof(uint32_t),
+            frame.drawsCapacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        frame.visibleCountsReadback = std::make_unique<WrpBuffer>(
+            wrpDevice,
+            sizeof(uint32_t),
+            frame.drawsCapacity,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        frame.visibleCountsReadback->map();
+        recreated = true;
+    }
+    if (frame.itemsCapacity < items)
+    {
+        frame.itemsCapacity = std::max(items, frame.itemsCapacity * 2);
+        frame.cullItems = std::make_unique<WrpBuffer>(
+            wrpDevice,
+            sizeof(CullItem),
+            frame.itemsCapacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        frame.cullItems->map();
+        // an instance is copied once for every submesh it's visible in
+        frame.culledInstances = std::make_unique<WrpBuffer>(
+            wrpDevice,
+            sizeof(DrawInstanceData),
+            frame.itemsCapacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        recreated = true;
+    }
+    return recreated;
+}
+
+void WrpDrawBatcher::writeDescriptorSets(FrameBuffers& frame)
+{
+    auto writeSet = [](WrpDescriptorWriter& writer, VkDescriptorSet& set) {
+        if (set == VK_NULL_HANDLE) writer.build(set);
+        else writer.overwrite(set);
+    };
+
+    VkDescriptorBufferInfo instancesInfo = frame.instances->descriptorInfo();
+    VkDescriptorBufferInfo materialsInfo = frame.materials->descriptorInfo();
+    VkDescriptorBufferInfo drawCullDataInfo = frame.drawCullData->descriptorInfo();
+    VkDescriptorBufferInfo cullItemsInfo = frame.cullItems->descriptorInfo();
+    VkDescriptorBufferInfo visibleCountsInfo = frame.visibleCounts->descriptorInfo();
+    VkDescriptorBufferInfo groupDrawCountsInfo = frame.groupDrawCounts->descriptorInfo();
+    VkDescriptorBufferInfo culledInstancesInfo = frame.culledInstances->descriptorInfo();
+    VkDescriptorBufferInfo culledMaterialsInfo = frame.culledMaterials->descriptorInfo();
+    VkDescriptorBufferInfo culledCommandsInfo = frame.culledCommands->descriptorInfo();
+
+    WrpDescriptorWriter writer(*setLayout, *descriptorAllocator);
+    writer.writeBuffer(0, &instancesInfo);
+    writer.writeBuffer(1, &materialsInfo);
+    writeSet(writer, frame.descriptorSet);
+
+    WrpDescriptorWriter culledWriter(*setLayout, *descriptorAllocator);
+    culledWriter.writeBuffer(0, &culledInstancesInfo);
+    culledWriter.writeBuffer(1, &culledMaterialsInfo);
+    writeSet(culledWriter, frame.culledDescriptorSet);
+
+    WrpDescriptorWriter cullWriter(*cullSetLayout, *descriptorAllocator);
+    cullWriter.writeBuffer(0, &instancesInfo);
+    cullWriter.writeBuffer(1, &materialsInfo);
+    cullWriter.writeBuffer(2, &drawCullDataInfo);
+    cullWriter.writeBuffer(3, &cullItemsInfo);
+    cullWriter.writeBuffer(4, &visibleCountsInfo);
+    cullWriter.writeBuffer(5, &groupDrawCountsInfo);
+    cullWriter.writeBuffer(6, &culledInstancesInfo);
+    cullWriter.writeBuffer(7, &culledMaterialsInfo);
+    cullWriter.writeBuffer(8, &culledCommandsInfo);
+    writeSet(cullWriter, frame.cullDescriptorSet);
+}
+
+void WrpDrawBatcher::cullReference(const std::array<glm::vec4, 6>& frustumPlanes, float radiusMargin,
+    std::vector<uint32_t>& visibleCounts) const
+{
+    visibleCounts.assign(drawCount, 0);
+    for (uint32_t draw = 0; draw < drawCount; ++draw)
+    {
+        const VkDrawIndexedIndirectCommand& command = drawCommands[draw];
+        glm::vec4 sphere = drawSpheres[draw];
+        for (uint32_t i = command.firstInstance; i < command.firstInstance + command.instanceCount; ++i)
+        {
+            const glm::mat4& modelMatrix = instanceTransforms[i]->modelMatrix();
+            float scale = glm::max(glm::max(glm::length(glm::vec3(modelMatrix[0])), glm::length(glm::vec3(modelMatrix[1]))),
+                glm::length(glm::vec3(modelMatrix[2])));
+            glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(glm::vec3(sphere), 1.f));
+            float radius = sphere.w * scale;
+            radius += radiusMargin * (1.f + radius);
+
+            bool visible = true;
+            for (const glm::vec4& plane : frustumPlanes) {
+                visible = visible && glm::dot(glm::vec3(plane), center) + plane.w >= -radius;
+            }
+            if (visible) ++visibleCounts[draw];
+        }
+    }
+}
+
+void WrpDrawBatcher::finishCullingValidation()
+{
+    for (FrameBuffers& frame : frames)
+    {
+        if (frame.validationPending) {
+            validateCulling(frame);
+        }
+    }
+}
+
+void WrpDrawBatcher::validateCulling(FrameBuffers& frame)
+{
+    frame.validationPending = false;
+    ++validatedFrameCount;
+    frame.visibleCountsReadback->invalidate();
+    auto* visibleCounts = static_cast<const uint32_t*>(frame.visibleCountsReadback->getMappedMemory());
+
+    size_t drawCount = frame.expectedMaxVisible.size();
+    for (size_t draw = 0; draw < drawCount; ++draw)
+    {
+        if (visibleCounts[draw] < frame.expectedMinVisible[draw] || visibleCounts[draw] > frame.expectedMaxVisible[draw])
+        {
+            ++cullingMismatchCount;
+            std::cerr << "GPU culling mismatch: draw " << draw << " has " << visibleCounts[draw]
+                      << " visible instances, CPU reference " << frame.expectedMinVisible[draw]
+                      << ".." << frame.expectedMaxVisible[draw] << std::endl;
+        }
+    }
+}
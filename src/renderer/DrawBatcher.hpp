@@ -0,0 +1,286 @@
+#pragma once
+
+#include "Device.hpp"
+#include "Buffer.hpp"
+#include "Descriptors.hpp"
+#include "Model.hpp"
+#include "FrustumCulling.hpp"
+#include "Pipeline.hpp"
+#include "RenderQueue.hpp"
+#include "Scene.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <array>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Per-object data read by the vertex shader as instances[gl_InstanceIndex]
+struct DrawInstanceData
+{
+    glm::mat4 modelMatrix{ 1.f };
+    glm::mat4 normalMatrix{ 1.f };
+};
+
+// Per-draw (model submesh) material data read as draws[push.drawBase + gl_DrawIDARB]. Matches the std430 layout.
+struct DrawMaterialData
+{
+    glm::vec4 diffuseColor{};
+    int diffuseTextureIndex = -1;
+    int specularTextureIndex = -1;
+    int padding[2]{};
+};
+
+// The only push constant of the batched draws: index of the first draw of the call in the draws buffer.
+// gl_DrawIDARB restarts from zero in every vkCmdDrawIndexedIndirect call.
+struct DrawPushConstants
+{
+    uint32_t drawBase = 0;
+};
+
+// Collects the objects of a render system, groups them by model and writes all per-object and per-material
+// data into per-frame storage buffers together with the VkDrawIndexedIndirectCommand array.
+// Each model is then submitted with one vkCmdDrawIndexedIndirect covering all its submeshes and copies
+// (or one call per submesh if multi-draw indirect isn't supported), so the number of recorded commands
+// depends on the number of different models, not on the number of objects.
+//
+// The copies can be frustum culled on CPU by upload(): the bounding spheres of all (object, submesh) pairs
+// are tested in SIMD batches and only the visible copies of each submesh are written, draws without
+// visible copies are skipped. It also works for the draws recorded one by one.
+//
+// They can also be frustum culled on GPU by cull(): a compute pass tests the bounding sphere of every
+// (object, submesh) pair against the frustum planes of GlobalUbo, copies the visible instances and materials
+// into device local buffers and writes the indirect commands of the visible draws, compacted per model, together
+// with their count (vkCmdDrawIndexedIndirectCountKHR). Without VK_KHR_draw_indirect_count the commands aren't
+// compacted, draws without visible instances are submitted with zero instances.
+// The culling passes of other classes (WrpOcclusionCulling) test the pairs by their own pipelines and write
+// the visible instances into the same buffers, see beginCulling().
+//
+// The draws are submitted to a WrpRenderQueue with the batcher's descriptor set (instances at binding 0, materials
+// at binding 1) after the system's sets; the pipeline layout must have DrawPushConstants in the vertex stage.
+class WrpDrawBatcher
+{
+public:
+    // material of the submesh of the model, it's called once per draw (not per object) each frame
+    using MaterialFn = std::function<DrawMaterialData(WrpModel& model, uint32_t subMeshIndex)>;
+
+    // globalSetLayout is the layout of the set with GlobalUbo, the culling pass reads the frustum planes from it
+    WrpDrawBatcher(WrpDevice& device, uint32_t framesInFlight, VkDescriptorSetLayout globalSetLayout);
+    ~WrpDrawBatcher();
+
+    WrpDrawBatcher(const WrpDrawBatcher&) = delete;
+    WrpDrawBatcher& operator=(const WrpDrawBatcher&) = delete;
+
+    VkDescriptorSetLayout getDescriptorSetLayout() const { return setLayout->getDescriptorSetLayout(); }
+
+    // starts collecting the objects of a new frame
+    void begin();
+    // the transform must stay valid until the frame's draws are submitted
+    void add(WrpEntity entity, WrpModel& model, TransformComponent& transform);
+    // Writes the collected data into the buffers of the frame. If cullingFrustum isn't null, the objects are
+    // culled on CPU against its planes (see WrpCamera::getFrustumPlanes()).
+    void upload(int frameIndex, const MaterialFn& material, const std::array<glm::vec4, 6>* cullingFrustum = nullptr);
+    // Records the culling compute pass, it must be called after upload() and outside of a render pass.
+    // The following submit() of the frame draws only the visible instances.
+    // frustumPlanes must be the planes written to GlobalUbo, they're used by the CPU reference of the validation.
+    // globalUboOffset is the dynamic offset of GlobalUbo in the global set (FrameInfo::globalUboOffset).
+    void cull(VkCommandBuffer commandBuffer, VkDescriptorSet globalDescriptorSet, uint32_t globalUboOffset,
+        int frameIndex, const std::array<glm::vec4, 6>& frustumPlanes);
+    // A culling pass of another class, used instead of cull(): beginCulling() clears the visible instance counts,
+    // the pass's pipeline then appends the visible instances of the getCullItemCount() pairs through
+    // getCullDescriptorSet() at set 1 (the bindings of FrustumCulling.comp), and endCulling() writes the commands
+    // of the draws. The following submit() draws the instances appended since beginCulling(). A frame can have
+    // several passes, the buffers of the previous one must not be read by GPU anymore.
+    void beginCulling(VkCommandBuffer commandBuffer, int frameIndex);
+    void endCulling(VkCommandBuffer commandBuffer, VkDescriptorSet globalDescriptorSet, uint32_t globalUboOffset,
+        int frameIndex);
+    VkDescriptorSetLayout getCullDescriptorSetLayout() const { return cullSetLayout->getDescriptorSetLayout(); }
+    VkDescriptorSet getCullDescriptorSet(int frameIndex) const { return frames[frameIndex].cullDescriptorSet; }
+    // visible instances of every draw appended by the last culling pass
+    VkBuffer getVisibleCountsBuffer(int frameIndex) const { return frames[frameIndex].visibleCounts->getBuffer(); }
+    // Submits the draws of the frame to the pass of the queue (opaque or depth pre-pass). state holds the pipeline,
+    // its layout and the system's descriptor sets; the batcher's set is bound after them. With indirect == false
+    // every object is drawn by its own vkCmdDrawIndexed, front to back from cameraPosition; it's kept to compare
+    // the CPU cost.
+    void submit(WrpRenderQueue& renderQueue, const WrpDrawItem& state, int frameIndex, bool indirect,
+        const glm::vec3& cameraPosition, uint32_t pass = WrpRenderQueue::PASS_OPAQUE);
+
+    // Reads back the visible instance counts of every frame culled by cull() and compares them with a CPU reference.
+    // Mismatches are reported to std::cerr and counted; it's the GPU culling test of --validate-gpu-culling,
+    // it costs a readback and a CPU culling per frame.
+    void setCullingValidation(bool enabled) { cullingValidation = enabled; }
+    // compares the frames whose results haven't been read back yet, the GPU must be idle
+    void finishCullingValidation();
+    uint64_t getCullingMismatchCount() const { return cullingMismatchCount; }
+    uint64_t getValidatedFrameCount() const { return validatedFrameCount; }
+    // Visible instances of every draw of the last upload() by the same sphere test as FrustumCulling.comp.
+    // The radius is widened (or narrowed) by radiusMargin, so the spheres touching the planes can't make
+    // the float differences between CPU and GPU a mismatch.
+    void cullReference(const std::array<glm::vec4, 6>& frustumPlanes, float radiusMargin,
+        std::vector<uint32_t>& visibleCounts) const;
+
+    bool isEmpty() const { return drawCount == 0; }
+    uint32_t getInstanceCount() const { return instanceCount; }
+    // draws written by the last upload()
+    uint32_t getDrawCount() const { return drawCount; }
+    // triangles of the draws written by the last upload(), after the CPU culling but before the GPU one
+    uint64_t getTriangleCount() const { return triangleCount; }
+    // draw calls submitted since the last upload()
+    uint32_t getDrawCallCount() const { return drawCallCount; }
+    // CPU culling results of the last upload(), counted in (object, submesh) pairs
+    uint32_t getCpuVisibleCount() const { return itemCount; }
+    uint32_t getCpuCulledCount() const { return cpuCulledCount; }
+    float getCpuCullingMs() const { return cpuCullingMs; }
+
+    // (object, submesh) pairs tested by the culling passes, written by the last upload()
+    uint32_t getCullItemCount() const { return itemCount; }
+    // calls fn(entity, model) for every object collected for the last upload(), the ones culled on CPU included
+    template <typename Fn>
+    void forEachObject(Fn&& fn) const
+    {
+        for (const auto& kv : groups) {
+            for (WrpEntity entity : kv.second.entities) fn(entity, *kv.second.model);
+        }
+    }
+    // calls fn(entity, subMeshIndex) for every pair of the last upload() in the order of the culling threads
+    template <typename Fn>
+    void forEachCullItem(Fn&& fn) const
+    {
+        for (const auto& kv : groups)
+        {
+            const ModelGroup& group = kv.second;
+            for (uint32_t draw = group.firstDraw; draw < group.firstDraw + group.drawCount; ++draw)
+            {
+                const VkDrawIndexedIndirectCommand& command = drawCommands[draw];
+                for (uint32_t i = command.firstInstance; i < command.firstInstance + command.instanceCount; ++i) {
+                    fn(instanceEntities[i], drawSubMeshes[draw]);
+                }
+            }
+        }
+    }
+
+private:
+    // copies of one model; each of its submeshes is one indirect command drawing all copies
+    struct ModelGroup
+    {
+        WrpModel* model = nullptr;
+        std::vector<WrpEntity> entities;
+        std::vector<TransformComponent*> transforms; // parallel to entities
+        uint32_t index = 0;
+        uint32_t firstDraw = 0;
+        uint32_t drawCount = 0; // submeshes with visible copies
+    };
+
+    // Per-draw input of the culling pass. Matches the std430 layout of FrustumCulling.comp.
+    struct DrawCullData
+    {
+        glm::vec4 boundingSphere{};      // of the submesh, in model space
+        uint32_t indexCount = 0;
+        uint32_t firstIndex = 0;
+        uint32_t culledFirstInstance = 0; // first slot of the draw's visible instances in the culled instances
+        uint32_t groupIndex = 0;          // index of the draw count of the model
+        uint32_t groupFirstDraw = 0;      // first command of the model
+        uint32_t padding[3]{};
+    };
+
+    // (instance, draw) pair tested by the culling passes. Matches the std430 layout of FrustumCulling.comp.
+    struct CullItem
+    {
+        uint32_t instance = 0;
+        uint32_t draw = 0;
+        uint32_t padding[2]{};
+    };
+
+    // phases of FrustumCulling.comp
+    enum CullPhase : uint32_t
+    {
+        CULL_PHASE_FRUSTUM = 0,        // test the pairs against the frustum
+        CULL_PHASE_WRITE_COMMANDS = 1  // write the commands of the draws
+    };
+
+    struct CullPushConstants
+    {
+        uint32_t count = 0;        // threads doing work: (object, submesh) pairs or draws
+        uint32_t phase = 0;        // CullPhase
+        uint32_t compactDraws = 0; // skip the draws without visible instances and count the written ones
+    };
+
+    // buffers rewritten by the CPU each frame and the culling output, one set per frame in flight
+    struct FrameBuffers
+    {
+        std::unique_ptr<WrpBuffer> instances;
+        std::unique_ptr<WrpBuffer> materials;
+        std::unique_ptr<WrpBuffer> commands;
+        std::unique_ptr<WrpBuffer> drawCullData;
+        std::unique_ptr<WrpBuffer> cullItems; // CullItem pairs tested by the culling pass
+        uint32_t instancesCapacity = 0;
+        uint32_t drawsCapacity = 0;
+        uint32_t itemsCapacity = 0;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+        // written by the culling pass
+        std::unique_ptr<WrpBuffer> culledInstances;
+        std::unique_ptr<WrpBuffer> culledMaterials;
+        std::unique_ptr<WrpBuffer> culledCommands;
+        std::unique_ptr<WrpBuffer> visibleCounts;   // visible instances of each draw
+        std::unique_ptr<WrpBuffer> groupDrawCounts; // compacted commands of each model
+        VkDescriptorSet culledDescriptorSet = VK_NULL_HANDLE;
+        VkDescriptorSet cullDescriptorSet = VK_NULL_HANDLE;
+        bool culled = false; // a culling pass was recorded after the last upload()
+
+        // validation
+        std::unique_ptr<WrpBuffer> visibleCountsReadback;
+        std::vector<uint32_t> expectedMinVisible;
+        std::vector<uint32_t> expectedMaxVisible;
+        bool validationPending = false;
+    };
+
+    void createCullPipeline(VkDescriptorSetLayout globalSetLayout);
+    void bindCullPipeline(VkCommandBuffer commandBuffer, VkDescriptorSet globalDescriptorSet, uint32_t globalUboOffset,
+        const FrameBuffers& frame);
+    void cullGroup(ModelGroup& group, const std::array<glm::vec4, 6>& frustumPlanes);
+    bool reserve(FrameBuffers& frame, uint32_t instances, uint32_t draws, uint32_t items);
+    void writeDescriptorSets(FrameBuffers& frame);
+    void validateCulling(FrameBuffers& frame);
+
+    WrpDevice& wrpDevice;
+    std::unique_ptr<WrpDescriptorSetLayout> setLayout;
+    std::unique_ptr<WrpDescriptorSetLayout> cullSetLayout;
+    std::unique_ptr<WrpDescriptorAllocator> descriptorAllocator;
+    std::vector<FrameBuffers> frames; // indexed by frame index
+
+    VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+    std::unique_ptr<WrpComputePipeline> cullPipeline;
+    bool compactDraws = false; // draw counts are read from groupDrawCounts
+
+    // groups are kept between frames to reuse the vectors' memory
+    std::unordered_map<WrpModel*, ModelGroup> groups;
+    uint32_t instanceCount = 0; // collected objects
+    uint32_t drawCount = 0;
+    uint32_t itemCount = 0;     // (instance, draw) pairs written by upload()
+    uint64_t triangleCount = 0;
+    uint32_t drawCallCount = 0;
+
+    // CPU copies of the frame's commands, bounding spheres and indices of their submeshes, transforms and entities
+    // of the instances
+    std::vector<VkDrawIndexedIndirectCommand> drawCommands;
+    std::vector<glm::vec4> drawSpheres;
+    std::vector<uint32_t> drawSubMeshes;
+    std::vector<TransformComponent*> instanceTransforms;
+    std::vector<WrpEntity> instanceEntities;
+
+    // CPU culling, the buffers are reused between the groups and frames
+    std::vector<DrawInstanceData> groupInstances;
+    WrpSphereBounds sphereBounds;
+    std::vector<uint8_t> sphereVisible;
+    uint32_t cpuCulledCount = 0;
+    float cpuCullingMs = 0.f;
+
+    bool cullingValidation = false;
+    uint64_t cullingMismatchCount = 0;
+    uint64_t validatedFrameCount = 0;
+};
@@ -1,16 +1,26 @@
 #pragma once
 
+#include "Bvh.hpp"
 #include "Camera.hpp"
-#include "SceneObject.hpp"
+#include "Scene.hpp"
 
 // lib
 #include <vulkan/vulkan.h>
 
-#define MAX_LIGHTS 10
+class WrpDepthPyramid;
+
+#define MAX_LIGHTS 4096 // ёмкость storage буфера точечных источников света, см. WrpClusteredLighting
 
 struct PointLight
 {
-	glm::vec4 position{}; // w - игнорируется
+	glm::vec4 position{}; // w - радиус влияния источника
+	glm::vec4 color{};	  // w - интенсивность цвета
+};
+
+// instance of the point light billboards, read by PointLight.vert as billboards[gl_InstanceIndex]
+struct PointLightBillboard
+{
+	glm::vec4 position{}; // w - радиус билборда
 	glm::vec4 color{};	  // w - интенсивность цвета
 };
 
@@ -18,6 +28,39 @@ struct RenderingSettings
 {
     int reflectionModel;
     int polygonFillMode;
+    bool instancing = true; // draw all copies and submeshes of a model with one indirect call, otherwise one draw per object
+    bool cpuCulling = true; // frustum cull the objects' submeshes on CPU before the upload
+    bool gpuCulling = true; // frustum cull the indirect draws by a compute pass
+    bool occlusionCulling = true; // two-phase occlusion culling against the depth pyramid, needs gpuCulling
+    bool depthPrepass = false; // depth-only pass before the colour pass, which then shades only the visible fragments
+    int recordThreads = 0; // threads recording the draws into secondary command buffers, 0 = inline on the main thread
+    bool clusteredLighting = true; // shade the fragments with the lights binned into their cluster, otherwise with all lights
+};
+
+// CPU side statistics of the scene rendering, shown by GUI
+struct RenderStats
+{
+    uint32_t drawCalls = 0;
+    uint32_t instances = 0;
+    float recordCpuMs = 0.f; // time spent by render systems recording the frame's commands
+    // the cached matrices rebuilt for the changed transforms at the start of the frame
+    uint32_t updatedTransforms = 0;
+    float transformUpdateCpuMs = 0.f;
+    float gpuFrameMs = 0.f; // GPU time of the frame's commands, a few frames old
+    // state binds of the render queue: pipelines, descriptor sets, vertex and index buffers, push constants
+    uint32_t binds = 0;
+    uint32_t skippedBinds = 0;
+    // CPU frustum culling, counted in (object, submesh) pairs
+    uint32_t visibleSubMeshes = 0;
+    uint32_t culledSubMeshes = 0;
+    float cullingCpuMs = 0.f;
+    // GPU occlusion culling of a previous frame, counted in (object, submesh) pairs
+    uint32_t earlyVisibleSubMeshes = 0;
+    uint32_t lateVisibleSubMeshes = 0;
+    uint32_t occludedSubMeshes = 0;
+    // clustered lighting
+    uint32_t pointLights = 0;
+    float lightCullingGpuMs = 0.f; // GPU time of binning the lights into the clusters
 };
 
 // Структура, хранящая нужную для отрисовки кадра информацию.
@@ -29,8 +72,11 @@ struct FrameInfo
 	VkCommandBuffer commandBuffer;
 	WrpCamera& camera;
 	VkDescriptorSet globalDescriptorSet;
-	SceneObject::Map& sceneObjects;
+	WrpScene& scene;
     RenderingSettings& renderingSettings;
+    uint32_t globalUboOffset = 0; // dynamic offset of the frame's GlobalUbo (binding 0 of the global set), see WrpUniformRing
+    const WrpBvh* sceneBvh = nullptr; // BVH of the objects with models (user data - entity handle), it's optional
+    const WrpDepthPyramid* depthPyramid = nullptr; // the frame is drawn with the two-phase occlusion culling
 };
 
 struct GlobalUbo // global uniform buffer object
@@ -43,26 +89,13 @@ struct GlobalUbo // global uniform buffer object
 	glm::vec4 ambientLightColor{ 1.f, 1.f, 1.f, .02f }; // [r, g, b, w]
 	float directionalLightIntensity;
 	alignas(16) glm::vec4 directionalLightPosition;
-	PointLight pointLights[MAX_LIGHTS];
-	int numLights; // кол-во активных точечных источников света
+	int numLights; // кол-во активных точечных источников света, сами источники хранятся в storage буфере
     float diffuseProportion;
     float roughness;
     float indexOfRefraction;
-};
-
-struct SimplePushConstantData
-{
-    glm::mat4 modelMatrix{ 1.f }; // такой конструктор создаёт единичную матрицу
-    glm::mat4 normalMatrix{ 1.f };
-    alignas(16) glm::vec3 diffuseColor{};
-};
-
-struct TextureSystemPushConstantData
-{
-    glm::mat4 modelMatrix{ 1.f };
-    glm::mat4 normalMatrix{1.f};
-    // 128 byte min limit is reached. next fields will be limited by maxPushConstantSize
-    int diffTexIndex;
-    int specTexIndex;
-    alignas(16) glm::vec3 diffuseColor{};
+    alignas(16) glm::vec4 frustumPlanes[6]; // плоскости пирамиды видимости камеры, см. WrpCamera::getFrustumPlanes()
+    // сетка кластеров освещения, заполняется WrpClusteredLighting::update()
+    alignas(16) glm::uvec4 clusterCount{}; // xyz - число кластеров по осям; w - 0, если каждый фрагмент перебирает все источники
+    glm::vec4 clusterTileSize{}; // xy - размер тайла кластера в пикселях, zw - размер экрана в пикселях
+    glm::vec4 clusterSlicing{}; // x, y - масштаб и сдвиг логарифма глубины для индекса слоя кластеров
 };
@@ -0,0 +1,140 @@
+#include "FrustumCulling.hpp"
+
+// std
+#include <limits>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define WRP_CULLING_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define WRP_CULLING_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define WRP_CULLING_NEON
+#endif
+
+void WrpSphereBounds::clear()
+{
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    radius.clear();
+    count = 0;
+}
+
+void WrpSphereBounds::add(const glm::vec3& center, float sphereRadius)
+{
+    // the arrays grow by a whole batch of padding spheres; a sphere of the negative infinite radius
+    // is outside of any plane
+    if (count == centerX.size())
+    {
+        centerX.resize(count + BATCH_SIZE, 0.f);
+        centerY.resize(count + BATCH_SIZE, 0.f);
+        centerZ.resize(count + BATCH_SIZE, 0.f);
+        radius.resize(count + BATCH_SIZE, -std::numeric_limits<float>::infinity());
+    }
+    centerX[count] = center.x;
+    centerY[count] = center.y;
+    centerZ[count] = center.z;
+    radius[count] = sphereRadius;
+    ++count;
+}
+
+uint32_t WrpSphereBounds::cull(const std::array<glm::vec4, 6>& frustumPlanes, std::vector<uint8_t>& visible) const
+{
+    visible.resize(centerX.size());
+    uint32_t visibleCount = 0;
+
+#if defined(WRP_CULLING_AVX)
+    for (size_t i = 0; i < centerX.size(); i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(&centerX[i]);
+        __m256 y = _mm256_loadu_ps(&centerY[i]);
+        __m256 z = _mm256_loadu_ps(&centerZ[i]);
+        __m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&radius[i]));
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (const glm::vec4& plane : frustumPlanes)
+        {
+            __m256 distance = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(plane.x)), _mm256_mul_ps(y, _mm256_set1_ps(plane.y))),
+                _mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps(plane.z)), _mm256_set1_ps(plane.w)));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+        }
+        int mask = _mm256_movemask_ps(inside);
+        for (int lane = 0; lane < 8; ++lane)
+        {
+            visible[i + lane] = (mask >> lane) & 1;
+            visibleCount += (mask >> lane) & 1;
+        }
+    }
+#elif defined(WRP_CULLING_SSE)
+    for (size_t i = 0; i < centerX.size(); i += 4)
+    {
+        __m128 x = _mm_loadu_ps(&centerX[i]);
+        __m128 y = _mm_loadu_ps(&centerY[i]);
+        __m128 z = _mm_loadu_ps(&centerZ[i]);
+        __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&radius[i]));
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const glm::vec4& plane : frustumPlanes)
+        {
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_mul_ps(y, _mm_set1_ps(plane.y))),
+                _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+        }
+        int mask = _mm_movemask_ps(inside);
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            visible[i + lane] = (mask >> lane) & 1;
+            visibleCount += (mask >> lane) & 1;
+        }
+    }
+#elif defined(WRP_CULLING_NEON)
+    for (size_t i = 0; i < centerX.size(); i += 4)
+    {
+        float32x4_t x = vld1q_f32(&centerX[i]);
+        float32x4_t y = vld1q_f32(&centerY[i]);
+        float32x4_t z = vld1q_f32(&centerZ[i]);
+        float32x4_t negativeRadius = vnegq_f32(vld1q_f32(&radius[i]));
+        uint32x4_t inside = vdupq_n_u32(0xFFFFFFFFu);
+        for (const glm::vec4& plane : frustumPlanes)
+        {
+            float32x4_t distance = vaddq_f32(
+                vaddq_f32(vmulq_n_f32(x, plane.x), vmulq_n_f32(y, plane.y)),
+                vaddq_f32(vmulq_n_f32(z, plane.z), vdupq_n_f32(plane.w)));
+            inside = vandq_u32(inside, vcgeq_f32(distance, negativeRadius));
+        }
+        uint32_t lanes[4];
+        vst1q_u32(lanes, inside);
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            visible[i + lane] = lanes[lane] != 0;
+            visibleCount += lanes[lane] != 0;
+        }
+    }
+#else
+    visibleCount = cullScalar(frustumPlanes, visible);
+#endif
+
+    return visibleCount;
+}
+
+uint32_t WrpSphereBounds::cullScalar(const std::array<glm::vec4, 6>& frustumPlanes, std::vector<uint8_t>& visible) const
+{
+    visible.resize(centerX.size());
+    uint32_t visibleCount = 0;
+    for (size_t i = 0; i < centerX.size(); ++i)
+    {
+        bool inside = true;
+        for (const glm::vec4& plane : frustumPlanes)
+        {
+            // the same order of the operations as in the vectorized versions
+            float distance = (centerX[i] * plane.x + centerY[i] * plane.y) + (centerZ[i] * plane.z + plane.w);
+            inside = inside && distance >= -radius[i];
+        }
+        visible[i] = inside;
+        visibleCount += inside;
+    }
+    return visibleCount;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+// libs
+#define GLM_FORCE_RADIANS			  // Функции GLM будут работать с радианами, а не градусами
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE   // GLM будет ожидать интервал нашего буфера глубины от 0 до 1 (например, для OpenGL используется интервал от -1 до 1)
+#include <glm/glm.hpp>
+
+// std
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// World space bounding spheres stored as a structure of arrays, so the frustum test can load the same
+// component of 4 (SSE, NEON) or 8 (AVX) spheres with one instruction. The arrays are padded to a multiple of 8
+// with spheres that are never visible, so the vectorized loop has no scalar tail.
+class WrpSphereBounds
+{
+public:
+    static constexpr uint32_t BATCH_SIZE = 8;
+
+    void clear();
+    void add(const glm::vec3& center, float radius);
+    uint32_t size() const { return count; }
+
+    // Tests the spheres against the planes from WrpCamera::getFrustumPlanes(). visible[i] is set to 1 for
+    // the spheres intersecting or inside the frustum and to 0 for the others; returns the number of visible ones.
+    uint32_t cull(const std::array<glm::vec4, 6>& frustumPlanes, std::vector<uint8_t>& visible) const;
+    // the same test without SIMD, it's the reference for the vectorized versions
+    uint32_t cullScalar(const std::array<glm::vec4, 6>& frustumPlanes, std::vector<uint8_t>& visible) const;
+
+private:
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> radius;
+    uint32_t count = 0;
+};
@@ -0,0 +1,79 @@
+#include "GpuTimer.hpp"
+
+// std
+#include <array>
+#include <cassert>
+#include <stdexcept>
+
+WrpGpuTimer::WrpGpuTimer(WrpDevice& device, uint32_t framesInFlight)
+    : wrpDevice{device}, written(framesInFlight, false)
+{
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(wrpDevice.getPhysicalDevice(), &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(wrpDevice.getPhysicalDevice(), &familyCount, families.data());
+
+    uint32_t validBits = families[wrpDevice.getGraphicsQueueFamily()].timestampValidBits;
+    if (validBits == 0) return; // таймер не поддерживается, время всегда 0
+    timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+    timestampPeriodNs = wrpDevice.properties.limits.timestampPeriod;
+
+    // пара запросов (начало и конец) на каждый кадр в полёте
+    VkQueryPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = 2 * framesInFlight;
+    if (vkCreateQueryPool(wrpDevice.device(), &poolInfo, nullptr, &queryPool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create timestamp query pool!");
+    }
+}
+
+WrpGpuTimer::~WrpGpuTimer()
+{
+    vkDestroyQueryPool(wrpDevice.device(), queryPool, nullptr);
+}
+
+void WrpGpuTimer::readResult(int frameIndex)
+{
+    if (!written[frameIndex]) return;
+    written[frameIndex] = false;
+
+    std::array<uint64_t, 2> timestamps{};
+    VkResult result = vkGetQueryPoolResults(wrpDevice.device(), queryPool, 2 * frameIndex, 2,
+        sizeof(timestamps), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) return; // VK_NOT_READY: the frame wasn't submitted (swap chain recreation)
+
+    uint64_t ticks = ((timestamps[1] & timestampMask) - (timestamps[0] & timestampMask)) & timestampMask;
+    lastMs = static_cast<float>(static_cast<double>(ticks) * timestampPeriodNs * 1e-6);
+    if (resultCallback) {
+        resultCallback(lastMs);
+    }
+}
+
+void WrpGpuTimer::readRemainingResults(int nextFrameIndex)
+{
+    // the oldest frame in flight is the one whose index comes next
+    int frameCount = static_cast<int>(written.size());
+    for (int i = 0; i < frameCount; ++i) {
+        readResult((nextFrameIndex + i) % frameCount);
+    }
+}
+
+void WrpGpuTimer::begin(VkCommandBuffer commandBuffer, int frameIndex)
+{
+    assert(frameIndex >= 0 && static_cast<size_t>(frameIndex) < written.size() && "Invalid frame index");
+    if (!isSupported()) return;
+
+    readResult(frameIndex);
+    vkCmdResetQueryPool(commandBuffer, queryPool, 2 * frameIndex, 2);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 2 * frameIndex);
+}
+
+void WrpGpuTimer::end(VkCommandBuffer commandBuffer, int frameIndex)
+{
+    if (!isSupported()) return;
+
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 2 * frameIndex + 1);
+    written[frameIndex] = true;
+}
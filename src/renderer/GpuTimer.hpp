@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Device.hpp"
+
+// std
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Measures the GPU time between two points of the frame's command buffer by timestamp queries.
+// Every frame in flight has its pair of queries; their results are read when the frame index comes around again,
+// after WrpRenderer::beginFrame() has waited for its fence, so reading never stalls.
+class WrpGpuTimer
+{
+public:
+    WrpGpuTimer(WrpDevice& device, uint32_t framesInFlight);
+    ~WrpGpuTimer();
+
+    WrpGpuTimer(const WrpGpuTimer&) = delete;
+    WrpGpuTimer& operator=(const WrpGpuTimer&) = delete;
+
+    // Reads the previous result of the frame and writes the start timestamp. Both calls must be recorded outside
+    // of a render pass: the queries are reset here and the render pass may consist of secondary command buffers.
+    void begin(VkCommandBuffer commandBuffer, int frameIndex);
+    void end(VkCommandBuffer commandBuffer, int frameIndex);
+
+    // the queue family of the graphics queue may not support timestamps, then the time is always 0
+    bool isSupported() const { return timestampMask != 0; }
+    // the time of the last frame whose result is read
+    float getLastMs() const { return lastMs; }
+
+    // Called with the time of every frame whose result is read, in the order the frames were submitted.
+    void setResultCallback(std::function<void(float)> callback) { resultCallback = std::move(callback); }
+    // Reads the results not read yet; nextFrameIndex is the index of the frame after the last submitted one.
+    // The frames must have been executed, e.g. after vkDeviceWaitIdle().
+    void readRemainingResults(int nextFrameIndex);
+
+private:
+    void readResult(int frameIndex);
+
+    WrpDevice& wrpDevice;
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    std::vector<bool> written; // whether the queries of the frame were written and their result isn't read yet
+    uint64_t timestampMask = 0; // valid bits of the timestamps
+    float timestampPeriodNs = 1.f;
+    float lastMs = 0.f;
+    std::function<void(float)> resultCallback;
+};
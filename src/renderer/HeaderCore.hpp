@@ -20,3 +20,9 @@
 #ifndef SHADERS_DIR
 #define SHADERS_DIR "../../../src/shaders/"
 #endif
+
+// Directory for the data generated at runtime (pipeline cache, compiled shaders).
+// It's relative to the working directory, so the source tree is never written to.
+#ifndef CACHE_DIR
+#define CACHE_DIR "./cache/"
+#endif
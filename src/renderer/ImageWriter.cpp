@@ -0,0 +1,139 @@
+#include "ImageWriter.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// CRC-32 of the PNG chunks (ISO 3309, polynomial 0xEDB88320)
+const std::array<uint32_t, 256>& crcTable()
+{
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t n = 0; n < 256; n++)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[n] = c;
+        }
+        return t;
+    }();
+    return table;
+}
+
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+{
+    const auto& table = crcTable();
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+void appendU32(std::vector<uint8_t>& out, uint32_t value) // big-endian, as everything in PNG
+{
+    out.push_back(static_cast<uint8_t>(value >> 24));
+    out.push_back(static_cast<uint8_t>(value >> 16));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+void appendChunk(std::vector<uint8_t>& out, const char type[4], const std::vector<uint8_t>& data)
+{
+    appendU32(out, static_cast<uint32_t>(data.size()));
+    size_t typeBegin = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    // the CRC covers the type and the data, but not the length
+    appendU32(out, crc32(out.data() + typeBegin, out.size() - typeBegin));
+}
+
+// zlib stream of stored (uncompressed) deflate blocks
+std::vector<uint8_t> zlibStore(const std::vector<uint8_t>& data)
+{
+    constexpr size_t MAX_BLOCK_SIZE = 65535;
+
+    std::vector<uint8_t> out;
+    out.reserve(data.size() + data.size() / MAX_BLOCK_SIZE * 5 + 11);
+    out.push_back(0x78); // deflate, 32K window
+    out.push_back(0x01); // no preset dictionary, the fastest level; (0x78 << 8 | 0x01) % 31 == 0
+
+    size_t offset = 0;
+    do
+    {
+        size_t blockSize = std::min(MAX_BLOCK_SIZE, data.size() - offset);
+        bool last = offset + blockSize == data.size();
+        out.push_back(last ? 1 : 0); // BFINAL, BTYPE = 00 (stored)
+        out.push_back(static_cast<uint8_t>(blockSize));
+        out.push_back(static_cast<uint8_t>(blockSize >> 8));
+        out.push_back(static_cast<uint8_t>(~blockSize));
+        out.push_back(static_cast<uint8_t>(~blockSize >> 8));
+        out.insert(out.end(), data.begin() + offset, data.begin() + offset + blockSize);
+        offset += blockSize;
+    } while (offset < data.size());
+
+    // Adler-32 of the uncompressed data; the sums are reduced often enough not to overflow
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < data.size(); i += 4096)
+    {
+        size_t end = std::min(data.size(), i + 4096);
+        for (size_t j = i; j < end; j++)
+        {
+            a += data[j];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    appendU32(out, (b << 16) | a);
+
+    return out;
+}
+
+} // namespace
+
+void writePng(const std::string& path, uint32_t width, uint32_t height, const uint8_t* rgba)
+{
+    if (width == 0 || height == 0)
+    {
+        throw std::runtime_error("Can't write an empty image to " + path + "!");
+    }
+
+    // every scanline starts with its filter type, 0 (none)
+    const size_t rowSize = static_cast<size_t>(width) * 4;
+    std::vector<uint8_t> scanlines;
+    scanlines.reserve((rowSize + 1) * height);
+    for (uint32_t y = 0; y < height; y++)
+    {
+        scanlines.push_back(0);
+        scanlines.insert(scanlines.end(), rgba + y * rowSize, rgba + (y + 1) * rowSize);
+    }
+
+    std::vector<uint8_t> header;
+    appendU32(header, width);
+    appendU32(header, height);
+    header.push_back(8); // bit depth
+    header.push_back(6); // color type: RGBA
+    header.push_back(0); // compression: deflate
+    header.push_back(0); // filter method: adaptive
+    header.push_back(0); // no interlace
+
+    std::vector<uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    appendChunk(png, "IHDR", header);
+    appendChunk(png, "IDAT", zlibStore(scanlines));
+    appendChunk(png, "IEND", {});
+
+    std::ofstream file{path, std::ios::binary};
+    file.write(reinterpret_cast<const char*>(png.data()), static_cast<std::streamsize>(png.size()));
+    if (!file)
+    {
+        throw std::runtime_error("Failed to write image " + path + "!");
+    }
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <string>
+
+// Writes 8-bit RGBA pixels, rows from top to bottom, as a PNG file. The image data is stored in uncompressed
+// deflate blocks, so no compression library is needed: the files are bigger, but it's only used to check
+// the frames rendered in the headless mode. Throws if the file can't be written.
+void writePng(const std::string& path, uint32_t width, uint32_t height, const uint8_t* rgba);
@@ -11,6 +11,7 @@
 #include <cassert>
 #include <cstring>
 #include <iostream>
+#include <limits>
 #include <unordered_map>
 
 namespace std
@@ -33,6 +34,7 @@ WrpModel::WrpModel(WrpDevice& device, const WrpModel::Builder& builder)
     createVertexBuffers(builder.vertices);
     createIndexBuffers(builder.indices);
     createTextures(builder.texturePaths);
+    computeBounds(builder.vertices, builder.indices);
 }
 
 WrpModel::~WrpModel(){}
@@ -227,6 +229,40 @@ WrpModel::Builder::SubMesh WrpModel::Builder::createSubMesh(
     return subMesh;
 }
 
+// Box of the whole model is used by the scene BVH, a sphere around the AABB of each submesh's vertices
+// is used by the frustum culling of the submesh draws.
+void WrpModel::computeBounds(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+{
+    if (!vertices.empty()) boundingBox = {vertices[0].position, vertices[0].position};
+    for (const Vertex& vertex : vertices)
+    {
+        boundingBox.min = glm::min(boundingBox.min, vertex.position);
+        boundingBox.max = glm::max(boundingBox.max, vertex.position);
+    }
+
+    for (Builder::SubMesh& subMesh : subMeshesInfos)
+    {
+        if (subMesh.indexCount == 0) continue;
+
+        glm::vec3 minPosition{std::numeric_limits<float>::max()};
+        glm::vec3 maxPosition{std::numeric_limits<float>::lowest()};
+        for (uint32_t i = subMesh.indexStart; i < subMesh.indexStart + subMesh.indexCount; ++i)
+        {
+            minPosition = glm::min(minPosition, vertices[indices[i]].position);
+            maxPosition = glm::max(maxPosition, vertices[indices[i]].position);
+        }
+        glm::vec3 center = (minPosition + maxPosition) * 0.5f;
+
+        float radiusSquared = 0.f;
+        for (uint32_t i = subMesh.indexStart; i < subMesh.indexStart + subMesh.indexCount; ++i)
+        {
+            glm::vec3 offset = vertices[indices[i]].position - center;
+            radiusSquared = glm::max(radiusSquared, glm::dot(offset, offset));
+        }
+        subMesh.boundingSphere = glm::vec4(center, glm::sqrt(radiusSquared));
+    }
+}
+
 void WrpModel::createVertexBuffers(const std::vector<Vertex>& vertices)
 {
     vertexCount = static_cast<uint32_t>(vertices.size());
@@ -326,9 +362,10 @@ void WrpModel::draw(VkCommandBuffer commandBuffer)
     }
 }
 
-void WrpModel::drawIndexed(VkCommandBuffer commandBuffer, uint32_t indexCount, uint32_t indexStart)
+void WrpModel::drawIndexed(VkCommandBuffer commandBuffer, uint32_t indexCount, uint32_t indexStart,
+    uint32_t instanceCount, uint32_t firstInstance)
 {
-    vkCmdDrawIndexed(commandBuffer, indexCount, 1, indexStart, 0, 0);
+    vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, indexStart, 0, firstInstance);
 }
 
 // Binding vertexBuffers and indexBuffer to graphics pipeline
@@ -382,3 +419,8 @@ std::vector<VkVertexInputAttributeDescription> WrpModel::Vertex::getAttributeDes
 
     return attributeDescriptions;
 }
+
+std::vector<VkVertexInputAttributeDescription> WrpModel::Vertex::getPositionAttributeDescriptions()
+{
+    return { {0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, position)} };
+}
@@ -3,6 +3,7 @@
 #include "Device.hpp"
 #include "Buffer.hpp"
 #include "Texture.hpp"
+#include "Bvh.hpp"
 
 // libs
 #define GLM_FORCE_RADIANS			  // Функции GLM будут работать с радианами, а не градусами
@@ -27,6 +28,8 @@ public:
 
         static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
         static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+        // only the position from the same binding, for the depth-only pipelines
+        static std::vector<VkVertexInputAttributeDescription> getPositionAttributeDescriptions();
 
         bool operator==(const Vertex& other) const
         {
@@ -46,6 +49,7 @@ public:
             int diffuseTextureIndex;
             glm::vec3 diffuseColor;
             int specularTextureIndex;
+            glm::vec4 boundingSphere{}; // xyz - центр в пространстве модели, w - радиус; вычисляется в WrpModel
         };
 
         std::vector<Vertex> vertices{};
@@ -73,10 +77,12 @@ public:
 
     void bind(VkCommandBuffer commandBuffer);
     void draw(VkCommandBuffer commandBuffer);
-    void drawIndexed(VkCommandBuffer commandBuffer, uint32_t indexCount, uint32_t indexStart = 0);
+    void drawIndexed(VkCommandBuffer commandBuffer, uint32_t indexCount, uint32_t indexStart = 0,
+        uint32_t instanceCount = 1, uint32_t firstInstance = 0);
 
     std::vector<Builder::SubMesh>& getSubMeshesInfos() {return subMeshesInfos;}
     std::vector<std::unique_ptr<WrpTexture>>& getTextures() {return textures;}
+    const WrpAabb& getBoundingBox() const {return boundingBox;} // в пространстве модели
 
     bool hasTextures = false;
 
@@ -84,6 +90,7 @@ private:
     void createVertexBuffers(const std::vector<Vertex>& vertices);
     void createIndexBuffers(const std::vector<uint32_t>& indices);
     void createTextures(const std::vector<std::string>& texturePaths);
+    void computeBounds(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
 
     WrpDevice& wrpDevice;
 
@@ -96,4 +103,5 @@ private:
 
     std::vector<Builder::SubMesh> subMeshesInfos;
     std::vector<std::unique_ptr<WrpTexture>> textures;
+    WrpAabb boundingBox{};
 };
@@ -0,0 +1,360 @@
+#include "OcclusionCulling.hpp"
+
+// std
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+namespace
+{
+    constexpr uint32_t CULL_WORKGROUP_SIZE = 64; // local_size_x of OcclusionCullingEarly.comp and OcclusionCullingLate.comp
+    constexpr uint32_t MIN_VISIBILITY_CAPACITY = 1024;
+
+    uint32_t workgroupCount(uint32_t threads)
+    {
+        return (threads + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE;
+    }
+}
+
+WrpOcclusionCulling::WrpOcclusionCulling(WrpDevice& device, WrpDrawBatcher& batcher, uint32_t framesInFlight,
+    VkDescriptorSetLayout globalSetLayout)
+    : wrpDevice{device}, batcher{batcher}
+{
+    setLayout = WrpDescriptorSetLayout::Builder(wrpDevice)
+        .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // visibility
+        .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // item slots
+        .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // occlusion stats
+        .build();
+
+    depthPyramidSetLayout = WrpDescriptorSetLayout::Builder(wrpDevice)
+        .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+        .build();
+
+    // per frame: the occlusion set and the depth pyramid set, 3 storage buffers and a sampler in total
+    descriptorAllocator = WrpDescriptorAllocator::Builder(wrpDevice)
+        .setInitialSetsPerPool(framesInFlight * 2)
+        .addPoolSizeRatio(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3.f / 2.f)
+        .addPoolSizeRatio(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.f / 2.f)
+        .build();
+
+    frames.resize(framesInFlight);
+    for (FrameBuffers& frame : frames)
+    {
+        frame.stats = std::make_unique<WrpBuffer>(
+            wrpDevice,
+            sizeof(OcclusionStats),
+            1,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        frame.stats->map();
+    }
+
+    // the passes append the visible instances through the batcher's culling set
+    earlyPipelineLayout = createPipelineLayout({globalSetLayout, batcher.getCullDescriptorSetLayout(),
+        setLayout->getDescriptorSetLayout()});
+    earlyPipeline = std::make_unique<WrpComputePipeline>(wrpDevice, "OcclusionCullingEarly.comp", earlyPipelineLayout);
+
+    latePipelineLayout = createPipelineLayout({globalSetLayout, batcher.getCullDescriptorSetLayout(),
+        setLayout->getDescriptorSetLayout(), depthPyramidSetLayout->getDescriptorSetLayout()});
+    latePipeline = std::make_unique<WrpComputePipeline>(wrpDevice, "OcclusionCullingLate.comp", latePipelineLayout);
+}
+
+WrpOcclusionCulling::~WrpOcclusionCulling()
+{
+    earlyPipeline.reset();
+    latePipeline.reset();
+    vkDestroyPipelineLayout(wrpDevice.device(), earlyPipelineLayout, nullptr);
+    vkDestroyPipelineLayout(wrpDevice.device(), latePipelineLayout, nullptr);
+}
+
+VkPipelineLayout WrpOcclusionCulling::createPipelineLayout(const std::vector<VkDescriptorSetLayout>& descriptorSetLayouts)
+{
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    if (vkCreatePipelineLayout(wrpDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create occlusion culling pipeline layout!");
+    }
+    return pipelineLayout;
+}
+
+void WrpOcclusionCulling::cullEarly(VkCommandBuffer commandBuffer, VkDescriptorSet globalDescriptorSet,
+    uint32_t globalUboOffset, int frameIndex, const std::array<glm::vec4, 6>& frustumPlanes)
+{
+    FrameBuffers& frame = frames[frameIndex];
+    // the GPU has finished the previous frame with this index, its results can be read
+    if (frame.validationPending) {
+        validateCulling(frame);
+    }
+    stats = {};
+    if (frame.statsPending)
+    {
+        frame.statsPending = false;
+        frame.stats->invalidate();
+        stats = *static_cast<const OcclusionStats*>(frame.stats->getMappedMemory());
+    }
+
+    assignVisibilitySlots();
+    if (batcher.isEmpty()) return;
+
+    writeItemSlots(frame);
+    if (frame.descriptorSetDirty) {
+        writeDescriptorSet(frame);
+    }
+
+    // the visibility was written by the late pass of the previous frame
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    // the new slots are drawn by the early pass, so they're in the depth pyramid right away
+    if (uninitializedVisibility < visibilitySlotCount)
+    {
+        VkDeviceSize offset = uninitializedVisibility * sizeof(uint32_t);
+        vkCmdFillBuffer(commandBuffer, visibility->getBuffer(), offset,
+            visibilitySlotCount * sizeof(uint32_t) - offset, 1);
+        uninitializedVisibility = std::numeric_limits<uint32_t>::max();
+    }
+    vkCmdFillBuffer(commandBuffer, frame.stats->getBuffer(), 0, sizeof(OcclusionStats), 0);
+
+    // the fills are synchronized with the pass by the barrier of beginCulling()
+    batcher.beginCulling(commandBuffer, frameIndex);
+    dispatch(commandBuffer, earlyPipelineLayout, *earlyPipeline,
+        {globalDescriptorSet, batcher.getCullDescriptorSet(frameIndex), frame.descriptorSet}, globalUboOffset);
+    batcher.endCulling(commandBuffer, globalDescriptorSet, globalUboOffset, frameIndex);
+
+    if (cullingValidation)
+    {
+        // the occlusion isn't known on CPU, so the passes are checked against the frustum culling only
+        batcher.cullReference(frustumPlanes, 1e-3f, frame.expectedMaxVisible);
+        copyVisibleCounts(commandBuffer, frame, frameIndex, 0);
+    }
+}
+
+void WrpOcclusionCulling::cullLate(VkCommandBuffer commandBuffer, VkDescriptorSet globalDescriptorSet,
+    uint32_t globalUboOffset, int frameIndex, const WrpDepthPyramid& depthPyramid)
+{
+    if (batcher.isEmpty()) return;
+
+    FrameBuffers& frame = frames[frameIndex];
+
+    // the buffers of the early pass are reused, the draws and the copy reading them must be finished
+    vkCmdPipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+    VkDescriptorImageInfo depthPyramidInfo = depthPyramid.getDescriptorInfo(frameIndex);
+    WrpDescriptorWriter writer(*depthPyramidSetLayout, *descriptorAllocator);
+    writer.writeImage(0, &depthPyramidInfo);
+    if (frame.depthPyramidDescriptorSet == VK_NULL_HANDLE) writer.build(frame.depthPyramidDescriptorSet);
+    else writer.overwrite(frame.depthPyramidDescriptorSet);
+
+    batcher.beginCulling(commandBuffer, frameIndex);
+    dispatch(commandBuffer, latePipelineLayout, *latePipeline,
+        {globalDescriptorSet, batcher.getCullDescriptorSet(frameIndex), frame.descriptorSet,
+        frame.depthPyramidDescriptorSet}, globalUboOffset);
+    batcher.endCulling(commandBuffer, globalDescriptorSet, globalUboOffset, frameIndex);
+
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    VkPipelineStageFlags srcStages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    if (cullingValidation)
+    {
+        copyVisibleCounts(commandBuffer, frame, frameIndex, 1);
+        barrier.srcAccessMask |= VK_ACCESS_TRANSFER_WRITE_BIT;
+        srcStages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+        frame.validationPending = true;
+    }
+    vkCmdPipelineBarrier(commandBuffer, srcStages, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    frame.statsPending = true;
+}
+
+void WrpOcclusionCulling::dispatch(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout,
+    WrpComputePipeline& pipeline, const std::vector<VkDescriptorSet>& descriptorSets, uint32_t globalUboOffset)
+{
+    // a thread per (object, submesh) pair
+    PushConstants push{};
+    push.count = batcher.getCullItemCount();
+    pipeline.bind(commandBuffer);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout,
+        0, static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(), 1, &globalUboOffset);
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &push);
+    vkCmdDispatch(commandBuffer, workgroupCount(push.count), 1, 1);
+}
+
+// Keeps the visibility slots of the batched objects: an object gets a slot per submesh of its model when it's
+// batched the first time and loses them when it's not batched anymore. The freed slots are reused by compaction,
+// it resets the visibility of all objects.
+void WrpOcclusionCulling::assignVisibilitySlots()
+{
+    ++frameCounter;
+    uint32_t liveSlots = 0;
+    batcher.forEachObject([&](WrpEntity entity, WrpModel& model) {
+        uint32_t slotCount = static_cast<uint32_t>(model.getSubMeshesInfos().size());
+        VisibilitySlots& slots = visibilitySlots[entity];
+        // a new object, or its model was replaced
+        if (slots.count != slotCount)
+        {
+            slots.first = visibilitySlotCount;
+            slots.count = slotCount;
+            uninitializedVisibility = std::min(uninitializedVisibility, visibilitySlotCount);
+            visibilitySlotCount += slotCount;
+        }
+        slots.lastFrame = frameCounter;
+        liveSlots += slotCount;
+    });
+
+    for (auto it = visibilitySlots.begin(); it != visibilitySlots.end();)
+    {
+        if (it->second.lastFrame != frameCounter) it = visibilitySlots.erase(it);
+        else ++it;
+    }
+
+    if (visibilitySlotCount > liveSlots * 2 + MIN_VISIBILITY_CAPACITY)
+    {
+        visibilitySlotCount = 0;
+        for (auto& kv : visibilitySlots)
+        {
+            kv.second.first = visibilitySlotCount;
+            visibilitySlotCount += kv.second.count;
+        }
+        uninitializedVisibility = 0;
+    }
+    reserveVisibility(visibilitySlotCount);
+}
+
+// The visibility buffer is shared by the frames in flight, so it's recreated when the GPU is idle.
+// The content of the old buffer is lost, all slots become visible.
+void WrpOcclusionCulling::reserveVisibility(uint32_t slots)
+{
+    if (visibility && visibilityCapacity >= slots) return;
+
+    if (visibility) {
+        vkDeviceWaitIdle(wrpDevice.device());
+    }
+    visibilityCapacity = std::max({slots, visibilityCapacity * 2, MIN_VISIBILITY_CAPACITY});
+    visibility = std::make_unique<WrpBuffer>(
+        wrpDevice,
+        sizeof(uint32_t),
+        visibilityCapacity,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    uninitializedVisibility = 0;
+    for (FrameBuffers& frame : frames) {
+        frame.descriptorSetDirty = true;
+    }
+}
+
+// Writes the visibility slot of every (object, submesh) pair in the order of the batcher's cull items.
+// The buffer isn't used by GPU anymore when the frame index comes around again, so it can be recreated right away.
+void WrpOcclusionCulling::writeItemSlots(FrameBuffers& frame)
+{
+    uint32_t itemCount = batcher.getCullItemCount();
+    if (frame.itemsCapacity < itemCount)
+    {
+        frame.itemsCapacity = std::max(itemCount, frame.itemsCapacity * 2);
+        frame.itemSlots = std::make_unique<WrpBuffer>(
+            wrpDevice,
+            sizeof(uint32_t),
+            frame.itemsCapacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        frame.itemSlots->map();
+        frame.descriptorSetDirty = true;
+    }
+
+    auto* itemSlots = static_cast<uint32_t*>(frame.itemSlots->getMappedMemory());
+    uint32_t item = 0;
+    batcher.forEachCullItem([&](WrpEntity entity, uint32_t subMesh) {
+        itemSlots[item++] = visibilitySlots[entity].first + subMesh;
+    });
+    frame.itemSlots->flush();
+}
+
+void WrpOcclusionCulling::writeDescriptorSet(FrameBuffers& frame)
+{
+    VkDescriptorBufferInfo visibilityInfo = visibility->descriptorInfo();
+    VkDescriptorBufferInfo itemSlotsInfo = frame.itemSlots->descriptorInfo();
+    VkDescriptorBufferInfo statsInfo = frame.stats->descriptorInfo();
+
+    WrpDescriptorWriter writer(*setLayout, *descriptorAllocator);
+    writer.writeBuffer(0, &visibilityInfo);
+    writer.writeBuffer(1, &itemSlotsInfo);
+    writer.writeBuffer(2, &statsInfo);
+    if (frame.descriptorSet == VK_NULL_HANDLE) writer.build(frame.descriptorSet);
+    else writer.overwrite(frame.descriptorSet);
+    frame.descriptorSetDirty = false;
+}
+
+// Copies the visible counts of the pass to the pass's part of the readback buffer, the counts were synchronized
+// with the transfer by WrpDrawBatcher::endCulling()
+void WrpOcclusionCulling::copyVisibleCounts(VkCommandBuffer commandBuffer, FrameBuffers& frame, int frameIndex,
+    uint32_t pass)
+{
+    uint32_t drawCount = batcher.getDrawCount();
+    if (pass == 0 && frame.drawsCapacity < drawCount)
+    {
+        frame.drawsCapacity = std::max(drawCount, frame.drawsCapacity * 2);
+        frame.visibleCountsReadback = std::make_unique<WrpBuffer>(
+            wrpDevice,
+            sizeof(uint32_t),
+            frame.drawsCapacity * 2,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        frame.visibleCountsReadback->map();
+    }
+
+    VkBufferCopy region{};
+    region.dstOffset = pass * drawCount * sizeof(uint32_t);
+    region.size = drawCount * sizeof(uint32_t);
+    vkCmdCopyBuffer(commandBuffer, batcher.getVisibleCountsBuffer(frameIndex), frame.visibleCountsReadback->getBuffer(),
+        1, &region);
+}
+
+void WrpOcclusionCulling::finishCullingValidation()
+{
+    for (FrameBuffers& frame : frames)
+    {
+        if (frame.validationPending) {
+            validateCulling(frame);
+        }
+    }
+}
+
+void WrpOcclusionCulling::validateCulling(FrameBuffers& frame)
+{
+    frame.validationPending = false;
+    ++validatedFrameCount;
+    frame.visibleCountsReadback->invalidate();
+    auto* visibleCounts = static_cast<const uint32_t*>(frame.visibleCountsReadback->getMappedMemory());
+
+    size_t drawCount = frame.expectedMaxVisible.size();
+    for (size_t draw = 0; draw < drawCount; ++draw)
+    {
+        // both passes draw only the instances in the frustum, and never the same one twice
+        uint32_t early = visibleCounts[draw];
+        uint32_t late = visibleCounts[drawCount + draw];
+        if (early + late > frame.expectedMaxVisible[draw])
+        {
+            ++cullingMismatchCount;
+            std::cerr << "GPU occlusion culling mismatch: draw " << draw << " has " << early << " + " << late
+                      << " visible instances, CPU frustum reference " << frame.expectedMaxVisible[draw] << std::endl;
+        }
+    }
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "Device.hpp"
+#include "Buffer.hpp"
+#include "Descriptors.hpp"
+#include "DepthPyramid.hpp"
+#include "DrawBatcher.hpp"
+#include "Pipeline.hpp"
+#include "Scene.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <array>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Two-phase occlusion culling of the draws of a WrpDrawBatcher, used instead of WrpDrawBatcher::cull().
+// The frame is drawn in two render passes:
+//  - cullEarly() culls against the frustum only the (object, submesh) pairs visible in the previous frame,
+//    the batcher's submit() draws them and the depth pyramid is built from their depth;
+//  - cullLate() tests all pairs against the frustum and the pyramid, keeps the result for the next frame
+//    and leaves for the following submit() only the visible pairs that weren't drawn by the early pass.
+// Every pair visible in the frame is drawn by one of the passes, so the objects don't pop in when they're disoccluded.
+// The pairs keep their visibility slots between frames by the entity handle.
+//
+// Both passes are culling passes of the batcher (see WrpDrawBatcher::beginCulling()): they append the visible
+// instances through its culling set, the batcher writes the commands.
+class WrpOcclusionCulling
+{
+public:
+    // globalSetLayout is the layout of the set with GlobalUbo, the passes read the frustum planes and the matrices from it
+    WrpOcclusionCulling(WrpDevice& device, WrpDrawBatcher& batcher, uint32_t framesInFlight,
+        VkDescriptorSetLayout globalSetLayout);
+    ~WrpOcclusionCulling();
+
+    WrpOcclusionCulling(const WrpOcclusionCulling&) = delete;
+    WrpOcclusionCulling& operator=(const WrpOcclusionCulling&) = delete;
+
+    // Called after the batcher's upload() and outside of a render pass, the following submit() draws the pairs
+    // visible in the previous frame. frustumPlanes must be the planes written to GlobalUbo, they're used by
+    // the CPU reference of the validation.
+    void cullEarly(VkCommandBuffer commandBuffer, VkDescriptorSet globalDescriptorSet, uint32_t globalUboOffset,
+        int frameIndex, const std::array<glm::vec4, 6>& frustumPlanes);
+    // Called after the depth pyramid of the frame is built from the depth drawn by the early pass, the next
+    // submit() draws the rest.
+    void cullLate(VkCommandBuffer commandBuffer, VkDescriptorSet globalDescriptorSet, uint32_t globalUboOffset,
+        int frameIndex, const WrpDepthPyramid& depthPyramid);
+
+    // Reads back the visible instance counts of both passes of every frame and compares them with the CPU frustum
+    // reference of the batcher, the occlusion isn't known on CPU.
+    void setCullingValidation(bool enabled) { cullingValidation = enabled; }
+    // compares the frames whose results haven't been read back yet, the GPU must be idle
+    void finishCullingValidation();
+    uint64_t getCullingMismatchCount() const { return cullingMismatchCount; }
+    uint64_t getValidatedFrameCount() const { return validatedFrameCount; }
+
+    // Results in (object, submesh) pairs: drawn by the early pass, drawn by the late pass and culled by
+    // the depth pyramid. They're read back from the GPU, so they're a few frames old.
+    uint32_t getEarlyVisibleCount() const { return stats.earlyVisible; }
+    uint32_t getLateVisibleCount() const { return stats.lateVisible; }
+    uint32_t getOccludedCount() const { return stats.occluded; }
+
+private:
+    // Matches OcclusionStatsBuffer of OcclusionCulling.glsl
+    struct OcclusionStats
+    {
+        uint32_t earlyVisible = 0;
+        uint32_t lateVisible = 0;
+        uint32_t occluded = 0;
+    };
+
+    // visibility slots of an object's submeshes
+    struct VisibilitySlots
+    {
+        uint32_t first = 0;
+        uint32_t count = 0;
+        uint64_t lastFrame = 0; // cullEarly() that has seen the object
+    };
+
+    struct PushConstants
+    {
+        uint32_t count = 0; // (object, submesh) pairs
+    };
+
+    struct FrameBuffers
+    {
+        std::unique_ptr<WrpBuffer> itemSlots; // visibility slot of every cull item of the batcher
+        uint32_t itemsCapacity = 0;
+        std::unique_ptr<WrpBuffer> stats;     // host visible
+        bool statsPending = false;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        VkDescriptorSet depthPyramidDescriptorSet = VK_NULL_HANDLE;
+        bool descriptorSetDirty = true;
+
+        // validation, the counts of the early pass are followed by the counts of the late one
+        std::unique_ptr<WrpBuffer> visibleCountsReadback;
+        uint32_t drawsCapacity = 0;
+        std::vector<uint32_t> expectedMaxVisible;
+        bool validationPending = false;
+    };
+
+    VkPipelineLayout createPipelineLayout(const std::vector<VkDescriptorSetLayout>& descriptorSetLayouts);
+    void assignVisibilitySlots();
+    void reserveVisibility(uint32_t slots);
+    void writeItemSlots(FrameBuffers& frame);
+    void writeDescriptorSet(FrameBuffers& frame);
+    void dispatch(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, WrpComputePipeline& pipeline,
+        const std::vector<VkDescriptorSet>& descriptorSets, uint32_t globalUboOffset);
+    void copyVisibleCounts(VkCommandBuffer commandBuffer, FrameBuffers& frame, int frameIndex, uint32_t pass);
+    void validateCulling(FrameBuffers& frame);
+
+    WrpDevice& wrpDevice;
+    WrpDrawBatcher& batcher;
+
+    std::unique_ptr<WrpDescriptorSetLayout> setLayout;
+    std::unique_ptr<WrpDescriptorSetLayout> depthPyramidSetLayout;
+    std::unique_ptr<WrpDescriptorAllocator> descriptorAllocator;
+    VkPipelineLayout earlyPipelineLayout = VK_NULL_HANDLE;
+    VkPipelineLayout latePipelineLayout = VK_NULL_HANDLE; // the early layout with the depth pyramid set
+    std::unique_ptr<WrpComputePipeline> earlyPipeline;
+    std::unique_ptr<WrpComputePipeline> latePipeline;
+    std::vector<FrameBuffers> frames; // indexed by frame index
+
+    // Visibility of the (object, submesh) pairs in the previous frame, shared by the frames in flight.
+    // The slots of the objects are kept by their entity handles, the slots of the removed objects are reused
+    // by compaction.
+    std::unique_ptr<WrpBuffer> visibility;
+    uint32_t visibilityCapacity = 0;
+    uint32_t uninitializedVisibility = 0; // the slots from it on are filled as visible by the next cullEarly()
+    std::unordered_map<WrpEntity, VisibilitySlots> visibilitySlots;
+    uint32_t visibilitySlotCount = 0; // slots assigned so far, including the ones of the removed objects
+    uint64_t frameCounter = 0;
+    OcclusionStats stats;
+
+    bool cullingValidation = false;
+    uint64_t cullingMismatchCount = 0;
+    uint64_t validatedFrameCount = 0;
+};
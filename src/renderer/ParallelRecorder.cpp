@@ -0,0 +1,137 @@
+#include "ParallelRecorder.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <future>
+#include <stdexcept>
+
+WrpParallelRecorder::WrpParallelRecorder(WrpDevice& device, WrpRenderer& renderer, unsigned int threadCount)
+    : wrpDevice{device}, wrpRenderer{renderer}, threadPool{threadCount}
+{
+    frames.resize(wrpRenderer.getFramesInFlight());
+    for (auto& frame : frames)
+    {
+        frame.resize(threadPool.getThreadCount() + 1);
+        for (auto& threadCommands : frame) {
+            createThreadCommands(threadCommands);
+        }
+    }
+}
+
+WrpParallelRecorder::~WrpParallelRecorder()
+{
+    threadPool.waitIdle();
+    for (auto& frame : frames)
+    {
+        for (auto& threadCommands : frame) {
+            // буферы команд освобождаются вместе с пулом
+            vkDestroyCommandPool(wrpDevice.device(), threadCommands.commandPool, nullptr);
+        }
+    }
+}
+
+void WrpParallelRecorder::createThreadCommands(ThreadCommands& threadCommands)
+{
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = wrpDevice.getGraphicsQueueFamily();
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // буферы перезаписываются каждый кадр
+
+    if (vkCreateCommandPool(wrpDevice.device(), &poolInfo, nullptr, &threadCommands.commandPool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create command pool for secondary command buffers!");
+    }
+}
+
+void WrpParallelRecorder::beginFrame(int frameIndex)
+{
+    assert(frameIndex >= 0 && static_cast<size_t>(frameIndex) < frames.size() && "Invalid frame index");
+
+    currentFrameIndex = frameIndex;
+    for (auto& threadCommands : frames[frameIndex])
+    {
+        vkResetCommandPool(wrpDevice.device(), threadCommands.commandPool, 0);
+        threadCommands.usedCount = 0;
+    }
+}
+
+VkCommandBuffer WrpParallelRecorder::acquireCommandBuffer(unsigned int threadIndex)
+{
+    assert(currentFrameIndex >= 0 && "beginFrame() must be called before recording");
+
+    // only the thread threadIndex touches its commands, no locking is needed
+    ThreadCommands& threadCommands = frames[currentFrameIndex][threadIndex];
+    if (threadCommands.usedCount == threadCommands.commandBuffers.size())
+    {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandPool = threadCommands.commandPool;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        if (vkAllocateCommandBuffers(wrpDevice.device(), &allocInfo, &commandBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to allocate secondary command buffer!");
+        }
+        threadCommands.commandBuffers.push_back(commandBuffer);
+    }
+    return threadCommands.commandBuffers[threadCommands.usedCount++];
+}
+
+void WrpParallelRecorder::record(VkCommandBuffer primaryCommandBuffer, WrpRenderQueue& renderQueue, unsigned int taskCount)
+{
+    uint32_t drawCount = renderQueue.size();
+    if (drawCount == 0) return;
+
+    uint32_t maxTaskCount = std::max(1u, drawCount / MIN_DRAWS_PER_TASK);
+    taskCount = std::clamp(taskCount, 1u, std::min(maxTaskCount, threadPool.getThreadCount()));
+    uint32_t drawsPerTask = (drawCount + taskCount - 1) / taskCount;
+
+    std::vector<std::future<WrpRenderQueue::BindCounts>> results;
+    std::vector<VkCommandBuffer> commandBuffers(taskCount, VK_NULL_HANDLE);
+    results.reserve(taskCount);
+    for (unsigned int task = 0; task < taskCount; ++task)
+    {
+        uint32_t first = std::min(task * drawsPerTask, drawCount);
+        uint32_t last = std::min(first + drawsPerTask, drawCount);
+        results.push_back(threadPool.submit(
+            [this, &renderQueue, &commandBuffers, task, first, last]()
+            {
+                VkCommandBuffer commandBuffer = acquireCommandBuffer(WrpThreadPool::currentWorkerIndex() + 1);
+                wrpRenderer.beginSecondaryCommandBuffer(commandBuffer);
+                // each range binds the state of its first draw, the secondary buffers don't inherit it
+                WrpRenderQueue::BindCounts counts = renderQueue.recordRange(commandBuffer, first, last);
+                if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+                {
+                    throw std::runtime_error("Failed to record secondary command buffer!");
+                }
+                commandBuffers[task] = commandBuffer;
+                return counts;
+            }));
+    }
+
+    // get() rethrows the exceptions of the jobs, all of them are waited first so none still uses the queue
+    for (auto& result : results) {
+        result.wait();
+    }
+    for (auto& result : results) {
+        renderQueue.addStatistics(result.get());
+    }
+
+    vkCmdExecuteCommands(primaryCommandBuffer, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+}
+
+void WrpParallelRecorder::recordOnMainThread(VkCommandBuffer primaryCommandBuffer,
+    const std::function<void(VkCommandBuffer)>& recordCommands)
+{
+    VkCommandBuffer commandBuffer = acquireCommandBuffer(0);
+    wrpRenderer.beginSecondaryCommandBuffer(commandBuffer);
+    recordCommands(commandBuffer);
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to record secondary command buffer!");
+    }
+    vkCmdExecuteCommands(primaryCommandBuffer, 1, &commandBuffer);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Device.hpp"
+#include "Renderer.hpp"
+#include "RenderQueue.hpp"
+#include "ThreadPool.hpp"
+
+// libs
+#include <vulkan/vulkan.h>
+
+// std
+#include <functional>
+#include <vector>
+
+// Records the sorted draws of a WrpRenderQueue into secondary command buffers on a pool of worker threads
+// and executes them in the primary command buffer in the order of the queue.
+// Command pools can't be used by several threads at once, so every frame in flight has a pool per thread
+// (the main thread and the workers); the pools of a frame are reset by beginFrame(), when its fence has been waited.
+class WrpParallelRecorder
+{
+public:
+    // threadCount == 0 means one thread per hardware thread
+    WrpParallelRecorder(WrpDevice& device, WrpRenderer& renderer, unsigned int threadCount = 0);
+    ~WrpParallelRecorder();
+
+    WrpParallelRecorder(const WrpParallelRecorder&) = delete;
+    WrpParallelRecorder& operator=(const WrpParallelRecorder&) = delete;
+
+    // called after WrpRenderer::beginFrame(), the secondary command buffers of the frame are reused
+    void beginFrame(int frameIndex);
+
+    // The render pass must be begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS. The draws are split into
+    // up to taskCount ranges, which are recorded in parallel; the queue's bind statistics get their counts.
+    void record(VkCommandBuffer primaryCommandBuffer, WrpRenderQueue& renderQueue, unsigned int taskCount);
+    // records the commands of the calling thread (GUI) into a secondary command buffer and executes it
+    void recordOnMainThread(VkCommandBuffer primaryCommandBuffer, const std::function<void(VkCommandBuffer)>& recordCommands);
+
+    unsigned int getThreadCount() const { return threadPool.getThreadCount(); }
+
+private:
+    // the ranges are not made shorter, recording fewer draws doesn't pay for the job and the command buffer
+    static constexpr uint32_t MIN_DRAWS_PER_TASK = 128;
+
+    struct ThreadCommands
+    {
+        VkCommandPool commandPool = VK_NULL_HANDLE;
+        std::vector<VkCommandBuffer> commandBuffers;
+        size_t usedCount = 0;
+    };
+
+    void createThreadCommands(ThreadCommands& threadCommands);
+    // index 0 is the main thread, i + 1 - the worker i
+    VkCommandBuffer acquireCommandBuffer(unsigned int threadIndex);
+
+    WrpDevice& wrpDevice;
+    WrpRenderer& wrpRenderer;
+    WrpThreadPool threadPool;
+
+    std::vector<std::vector<ThreadCommands>> frames; // [frame in flight][thread]
+    int currentFrameIndex = -1;
+};
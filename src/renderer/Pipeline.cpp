@@ -13,10 +13,10 @@ WrpPipeline::WrpPipeline(
     const std::string& vertFilepath,
     const std::string& fragFilepath,
     PipelineConfigInfo& configInfo,
-    ShaderModule* vertShaderModule,
-    ShaderModule* fragShaderModule) : wrpDevice(device)
+    std::shared_ptr<ShaderModule> vertShaderModule,
+    std::shared_ptr<ShaderModule> fragShaderModule) : wrpDevice(device)
 {
-    createGraphicsPipeline(vertFilepath, fragFilepath, configInfo, vertShaderModule, fragShaderModule);
+    createGraphicsPipeline(vertFilepath, fragFilepath, configInfo, std::move(vertShaderModule), std::move(fragShaderModule));
 }
 
 WrpPipeline::~WrpPipeline()
@@ -28,21 +28,21 @@ void WrpPipeline::createGraphicsPipeline(
     const std::string& vertFilepath,
     const std::string& fragFilepath,
     PipelineConfigInfo& configInfo,
-    ShaderModule* vertShaderModule,
-    ShaderModule* fragShaderModule)
+    std::shared_ptr<ShaderModule> vertShaderModule,
+    std::shared_ptr<ShaderModule> fragShaderModule)
 {
     // Явные проверки на наличие объектов pipelineLayout и renderPass в структуре конфигурационной информации (configInfo)
     assert(configInfo.pipelineLayout != VK_NULL_HANDLE && "Cannot create graphics pipeline: no pipelineLayout provided in configInfo");
     assert(configInfo.renderPass != VK_NULL_HANDLE && "Cannot create graphics pipeline: no renderPass provided in configInfo");
     std::cout << "Graphics Pipeline is creating..." << std::endl;
 
-    // создание шейдерных модулей, если они не были переданы
+    // получение шейдерных модулей, если они не были переданы (одинаковые шейдеры переиспользуются через кэш модулей)
     if (!vertShaderModule) {
-        vertShaderModule = new ShaderModule(wrpDevice, vertFilepath);
+        vertShaderModule = ShaderModule::create(wrpDevice, vertFilepath);
         std::cout << "Vertex Shader Code Size: " << vertShaderModule->getSourceSizeInBytes() << std::endl;
     }
     if (!fragShaderModule) {
-        fragShaderModule = new ShaderModule(wrpDevice, fragFilepath);
+        fragShaderModule = ShaderModule::create(wrpDevice, fragFilepath);
         std::cout << "Fragment Shader Code Size: " << fragShaderModule->getSourceSizeInBytes() << std::endl;
     }
 
@@ -65,6 +65,16 @@ void WrpPipeline::createGraphicsPipeline(
     shaderStages[1].pNext = nullptr;
     shaderStages[1].pSpecializationInfo = nullptr;
 
+    VkSpecializationInfo fragSpecializationInfo{};
+    if (!configInfo.fragSpecializationEntries.empty())
+    {
+        fragSpecializationInfo.mapEntryCount = static_cast<uint32_t>(configInfo.fragSpecializationEntries.size());
+        fragSpecializationInfo.pMapEntries = configInfo.fragSpecializationEntries.data();
+        fragSpecializationInfo.dataSize = configInfo.fragSpecializationData.size();
+        fragSpecializationInfo.pData = configInfo.fragSpecializationData.data();
+        shaderStages[1].pSpecializationInfo = &fragSpecializationInfo;
+    }
+
     // Получение структур с описанием привязок и атрибутов Vertex Buffer'а(ов). Они используются дальше при описании VertexInput этапа.
     auto& bindingDescriptions = configInfo.bindingDescriptions;
     auto& attributeDescriptions = configInfo.attributeDescriptions;
@@ -110,7 +120,7 @@ void WrpPipeline::createGraphicsPipeline(
     pipelineInfo.flags = 0; // два поля выше исп., если задать флаг VK_PIPELINE_CREATE_DERIVATIVE_BIT
 
     if (vkCreateGraphicsPipelines(wrpDevice.device(),
-        VK_NULL_HANDLE,
+        configInfo.pipelineCache != VK_NULL_HANDLE ? configInfo.pipelineCache : wrpDevice.getPipelineCache(),
         1, &pipelineInfo,
         nullptr,
         &graphicsPipeline) != VK_SUCCESS)
@@ -118,9 +128,10 @@ void WrpPipeline::createGraphicsPipeline(
         throw std::runtime_error("Failed to create graphics pipeline");
     }
 
-    // Шейдерные модули можно освободить сразу после создания пайплайна, т.к. шейдеры уже скомпилированы
-    delete vertShaderModule;
-    delete fragShaderModule;
+    // Модули удерживаются пайплайном, чтобы другие пайплайны с теми же шейдерами получали их из кэша модулей,
+    // а не создавали заново. Модуль уничтожается вместе с последним использующим его пайплайном.
+    vertModule = std::move(vertShaderModule);
+    fragModule = std::move(fragShaderModule);
 }
 
 void WrpPipeline::bind(VkCommandBuffer commandBuffer)
@@ -243,3 +254,36 @@ void WrpPipeline::enableAlphaBlending(PipelineConfigInfo & configInfo)
     configInfo.colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;  // не исп.
     configInfo.colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;              // не исп.
 }
+
+WrpComputePipeline::WrpComputePipeline(WrpDevice& device, const std::string& compFilepath, VkPipelineLayout pipelineLayout)
+    : wrpDevice{device}
+{
+    compModule = ShaderModule::create(wrpDevice, compFilepath);
+
+    VkPipelineShaderStageCreateInfo shaderStage{};
+    shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    shaderStage.module = compModule->shaderModule;
+    shaderStage.pName = "main";
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage = shaderStage;
+    pipelineInfo.layout = pipelineLayout;
+
+    if (vkCreateComputePipelines(wrpDevice.device(), wrpDevice.getPipelineCache(), 1, &pipelineInfo,
+        nullptr, &computePipeline) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create compute pipeline");
+    }
+}
+
+WrpComputePipeline::~WrpComputePipeline()
+{
+    vkDestroyPipeline(wrpDevice.device(), computePipeline, nullptr);
+}
+
+void WrpComputePipeline::bind(VkCommandBuffer commandBuffer)
+{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+}
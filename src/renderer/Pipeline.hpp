@@ -4,7 +4,10 @@
 #include "ShaderModule.hpp"
 
 // std
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 // Структура для хранения данных для конфигурирования пайплайна. Структура доступна
@@ -32,6 +35,26 @@ struct PipelineConfigInfo
     VkPipelineLayout pipelineLayout = nullptr;
     VkRenderPass renderPass = nullptr;				// определяет структуру подпроходов рендера (их вложения (attachments))
     uint32_t subpass = 0;
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE; // если не задан, используется общий кэш девайса
+
+    // Константы специализации фрагментного шейдера (layout(constant_id = N) const ...).
+    // Позволяют задать значения констант при создании пайплайна без перекомпиляции шейдера.
+    std::vector<VkSpecializationMapEntry> fragSpecializationEntries{};
+    std::vector<uint8_t> fragSpecializationData{};
+
+    template <typename T>
+    void addFragSpecializationConstant(uint32_t constantId, const T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "Specialization constant must be a scalar value");
+        VkSpecializationMapEntry entry{};
+        entry.constantID = constantId;
+        entry.offset = static_cast<uint32_t>(fragSpecializationData.size());
+        entry.size = sizeof(T);
+        fragSpecializationEntries.push_back(entry);
+
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+        fragSpecializationData.insert(fragSpecializationData.end(), bytes, bytes + sizeof(T));
+    }
 };
 
 class WrpPipeline
@@ -42,8 +65,8 @@ public:
         const std::string& vertFilepath,
         const std::string& fragFilepath,
         PipelineConfigInfo& configInfo,
-        ShaderModule* vertShaderModule = nullptr,
-        ShaderModule* fragShaderModule = nullptr);
+        std::shared_ptr<ShaderModule> vertShaderModule = nullptr,
+        std::shared_ptr<ShaderModule> fragShaderModule = nullptr);
 
     ~WrpPipeline();
 
@@ -52,6 +75,7 @@ public:
     WrpPipeline& operator=(const WrpPipeline&) = delete;
 
     void bind(VkCommandBuffer commandBuffer);
+    VkPipeline getPipeline() const { return graphicsPipeline; }
 
     static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
     static void enableAlphaBlending(PipelineConfigInfo& configInfo);
@@ -61,10 +85,30 @@ private:
         const std::string& vertFilepath,
         const std::string& fragFilepath,
         PipelineConfigInfo& configInfo,
-        ShaderModule* vertShaderModule = nullptr,
-        ShaderModule* fragShaderModule = nullptr
+        std::shared_ptr<ShaderModule> vertShaderModule,
+        std::shared_ptr<ShaderModule> fragShaderModule
     );
 
     WrpDevice& wrpDevice;				// девайс
     VkPipeline graphicsPipeline;		// Vulkan Graphics Pipeline (это указатель, сам тип определён через typedef)
+    std::shared_ptr<ShaderModule> vertModule;
+    std::shared_ptr<ShaderModule> fragModule;
+};
+
+// Compute pipeline made of a single compute shader from SHADERS_DIR
+class WrpComputePipeline
+{
+public:
+    WrpComputePipeline(WrpDevice& device, const std::string& compFilepath, VkPipelineLayout pipelineLayout);
+    ~WrpComputePipeline();
+
+    WrpComputePipeline(const WrpComputePipeline&) = delete;
+    WrpComputePipeline& operator=(const WrpComputePipeline&) = delete;
+
+    void bind(VkCommandBuffer commandBuffer);
+
+private:
+    WrpDevice& wrpDevice;
+    VkPipeline computePipeline;
+    std::shared_ptr<ShaderModule> compModule;
 };
@@ -0,0 +1,81 @@
+#include "PipelineCompiler.hpp"
+
+// std
+#include <stdexcept>
+
+WrpPipelineCompiler::WrpPipelineCompiler(WrpDevice& device, unsigned int threadCount)
+    : wrpDevice{device}, threadPool{threadCount}
+{
+    createWorkerCaches();
+}
+
+WrpPipelineCompiler::~WrpPipelineCompiler()
+{
+    threadPool.waitIdle();
+    mergeWorkerCaches(); // errors are ignored here: losing cache data only makes the next start cold
+    for (auto cache : workerCaches) {
+        vkDestroyPipelineCache(wrpDevice.device(), cache, nullptr);
+    }
+}
+
+WrpPipelineCompiler::PipelineFuture WrpPipelineCompiler::compileAsync(
+    const std::string& vertFilepath,
+    const std::string& fragFilepath,
+    ConfigureFn configure,
+    std::shared_ptr<ShaderModule> vertShaderModule,
+    std::shared_ptr<ShaderModule> fragShaderModule)
+{
+    return threadPool.submit(
+        [this, vertFilepath, fragFilepath, configure = std::move(configure),
+         vertShaderModule = std::move(vertShaderModule), fragShaderModule = std::move(fragShaderModule)]() mutable
+        {
+            PipelineConfigInfo configInfo{};
+            configure(configInfo);
+            configInfo.pipelineCache = workerCaches[WrpThreadPool::currentWorkerIndex()];
+            return std::make_unique<WrpPipeline>(wrpDevice, vertFilepath, fragFilepath, configInfo,
+                std::move(vertShaderModule), std::move(fragShaderModule));
+        });
+}
+
+void WrpPipelineCompiler::waitIdle()
+{
+    threadPool.waitIdle();
+    if (mergeWorkerCaches() != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to merge pipeline caches!");
+    }
+}
+
+void WrpPipelineCompiler::createWorkerCaches()
+{
+    // seed every worker cache with the data loaded from disk, so warm starts benefit on all threads
+    size_t dataSize = 0;
+    std::vector<char> initialData;
+    if (vkGetPipelineCacheData(wrpDevice.device(), wrpDevice.getPipelineCache(), &dataSize, nullptr) == VK_SUCCESS && dataSize > 0)
+    {
+        initialData.resize(dataSize);
+        if (vkGetPipelineCacheData(wrpDevice.device(), wrpDevice.getPipelineCache(), &dataSize, initialData.data()) != VK_SUCCESS) {
+            initialData.clear();
+        }
+    }
+
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = initialData.size();
+    cacheInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+
+    workerCaches.resize(threadPool.getThreadCount(), VK_NULL_HANDLE);
+    for (auto& cache : workerCaches)
+    {
+        if (vkCreatePipelineCache(wrpDevice.device(), &cacheInfo, nullptr, &cache) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create worker pipeline cache!");
+        }
+    }
+}
+
+VkResult WrpPipelineCompiler::mergeWorkerCaches()
+{
+    return vkMergePipelineCaches(wrpDevice.device(), wrpDevice.getPipelineCache(),
+        static_cast<uint32_t>(workerCaches.size()), workerCaches.data());
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Device.hpp"
+#include "Pipeline.hpp"
+#include "ShaderModule.hpp"
+#include "ThreadPool.hpp"
+
+// std
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Creates graphics pipelines (including shader compilation) on a pool of worker threads.
+// Every worker has its own VkPipelineCache seeded with the device cache, so threads don't contend on one cache;
+// the per-thread caches are merged back into the device cache by waitIdle(), before it is saved to disk.
+class WrpPipelineCompiler
+{
+public:
+    using PipelineFuture = std::future<std::unique_ptr<WrpPipeline>>;
+    // fills PipelineConfigInfo on the worker thread (the struct is not copyable and holds pointers to itself)
+    using ConfigureFn = std::function<void(PipelineConfigInfo&)>;
+
+    // threadCount == 0 means one thread per hardware thread
+    WrpPipelineCompiler(WrpDevice& device, unsigned int threadCount = 0);
+    ~WrpPipelineCompiler();
+
+    WrpPipelineCompiler(const WrpPipelineCompiler&) = delete;
+    WrpPipelineCompiler& operator=(const WrpPipelineCompiler&) = delete;
+
+    PipelineFuture compileAsync(
+        const std::string& vertFilepath,
+        const std::string& fragFilepath,
+        ConfigureFn configure,
+        std::shared_ptr<ShaderModule> vertShaderModule = nullptr,
+        std::shared_ptr<ShaderModule> fragShaderModule = nullptr);
+
+    // waits for all submitted jobs and merges the per-thread caches into the device pipeline cache
+    void waitIdle();
+
+    unsigned int getThreadCount() const { return threadPool.getThreadCount(); }
+
+private:
+    void createWorkerCaches();
+    VkResult mergeWorkerCaches();
+
+    WrpDevice& wrpDevice;
+    WrpThreadPool threadPool;
+    std::vector<VkPipelineCache> workerCaches;
+};
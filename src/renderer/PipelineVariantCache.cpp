@@ -0,0 +1,163 @@
+#include "PipelineVariantCache.hpp"
+
+#include "Model.hpp"
+#include "Utils.hpp"
+
+// std
+#include <chrono>
+#include <iterator>
+
+size_t PipelineVariantKeyHash::operator()(const PipelineVariantKey& key) const
+{
+    size_t seed = 0;
+    hashCombine(seed, key.vertShader, key.fragShader, key.pipelineLayout, key.renderPass, key.subpass,
+        static_cast<int>(key.polygonMode), key.hasVertexInput, key.positionOnly, key.alphaBlending, key.colorWrite,
+        key.depthTest, key.depthWrite, static_cast<int>(key.depthCompareOp));
+    for (int32_t constant : key.fragSpecializationConstants) {
+        hashCombine(seed, constant);
+    }
+    return seed;
+}
+
+WrpPipelineVariantCache::WrpPipelineVariantCache(WrpDevice& device, WrpPipelineCompiler& pipelineCompiler,
+    uint32_t framesInFlight, size_t capacity)
+    : wrpDevice{device}, wrpPipelineCompiler{pipelineCompiler}, framesInFlight{framesInFlight}, capacity{capacity}
+{
+}
+
+WrpPipelineVariantCache::~WrpPipelineVariantCache()
+{
+    // pending jobs must not outlive the cache
+    for (auto& kv : entries) {
+        if (kv.second.pending.valid()) kv.second.pending.wait();
+    }
+}
+
+WrpPipeline* WrpPipelineVariantCache::get(const PipelineVariantKey& key)
+{
+    Entry& entry = request(key);
+    touch(entry);
+    if (!entry.pipeline) {
+        entry.pipeline = entry.pending.get();
+    }
+    return entry.pipeline.get();
+}
+
+bool WrpPipelineVariantCache::isReady(const PipelineVariantKey& key)
+{
+    return isEntryReady(request(key));
+}
+
+void WrpPipelineVariantCache::prewarm(const std::vector<PipelineVariantKey>& keys)
+{
+    for (const auto& key : keys) {
+        request(key);
+    }
+}
+
+void WrpPipelineVariantCache::releaseLayout(VkPipelineLayout pipelineLayout)
+{
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        auto next = std::next(it);
+        if (it->first.pipelineLayout == pipelineLayout)
+        {
+            if (it->second.pending.valid()) it->second.pending.wait(); // the job uses the layout
+            isEntryReady(it->second);
+            retire(it);
+        }
+        it = next;
+    }
+}
+
+void WrpPipelineVariantCache::nextFrame()
+{
+    ++frameNumber;
+    std::erase_if(retiredPipelines, [this](const RetiredPipeline& retired) {
+        return retired.destroyFrame <= frameNumber;
+    });
+}
+
+WrpPipelineVariantCache::Entry& WrpPipelineVariantCache::request(const PipelineVariantKey& key)
+{
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+        return it->second;
+    }
+
+    evictIfFull();
+
+    auto configure = [key](PipelineConfigInfo& configInfo) {
+        WrpPipeline::defaultPipelineConfigInfo(configInfo);
+        if (key.alphaBlending) {
+            WrpPipeline::enableAlphaBlending(configInfo);
+        }
+        if (!key.hasVertexInput) {
+            configInfo.bindingDescriptions.clear();
+            configInfo.attributeDescriptions.clear();
+        }
+        else if (key.positionOnly) {
+            configInfo.attributeDescriptions = WrpModel::Vertex::getPositionAttributeDescriptions();
+        }
+        if (!key.colorWrite) {
+            configInfo.colorBlendAttachment.colorWriteMask = 0;
+        }
+        configInfo.pipelineLayout = key.pipelineLayout;
+        configInfo.renderPass = key.renderPass;
+        configInfo.subpass = key.subpass;
+        configInfo.rasterizationInfo.polygonMode = key.polygonMode;
+        configInfo.depthStencilInfo.depthTestEnable = key.depthTest ? VK_TRUE : VK_FALSE;
+        configInfo.depthStencilInfo.depthWriteEnable = key.depthWrite ? VK_TRUE : VK_FALSE;
+        configInfo.depthStencilInfo.depthCompareOp = key.depthCompareOp;
+        for (uint32_t id = 0; id < key.fragSpecializationConstants.size(); ++id) {
+            configInfo.addFragSpecializationConstant(id, key.fragSpecializationConstants[id]);
+        }
+    };
+
+    lru.push_front(key);
+    Entry& entry = entries[key];
+    entry.lruPosition = lru.begin();
+    entry.pending = wrpPipelineCompiler.compileAsync(key.vertShader, key.fragShader, configure);
+    return entry;
+}
+
+bool WrpPipelineVariantCache::isEntryReady(Entry& entry)
+{
+    if (entry.pipeline) return true;
+    if (entry.pending.valid() && entry.pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+        entry.pipeline = entry.pending.get();
+        return true;
+    }
+    return false;
+}
+
+void WrpPipelineVariantCache::touch(Entry& entry)
+{
+    lru.splice(lru.begin(), lru, entry.lruPosition);
+}
+
+void WrpPipelineVariantCache::evictIfFull()
+{
+    // the least recently used variants are at the back; the ones still compiling are kept
+    auto it = lru.end();
+    while (entries.size() >= capacity && it != lru.begin())
+    {
+        --it;
+        auto entryIt = entries.find(*it);
+        if (!isEntryReady(entryIt->second)) continue;
+
+        ++it; // the current list node is erased by retire()
+        retire(entryIt);
+    }
+}
+
+void WrpPipelineVariantCache::retire(std::unordered_map<PipelineVariantKey, Entry, PipelineVariantKeyHash>::iterator entryIt)
+{
+    // the pipeline can still be used by frames in flight
+    if (entryIt->second.pipeline) {
+        retiredPipelines.push_back({std::move(entryIt->second.pipeline), frameNumber + framesInFlight});
+    }
+    lru.erase(entryIt->second.lruPosition);
+    entries.erase(entryIt);
+}
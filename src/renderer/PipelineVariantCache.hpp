@@ -0,0 +1,103 @@
+#pragma once
+
+#include "Device.hpp"
+#include "Pipeline.hpp"
+#include "PipelineCompiler.hpp"
+
+// std
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Everything that makes graphics pipelines of the render systems different.
+// The reflection model is selected by the fragment shader, so it's a part of the shader set.
+struct PipelineVariantKey
+{
+    std::string vertShader;
+    std::string fragShader;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    uint32_t subpass = 0;
+    VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+    bool hasVertexInput = true;    // false for the pipelines generating vertices in shader (billboards)
+    bool positionOnly = false;     // only the position attribute of the vertices is read (depth pre-pass)
+    bool alphaBlending = false;
+    bool colorWrite = true;
+    bool depthTest = true;
+    bool depthWrite = true;
+    VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
+    std::vector<int32_t> fragSpecializationConstants{}; // value of constant_id = i is at index i
+
+    bool operator==(const PipelineVariantKey& other) const = default;
+};
+
+struct PipelineVariantKeyHash
+{
+    size_t operator()(const PipelineVariantKey& key) const;
+};
+
+// Cache of the pipeline variants shared by render systems. A variant is created lazily on the first request
+// (or in background by prewarm()) and stays in the cache, so switching render states back and forth
+// doesn't recreate pipelines and doesn't stall the GPU queue.
+// When the cache is full, the least recently used variant is evicted; its pipeline is destroyed only after
+// all frames in flight which could use it are finished.
+class WrpPipelineVariantCache
+{
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 64;
+
+    WrpPipelineVariantCache(WrpDevice& device, WrpPipelineCompiler& pipelineCompiler,
+        uint32_t framesInFlight, size_t capacity = DEFAULT_CAPACITY);
+    ~WrpPipelineVariantCache();
+
+    WrpPipelineVariantCache(const WrpPipelineVariantCache&) = delete;
+    WrpPipelineVariantCache& operator=(const WrpPipelineVariantCache&) = delete;
+
+    // returns the pipeline of the variant, waiting for its creation if needed
+    WrpPipeline* get(const PipelineVariantKey& key);
+    // Checks whether the variant can be bound without waiting. A missing variant is requested, so a caller can keep
+    // binding the previous variant for a few frames while the new one is compiling in background.
+    bool isReady(const PipelineVariantKey& key);
+    // starts background creation of the variants that are not in the cache yet
+    void prewarm(const std::vector<PipelineVariantKey>& keys);
+    // Removes the variants created with the layout, which is going to be destroyed. Otherwise a new layout
+    // with the same handle value could match the stale variants.
+    void releaseLayout(VkPipelineLayout pipelineLayout);
+    // must be called once per frame: destroys the evicted pipelines that are not used by frames in flight anymore
+    void nextFrame();
+
+    size_t getSize() const { return entries.size(); }
+
+private:
+    struct Entry
+    {
+        std::unique_ptr<WrpPipeline> pipeline;
+        WrpPipelineCompiler::PipelineFuture pending;
+        std::list<PipelineVariantKey>::iterator lruPosition;
+    };
+
+    struct RetiredPipeline
+    {
+        std::unique_ptr<WrpPipeline> pipeline;
+        uint64_t destroyFrame;
+    };
+
+    Entry& request(const PipelineVariantKey& key);
+    bool isEntryReady(Entry& entry);
+    void retire(std::unordered_map<PipelineVariantKey, Entry, PipelineVariantKeyHash>::iterator entryIt);
+    void touch(Entry& entry);
+    void evictIfFull();
+
+    WrpDevice& wrpDevice;
+    WrpPipelineCompiler& wrpPipelineCompiler;
+    uint32_t framesInFlight;
+    size_t capacity;
+    uint64_t frameNumber = 0;
+
+    std::unordered_map<PipelineVariantKey, Entry, PipelineVariantKeyHash> entries;
+    std::list<PipelineVariantKey> lru; // the most recently used variant is at the front
+    std::vector<RetiredPipeline> retiredPipelines;
+};
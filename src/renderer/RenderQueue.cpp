@@ -0,0 +1,245 @@
+#include "RenderQueue.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+uint64_t WrpRenderQueue::makeSortKey(uint32_t pass, uint32_t pipelineId, uint32_t materialId, uint32_t modelId,
+    uint32_t depth)
+{
+    uint64_t key = pass;
+    key = (key << PIPELINE_BITS) | (pipelineId & ((1u << PIPELINE_BITS) - 1));
+    key = (key << MATERIAL_BITS) | (materialId & ((1u << MATERIAL_BITS) - 1));
+    key = (key << MODEL_BITS) | (modelId & ((1u << MODEL_BITS) - 1));
+    key = (key << DEPTH_BITS) | (depth & ((1u << DEPTH_BITS) - 1));
+    return key;
+}
+
+uint32_t WrpRenderQueue::frontToBackDepth(float distance)
+{
+    // positive floats compare like their bit patterns; the sign bit is dropped, 8 bits of the exponent
+    // and 7 bits of the mantissa are kept
+    uint32_t bits = 0;
+    float value = std::max(distance, 0.f);
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits >> (32 - DEPTH_BITS - 1);
+}
+
+uint32_t WrpRenderQueue::backToFrontDepth(float distance)
+{
+    return ((1u << DEPTH_BITS) - 1) - frontToBackDepth(distance);
+}
+
+uint32_t WrpRenderQueue::stateId(std::unordered_map<const void*, uint32_t>& ids, const void* state, uint32_t bits)
+{
+    // the destroyed objects keep their ids, so the ids are reassigned when they run out
+    if (ids.size() >= (1u << bits) && ids.find(state) == ids.end()) {
+        ids.clear();
+    }
+    auto result = ids.emplace(state, static_cast<uint32_t>(ids.size()));
+    return result.first->second;
+}
+
+void WrpRenderQueue::submit(const WrpDrawItem& item, const void* pushConstants)
+{
+    assert(item.descriptorSetCount <= WrpDrawItem::MAX_DESCRIPTOR_SETS && "Too many descriptor sets");
+    assert((item.pushConstantSize == 0 || pushConstants != nullptr) && "Push constants data is missing");
+
+    items.push_back(item);
+    pushConstantOffsets.push_back(static_cast<uint32_t>(pushConstantData.size()));
+    if (item.pushConstantSize > 0)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(pushConstants);
+        pushConstantData.insert(pushConstantData.end(), bytes, bytes + item.pushConstantSize);
+    }
+}
+
+void WrpRenderQueue::clear()
+{
+    items.clear();
+    pushConstantOffsets.clear();
+    pushConstantData.clear();
+    order.clear();
+}
+
+void WrpRenderQueue::resetStatistics()
+{
+    bindCount = 0;
+    skippedBindCount = 0;
+}
+
+// LSD radix sort with 8-bit digits. The passes where all keys have the same digit are skipped, usually
+// most of the upper bits are the same (a couple of passes and pipelines).
+void WrpRenderQueue::sort()
+{
+    size_t count = items.size();
+    order.resize(count);
+    orderScratch.resize(count);
+    keys.resize(count);
+    keysScratch.resize(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        order[i] = static_cast<uint32_t>(i);
+        keys[i] = items[i].sortKey;
+    }
+
+    for (uint32_t shift = 0; shift < 64; shift += 8)
+    {
+        std::array<uint32_t, 256> offsets{};
+        for (uint64_t key : keys) {
+            ++offsets[(key >> shift) & 0xFF];
+        }
+        if (count == 0 || offsets[(keys[0] >> shift) & 0xFF] == count) continue;
+
+        uint32_t sum = 0;
+        for (uint32_t& offset : offsets)
+        {
+            uint32_t digitCount = offset;
+            offset = sum;
+            sum += digitCount;
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint32_t position = offsets[(keys[i] >> shift) & 0xFF]++;
+            keysScratch[position] = keys[i];
+            orderScratch[position] = order[i];
+        }
+        keys.swap(keysScratch);
+        order.swap(orderScratch);
+    }
+}
+
+void WrpRenderQueue::record(VkCommandBuffer commandBuffer)
+{
+    addStatistics(recordRange(commandBuffer, 0, size()));
+}
+
+void WrpRenderQueue::addStatistics(const BindCounts& counts)
+{
+    bindCount += counts.binds;
+    skippedBindCount += counts.skippedBinds;
+}
+
+WrpRenderQueue::BindCounts WrpRenderQueue::recordRange(VkCommandBuffer commandBuffer, uint32_t first, uint32_t last) const
+{
+    assert(order.size() == items.size() && "The queue must be sorted before recording");
+    assert(first <= last && last <= order.size() && "Invalid range of draws");
+
+    BindCounts counts{};
+    VkPipeline boundPipeline = VK_NULL_HANDLE;
+    VkPipelineLayout boundLayout = VK_NULL_HANDLE;
+    std::array<VkDescriptorSet, WrpDrawItem::MAX_DESCRIPTOR_SETS> boundSets{};
+    std::array<uint32_t, WrpDrawItem::MAX_DESCRIPTOR_SETS> boundOffsets{};
+    WrpModel* boundModel = nullptr;
+    const uint8_t* boundPushConstants = nullptr;
+    uint32_t boundPushConstantSize = 0;
+    VkShaderStageFlags boundPushConstantStages = 0;
+
+    for (uint32_t position = first; position < last; ++position)
+    {
+        uint32_t index = order[position];
+        const WrpDrawItem& item = items[index];
+
+        if (item.pipeline != boundPipeline)
+        {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, item.pipeline);
+            boundPipeline = item.pipeline;
+            ++counts.binds;
+        }
+        else {
+            ++counts.skippedBinds;
+        }
+
+        // the sets and push constants of another layout may be incompatible, they're bound again
+        if (item.pipelineLayout != boundLayout)
+        {
+            boundLayout = item.pipelineLayout;
+            boundSets.fill(VK_NULL_HANDLE);
+            boundPushConstants = nullptr;
+        }
+
+        // the changed sets are bound by ranges of consecutive sets; a set with a dynamic uniform buffer
+        // is changed also by another offset
+        auto setChanged = [&](uint32_t set) {
+            return item.descriptorSets[set] != boundSets[set] ||
+                (((item.dynamicOffsetSets >> set) & 1u) != 0 && item.dynamicOffsets[set] != boundOffsets[set]);
+        };
+        for (uint32_t set = 0; set < item.descriptorSetCount;)
+        {
+            if (!setChanged(set))
+            {
+                ++counts.skippedBinds;
+                ++set;
+                continue;
+            }
+            uint32_t firstSet = set;
+            std::array<uint32_t, WrpDrawItem::MAX_DESCRIPTOR_SETS> offsets;
+            uint32_t offsetCount = 0;
+            while (set < item.descriptorSetCount && setChanged(set))
+            {
+                boundSets[set] = item.descriptorSets[set];
+                if ((item.dynamicOffsetSets >> set) & 1u)
+                {
+                    boundOffsets[set] = item.dynamicOffsets[set];
+                    offsets[offsetCount++] = item.dynamicOffsets[set];
+                }
+                ++set;
+            }
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, item.pipelineLayout,
+                firstSet, set - firstSet, &item.descriptorSets[firstSet], offsetCount, offsets.data());
+            counts.binds += set - firstSet;
+        }
+
+        if (item.model != nullptr)
+        {
+            if (item.model != boundModel)
+            {
+                // прикрепление буфера вершин (модели) и буфера индексов к буферу команд (создание привязки)
+                item.model->bind(commandBuffer);
+                boundModel = item.model;
+                ++counts.binds;
+            }
+            else {
+                ++counts.skippedBinds;
+            }
+        }
+
+        if (item.pushConstantSize > 0)
+        {
+            const uint8_t* pushConstants = pushConstantData.data() + pushConstantOffsets[index];
+            if (boundPushConstants == nullptr || item.pushConstantSize != boundPushConstantSize ||
+                item.pushConstantStages != boundPushConstantStages ||
+                std::memcmp(pushConstants, boundPushConstants, item.pushConstantSize) != 0)
+            {
+                vkCmdPushConstants(commandBuffer, item.pipelineLayout, item.pushConstantStages,
+                    0, item.pushConstantSize, pushConstants);
+                boundPushConstants = pushConstants;
+                boundPushConstantSize = item.pushConstantSize;
+                boundPushConstantStages = item.pushConstantStages;
+                ++counts.binds;
+            }
+            else {
+                ++counts.skippedBinds;
+            }
+        }
+
+        switch (item.command)
+        {
+        case WrpDrawItem::Command::Draw:
+            vkCmdDraw(commandBuffer, item.count, item.instanceCount, item.first, item.firstInstance);
+            break;
+        case WrpDrawItem::Command::DrawIndexed:
+            vkCmdDrawIndexed(commandBuffer, item.count, item.instanceCount, item.first, 0, item.firstInstance);
+            break;
+        case WrpDrawItem::Command::DrawIndexedIndirect:
+            vkCmdDrawIndexedIndirect(commandBuffer, item.indirectBuffer, item.indirectOffset, item.drawCount, item.stride);
+            break;
+        case WrpDrawItem::Command::DrawIndexedIndirectCount:
+            vkCmdDrawIndexedIndirectCountKHR(commandBuffer, item.indirectBuffer, item.indirectOffset,
+                item.countBuffer, item.countOffset, item.drawCount, item.stride);
+            break;
+        }
+    }
+    return counts;
+}
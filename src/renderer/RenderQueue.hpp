@@ -0,0 +1,142 @@
+#pragma once
+
+#include "Model.hpp"
+
+// libs
+#include <vulkan/vulkan.h>
+
+// std
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// A draw with all the state it needs. The state is bound by WrpRenderQueue::record() only if it differs from
+// the state of the previous draw.
+struct WrpDrawItem
+{
+    static constexpr uint32_t MAX_DESCRIPTOR_SETS = 4;
+
+    enum class Command : uint8_t
+    {
+        Draw,
+        DrawIndexed,
+        DrawIndexedIndirect,
+        DrawIndexedIndirectCount
+    };
+
+    uint64_t sortKey = 0; // see WrpRenderQueue::makeSortKey()
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    std::array<VkDescriptorSet, MAX_DESCRIPTOR_SETS> descriptorSets{}; // bound starting from set 0
+    uint32_t descriptorSetCount = 0;
+    // offsets of the dynamic uniform buffers, a set has one if its bit is in dynamicOffsetSets
+    std::array<uint32_t, MAX_DESCRIPTOR_SETS> dynamicOffsets{};
+    uint32_t dynamicOffsetSets = 0;
+    WrpModel* model = nullptr; // vertex and index buffers, nullptr for the draws without vertex input
+    VkShaderStageFlags pushConstantStages = 0;
+    uint32_t pushConstantSize = 0; // the data is passed to WrpRenderQueue::submit()
+
+    Command command = Command::DrawIndexed;
+    uint32_t count = 0;         // vertices or indices
+    uint32_t instanceCount = 1;
+    uint32_t first = 0;         // first vertex or index
+    uint32_t firstInstance = 0;
+    // indirect draws
+    VkBuffer indirectBuffer = VK_NULL_HANDLE;
+    VkDeviceSize indirectOffset = 0;
+    VkBuffer countBuffer = VK_NULL_HANDLE;
+    VkDeviceSize countOffset = 0;
+    uint32_t drawCount = 0;     // the maximum for the count variant
+    uint32_t stride = 0;
+};
+
+// Draws of a render pass instance submitted by the render systems. They're sorted by 64-bit keys,
+// from the most significant bits:
+//  - pass (4 bits): depth pre-pass, then opaque objects, then the translucent ones;
+//  - pipeline (12 bits);
+//  - material (16 bits): descriptor set or another per-draw state of the system;
+//  - model (16 bits): vertex and index buffers;
+//  - depth (16 bits): front to back for the opaque objects (early depth test), back to front for the translucent ones.
+// So the draws sharing a pipeline, material or model follow each other and the recorder skips their binds.
+//
+// Ids of pipelines, materials and models in the keys are assigned by the queue on first use and kept between frames.
+class WrpRenderQueue
+{
+public:
+    enum Pass : uint32_t
+    {
+        PASS_DEPTH_PREPASS = 0,
+        PASS_OPAQUE = 1,
+        PASS_TRANSLUCENT = 2
+    };
+
+    WrpRenderQueue() = default;
+
+    WrpRenderQueue(const WrpRenderQueue&) = delete;
+    WrpRenderQueue& operator=(const WrpRenderQueue&) = delete;
+
+    static uint64_t makeSortKey(uint32_t pass, uint32_t pipelineId, uint32_t materialId, uint32_t modelId, uint32_t depth);
+    // 16-bit depth keys of a distance to the camera: the upper bits of the float, which are ordered like its value
+    static uint32_t frontToBackDepth(float distance);
+    static uint32_t backToFrontDepth(float distance);
+
+    uint32_t pipelineId(VkPipeline pipeline) { return stateId(pipelineIds, pipeline, PIPELINE_BITS); }
+    uint32_t materialId(const void* material) { return stateId(materialIds, material, MATERIAL_BITS); }
+    uint32_t modelId(const WrpModel* model) { return stateId(modelIds, model, MODEL_BITS); }
+
+    // pushConstants points to item.pushConstantSize bytes, they're copied
+    void submit(const WrpDrawItem& item, const void* pushConstants = nullptr);
+    void clear();
+
+    // Radix sort of the submitted draws by their keys. It's stable, the draws with equal keys keep
+    // the submission order.
+    void sort();
+    // Records the sorted draws. The state bound by the previous commands of the command buffer isn't known,
+    // so the state of the first draw is always bound.
+    void record(VkCommandBuffer commandBuffer);
+
+    struct BindCounts
+    {
+        uint32_t binds = 0;
+        uint32_t skippedBinds = 0;
+    };
+    // Records the sorted draws [first, last) the same way. The queue isn't changed, so the ranges can be recorded
+    // into different command buffers by different threads; their counts are then added by addStatistics().
+    BindCounts recordRange(VkCommandBuffer commandBuffer, uint32_t first, uint32_t last) const;
+    void addStatistics(const BindCounts& counts);
+
+    uint32_t size() const { return static_cast<uint32_t>(items.size()); }
+
+    // binds recorded and skipped as redundant since the last resetStatistics(): pipelines, descriptor sets,
+    // vertex and index buffers of the models and push constants
+    uint32_t getBindCount() const { return bindCount; }
+    uint32_t getSkippedBindCount() const { return skippedBindCount; }
+    void resetStatistics();
+
+private:
+    static constexpr uint32_t PIPELINE_BITS = 12;
+    static constexpr uint32_t MATERIAL_BITS = 16;
+    static constexpr uint32_t MODEL_BITS = 16;
+    static constexpr uint32_t DEPTH_BITS = 16;
+
+    static uint32_t stateId(std::unordered_map<const void*, uint32_t>& ids, const void* state, uint32_t bits);
+
+    std::vector<WrpDrawItem> items;
+    std::vector<uint32_t> pushConstantOffsets; // of the items' data in pushConstantData
+    std::vector<uint8_t> pushConstantData;
+
+    // sorted order of the items and the radix sort buffers
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> orderScratch;
+    std::vector<uint64_t> keys;
+    std::vector<uint64_t> keysScratch;
+
+    std::unordered_map<const void*, uint32_t> pipelineIds;
+    std::unordered_map<const void*, uint32_t> materialIds;
+    std::unordered_map<const void*, uint32_t> modelIds;
+
+    uint32_t bindCount = 0;
+    uint32_t skippedBindCount = 0;
+};
@@ -1,4 +1,5 @@
 #include "Renderer.hpp"
+#include "ImageWriter.hpp"
 #include "Utils.hpp"
 
 // std
@@ -6,16 +7,25 @@
 #include <cassert>
 #include <array>
 #include <iostream>
+#include <limits>
+#include <string>
 
-WrpRenderer::WrpRenderer(WrpWindow& window, WrpDevice& device) : wrpWindow{ window }, wrpDevice{ device }
+WrpRenderer::WrpRenderer(WrpWindow& window, WrpDevice& device, uint32_t framesInFlight)
+    : wrpWindow{ window }, wrpDevice{ device }
 {
+    if (framesInFlight < MIN_FRAMES_IN_FLIGHT || framesInFlight > MAX_FRAMES_IN_FLIGHT)
+    {
+        throw std::runtime_error("Frames in flight must be from " + std::to_string(MIN_FRAMES_IN_FLIGHT) +
+            " to " + std::to_string(MAX_FRAMES_IN_FLIGHT) + ", got " + std::to_string(framesInFlight) + "!");
+    }
+
     recreateSwapChain();
-    createCommandBuffers();
+    createFrameResources(framesInFlight);
 }
 
 WrpRenderer::~WrpRenderer()
 {
-    freeCommandBuffers();
+    destroyFrameResources();
 }
 
 void WrpRenderer::recreateSwapChain()
@@ -23,6 +33,10 @@ void WrpRenderer::recreateSwapChain()
     // glfwWaitEvents() waits for the event which cause resize of window when it has no size.
     // It can be helpful for the window minimizing case.
     auto extent = wrpWindow.getExtent();
+    if (wrpWindow.isHeadless() && (extent.width == 0 || extent.height == 0))
+    {
+        throw std::runtime_error("Headless window must have a non-zero size!");
+    }
     while (extent.width == 0 || extent.height == 0)
     {
         extent = wrpWindow.getExtent();
@@ -49,41 +63,71 @@ void WrpRenderer::recreateSwapChain()
     }
 }
 
-void WrpRenderer::createCommandBuffers()
+void WrpRenderer::createFrameResources(uint32_t framesInFlight)
 {
-    // CommandBuffers count are equal to FrameBuffers count
-    commandBuffers.resize(wrpSwapChain->getImageCount());
+    frames.resize(framesInFlight);
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = wrpDevice.getGraphicsQueueFamily();
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // буфер команд перезаписывается каждый кадр
 
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandPool = wrpDevice.getCommandPool();
-    allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+    // the fences are signaled, so the first beginFrame() of every frame doesn't wait
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-    if (vkAllocateCommandBuffers(wrpDevice.device(), &allocInfo, commandBuffers.data()) != VK_SUCCESS)
+    for (FrameResources& frame : frames)
     {
-        throw std::runtime_error("Failed to allocate command buffers!");
+        if (vkCreateCommandPool(wrpDevice.device(), &poolInfo, nullptr, &frame.commandPool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create frame command pool!");
+        }
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = frame.commandPool;
+        allocInfo.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(wrpDevice.device(), &allocInfo, &frame.commandBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to allocate command buffers!");
+        }
+
+        if (createSemaphore(wrpDevice.device(), &frame.imageAvailableSemaphore) != VK_SUCCESS ||
+            vkCreateFence(wrpDevice.device(), &fenceInfo, nullptr, &frame.inFlightFence) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create synchronization objects for a frame!");
+        }
     }
 }
 
-void WrpRenderer::freeCommandBuffers()
+void WrpRenderer::destroyFrameResources()
 {
-    vkFreeCommandBuffers(
-        wrpDevice.device(),
-        wrpDevice.getCommandPool(),
-        static_cast<uint32_t>(commandBuffers.size()),
-        commandBuffers.data()
-    );
-
-    commandBuffers.clear();
+    // the frames still executed by the GPU must finish before their objects are destroyed
+    vkDeviceWaitIdle(wrpDevice.device());
+    for (FrameResources& frame : frames)
+    {
+        vkDestroyFence(wrpDevice.device(), frame.inFlightFence, nullptr);
+        vkDestroySemaphore(wrpDevice.device(), frame.imageAvailableSemaphore, nullptr);
+        // the command buffer is freed with its pool
+        vkDestroyCommandPool(wrpDevice.device(), frame.commandPool, nullptr);
+    }
+    frames.clear();
 }
 
 VkCommandBuffer WrpRenderer::beginFrame()
 {
     assert(!isFrameStarted && "Can't call beginFrame while already in progress.");
 
+    FrameResources& frame = frames[currentFrameIndex];
+
+    // Wait for fence signal when the frame's previous command buffer has executed. After it the frame's command
+    // pool and the per-frame resources of the systems can be reused.
+    vkWaitForFences(wrpDevice.device(), 1, &frame.inFlightFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+
     // currentImageIndex gets index of the next FrameBuffer to render to
-    VkResult result = wrpSwapChain->acquireNextImage(&currentImageIndex);
+    VkResult result = wrpSwapChain->acquireNextImage(frame.imageAvailableSemaphore, &currentImageIndex);
 
     // If result is OUT_OF_DATE, it means surface, that are being rendered to, got changed properties.
     // It can be window size change, for example. In this case SwapChain is recreating with the new extent.
@@ -100,6 +144,7 @@ VkCommandBuffer WrpRenderer::beginFrame()
 
     // Start frame creating in current command buffer
     isFrameStarted = true;
+    vkResetCommandPool(wrpDevice.device(), frame.commandPool, 0);
 
     auto commandBuffer = getCurrentCommandBuffer();
 
@@ -128,7 +173,10 @@ void WrpRenderer::endFrame()
 
     // Отправка буфера команд для соответствующего кадра в очередь на выполнение девайсом (с учётом синхронизации работы CPU и GPU).
     // Команды выполняются и SwapChain предоставляет полученное из Color attachment'а изображение дисплею в нужное время (в зависимости от выбранного PRESENT MODE).
-    auto result = wrpSwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
+    FrameResources& frame = frames[currentFrameIndex];
+    auto result = wrpSwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex,
+        frame.imageAvailableSemaphore, frame.inFlightFence);
+    lastSubmittedImageIndex = static_cast<int>(currentImageIndex);
 
     /* Проверка изменения размеров окна, сброс флага, пересоздание цепи обмена.
        Результат SUBOPTIMAL_KHR указывает на случай, когда свойства поверхности изменились, но SwapChain
@@ -144,10 +192,25 @@ void WrpRenderer::endFrame()
     }
 
     isFrameStarted = false;
-    currentFrameIndex = (currentFrameIndex + 1) % wrpSwapChain->getImageCount(); // выбираем следующий кадр
+    currentFrameIndex = (currentFrameIndex + 1) % static_cast<int>(frames.size()); // выбираем следующий кадр
 }
 
-void WrpRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer, ImVec4 clearColors)
+void WrpRenderer::saveLastFrame(const std::string& path)
+{
+    assert(!isFrameStarted && "Can't save the last frame while a frame is in progress.");
+    if (lastSubmittedImageIndex < 0)
+    {
+        throw std::runtime_error("No frame has been rendered to save!");
+    }
+
+    vkDeviceWaitIdle(wrpDevice.device()); // the frame's image must be fully rendered
+    std::vector<uint8_t> pixels = wrpSwapChain->readImage(static_cast<uint32_t>(lastSubmittedImageIndex));
+    VkExtent2D extent = wrpSwapChain->getSwapChainExtent();
+    writePng(path, extent.width, extent.height, pixels.data());
+    std::cout << "Saved the last frame to " << path << std::endl;
+}
+
+void WrpRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer, ImVec4 clearColors, VkSubpassContents contents)
 {
     assert(isFrameStarted && "Can't call beginSwapChainRenderPass if frame is not in progress");
     assert(commandBuffer == getCurrentCommandBuffer() && "Can't begin render pass on command buffer from a different frame");
@@ -171,8 +234,61 @@ void WrpRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer, ImVec4
     renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
     renderPassInfo.pClearValues = clearValues.data();
 
-    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE); // начинаем проход рендера
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents); // начинаем проход рендера
+
+    // the secondary command buffers set them by themselves, see beginSecondaryCommandBuffer()
+    if (contents == VK_SUBPASS_CONTENTS_INLINE) {
+        setViewportAndScissor(commandBuffer);
+    }
+}
+
+// Continues the frame after beginSwapChainRenderPass() ... endSwapChainRenderPass() and the commands recorded
+// outside of the render pass: the attachments keep the content drawn so far.
+void WrpRenderer::resumeSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents)
+{
+    assert(isFrameStarted && "Can't call resumeSwapChainRenderPass if frame is not in progress");
+    assert(commandBuffer == getCurrentCommandBuffer() && "Can't begin render pass on command buffer from a different frame");
+
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = wrpSwapChain->getLoadRenderPass();
+    renderPassInfo.framebuffer = wrpSwapChain->getFrameBuffer(currentImageIndex);
+    renderPassInfo.renderArea.offset = { 0, 0 };
+    renderPassInfo.renderArea.extent = wrpSwapChain->getSwapChainExtent();
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+    if (contents == VK_SUBPASS_CONTENTS_INLINE) {
+        setViewportAndScissor(commandBuffer);
+    }
+}
+
+void WrpRenderer::beginSecondaryCommandBuffer(VkCommandBuffer commandBuffer)
+{
+    assert(isFrameStarted && "Can't call beginSecondaryCommandBuffer if frame is not in progress");
+
+    // both render passes of the swap chain are compatible, the commands can be executed in any of them
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = wrpSwapChain->getRenderPass();
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = wrpSwapChain->getFrameBuffer(currentImageIndex);
 
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to begin recording secondary command buffer!");
+    }
+
+    // динамическое состояние не наследуется вторичным буфером команд от первичного
+    setViewportAndScissor(commandBuffer);
+}
+
+void WrpRenderer::setViewportAndScissor(VkCommandBuffer commandBuffer)
+{
     /* Ширина и высота изображения берутся из SwapChain, т.к. они могут отличаться от ширины и высоты из окна WrpWindow.
        Например, такой эффект есть при использовании Retina дисплеев (Apple), у которых высокая плотность пикселей.
        Перезаписываясь каждый кадр, динамические Viewport и Scissor всегда получают корректное значение ширины и высоты окна.*/
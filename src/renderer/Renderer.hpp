@@ -10,26 +10,52 @@
 // std
 #include <cassert>
 #include <memory>
+#include <string>
 #include <vector>
 
+// Records and submits the frames into the swap chain images. The number of frames in flight - frames recorded
+// by the CPU while the GPU still executes the previous ones - is set explicitly and doesn't depend on the number
+// of images the driver has created: more frames trade latency and memory for throughput. Every frame in flight
+// has its own command pool, command buffer, image acquisition semaphore and fence; the per-frame resources of
+// the systems are indexed by getFrameIndex() and sized by getFramesInFlight().
 class WrpRenderer
 {
 public:
-    WrpRenderer(WrpWindow& window, WrpDevice& device);
+    static constexpr uint32_t MIN_FRAMES_IN_FLIGHT = 1;
+    static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 3;
+    static constexpr uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+
+    WrpRenderer(WrpWindow& window, WrpDevice& device, uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT);
     ~WrpRenderer();
 
     WrpRenderer(const WrpRenderer&) = delete;
     WrpRenderer& operator=(const WrpRenderer&) = delete;
 
     VkRenderPass getSwapChainRenderPass() const { return wrpSwapChain->getRenderPass(); }
-    uint32_t getSwapChainImageCount() const { return wrpSwapChain->getImageCount(); }
+    VkExtent2D getSwapChainExtent() const { return wrpSwapChain->getSwapChainExtent(); }
+    VkFormat getDepthFormat() const { return wrpSwapChain->getDepthFormat(); }
+    VkSampleCountFlagBits getSampleCount() const { return wrpSwapChain->getSampleCount(); }
+    uint32_t getSwapChainImageCount() const { return static_cast<uint32_t>(wrpSwapChain->getImageCount()); }
+    uint32_t getFramesInFlight() const { return static_cast<uint32_t>(frames.size()); }
     float getAspectRatio() const {return wrpSwapChain->extentAspectRatio();}
     bool isFrameInProgress() const { return isFrameStarted; }
 
     VkCommandBuffer getCurrentCommandBuffer() const
     {
         assert(isFrameStarted && "Cannot get command buffer when frame not in progress");
-        return commandBuffers[currentFrameIndex];
+        return frames[currentFrameIndex].commandBuffer;
+    }
+
+    // depth attachment of the frame being recorded
+    VkImage getCurrentDepthImage() const
+    {
+        assert(isFrameStarted && "Cannot get depth image when frame not in progress");
+        return wrpSwapChain->getDepthImage(currentImageIndex);
+    }
+    VkImageView getCurrentDepthImageView() const
+    {
+        assert(isFrameStarted && "Cannot get depth image view when frame not in progress");
+        return wrpSwapChain->getDepthImageView(currentImageIndex);
     }
 
     int getFrameIndex() const
@@ -40,20 +66,43 @@ public:
 
     VkCommandBuffer beginFrame();
     void endFrame();
-    void beginSwapChainRenderPass(VkCommandBuffer commandBuffer, ImVec4 clearColors);
+    // With VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS the render pass is recorded by the secondary command
+    // buffers begun by beginSecondaryCommandBuffer() and executed by vkCmdExecuteCommands().
+    void beginSwapChainRenderPass(VkCommandBuffer commandBuffer, ImVec4 clearColors,
+        VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+    // Begins the render pass again after endSwapChainRenderPass(), keeping the color and depth drawn so far.
+    // Depth must be in VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL again if it was transitioned in between.
+    void resumeSwapChainRenderPass(VkCommandBuffer commandBuffer,
+        VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
     void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
+    // Begins a secondary command buffer continuing the swap chain render pass of the current frame and sets
+    // its viewport and scissor. It can be called from any thread while the frame is recorded.
+    void beginSecondaryCommandBuffer(VkCommandBuffer commandBuffer);
+
+    // Headless mode only: waits for the GPU and writes the image of the last submitted frame as a PNG file.
+    void saveLastFrame(const std::string& path);
 
 private:
-    void createCommandBuffers();
-    void freeCommandBuffers();
+    struct FrameResources
+    {
+        VkCommandPool commandPool = VK_NULL_HANDLE; // reset as a whole when the frame begins
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkSemaphore imageAvailableSemaphore = VK_NULL_HANDLE;
+        VkFence inFlightFence = VK_NULL_HANDLE; // signaled when the frame's commands have been executed
+    };
+
+    void createFrameResources(uint32_t framesInFlight);
+    void destroyFrameResources();
     void recreateSwapChain();
+    void setViewportAndScissor(VkCommandBuffer commandBuffer);
 
     WrpWindow& wrpWindow;
     WrpDevice& wrpDevice;
     std::unique_ptr<WrpSwapChain> wrpSwapChain;
-    std::vector<VkCommandBuffer> commandBuffers;
+    std::vector<FrameResources> frames;
 
     uint32_t currentImageIndex;
-    int currentFrameIndex{ 0 };           // [0, Max_Frames_In_Flight]
+    int lastSubmittedImageIndex{ -1 };    // -1 until the first frame is submitted
+    int currentFrameIndex{ 0 };           // [0, getFramesInFlight())
     bool isFrameStarted{ false };
 };
@@ -0,0 +1,299 @@
+#include "Scene.hpp"
+
+// std
+#include <cassert>
+#include <stdexcept>
+
+WrpEntity WrpScene::createEntity(std::string name)
+{
+    uint32_t index;
+    if (!freeIndices.empty())
+    {
+        index = freeIndices.back();
+        freeIndices.pop_back();
+    }
+    else
+    {
+        index = static_cast<uint32_t>(generations.size());
+        if (index > ENTITY_INDEX_MASK) {
+            throw std::runtime_error("Too many scene entities!");
+        }
+        generations.push_back(0);
+        names.emplace_back();
+    }
+
+    WrpEntity entity = (static_cast<uint32_t>(generations[index]) << ENTITY_INDEX_BITS) | index;
+    names[index] = std::move(name);
+    names[index].append(std::to_string(index));
+    transforms.emplace(entity);
+    return entity;
+}
+
+WrpEntity WrpScene::createPointLight(float intensity, float radius, glm::vec3 color)
+{
+    WrpEntity entity = createEntity("PointLight");
+    transforms.get(entity).scale.x = radius;  // радиус видимого билборда сохраняется в X-компоненту scale'а
+    PointLightComponent& pointLight = pointLights.emplace(entity);
+    pointLight.color = color;
+    pointLight.lightIntensity = intensity;
+    return entity;
+}
+
+void WrpScene::destroyEntity(WrpEntity entity)
+{
+    if (!isAlive(entity)) return;
+
+    if (hierarchies.contains(entity))
+    {
+        WrpEntity parent = hierarchies.get(entity).parent;
+        // the component is dropped with the last child if the entity has no parent
+        for (HierarchyComponent* hierarchy = hierarchies.find(entity);
+             hierarchy && hierarchy->firstChild != NULL_ENTITY; hierarchy = hierarchies.find(entity))
+        {
+            setParent(hierarchy->firstChild, parent, true);
+        }
+        setParent(entity, NULL_ENTITY);
+    }
+
+    transforms.remove(entity);
+    models.remove(entity);
+    pointLights.remove(entity);
+
+    uint32_t index = entityIndex(entity);
+    ++generations[index];
+    names[index].clear();
+    freeIndices.push_back(index);
+}
+
+void WrpScene::reserve(size_t entityCount)
+{
+    transforms.reserve(entityCount);
+    generations.reserve(entityCount);
+    names.reserve(entityCount);
+}
+
+const std::string& WrpScene::getName(WrpEntity entity) const
+{
+    assert(isAlive(entity) && "Invalid entity");
+    return names[entityIndex(entity)];
+}
+
+WrpModel* WrpScene::getModel(WrpEntity entity)
+{
+    ModelComponent* component = models.find(entity);
+    return component ? component->model.get() : nullptr;
+}
+
+void WrpScene::setModel(WrpEntity entity, std::shared_ptr<WrpModel> model)
+{
+    assert(isAlive(entity) && "Invalid entity");
+    if (model) models.emplace(entity, std::move(model));
+    else models.remove(entity);
+}
+
+void WrpScene::setParent(WrpEntity entity, WrpEntity parent, bool keepWorldTransform)
+{
+    assert(isAlive(entity) && "Invalid entity");
+    if (parent != NULL_ENTITY)
+    {
+        if (!isAlive(parent)) {
+            throw std::runtime_error("Invalid parent entity!");
+        }
+        if (parent == entity || isAncestor(entity, parent)) {
+            throw std::runtime_error("The parent can't be the entity or its descendant!");
+        }
+    }
+    if (getParent(entity) == parent) return;
+
+    // the world matrix of the last propagation
+    glm::mat4 worldMatrix = transforms.get(entity).modelMatrix();
+
+    if (HierarchyComponent* hierarchy = hierarchies.find(entity); hierarchy && hierarchy->parent != NULL_ENTITY)
+    {
+        WrpEntity oldParent = hierarchy->parent;
+        unlink(entity, *hierarchy);
+        removeIfDetached(oldParent);
+    }
+
+    if (parent != NULL_ENTITY)
+    {
+        // the parent's component is created first, the emplace can move the entity's one
+        if (!hierarchies.contains(parent)) hierarchies.emplace(parent);
+        if (!hierarchies.contains(entity)) hierarchies.emplace(entity);
+
+        HierarchyComponent& parentHierarchy = hierarchies.get(parent);
+        HierarchyComponent& hierarchy = hierarchies.get(entity);
+        hierarchy.parent = parent;
+        hierarchy.previousSibling = parentHierarchy.lastChild;
+        if (parentHierarchy.lastChild != NULL_ENTITY) {
+            hierarchies.get(parentHierarchy.lastChild).nextSibling = entity;
+        }
+        else {
+            parentHierarchy.firstChild = entity;
+        }
+        parentHierarchy.lastChild = entity;
+    }
+    else {
+        removeIfDetached(entity);
+    }
+
+    TransformComponent& transform = transforms.get(entity);
+    transform.hasParent = parent != NULL_ENTITY;
+    if (keepWorldTransform)
+    {
+        transform.fromModelMatrix(parent != NULL_ENTITY
+            ? glm::inverse(transforms.get(parent).modelMatrix()) * worldMatrix
+            : worldMatrix);
+    }
+    else {
+        resetToLocal(transform);
+    }
+    hierarchyChanged = true;
+}
+
+WrpEntity WrpScene::getParent(WrpEntity entity) const
+{
+    const HierarchyComponent* hierarchy = hierarchies.find(entity);
+    return hierarchy ? hierarchy->parent : NULL_ENTITY;
+}
+
+WrpEntity WrpScene::getFirstChild(WrpEntity entity) const
+{
+    const HierarchyComponent* hierarchy = hierarchies.find(entity);
+    return hierarchy ? hierarchy->firstChild : NULL_ENTITY;
+}
+
+WrpEntity WrpScene::getNextSibling(WrpEntity entity) const
+{
+    const HierarchyComponent* hierarchy = hierarchies.find(entity);
+    return hierarchy ? hierarchy->nextSibling : NULL_ENTITY;
+}
+
+bool WrpScene::isAncestor(WrpEntity ancestor, WrpEntity entity) const
+{
+    for (WrpEntity parent = getParent(entity); parent != NULL_ENTITY; parent = getParent(parent)) {
+        if (parent == ancestor) return true;
+    }
+    return false;
+}
+
+void WrpScene::unlink(WrpEntity entity, HierarchyComponent& hierarchy)
+{
+    HierarchyComponent& parentHierarchy = hierarchies.get(hierarchy.parent);
+    if (hierarchy.previousSibling != NULL_ENTITY) {
+        hierarchies.get(hierarchy.previousSibling).nextSibling = hierarchy.nextSibling;
+    }
+    else {
+        parentHierarchy.firstChild = hierarchy.nextSibling;
+    }
+    if (hierarchy.nextSibling != NULL_ENTITY) {
+        hierarchies.get(hierarchy.nextSibling).previousSibling = hierarchy.previousSibling;
+    }
+    else {
+        parentHierarchy.lastChild = hierarchy.previousSibling;
+    }
+    hierarchy.parent = NULL_ENTITY;
+    hierarchy.nextSibling = NULL_ENTITY;
+    hierarchy.previousSibling = NULL_ENTITY;
+}
+
+void WrpScene::removeIfDetached(WrpEntity entity)
+{
+    const HierarchyComponent* hierarchy = hierarchies.find(entity);
+    if (hierarchy && hierarchy->parent == NULL_ENTITY && hierarchy->firstChild == NULL_ENTITY) {
+        hierarchies.remove(entity);
+    }
+}
+
+void WrpScene::resetToLocal(TransformComponent& transform)
+{
+    transform.updateMatrices(glm::sin(transform.rotation), glm::cos(transform.rotation));
+}
+
+void WrpScene::rebuildHierarchy()
+{
+    hierarchyNodes.clear();
+    const std::vector<WrpEntity>& entities = hierarchies.entities();
+    for (size_t i = 0; i < entities.size(); ++i)
+    {
+        if (hierarchies.data()[i].parent != NULL_ENTITY) continue;
+
+        // depth first from every root; the children are pushed from the last one, so they are visited in order
+        hierarchyStack.emplace_back(entities[i], NO_PARENT);
+        while (!hierarchyStack.empty())
+        {
+            auto [entity, parentNode] = hierarchyStack.back();
+            hierarchyStack.pop_back();
+
+            uint32_t node = static_cast<uint32_t>(hierarchyNodes.size());
+            HierarchyNode& hierarchyNode = hierarchyNodes.emplace_back();
+            hierarchyNode.entity = entity;
+            hierarchyNode.parent = parentNode;
+
+            // the cached matrices of the children may be world ones of the old structure
+            if (parentNode != NO_PARENT) {
+                resetToLocal(transforms.get(entity));
+            }
+
+            for (WrpEntity child = hierarchies.get(entity).lastChild; child != NULL_ENTITY;
+                 child = hierarchies.get(child).previousSibling)
+            {
+                hierarchyStack.emplace_back(child, node);
+            }
+        }
+    }
+}
+
+uint32_t WrpScene::updateWorldTransforms()
+{
+    // after a change of the structure every node is rebuilt
+    bool rebuildAll = hierarchyChanged;
+    if (hierarchyChanged)
+    {
+        rebuildHierarchy();
+        hierarchyChanged = false;
+    }
+
+    uint32_t updatedCount = 0;
+    for (HierarchyNode& node : hierarchyNodes)
+    {
+        TransformComponent& transform = transforms.get(node.entity);
+        // a changed transform has its local matrices cached, the ones propagated before are recorded by the version
+        const glm::mat4& modelMatrix = transform.modelMatrix();
+        bool localChanged = rebuildAll || transform.version != node.transformVersion;
+
+        if (node.parent == NO_PARENT)
+        {
+            // the root's local matrices are the world ones
+            if (localChanged)
+            {
+                node.worldMatrix = modelMatrix;
+                node.worldNormalMatrix = transform.cachedNormalMatrix;
+            }
+            node.changed = localChanged;
+        }
+        else
+        {
+            if (localChanged)
+            {
+                node.localMatrix = modelMatrix;
+                node.localNormalMatrix = transform.cachedNormalMatrix;
+            }
+
+            const HierarchyNode& parentNode = hierarchyNodes[node.parent];
+            node.changed = localChanged || parentNode.changed;
+            if (node.changed)
+            {
+                // the inverse transpose of the product is the product of the inverse transposes
+                node.worldMatrix = parentNode.worldMatrix * node.localMatrix;
+                node.worldNormalMatrix = parentNode.worldNormalMatrix * node.localNormalMatrix;
+                transform.cachedModelMatrix = node.worldMatrix;
+                transform.cachedNormalMatrix = node.worldNormalMatrix;
+                ++transform.version;
+                ++updatedCount;
+            }
+        }
+        node.transformVersion = transform.version;
+    }
+    return updatedCount;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "ComponentPool.hpp"
+#include "Components.hpp"
+
+// std
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Entities of the scene and their components. Every component type is stored in its own WrpComponentPool,
+// contiguous arrays instead of the nodes of a map, so the systems iterate the transforms, the model references
+// and the lights linearly and find the other components of an entity by its handle in O(1).
+// Every entity has a transform, the models and the lights are optional.
+//
+// The entities form a hierarchy: the transform of a child is relative to its parent. The hierarchy's entities are
+// kept in a flat array ordered depth first, every parent before its children, rebuilt only when the structure
+// changes. updateWorldTransforms() walks it linearly and rebuilds the world matrices of the subtrees whose local
+// transform changed, the rest of the nodes only compare the transform version.
+class WrpScene
+{
+public:
+    WrpScene() = default;
+
+    WrpScene(const WrpScene&) = delete;
+    WrpScene& operator=(const WrpScene&) = delete;
+
+    // the name gets the entity index appended
+    WrpEntity createEntity(std::string name = "Object");
+    // the radius of the light's billboard is stored in transform.scale.x
+    WrpEntity createPointLight(float intensity = 10.f, float radius = 0.1f, glm::vec3 color = glm::vec3(1.f));
+    // removes the entity with all its components, its handle becomes invalid; its children are moved
+    // to its parent keeping their world transform
+    void destroyEntity(WrpEntity entity);
+    bool isAlive(WrpEntity entity) const { return transforms.contains(entity); }
+    void reserve(size_t entityCount);
+
+    size_t getEntityCount() const { return transforms.size(); }
+    // the alive entities in the order of their transforms
+    const std::vector<WrpEntity>& getEntities() const { return transforms.entities(); }
+    const std::string& getName(WrpEntity entity) const;
+
+    TransformComponent& getTransform(WrpEntity entity) { return transforms.get(entity); }
+    // nullptr if the entity has no model
+    WrpModel* getModel(WrpEntity entity);
+    void setModel(WrpEntity entity, std::shared_ptr<WrpModel> model);
+
+    // NULL_ENTITY as the parent makes the entity a root. The transform either stays relative (it moves with
+    // the parent) or is recomputed so the world transform stays, as the editor does. Throws if the parent is
+    // the entity itself or its descendant.
+    void setParent(WrpEntity entity, WrpEntity parent, bool keepWorldTransform = false);
+    // NULL_ENTITY for the roots
+    WrpEntity getParent(WrpEntity entity) const;
+    WrpEntity getFirstChild(WrpEntity entity) const;
+    WrpEntity getNextSibling(WrpEntity entity) const;
+    bool isAncestor(WrpEntity ancestor, WrpEntity entity) const;
+
+    // Builds the world matrices of the children whose local transform or a parent's world transform changed,
+    // called by WrpTransformUpdater after the local matrices are rebuilt. Returns the number of the children
+    // whose world matrix was rebuilt.
+    uint32_t updateWorldTransforms();
+
+    template <typename T>
+    WrpComponentPool<T>& getPool();
+
+    // Calls fn(entity, component, transform) for every entity with the component T, in the order of T's array.
+    // The transforms are found through the sparse array of their pool.
+    template <typename T, typename Fn>
+    void each(Fn&& fn)
+    {
+        WrpComponentPool<T>& pool = getPool<T>();
+        const std::vector<WrpEntity>& entities = pool.entities();
+        std::vector<T>& components = pool.data();
+        for (size_t i = 0; i < entities.size(); ++i) {
+            fn(entities[i], components[i], transforms.get(entities[i]));
+        }
+    }
+
+    WrpComponentPool<TransformComponent> transforms;
+    WrpComponentPool<ModelComponent> models;
+    WrpComponentPool<PointLightComponent> pointLights;
+    WrpComponentPool<HierarchyComponent> hierarchies;
+
+private:
+    static constexpr uint32_t NO_PARENT = ~0u;
+
+    // node of the flat hierarchy, the world matrices of the parents are read from the nodes before it
+    struct HierarchyNode
+    {
+        WrpEntity entity = NULL_ENTITY;
+        uint32_t parent = NO_PARENT;    // index of the parent's node
+        uint32_t transformVersion = 0;  // the version of the transform seen by the last propagation
+        bool changed = false;           // the world matrix was rebuilt by the last propagation
+        glm::mat4 localMatrix{1.f};
+        glm::mat3 localNormalMatrix{1.f};
+        glm::mat4 worldMatrix{1.f};
+        glm::mat3 worldNormalMatrix{1.f};
+    };
+
+    // removes the entity from its parent's children
+    void unlink(WrpEntity entity, HierarchyComponent& hierarchy);
+    // drops the hierarchy component of an entity which has neither parent nor children
+    void removeIfDetached(WrpEntity entity);
+    // rebuilds the cached matrices from the fields, they are local again
+    static void resetToLocal(TransformComponent& transform);
+    void rebuildHierarchy();
+
+    // indexed by the entity index
+    std::vector<uint8_t> generations;
+    std::vector<std::string> names;
+    std::vector<uint32_t> freeIndices;
+
+    std::vector<HierarchyNode> hierarchyNodes;
+    std::vector<std::pair<WrpEntity, uint32_t>> hierarchyStack; // the entity and its parent's node
+    bool hierarchyChanged = false;
+};
+
+template <typename T>
+WrpComponentPool<T>& WrpScene::getPool()
+{
+    if constexpr (std::is_same_v<T, TransformComponent>) return transforms;
+    else if constexpr (std::is_same_v<T, ModelComponent>) return models;
+    else if constexpr (std::is_same_v<T, HierarchyComponent>) return hierarchies;
+    else {
+        static_assert(std::is_same_v<T, PointLightComponent>, "Unknown component type");
+        return pointLights;
+    }
+}
@@ -0,0 +1,66 @@
+#include "SceneBvh.hpp"
+
+namespace
+{
+    constexpr float MAX_COST_GROWTH = 1.5f;    // rebuild if the SAH cost grows by this factor since the last rebuild
+    constexpr float MAX_INSERTED_SHARE = 0.25f; // rebuild if such a part of the objects was inserted in one sync
+}
+
+void WrpSceneBvh::sync(WrpScene& scene)
+{
+    ++syncIndex;
+    uint32_t inserted = 0;
+    uint32_t changed = 0;
+    scene.each<ModelComponent>([&](WrpEntity entity, ModelComponent& component, TransformComponent& transform) {
+        if (component.model == nullptr) return;
+
+        uint32_t index = entityIndex(entity);
+        if (index >= proxies.size()) {
+            proxies.resize(index + 1);
+        }
+        Proxy& proxy = proxies[index];
+        if (proxy.id != WrpBvh::NULL_PROXY && proxy.entity != entity)
+        {
+            // the entity of the proxy was destroyed and its slot reused
+            bvh.remove(proxy.id);
+            proxy.id = WrpBvh::NULL_PROXY;
+            ++changed;
+        }
+
+        const glm::mat4& modelMatrix = transform.modelMatrix();
+        if (proxy.id == WrpBvh::NULL_PROXY)
+        {
+            proxy.id = bvh.insert(WrpAabb::transform(component.model->getBoundingBox(), modelMatrix), entity);
+            ++inserted;
+        }
+        else if (proxy.transformVersion != transform.getVersion() || proxy.model != component.model.get())
+        {
+            // the box is transformed only for the moved objects
+            if (bvh.update(proxy.id, WrpAabb::transform(component.model->getBoundingBox(), modelMatrix))) {
+                ++changed;
+            }
+        }
+        proxy.entity = entity;
+        proxy.transformVersion = transform.getVersion();
+        proxy.model = component.model.get();
+        proxy.syncIndex = syncIndex;
+    });
+
+    for (Proxy& proxy : proxies)
+    {
+        if (proxy.id != WrpBvh::NULL_PROXY && proxy.syncIndex != syncIndex)
+        {
+            bvh.remove(proxy.id);
+            proxy.id = WrpBvh::NULL_PROXY;
+            ++changed;
+        }
+    }
+
+    if (inserted == 0 && changed == 0) return;
+    if (inserted > MAX_INSERTED_SHARE * bvh.getProxyCount() || bvh.getCost() > MAX_COST_GROWTH * costAfterRebuild)
+    {
+        bvh.rebuild();
+        costAfterRebuild = bvh.getCost();
+        ++rebuildCount;
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Bvh.hpp"
+#include "Scene.hpp"
+
+// std
+#include <vector>
+
+// BVH over the scene entities with models, the user data of its proxies are the entity handles.
+// sync() is called once per frame before the systems query it.
+class WrpSceneBvh
+{
+public:
+    // Inserts the new objects, updates the boxes of the moved ones and removes the destroyed ones.
+    // The tree is rebuilt when many objects were inserted or the refits have degraded it.
+    void sync(WrpScene& scene);
+
+    const WrpBvh& getBvh() const { return bvh; }
+    uint32_t getRebuildCount() const { return rebuildCount; }
+
+private:
+    struct Proxy
+    {
+        WrpBvh::ProxyId id = WrpBvh::NULL_PROXY;
+        WrpEntity entity = NULL_ENTITY;
+        uint64_t syncIndex = 0; // last sync() that has seen the object
+        uint32_t transformVersion = 0; // the box is up to date with this version of the object's transform
+        const WrpModel* model = nullptr;
+    };
+
+    WrpBvh bvh;
+    std::vector<Proxy> proxies; // indexed by the entity index
+    uint64_t syncIndex = 0;
+    float costAfterRebuild = 0.f;
+    uint32_t rebuildCount = 0;
+};
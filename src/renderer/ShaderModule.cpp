@@ -1,13 +1,43 @@
 #include "ShaderModule.hpp"
 #include "HeaderCore.hpp"
 
+#include "Utils.hpp"
+
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <filesystem>
 #include <string>
 #include <fstream>
 #include <iostream>
 
-ShaderModule::ShaderModule(WrpDevice& device, std::string shaderFilename) : wrpDevice(device)
+std::mutex ShaderModule::modulesCacheMutex;
+std::unordered_map<uint64_t, std::weak_ptr<ShaderModule>> ShaderModule::modulesCache;
+std::atomic<uint32_t> ShaderModule::moduleRequests{0};
+std::atomic<uint32_t> ShaderModule::moduleCacheHits{0};
+std::atomic<uint32_t> ShaderModule::diskCacheHits{0};
+std::atomic<uint32_t> ShaderModule::diskCacheMisses{0};
+std::atomic<uint64_t> ShaderModule::compileMicrosSpent{0};
+std::atomic<uint64_t> ShaderModule::compileMicrosSaved{0};
+
+// Header of the file with cached SPIR-V. The compile time is stored to report how much time the cache saves.
+struct SPIRVCacheFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceHash;
+    uint64_t compileMicros;
+    uint64_t spirvSizeInBytes;
+};
+static constexpr uint32_t SPIRV_CACHE_MAGIC = 0x56505357; // "WSPV"
+static constexpr uint32_t SPIRV_CACHE_VERSION = 1;
+static constexpr uint32_t SPIRV_MAGIC_NUMBER = 0x07230203;
+
+// Options passed to the compiler. They are a part of the cache key, so they must be changed together with compileShaderIntoSPIRV().
+static const char* SHADERC_COMPILE_OPTIONS = "entry=main;options=default";
+
+std::shared_ptr<ShaderModule> ShaderModule::create(WrpDevice& device, const std::string& shaderFilename)
 {
     std::string path = SHADERS_DIR + shaderFilename;
     std::string shaderSource = readShaderFile(path);
@@ -15,8 +45,66 @@ ShaderModule::ShaderModule(WrpDevice& device, std::string shaderFilename) : wrpD
         throw std::runtime_error("[ShaderModule] Shader source string is empty.");
     }
 
-    if (compileShaderIntoSPIRV(glslangShaderStageFromFileName(path.c_str()), shaderSource, path) < 1) {
-        throw std::runtime_error("[ShaderModule] SPIR-V source has 0 size.");
+    shaderc_shader_kind shaderKind = glslangShaderStageFromFileName(path.c_str());
+    uint64_t sourceHash = hashShaderSource(shaderSource, shaderKind);
+    VkDevice vkDevice = device.device();
+    uint64_t moduleKey = fnv1a64(&vkDevice, sizeof(vkDevice), sourceHash);
+
+    ++moduleRequests;
+    {
+        std::lock_guard<std::mutex> lock(modulesCacheMutex);
+        if (auto cached = modulesCache[moduleKey].lock())
+        {
+            ++moduleCacheHits;
+            return cached;
+        }
+    }
+
+    // compilation is done without the lock, so different shaders can be compiled in parallel
+    std::shared_ptr<ShaderModule> module{new ShaderModule(device, path, shaderSource, shaderKind, sourceHash)};
+
+    std::lock_guard<std::mutex> lock(modulesCacheMutex);
+    if (auto cached = modulesCache[moduleKey].lock())
+    {
+        // the same shader was created by another thread in the meantime
+        ++moduleCacheHits;
+        return cached;
+    }
+    modulesCache[moduleKey] = module;
+    return module;
+}
+
+void ShaderModule::printCacheStatistics()
+{
+    uint32_t requests = moduleRequests;
+    uint32_t diskHits = diskCacheHits;
+    uint32_t diskLookups = diskHits + diskCacheMisses;
+    std::cout << "[ShaderModule] module cache: " << moduleCacheHits << "/" << requests << " hits; "
+              << "SPIR-V disk cache: " << diskHits << "/" << diskLookups << " hits; "
+              << "compile time spent: " << compileMicrosSpent / 1000.0 << " ms, "
+              << "saved: " << compileMicrosSaved / 1000.0 << " ms" << std::endl;
+}
+
+ShaderModule::ShaderModule(WrpDevice& device, const std::string& shaderPath, const std::string& shaderSource,
+    shaderc_shader_kind shaderKind, uint64_t sourceHash) : wrpDevice(device), sourceSizeInBytes(shaderSource.size())
+{
+    uint64_t compileMicros = 0;
+    if (loadSPIRVFromDiskCache(sourceHash, compileMicros))
+    {
+        ++diskCacheHits;
+        compileMicrosSaved += compileMicros;
+    }
+    else
+    {
+        ++diskCacheMisses;
+        auto compileBegin = std::chrono::high_resolution_clock::now();
+        if (compileShaderIntoSPIRV(shaderKind, shaderSource, shaderPath) < 1) {
+            throw std::runtime_error("[ShaderModule] SPIR-V source has 0 size.");
+        }
+        compileMicros = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::high_resolution_clock::now() - compileBegin).count();
+        compileMicrosSpent += compileMicros;
+        storeSPIRVToDiskCache(sourceHash, compileMicros);
     }
     createShaderModule();
 }
@@ -26,7 +114,7 @@ ShaderModule::~ShaderModule()
     vkDestroyShaderModule(wrpDevice.device(), shaderModule, nullptr);
 }
 
-std::string ShaderModule::readShaderFile(std::string& shaderPath)
+std::string ShaderModule::readShaderFile(const std::string& shaderPath)
 {
     // ate is setting pointer to the end of file to read file size right from to-go
     std::ifstream file(shaderPath, std::ios::ate | std::ios::binary);
@@ -65,12 +153,12 @@ std::string ShaderModule::readShaderFile(std::string& shaderPath)
         {
             throw std::runtime_error("Failed to handle #include directive in " + shaderPath);
         }
+        // the included file is looked up next to the including one (SHADERS_DIR for the shaders themselves)
         std::string name = code.substr(p1 + 1, p2 - p1 - 1);
-        std::string include = readShaderFile(name);
+        std::string include = readShaderFile((std::filesystem::path(shaderPath).parent_path() / name).string());
         code.replace(pos, p2 - pos + 1, include.c_str());
     }
 
-    sourceSizeInBytes = code.size();
     return code;
 }
 
@@ -106,7 +194,7 @@ bool ShaderModule::endsWith(const char* s, const char* part)
     return strcmp(s + sLength - partLength, part) == 0;
 }
 
-size_t ShaderModule::compileShaderIntoSPIRV(shaderc_shader_kind shaderKind, std::string& shaderSource, std::string& shaderPath)
+size_t ShaderModule::compileShaderIntoSPIRV(shaderc_shader_kind shaderKind, const std::string& shaderSource, const std::string& shaderPath)
 {
     shaderc_compiler_t compiler = shaderc_compiler_initialize();
     shaderc_compilation_result_t result = shaderc_compile_into_spv(compiler, shaderSource.data(), shaderSource.size(),
@@ -131,7 +219,97 @@ size_t ShaderModule::compileShaderIntoSPIRV(shaderc_shader_kind shaderKind, std:
     return sizeInBytes;
 }
 
-VkResult ShaderModule::createShaderModule()
+uint64_t ShaderModule::hashShaderSource(const std::string& shaderSource, shaderc_shader_kind shaderKind)
+{
+    // the compiler version is hashed as well, so its update invalidates the cache
+    unsigned int spvVersion = 0, spvRevision = 0;
+    shaderc_get_spv_version(&spvVersion, &spvRevision);
+
+    uint64_t hash = fnv1a64(shaderSource.data(), shaderSource.size());
+    hash = fnv1a64(&shaderKind, sizeof(shaderKind), hash);
+    hash = fnv1a64(SHADERC_COMPILE_OPTIONS, strlen(SHADERC_COMPILE_OPTIONS), hash);
+    hash = fnv1a64(&spvVersion, sizeof(spvVersion), hash);
+    hash = fnv1a64(&spvRevision, sizeof(spvRevision), hash);
+    return hash;
+}
+
+std::string ShaderModule::spirvCachePath(uint64_t sourceHash)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.spv", static_cast<unsigned long long>(sourceHash));
+    return std::string(CACHE_DIR "shaders/") + name;
+}
+
+bool ShaderModule::loadSPIRVFromDiskCache(uint64_t sourceHash, uint64_t& compileMicros)
+{
+    std::ifstream file(spirvCachePath(sourceHash), std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    size_t fileSize = static_cast<size_t>(file.tellg());
+    SPIRVCacheFileHeader header{};
+    if (fileSize < sizeof(header)) {
+        return false;
+    }
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+    // the entry is ignored (and will be overwritten) if it is damaged or belongs to another source
+    if (!file || header.magic != SPIRV_CACHE_MAGIC || header.version != SPIRV_CACHE_VERSION ||
+        header.sourceHash != sourceHash || header.spirvSizeInBytes == 0 ||
+        header.spirvSizeInBytes % sizeof(uint32_t) != 0 || header.spirvSizeInBytes != fileSize - sizeof(header))
+    {
+        return false;
+    }
+
+    spirv.resize(header.spirvSizeInBytes / sizeof(uint32_t));
+    file.read(reinterpret_cast<char*>(spirv.data()), header.spirvSizeInBytes);
+    if (!file || spirv[0] != SPIRV_MAGIC_NUMBER)
+    {
+        spirv.clear();
+        return false;
+    }
+
+    compileMicros = header.compileMicros;
+    return true;
+}
+
+void ShaderModule::storeSPIRVToDiskCache(uint64_t sourceHash, uint64_t compileMicros)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(CACHE_DIR "shaders/", ec);
+
+    SPIRVCacheFileHeader header{};
+    header.magic = SPIRV_CACHE_MAGIC;
+    header.version = SPIRV_CACHE_VERSION;
+    header.sourceHash = sourceHash;
+    header.compileMicros = compileMicros;
+    header.spirvSizeInBytes = spirv.size() * sizeof(uint32_t);
+
+    // write to a temporary file first, so a concurrent reader never sees a partially written entry
+    std::string path = spirvCachePath(sourceHash);
+    std::string tmpPath = path + "." + std::to_string(reinterpret_cast<uintptr_t>(this)) + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            return; // caching is optional
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(spirv.data()), header.spirvSizeInBytes);
+        if (!file) {
+            file.close();
+            std::filesystem::remove(tmpPath, ec);
+            return;
+        }
+    }
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec) {
+        std::filesystem::remove(tmpPath, ec);
+    }
+}
+
+void ShaderModule::createShaderModule()
 {
     VkShaderModuleCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
@@ -4,27 +4,63 @@
 
 #include "shaderc/shaderc.h"
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 #include <string>
 
+// Shader module compiled from GLSL at runtime.
+// Compilation results are cached on two levels:
+//  - on disk (CACHE_DIR/shaders), keyed by a hash of the #include-resolved source, shader stage and compile options,
+//    so unchanged shaders are not recompiled by shaderc on the next run;
+//  - in process, so identical sources requested by several pipelines share a single VkShaderModule.
 class ShaderModule
 {
 public:
-    ShaderModule(WrpDevice& device, std::string shaderFilename);
+    // Returns a shader module for the file from SHADERS_DIR, reusing an alive one if the source is the same
+    static std::shared_ptr<ShaderModule> create(WrpDevice& device, const std::string& shaderFilename);
+    static void printCacheStatistics();
+
     ~ShaderModule();
 
+    ShaderModule(const ShaderModule&) = delete;
+    ShaderModule& operator=(const ShaderModule&) = delete;
+
     size_t getSourceSizeInBytes() { return sourceSizeInBytes; };
 
     VkShaderModule shaderModule = nullptr;
 
 private:
-    std::string readShaderFile(std::string& shaderPath);
-    shaderc_shader_kind glslangShaderStageFromFileName(const char* fileName);
-    bool endsWith(const char* s, const char* part);
-    size_t compileShaderIntoSPIRV(shaderc_shader_kind shaderKind, std::string& shaderSource, std::string& shaderPath);
-    VkResult createShaderModule();
+    ShaderModule(WrpDevice& device, const std::string& shaderPath, const std::string& shaderSource,
+        shaderc_shader_kind shaderKind, uint64_t sourceHash);
+
+    static std::string readShaderFile(const std::string& shaderPath);
+    static shaderc_shader_kind glslangShaderStageFromFileName(const char* fileName);
+    static bool endsWith(const char* s, const char* part);
+    static uint64_t hashShaderSource(const std::string& shaderSource, shaderc_shader_kind shaderKind);
+    static std::string spirvCachePath(uint64_t sourceHash);
+
+    size_t compileShaderIntoSPIRV(shaderc_shader_kind shaderKind, const std::string& shaderSource, const std::string& shaderPath);
+    bool loadSPIRVFromDiskCache(uint64_t sourceHash, uint64_t& compileMicros);
+    void storeSPIRVToDiskCache(uint64_t sourceHash, uint64_t compileMicros);
+    void createShaderModule();
 
     WrpDevice& wrpDevice;
     size_t sourceSizeInBytes = 0;
     std::vector<uint32_t> spirv;
+
+    // in-process module cache; the key combines the source hash and the device
+    static std::mutex modulesCacheMutex;
+    static std::unordered_map<uint64_t, std::weak_ptr<ShaderModule>> modulesCache;
+
+    // statistics
+    static std::atomic<uint32_t> moduleRequests;
+    static std::atomic<uint32_t> moduleCacheHits;
+    static std::atomic<uint32_t> diskCacheHits;
+    static std::atomic<uint32_t> diskCacheMisses;
+    static std::atomic<uint64_t> compileMicrosSpent;
+    static std::atomic<uint64_t> compileMicrosSaved;
 };
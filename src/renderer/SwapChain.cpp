@@ -1,4 +1,5 @@
 #include "SwapChain.hpp"
+#include "Buffer.hpp"
 #include "Utils.hpp"
 
 #include <array>
@@ -37,6 +38,12 @@ WrpSwapChain::~WrpSwapChain()
         swapChain = nullptr;
     }
 
+    // the offscreen images are owned by the headless swap chain itself
+    for (size_t i = 0; i < offscreenImageMemories.size(); i++) {
+        vkDestroyImage(wrpDevice.device(), swapChainImages[i], nullptr);
+        vkFreeMemory(wrpDevice.device(), offscreenImageMemories[i], nullptr);
+    }
+
     vkDestroyImageView(wrpDevice.device(), colorImageView, nullptr);
     vkDestroyImage(wrpDevice.device(), colorImage, nullptr);
     vkFreeMemory(wrpDevice.device(), colorImageMemory, nullptr);
@@ -52,19 +59,23 @@ WrpSwapChain::~WrpSwapChain()
     }
 
     vkDestroyRenderPass(wrpDevice.device(), renderPass, nullptr);
+    vkDestroyRenderPass(wrpDevice.device(), loadRenderPass, nullptr);
 
     // cleanup synchronization objects
-    for (size_t i = 0; i < imageCount; i++) {
-        vkDestroySemaphore(wrpDevice.device(), renderFinishedSemaphores[i], nullptr);
-        vkDestroySemaphore(wrpDevice.device(), imageAvailableSemaphores[i], nullptr);
-        vkDestroyFence(wrpDevice.device(), inFlightFences[i], nullptr);
+    for (VkSemaphore semaphore : renderFinishedSemaphores) {
+        vkDestroySemaphore(wrpDevice.device(), semaphore, nullptr);
     }
 }
 
 void WrpSwapChain::init()
 {
     msaaSampleCount = wrpDevice.getMaxUsableMSAASampleCount(); // used in multiple structs
-    createSwapChain();
+    if (wrpWindow.isHeadless()) {
+        createOffscreenImages(); // the same images as the swap chain would have, but without a surface
+    }
+    else {
+        createSwapChain();
+    }
     createImageViews();      // creating VkImageView representations for SwapChain images
     createColorResources();  // создание изображений цвета для реализации мультисэмплинга
     createDepthResources();  // создание изображений для Depth Buffer вложения
@@ -138,6 +149,44 @@ void WrpSwapChain::createSwapChain()
     swapChainExtent = extent;
 }
 
+void WrpSwapChain::createOffscreenImages()
+{
+    imageCount = HEADLESS_IMAGE_COUNT;
+    std::cout << "Number of offscreen images: " << imageCount << std::endl;
+
+    // the format preferred for the surface, so the pipelines are the same as in the windowed mode
+    swapChainImageFormat = VK_FORMAT_B8G8R8A8_SRGB;
+    swapChainExtent = wrpWindow.getExtent();
+
+    swapChainImages.resize(imageCount);
+    offscreenImageMemories.resize(imageCount);
+    for (uint32_t i = 0; i < imageCount; i++)
+    {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = swapChainExtent.width;
+        imageInfo.extent.height = swapChainExtent.height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = swapChainImageFormat;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        // the rendered frame is copied from the image by readImage()
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        wrpDevice.createImageWithInfo(
+            imageInfo,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            swapChainImages[i],
+            offscreenImageMemories[i]
+        );
+    }
+}
+
 void WrpSwapChain::createImageViews()
 {
     swapChainImageViews.resize(swapChainImages.size());
@@ -179,7 +228,8 @@ void WrpSwapChain::createColorResources()
     imageInfo.format = swapChainImageFormat;
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageInfo.usage = VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    // not transient, the image is loaded by the second render pass of the frame (see loadRenderPass)
+    imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
     imageInfo.samples = msaaSampleCount;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
@@ -229,7 +279,8 @@ void WrpSwapChain::createDepthResources()
         imageInfo.format = swapChainDepthFormat;
         imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
         imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        // the depth is sampled by the depth pyramid build between the render passes of the frame
+        imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
         imageInfo.samples = msaaSampleCount;
         imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
         imageInfo.flags = 0;
@@ -284,7 +335,7 @@ void WrpSwapChain::createRenderPass()
     depthAttachment.format = swapChainDepthFormat;
     depthAttachment.samples = msaaSampleCount;
     depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE; // глубина читается после прохода рендера (пирамида глубины)
     depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -305,7 +356,9 @@ void WrpSwapChain::createRenderPass()
     colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    // the offscreen image isn't presented, it's left ready to be copied from
+    colorAttachmentResolve.finalLayout = wrpWindow.isHeadless() ?
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
     // Ссылка на привязку с индексом 2 (ColorResolveBuffer)
     VkAttachmentReference colorAttachmentResolveRef{};
@@ -350,6 +403,28 @@ void WrpSwapChain::createRenderPass()
     {
         throw std::runtime_error("Failed to create render pass!");
     }
+
+    // The same render pass, which continues the frame: color and depth are loaded instead of cleared.
+    // It differs only in the load operations and layouts, so it's compatible with the framebuffers and
+    // pipelines created for renderPass.
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    attachments = {colorAttachment, depthAttachment, colorAttachmentResolve};
+
+    // the loaded attachments were written by the previous render pass
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependency.dstStageMask = dependency.srcStageMask;
+    dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    if (vkCreateRenderPass(wrpDevice.device(), &renderPassInfo, nullptr, &loadRenderPass) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create render pass!");
+    }
 }
 
 void WrpSwapChain::createFramebuffers()
@@ -386,60 +461,73 @@ void WrpSwapChain::createFramebuffers()
 
 void WrpSwapChain::createSyncObjects()
 {
-    imageAvailableSemaphores.resize(imageCount);
     renderFinishedSemaphores.resize(imageCount);
-    inFlightFences.resize(imageCount);
     imagesInFlight.resize(imageCount, VK_NULL_HANDLE);
 
-    VkFenceCreateInfo fenceInfo = {};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
     for (size_t i = 0; i < imageCount; i++)
     {
-        if (createSemaphore(wrpDevice.device(), &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-            createSemaphore(wrpDevice.device(), &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-            vkCreateFence(wrpDevice.device(), &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS)
+        if (createSemaphore(wrpDevice.device(), &renderFinishedSemaphores[i]) != VK_SUCCESS)
         {
-            throw std::runtime_error("Failed to create synchronization objects for a frame!");
+            throw std::runtime_error("Failed to create synchronization objects for a swap chain image!");
         }
     }
 }
 
-VkResult WrpSwapChain::acquireNextImage(uint32_t* imageIndex)
+VkResult WrpSwapChain::acquireNextImage(VkSemaphore imageAvailableSemaphore, uint32_t* imageIndex)
 {
-    // Wait for fence signal when N'th frames command buffer has executed
-    vkWaitForFences(
-        wrpDevice.device(),
-        1,
-        &inFlightFences[currentFrame],
-        VK_TRUE,
-        std::numeric_limits<uint64_t>::max()); // big timeout number to wait till end
+    // The offscreen images are taken in turn. Nothing to wait for: the image's previous frame is waited
+    // in submitCommandBuffers() and the semaphore isn't signaled.
+    if (wrpWindow.isHeadless())
+    {
+        *imageIndex = nextOffscreenImage;
+        nextOffscreenImage = (nextOffscreenImage + 1) % imageCount;
+        return VK_SUCCESS;
+    }
 
     VkResult result = vkAcquireNextImageKHR(
         wrpDevice.device(),
         swapChain,
-        std::numeric_limits<uint64_t>::max(),
-        imageAvailableSemaphores[currentFrame],  // must be a not signaled semaphore
+        std::numeric_limits<uint64_t>::max(), // big timeout number to wait till end
+        imageAvailableSemaphore,  // must be a not signaled semaphore
         VK_NULL_HANDLE,
         imageIndex);
 
     return result;
 }
 
-VkResult WrpSwapChain::submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex)
+VkResult WrpSwapChain::submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex,
+    VkSemaphore imageAvailableSemaphore, VkFence inFlightFence)
 {
-    if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
+    // With fewer frames in flight than images the image is usually free already. With more frames the image
+    // may still be rendered by another frame, whose fence is waited here.
+    if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE && imagesInFlight[*imageIndex] != inFlightFence) {
         vkWaitForFences(wrpDevice.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
     }
-    imagesInFlight[*imageIndex] = inFlightFences[currentFrame];
+    imagesInFlight[*imageIndex] = inFlightFence;
+
+    // Resetting the frame's fence for further successful waiting
+    vkResetFences(wrpDevice.device(), 1, &inFlightFence);
+
+    if (wrpWindow.isHeadless())
+    {
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = buffers;
+
+        if (vkQueueSubmit(wrpDevice.graphicsQueue(), 1, &submitInfo, inFlightFence) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to submit draw command buffer!");
+        }
+        return VK_SUCCESS; // nothing to present
+    }
 
     VkSubmitInfo submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
     // Wait on writing colors to the image until it become available.
     // Each waiting stage corresponds to the semaphore with the same index.
-    VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
+    VkSemaphore waitSemaphores[] = {imageAvailableSemaphore};
     VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
     submitInfo.waitSemaphoreCount = 1;
     submitInfo.pWaitSemaphores = waitSemaphores;
@@ -449,17 +537,14 @@ VkResult WrpSwapChain::submitCommandBuffers(const VkCommandBuffer* buffers, uint
     submitInfo.pCommandBuffers = buffers;
     
     // specifying which semaphores to signal once command buffer(s) has finished execution
-    VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
+    VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[*imageIndex]};
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
-    // Resetting N'th frame fence for further successful waiting
-    vkResetFences(wrpDevice.device(), 1, &inFlightFences[currentFrame]);
-
     // Command buffer is submitting to graphics queue.
     // The passed fence will be signaled once command buffer(s) has finished execution.
     if (vkQueueSubmit(wrpDevice.graphicsQueue(), 1, &submitInfo,
-        inFlightFences[currentFrame]) != VK_SUCCESS)
+        inFlightFence) != VK_SUCCESS)
     {
         throw std::runtime_error("Failed to submit draw command buffer!");
     }
@@ -479,11 +564,77 @@ VkResult WrpSwapChain::submitCommandBuffers(const VkCommandBuffer* buffers, uint
     // Image is queueing for presentation
     auto result = vkQueuePresentKHR(wrpDevice.presentQueue(), &presentInfo);
 
-    currentFrame = (currentFrame + 1) % imageCount;
-
     return result;
 }
 
+std::vector<uint8_t> WrpSwapChain::readImage(uint32_t index)
+{
+    if (!wrpWindow.isHeadless())
+    {
+        throw std::runtime_error("Only the offscreen images of a headless swap chain can be read!");
+    }
+
+    constexpr VkDeviceSize PIXEL_SIZE = 4; // VK_FORMAT_B8G8R8A8_SRGB
+    WrpBuffer stagingBuffer{
+        wrpDevice,
+        PIXEL_SIZE,
+        swapChainExtent.width * swapChainExtent.height,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+    };
+
+    VkCommandBuffer commandBuffer = wrpDevice.beginSingleTimeCommands();
+
+    // the image is already in TRANSFER_SRC_OPTIMAL after the render pass, only its writes are made visible
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = swapChainImages[index];
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    vkCmdPipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkBufferImageCopy copyRegion{};
+    copyRegion.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    copyRegion.imageExtent = {swapChainExtent.width, swapChainExtent.height, 1};
+    vkCmdCopyImageToBuffer(commandBuffer, swapChainImages[index], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        stagingBuffer.getBuffer(), 1, &copyRegion);
+
+    VkBufferMemoryBarrier hostBarrier{};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    hostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hostBarrier.buffer = stagingBuffer.getBuffer();
+    hostBarrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+        0, 0, nullptr, 1, &hostBarrier, 0, nullptr);
+
+    wrpDevice.endSingleTimeCommands(commandBuffer); // waits until the copy is done
+
+    stagingBuffer.map();
+    const uint8_t* bgra = static_cast<const uint8_t*>(stagingBuffer.getMappedMemory());
+    std::vector<uint8_t> rgba(stagingBuffer.getBufferSize());
+    for (size_t i = 0; i < rgba.size(); i += PIXEL_SIZE)
+    {
+        rgba[i + 0] = bgra[i + 2];
+        rgba[i + 1] = bgra[i + 1];
+        rgba[i + 2] = bgra[i + 0];
+        rgba[i + 3] = bgra[i + 3];
+    }
+    stagingBuffer.unmap();
+
+    return rgba;
+}
+
 VkSurfaceFormatKHR WrpSwapChain::chooseSwapChainSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats)
 {
     for (const auto& availableFormat : availableFormats)
@@ -547,9 +698,9 @@ VkExtent2D WrpSwapChain::chooseSwapChainExtent(const VkSurfaceCapabilitiesKHR& c
 // Поиск поддерживаемого девайсом формата глубины из переданного списка
 VkFormat WrpSwapChain::findDepthFormat()
 {
-    // ищутся форматы с depth компонентом и с поддержкой depth stencil attachment использования
+    // ищутся форматы с depth компонентом, с поддержкой depth stencil attachment использования и чтения в шейдере
     return wrpDevice.findSupportedFormat(
         {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
         VK_IMAGE_TILING_OPTIMAL,
-        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
 }
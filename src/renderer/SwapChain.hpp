@@ -2,13 +2,19 @@
 
 #include "Device.hpp"
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
 
+// Images to render the frames into and the render passes writing them. With a headless window there is no
+// surface to present to: the swap chain creates its own offscreen images, the frames are rendered into them in
+// turn and the last one can be read back by readImage().
 class WrpSwapChain
 {
 public:
+    static constexpr uint32_t HEADLESS_IMAGE_COUNT = 3;
+
     WrpSwapChain(WrpDevice& device, WrpWindow& window);
     WrpSwapChain(WrpDevice& device, WrpWindow& window, std::shared_ptr<WrpSwapChain> previous);
     ~WrpSwapChain();
@@ -18,7 +24,14 @@ public:
 
     VkFramebuffer getFrameBuffer(int index) { return swapChainFramebuffers[index]; }
     VkRenderPass getRenderPass() { return renderPass; }
+    // compatible with getRenderPass(), but loads the attachments written by it instead of clearing them
+    VkRenderPass getLoadRenderPass() { return loadRenderPass; }
+    VkImage getImage(int index) { return swapChainImages[index]; }
     VkImageView getImageView(int index) { return swapChainImageViews[index]; }
+    VkImage getDepthImage(int index) { return depthImages[index]; }
+    VkImageView getDepthImageView(int index) { return depthImageViews[index]; }
+    VkFormat getDepthFormat() { return swapChainDepthFormat; }
+    VkSampleCountFlagBits getSampleCount() { return msaaSampleCount; }
     size_t getImageCount() { return imageCount; }
     VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
     VkExtent2D getSwapChainExtent() { return swapChainExtent; }
@@ -31,8 +44,15 @@ public:
     }
     VkFormat findDepthFormat();
 
-    VkResult acquireNextImage(uint32_t* imageIndex);
-    VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex);
+    // The frame's synchronization objects are owned by WrpRenderer: imageAvailableSemaphore is signaled when
+    // the acquired image can be written, inFlightFence - when the submitted commands have been executed.
+    VkResult acquireNextImage(VkSemaphore imageAvailableSemaphore, uint32_t* imageIndex);
+    VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex,
+        VkSemaphore imageAvailableSemaphore, VkFence inFlightFence);
+
+    // Copies the image rendered by a finished frame into tightly packed 8-bit RGBA pixels. Only the headless
+    // images can be read: the image must be in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL and not be rendered to.
+    std::vector<uint8_t> readImage(uint32_t index);
 
     bool compareSwapChainFormats(const WrpSwapChain& swapChain) const
     {
@@ -42,6 +62,7 @@ public:
 private:
     void init();
     void createSwapChain();
+    void createOffscreenImages();
     void createImageViews();
     void createColorResources();
     void createDepthResources();
@@ -60,6 +81,7 @@ private:
 
     std::vector<VkFramebuffer> swapChainFramebuffers;
     VkRenderPass renderPass;
+    VkRenderPass loadRenderPass;
 
     // color buffer used for multisampling
     VkImage colorImage;
@@ -73,17 +95,18 @@ private:
 
     std::vector<VkImage> swapChainImages;
     std::vector<VkImageView> swapChainImageViews;
+    std::vector<VkDeviceMemory> offscreenImageMemories; // headless only, the images are created by the swap chain
+    uint32_t nextOffscreenImage = 0;
 
     WrpDevice& wrpDevice;
     WrpWindow& wrpWindow;
 
-    VkSwapchainKHR swapChain;
+    VkSwapchainKHR swapChain = VK_NULL_HANDLE;
     std::shared_ptr<WrpSwapChain> oldSwapChain;
 
-    uint32_t imageCount = 0; // also defines count of frame buffers and command buffers
-    std::vector<VkSemaphore> imageAvailableSemaphores;
+    uint32_t imageCount = 0; // also defines count of frame buffers
+    // per image: the presentation of an image waits for its semaphore, which is reused only when the image
+    // is acquired again
     std::vector<VkSemaphore> renderFinishedSemaphores;
-    std::vector<VkFence> inFlightFences; // fences to control command buffer recording (only after successful execution in the queue)
-    std::vector<VkFence> imagesInFlight;
-    size_t currentFrame = 0;
+    std::vector<VkFence> imagesInFlight; // fence of the frame that rendered to the image last, not owned
 };
@@ -0,0 +1,92 @@
+#include "TextureHeap.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+
+WrpTextureHeap::WrpTextureHeap(WrpDevice& device, uint32_t framesInFlight, uint32_t requestedCapacity)
+    : wrpDevice{device}, framesInFlight{framesInFlight}
+{
+    // combined image samplers count against both samplers and sampled images limits
+    const auto& limits = wrpDevice.descriptorIndexingProperties;
+    capacity = std::min({requestedCapacity,
+        limits.maxPerStageDescriptorUpdateAfterBindSamplers,
+        limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+        limits.maxDescriptorSetUpdateAfterBindSamplers,
+        limits.maxDescriptorSetUpdateAfterBindSampledImages});
+    if (capacity == 0) {
+        throw std::runtime_error("Device doesn't support update after bind sampled images!");
+    }
+
+    pool = WrpDescriptorPool::Builder(wrpDevice)
+        .setMaxSets(1)
+        .setPoolFlags(VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT)
+        .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, capacity)
+        .build();
+
+    setLayout = WrpDescriptorSetLayout::Builder(wrpDevice)
+        .setLayoutFlags(VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT)
+        .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, capacity,
+            VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+            VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+            VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT)
+        .build();
+
+    if (!pool->allocateDescriptorSet(setLayout->getDescriptorSetLayout(), descriptorSet)) {
+        throw std::runtime_error("Failed to allocate bindless texture descriptor set!");
+    }
+
+    freeSlots.reserve(capacity);
+    for (uint32_t slot = capacity; slot > 0; --slot) {
+        freeSlots.push_back(slot - 1);
+    }
+
+    std::cout << "Bindless texture heap capacity: " << capacity << std::endl;
+}
+
+uint32_t WrpTextureHeap::add(const VkDescriptorImageInfo& imageInfo)
+{
+    if (freeSlots.empty())
+    {
+        std::cerr << "Bindless texture heap is full (" << capacity << " textures)" << std::endl;
+        return INVALID_SLOT;
+    }
+
+    uint32_t slot = freeSlots.back();
+    freeSlots.pop_back();
+    ++usedSlots;
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = descriptorSet;
+    write.dstBinding = 0;
+    write.dstArrayElement = slot;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.descriptorCount = 1;
+    write.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(wrpDevice.device(), 1, &write, 0, nullptr);
+
+    return slot;
+}
+
+void WrpTextureHeap::remove(uint32_t slot)
+{
+    if (slot == INVALID_SLOT) return;
+    assert(slot < capacity && "Texture heap slot is out of range");
+
+    // The descriptor is left as is: the slot is partially bound, so a stale descriptor is valid until it's accessed.
+    retiredSlots.push_back({slot, frameNumber + framesInFlight});
+    --usedSlots;
+}
+
+void WrpTextureHeap::nextFrame()
+{
+    ++frameNumber;
+    while (!retiredSlots.empty() && retiredSlots.front().retireFrame <= frameNumber)
+    {
+        freeSlots.push_back(retiredSlots.front().slot);
+        retiredSlots.pop_front();
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Device.hpp"
+#include "Descriptors.hpp"
+
+// std
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+// Bindless texture array: a single descriptor set with one large partially bound array of combined image samplers.
+// Textures are added to and removed from free slots with a single descriptor write, so the pipelines using
+// the array don't depend on the textures count and are never recreated because of it.
+// The set is updated after bind (VK_EXT_descriptor_indexing), so it can be written while frames are in flight:
+// a freed slot is reused only after all frames that could sample from it are finished.
+class WrpTextureHeap
+{
+public:
+    static constexpr uint32_t INVALID_SLOT = UINT32_MAX;
+    static constexpr uint32_t DEFAULT_CAPACITY = 4096;
+
+    // framesInFlight is the number of frames after which a freed slot can be reused
+    WrpTextureHeap(WrpDevice& device, uint32_t framesInFlight, uint32_t requestedCapacity = DEFAULT_CAPACITY);
+    ~WrpTextureHeap() = default;
+
+    WrpTextureHeap(const WrpTextureHeap&) = delete;
+    WrpTextureHeap& operator=(const WrpTextureHeap&) = delete;
+
+    // writes the texture into a free slot and returns its index in the array (INVALID_SLOT if the heap is full)
+    uint32_t add(const VkDescriptorImageInfo& imageInfo);
+    void remove(uint32_t slot);
+    // must be called once per frame: returns the slots freed framesInFlight frames ago to the freelist
+    void nextFrame();
+
+    VkDescriptorSetLayout getDescriptorSetLayout() const { return setLayout->getDescriptorSetLayout(); }
+    VkDescriptorSet getDescriptorSet() const { return descriptorSet; }
+    uint32_t getCapacity() const { return capacity; }
+    uint32_t getUsedSlotsCount() const { return usedSlots; }
+
+private:
+    struct RetiredSlot
+    {
+        uint32_t slot;
+        uint64_t retireFrame; // the slot can be reused when this frame is reached
+    };
+
+    WrpDevice& wrpDevice;
+    uint32_t framesInFlight;
+    uint32_t capacity;
+    uint32_t usedSlots = 0;
+    uint64_t frameNumber = 0;
+
+    std::unique_ptr<WrpDescriptorPool> pool;
+    std::unique_ptr<WrpDescriptorSetLayout> setLayout;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+    std::vector<uint32_t> freeSlots;       // used as a stack, so low indices are handed out first
+    std::deque<RetiredSlot> retiredSlots;  // ordered by retireFrame
+};
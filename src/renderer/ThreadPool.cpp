@@ -0,0 +1,68 @@
+#include "ThreadPool.hpp"
+
+// std
+#include <algorithm>
+
+static thread_local int workerIndexOfThisThread = -1;
+
+WrpThreadPool::WrpThreadPool(unsigned int threadCount)
+{
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    workers.reserve(threadCount);
+    for (unsigned int i = 0; i < threadCount; ++i) {
+        workers.emplace_back(&WrpThreadPool::workerLoop, this, i);
+    }
+}
+
+WrpThreadPool::~WrpThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueCondition.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void WrpThreadPool::waitIdle()
+{
+    std::unique_lock<std::mutex> lock(queueMutex);
+    idleCondition.wait(lock, [this]() { return jobs.empty() && activeJobs == 0; });
+}
+
+int WrpThreadPool::currentWorkerIndex() { return workerIndexOfThisThread; }
+
+void WrpThreadPool::workerLoop(unsigned int workerIndex)
+{
+    workerIndexOfThisThread = static_cast<int>(workerIndex);
+
+    while (true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueCondition.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            // remaining jobs are finished before stopping, so no future is left without a value
+            if (jobs.empty()) return;
+
+            job = std::move(jobs.front());
+            jobs.pop();
+            ++activeJobs;
+        }
+
+        job(); // exceptions are stored in the job's future by packaged_task
+
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            --activeJobs;
+            if (jobs.empty() && activeJobs == 0) {
+                idleCondition.notify_all();
+            }
+        }
+    }
+}
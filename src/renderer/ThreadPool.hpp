@@ -0,0 +1,58 @@
+#pragma once
+
+// std
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed-size pool of worker threads executing submitted jobs in FIFO order.
+// Each worker knows its index, so jobs can use per-thread resources (pipeline caches, command pools).
+class WrpThreadPool
+{
+public:
+    // threadCount == 0 means one thread per hardware thread
+    explicit WrpThreadPool(unsigned int threadCount = 0);
+    ~WrpThreadPool();
+
+    WrpThreadPool(const WrpThreadPool&) = delete;
+    WrpThreadPool& operator=(const WrpThreadPool&) = delete;
+
+    template <typename F>
+    auto submit(F&& job) -> std::future<std::invoke_result_t<std::decay_t<F>>>
+    {
+        using ResultType = std::invoke_result_t<std::decay_t<F>>;
+        auto task = std::make_shared<std::packaged_task<ResultType()>>(std::forward<F>(job));
+        std::future<ResultType> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            jobs.emplace([task]() { (*task)(); });
+        }
+        queueCondition.notify_one();
+        return result;
+    }
+
+    // blocks until the queue is empty and no job is executing
+    void waitIdle();
+
+    unsigned int getThreadCount() const { return static_cast<unsigned int>(workers.size()); }
+
+    // index of the pool worker executing the calling code, or -1 if called outside of the pool
+    static int currentWorkerIndex();
+
+private:
+    void workerLoop(unsigned int workerIndex);
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> jobs;
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    std::condition_variable idleCondition;
+    unsigned int activeJobs = 0;
+    bool stopping = false;
+};
@@ -0,0 +1,174 @@
+#include "TransformUpdater.hpp"
+
+// std
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define WRP_TRANSFORM_SSE
+#endif
+
+namespace
+{
+    // Cephes sinf/cosf: the angle is reduced to [-pi/4, pi/4] by the multiple of pi/4 computed in three parts
+    // (exact up to |x| ~ 8192) and the sine and cosine polynomials of the reduced angle are swapped and negated
+    // by the octant. The error is a few ulp, the same order as the matrices' float products.
+    constexpr float FOUR_OVER_PI = 1.27323954473516f;
+    constexpr float PI_OVER_FOUR_1 = 0.78515625f;
+    constexpr float PI_OVER_FOUR_2 = 2.4187564849853515625e-4f;
+    constexpr float PI_OVER_FOUR_3 = 3.77489497744594108e-8f;
+    constexpr float COS_C0 = 2.443315711809948e-5f;
+    constexpr float COS_C1 = -1.388731625493765e-3f;
+    constexpr float COS_C2 = 4.166664568298827e-2f;
+    constexpr float SIN_C0 = -1.9515295891e-4f;
+    constexpr float SIN_C1 = 8.3321608736e-3f;
+    constexpr float SIN_C2 = -1.6666654611e-1f;
+
+#if !defined(WRP_TRANSFORM_SSE)
+    // the same polynomials without intrinsics, the loop is branch free so compilers can vectorize it
+    void sinCos(const float* angles, float* sines, float* cosines, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            float x = std::fabs(angles[i]);
+            int octant = (static_cast<int>(x * FOUR_OVER_PI) + 1) & ~1;
+            float y = static_cast<float>(octant);
+            x = ((x - y * PI_OVER_FOUR_1) - y * PI_OVER_FOUR_2) - y * PI_OVER_FOUR_3;
+
+            float z = x * x;
+            float cosine = ((COS_C0 * z + COS_C1) * z + COS_C2) * z * z - 0.5f * z + 1.f;
+            float sine = ((SIN_C0 * z + SIN_C1) * z + SIN_C2) * z * x + x;
+
+            bool swap = (octant & 2) != 0;
+            bool negativeSine = (angles[i] < 0.f) != ((octant & 4) != 0);
+            bool negativeCosine = ((octant - 2) & 4) == 0;
+            float s = swap ? cosine : sine;
+            float c = swap ? sine : cosine;
+            sines[i] = negativeSine ? -s : s;
+            cosines[i] = negativeCosine ? -c : c;
+        }
+    }
+#else
+    void sinCosSse(const float* angles, float* sines, float* cosines, size_t count)
+    {
+        const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(0x80000000u)));
+        const __m128i one = _mm_set1_epi32(1);
+        const __m128i two = _mm_set1_epi32(2);
+        const __m128i four = _mm_set1_epi32(4);
+        for (size_t i = 0; i < count; i += 4)
+        {
+            __m128 angle = _mm_loadu_ps(&angles[i]);
+            __m128 sineSign = _mm_and_ps(angle, signMask);
+            __m128 x = _mm_andnot_ps(signMask, angle);
+
+            __m128i octant = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(FOUR_OVER_PI)));
+            octant = _mm_and_si128(_mm_add_epi32(octant, one), _mm_set1_epi32(~1));
+            __m128 y = _mm_cvtepi32_ps(octant);
+            x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(PI_OVER_FOUR_1)));
+            x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(PI_OVER_FOUR_2)));
+            x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(PI_OVER_FOUR_3)));
+
+            // the sign bits of the octant: bit 2 flips the sine, the cosine is negative when bit 2 of octant - 2 is 0
+            sineSign = _mm_xor_ps(sineSign, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(octant, four), 29)));
+            __m128 cosineSign = _mm_castsi128_ps(
+                _mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(octant, two), four), 29));
+            __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(octant, two), two));
+
+            __m128 z = _mm_mul_ps(x, x);
+            __m128 cosine = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(COS_C0), z), _mm_set1_ps(COS_C1));
+            cosine = _mm_add_ps(_mm_mul_ps(cosine, z), _mm_set1_ps(COS_C2));
+            cosine = _mm_mul_ps(_mm_mul_ps(cosine, z), z);
+            cosine = _mm_add_ps(_mm_sub_ps(cosine, _mm_mul_ps(z, _mm_set1_ps(0.5f))), _mm_set1_ps(1.f));
+            __m128 sine = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SIN_C0), z), _mm_set1_ps(SIN_C1));
+            sine = _mm_add_ps(_mm_mul_ps(sine, z), _mm_set1_ps(SIN_C2));
+            sine = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sine, z), x), x);
+
+            __m128 s = _mm_or_ps(_mm_and_ps(swap, cosine), _mm_andnot_ps(swap, sine));
+            __m128 c = _mm_or_ps(_mm_and_ps(swap, sine), _mm_andnot_ps(swap, cosine));
+            _mm_storeu_ps(&sines[i], _mm_xor_ps(s, sineSign));
+            _mm_storeu_ps(&cosines[i], _mm_xor_ps(c, cosineSign));
+        }
+    }
+#endif
+}
+
+uint32_t WrpTransformUpdater::update(WrpScene& scene)
+{
+    // the transforms are contiguous in their pool
+    uint32_t updatedCount = 0;
+    for (TransformComponent& transform : scene.transforms.data()) {
+        updatedCount += gather(transform);
+    }
+    updateRotated();
+    // the children's world matrices are built from the updated local ones
+    return updatedCount + scene.updateWorldTransforms();
+}
+
+uint32_t WrpTransformUpdater::update(const std::vector<TransformComponent*>& transforms)
+{
+    uint32_t updatedCount = 0;
+    for (TransformComponent* transform : transforms) {
+        updatedCount += gather(*transform);
+    }
+    updateRotated();
+    return updatedCount;
+}
+
+bool WrpTransformUpdater::gather(TransformComponent& transform)
+{
+    if (!transform.isDirty()) return false;
+    // the cached matrix of a child is its world matrix, its last column isn't the translation
+    if (transform.isRotationOrScaleDirty() || transform.hasParent)
+    {
+        rotatedTransforms.push_back(&transform);
+        // the chunk is updated while its transforms are still in the cache
+        if (rotatedTransforms.size() == CHUNK_SIZE) {
+            updateRotated();
+        }
+    }
+    else {
+        transform.updateTranslation();
+    }
+    return true;
+}
+
+void WrpTransformUpdater::updateRotated()
+{
+    size_t count = rotatedTransforms.size();
+    if (count == 0) return;
+
+    // the parts of the arrays are CHUNK_SIZE long, the lanes after count are padding
+    for (size_t i = 0; i < count; ++i)
+    {
+        const glm::vec3& rotation = rotatedTransforms[i]->rotation;
+        angles[i] = rotation.x;
+        angles[CHUNK_SIZE + i] = rotation.y;
+        angles[2 * CHUNK_SIZE + i] = rotation.z;
+    }
+
+#if defined(WRP_TRANSFORM_SSE)
+    sinCosSse(angles.data(), sines.data(), cosines.data(), angles.size());
+#else
+    sinCos(angles.data(), sines.data(), cosines.data(), angles.size());
+#endif
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        glm::vec3 sinRotation{sines[i], sines[CHUNK_SIZE + i], sines[2 * CHUNK_SIZE + i]};
+        glm::vec3 cosRotation{cosines[i], cosines[CHUNK_SIZE + i], cosines[2 * CHUNK_SIZE + i]};
+        rotatedTransforms[i]->updateMatrices(sinRotation, cosRotation);
+    }
+    rotatedTransforms.clear();
+}
+
+uint32_t WrpTransformUpdater::updateScalar(const std::vector<TransformComponent*>& transforms)
+{
+    uint32_t updatedCount = 0;
+    for (TransformComponent* transform : transforms)
+    {
+        if (!transform->isDirty()) continue;
+        transform->updateMatrices();
+        ++updatedCount;
+    }
+    return updatedCount;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "Scene.hpp"
+
+// std
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Rebuilds the cached matrices of the changed transforms in one batch, at the start of the frame, so the render
+// systems only read the cached ones. The transforms whose rotation or scale changed are gathered, the sines and
+// cosines of their angles are computed by a polynomial approximation for 4 angles at once (SSE2; on the other
+// targets the same branch-free loop is left to the compiler's vectorizer) and the matrices are built from them.
+// The transforms with only the translation changed get the new last column. update(WrpScene&) then propagates
+// the changes down the scene hierarchy.
+class WrpTransformUpdater
+{
+public:
+    // returns the number of the updated transforms, the children moved by their parents included
+    uint32_t update(WrpScene& scene);
+    uint32_t update(const std::vector<TransformComponent*>& transforms);
+    // the same update by glm::sin and glm::cos, it's the reference for the vectorized version
+    uint32_t updateScalar(const std::vector<TransformComponent*>& transforms);
+
+private:
+    // the transforms are updated by chunks small enough to stay in the cache between gathering their angles
+    // and building their matrices; a multiple of the SIMD width
+    static constexpr size_t CHUNK_SIZE = 64;
+
+    // updates the translation of the transform or adds it to the chunk; returns false if it isn't dirty
+    bool gather(TransformComponent& transform);
+    // computes the sines and cosines of the gathered transforms and builds their matrices
+    void updateRotated();
+
+    std::vector<TransformComponent*> rotatedTransforms;
+    // structure of arrays of the chunk's angles and their sines and cosines: [x angles | y angles | z angles]
+    std::array<float, 3 * CHUNK_SIZE> angles{};
+    std::array<float, 3 * CHUNK_SIZE> sines{};
+    std::array<float, 3 * CHUNK_SIZE> cosines{};
+};
@@ -0,0 +1,64 @@
+#include "UniformRing.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+WrpUniformRing::WrpUniformRing(WrpDevice& device, uint32_t framesInFlight, VkDeviceSize frameCapacity)
+    : wrpDevice{device},
+      framesInFlight{framesInFlight}
+{
+    assert(framesInFlight > 0 && "Uniform ring needs at least one frame");
+
+    const VkPhysicalDeviceLimits& limits = wrpDevice.properties.limits;
+    alignment = std::max<VkDeviceSize>(limits.minUniformBufferOffsetAlignment, 1);
+    atomSize = std::max<VkDeviceSize>(limits.nonCoherentAtomSize, 1);
+    // both are powers of two, the greater one is a multiple of the other
+    VkDeviceSize regionAlignment = std::max(alignment, atomSize);
+    this->frameCapacity = (frameCapacity + regionAlignment - 1) / regionAlignment * regionAlignment;
+
+    // PROPERTY_HOST_COHERENT is not used, only the written ranges are flushed
+    buffer = std::make_unique<WrpBuffer>(
+        wrpDevice, this->frameCapacity, framesInFlight,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    buffer->map();
+    mapped = static_cast<uint8_t*>(buffer->getMappedMemory());
+}
+
+void WrpUniformRing::beginFrame(int frameIndex)
+{
+    assert(frameIndex >= 0 && static_cast<uint32_t>(frameIndex) < framesInFlight && "Invalid frame index");
+
+    frameBegin = static_cast<VkDeviceSize>(frameIndex) * frameCapacity;
+    head = frameBegin;
+    flushedHead = frameBegin;
+}
+
+WrpUniformRing::Allocation WrpUniformRing::allocate(VkDeviceSize size)
+{
+    VkDeviceSize offset = (head + alignment - 1) / alignment * alignment;
+    if (offset + size > frameBegin + frameCapacity)
+    {
+        throw std::runtime_error("Uniform ring frame capacity exceeded!");
+    }
+    head = offset + size;
+    return {mapped + offset, static_cast<uint32_t>(offset)};
+}
+
+void WrpUniformRing::flush()
+{
+    if (head == flushedHead) return;
+
+    // the range is widened to the atoms, the region boundaries are aligned to them
+    VkDeviceSize begin = flushedHead / atomSize * atomSize;
+    VkDeviceSize end = std::min((head + atomSize - 1) / atomSize * atomSize, frameBegin + frameCapacity);
+    buffer->flush(end - begin, begin);
+    flushedHead = head;
+}
+
+VkDescriptorBufferInfo WrpUniformRing::descriptorInfo(VkDeviceSize range) const
+{
+    return VkDescriptorBufferInfo{buffer->getBuffer(), 0, range};
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Buffer.hpp"
+#include "Device.hpp"
+
+// libs
+#include <vulkan/vulkan.h>
+
+// std
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+// Frame-scoped linear allocator of uniform data over one persistently mapped buffer. The buffer is split into
+// a region per frame in flight; the systems sub-allocate their per-frame, per-pass or per-draw uniforms from
+// the region of the current frame and bind them by the dynamic offsets of a VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC
+// descriptor, so one descriptor set serves all the allocations. The memory isn't coherent: flush() flushes only
+// the range written since the previous flush. The region is rewound by beginFrame(), which must be called after
+// the fence of the frame has signalled (WrpRenderer::beginFrame() waits for it), so the GPU no longer reads it.
+class WrpUniformRing
+{
+public:
+    struct Allocation
+    {
+        void* data = nullptr;
+        uint32_t offset = 0; // dynamic offset from the start of the buffer
+    };
+
+    WrpUniformRing(WrpDevice& device, uint32_t framesInFlight, VkDeviceSize frameCapacity);
+
+    WrpUniformRing(const WrpUniformRing&) = delete;
+    WrpUniformRing& operator=(const WrpUniformRing&) = delete;
+
+    void beginFrame(int frameIndex);
+    // the allocations are aligned to minUniformBufferOffsetAlignment; throws if the frame's region is full
+    Allocation allocate(VkDeviceSize size);
+    template<typename T>
+    uint32_t push(const T& data)
+    {
+        Allocation allocation = allocate(sizeof(T));
+        std::memcpy(allocation.data, &data, sizeof(T));
+        return allocation.offset;
+    }
+    void flush();
+
+    // descriptor of a dynamic uniform buffer with the given range, the offset is passed when the set is bound
+    VkDescriptorBufferInfo descriptorInfo(VkDeviceSize range) const;
+
+    VkDeviceSize getFrameCapacity() const { return frameCapacity; }
+    VkDeviceSize getFrameUsage() const { return head - frameBegin; }
+
+private:
+    WrpDevice& wrpDevice;
+    std::unique_ptr<WrpBuffer> buffer;
+    uint8_t* mapped = nullptr;
+    VkDeviceSize alignment = 1;     // of the allocations
+    VkDeviceSize atomSize = 1;      // of the flushed ranges
+    VkDeviceSize frameCapacity = 0; // size of the region of a frame, a multiple of both alignments
+    uint32_t framesInFlight = 0;
+
+    VkDeviceSize frameBegin = 0;
+    VkDeviceSize head = 0;          // end of the allocated part of the region
+    VkDeviceSize flushedHead = 0;   // end of the flushed part
+};
@@ -3,6 +3,18 @@
 #include <chrono>
 #include <ctime>
 
+uint64_t fnv1a64(const void* data, size_t size, uint64_t seed)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull; // FNV prime
+    }
+    return hash;
+}
+
 VkResult createSemaphore(VkDevice device, VkSemaphore* outSemaphore)
 {
     VkSemaphoreCreateInfo createInfo = {
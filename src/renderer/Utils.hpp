@@ -3,6 +3,7 @@
 #include "HeaderCore.hpp"
 
 // std
+#include <cstdint>
 #include <functional>
 #include <string>
 
@@ -14,6 +15,11 @@ void hashCombine(std::size_t& seed, const T& v, const Rest&... rest)
     (hashCombine(seed, rest), ...);
 }
 
+// 64-bit FNV-1a hash. Unlike std::hash its result is stable between runs and platforms,
+// so it can be used as a key for the data stored on disk. Pass the previous result as seed to hash several buffers.
+constexpr uint64_t FNV1A_64_OFFSET_BASIS = 0xcbf29ce484222325ull;
+uint64_t fnv1a64(const void* data, size_t size, uint64_t seed = FNV1A_64_OFFSET_BASIS);
+
 VkResult createSemaphore(VkDevice device, VkSemaphore* outSemaphore);
 
 std::string getTimeStampStr();
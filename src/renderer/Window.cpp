@@ -3,13 +3,18 @@
 // std
 #include <stdexcept>
 
-WrpWindow::WrpWindow(int w, int h, std::string name) : width{ w }, height{ h }, windowName{ name }
+WrpWindow::WrpWindow(int w, int h, std::string name, bool headless)
+    : width{ w }, height{ h }, headless{ headless }, windowName{ name }
 {
-    initWindow();
+    if (!headless) {
+        initWindow();
+    }
 }
 
 WrpWindow::~WrpWindow()
 {
+    if (headless) return;
+
     // Уничтожение окна и его контекста. Освобождение всех остальных ресурсов библиотеки GLFW.
     glfwDestroyWindow(window);
     glfwTerminate();
@@ -17,12 +22,23 @@ WrpWindow::~WrpWindow()
 
 void WrpWindow::createWindowSurface(VkInstance instance, VkSurfaceKHR* surface)
 {
+    if (headless)
+    {
+        throw std::runtime_error("Headless window has no surface!");
+    }
     if (glfwCreateWindowSurface(instance, window, nullptr, surface) != VK_SUCCESS)
     {
         throw std::runtime_error("Failed to create window surface!");
     }
 }
 
+bool WrpWindow::isDisplayAvailable()
+{
+    if (glfwInit() != GLFW_TRUE) return false;
+    glfwTerminate();
+    return true;
+}
+
 void WrpWindow::initWindow()
 {
     glfwSetErrorCallback([](int error, const char* description) {
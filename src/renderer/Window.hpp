@@ -11,7 +11,9 @@
 class WrpWindow
 {
 public:
-    WrpWindow(int w, int h, std::string name);
+    // A headless window has no GLFW window and no surface: the frames are rendered into offscreen images
+    // of the given size (see WrpSwapChain), GLFW isn't even initialized.
+    WrpWindow(int w, int h, std::string name, bool headless = false);
     ~WrpWindow();
 
     // Удаление copy constructor и copy operator, чтобы лишить объекты этого класса
@@ -22,7 +24,8 @@ public:
     WrpWindow(const WrpWindow&) = delete;
     WrpWindow& operator=(const WrpWindow&) = delete;
 
-    bool shouldClose() { return glfwWindowShouldClose(window); }
+    bool shouldClose() { return !headless && glfwWindowShouldClose(window); }
+    bool isHeadless() const { return headless; }
     VkExtent2D getExtent() { return { static_cast<uint32_t>(width), static_cast<uint32_t>(height) }; }
     bool wasWindowResized() { return framebufferResized; }
     void resetWindowsResizedFlag() { framebufferResized = false; }
@@ -30,6 +33,9 @@ public:
 
     void createWindowSurface(VkInstance instance, VkSurfaceKHR* surface);
 
+    // whether GLFW can create windows, e.g. false on a Linux machine without a display server
+    static bool isDisplayAvailable();
+
 private:
     // Инициализация библиотеки GLFW и окна
     void initWindow();
@@ -39,7 +45,8 @@ private:
     int width;
     int height;
     bool framebufferResized = false;  // флаг изменения размера окна
+    bool headless = false;
 
     std::string windowName;
-    GLFWwindow* window;
+    GLFWwindow* window = nullptr;
 };
@@ -7,72 +7,74 @@
 #include <glm/gtc/constants.hpp>
 
 // std
+#include <algorithm>
 #include <stdexcept>
 #include <cassert>
 #include <array>
-#include <map>
+#include <iostream>
 
-struct PointLightPushConstants
+PointLightSystem::PointLightSystem(WrpDevice& device, WrpPipelineVariantCache& pipelineVariantCache,
+    uint32_t framesInFlight, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout)
+    : wrpDevice{device}, wrpPipelineVariantCache{pipelineVariantCache}
 {
-    glm::vec4 position{};
-    glm::vec4 color{};
-    float radius{};
-};
+    billboardSetLayout = WrpDescriptorSetLayout::Builder(wrpDevice)
+        .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+        .build();
+    descriptorAllocator = WrpDescriptorAllocator::Builder(wrpDevice)
+        .setInitialSetsPerPool(framesInFlight)
+        .addPoolSizeRatio(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.f)
+        .build();
+    frames.resize(framesInFlight);
 
-PointLightSystem::PointLightSystem(WrpDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout)
-    : wrpDevice{device}
-{
     createPipelineLayout(globalSetLayout);
-    createPipeline(renderPass);
+    createPipelineKey(renderPass);
 }
 
 PointLightSystem::~PointLightSystem()
 {
+    wrpPipelineVariantCache.releaseLayout(pipelineLayout);
     vkDestroyPipelineLayout(wrpDevice.device(), pipelineLayout, nullptr);
 }
 
 void PointLightSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
 {
-    // описание диапазона пуш-констант
-    VkPushConstantRange pushConstantRange{};
-    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT; // доступ к данным констант из обоих шейдеров
-    pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(PointLightPushConstants);
-
-    std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout}; // вектор используемых схем для наборов дескрипторов
+    // вектор используемых схем для наборов дескрипторов: глобальный набор и буфер билбордов кадра,
+    // пуш-константы не нужны - данные билбордов читаются по gl_InstanceIndex
+    std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout, billboardSetLayout->getDescriptorSetLayout()};
 
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
     pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-    pipelineLayoutInfo.pushConstantRangeCount = 1;
-    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    pipelineLayoutInfo.pushConstantRangeCount = 0;
+    pipelineLayoutInfo.pPushConstantRanges = nullptr;
     if (vkCreatePipelineLayout(wrpDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
     {
         throw std::runtime_error("failed to create pipeline layout!");
     }
 }
 
-void PointLightSystem::createPipeline(VkRenderPass renderPass)
+void PointLightSystem::createPipelineKey(VkRenderPass renderPass)
 {
     assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 
-    PipelineConfigInfo pipelineConfig{};
-    WrpPipeline::defaultPipelineConfigInfo(pipelineConfig);
-    WrpPipeline::enableAlphaBlending(pipelineConfig);
-    pipelineConfig.bindingDescriptions.clear();   // массивы с привязками и атрибутами буфера вершин очищаем, т.к.
-    pipelineConfig.attributeDescriptions.clear(); // они не нужны в PointLightSystem с билбордами
-    pipelineConfig.renderPass = renderPass;
-    pipelineConfig.pipelineLayout = pipelineLayout;
+    pipelineKey.vertShader = "PointLight.vert";
+    pipelineKey.fragShader = "PointLight.frag";
+    pipelineKey.pipelineLayout = pipelineLayout;
+    pipelineKey.renderPass = renderPass;
+    pipelineKey.alphaBlending = true;
+    pipelineKey.hasVertexInput = false; // привязки и атрибуты буфера вершин не нужны в PointLightSystem с билбордами
 
-    wrpPipeline = std::make_unique<WrpPipeline>(
-        wrpDevice,
-        "PointLight.vert",
-        "PointLight.frag",
-        pipelineConfig);
+    // the pipeline is compiled in background and awaited before the first use
+    wrpPipelineVariantCache.prewarm({pipelineKey});
+}
+
+void PointLightSystem::awaitPipelines()
+{
+    wrpPipelineVariantCache.get(pipelineKey);
 }
 
-void PointLightSystem::update(FrameInfo& frameInfo, GlobalUbo& ubo)
+void PointLightSystem::moveCarousel(FrameInfo& frameInfo)
 {
     // матрица преобразования для вращения объектов точечного света
     auto rotateLight = glm::rotate(
@@ -81,78 +83,105 @@ void PointLightSystem::update(FrameInfo& frameInfo, GlobalUbo& ubo)
         {0.f, -1.f, 0.f} // ось вращения (y == -1, значит вращение вокруг Up-вектора)
     );
 
-    int lightIndex = 0;
-    for (auto& kv : frameInfo.sceneObjects)
-    {
-        auto& obj = kv.second;
-        if (obj.pointLight == nullptr) continue;
-
-        assert(lightIndex < MAX_LIGHTS && "Point Lights exceed maximum specified");
-
-        // обновление позиции PointLight'а в карусели, если она включена
-        if (obj.pointLight->carouselEnabled == true)
-            obj.transform.translation = glm::vec3(rotateLight * glm::vec4(obj.transform.translation, 1.f));
-
-        // копируем текущие данные об объекте Point Light'а в Ubo структуру
-        ubo.pointLights[lightIndex].position = glm::vec4(obj.transform.translation, 1.f);
-        ubo.pointLights[lightIndex].color = glm::vec4(obj.color, obj.pointLight->lightIntensity);
-
-        lightIndex += 1;
-    }
-
-    ubo.numLights = lightIndex;
+    // обновление позиции PointLight'а в карусели, если она включена; у дочерних источников вращение идёт вокруг родителя
+    frameInfo.scene.each<PointLightComponent>([&](WrpEntity, PointLightComponent& pointLight, TransformComponent& transform) {
+        if (pointLight.carouselEnabled == true)
+            transform.translation = glm::vec3(rotateLight * glm::vec4(transform.translation, 1.f));
+    });
 }
 
-void PointLightSystem::render(FrameInfo& frameInfo)
+void PointLightSystem::update(FrameInfo& frameInfo)
 {
-    // Автоматическа сортировка PointLight'ов в мапе по их дистанции до камеры.
-    // Это нужно для поочерёдного порядка их отрисовки, начиная с дальних билбордов,
-    // а затем для их дальнейшего правильного смешивания цветов в ColorBlend этапе.
-    std::map<float, SceneObject::id_t> sorted;
-    for (auto& kv : frameInfo.sceneObjects)
+    lights.clear();
+    billboards.clear();
+    uint32_t droppedCount = 0;
+    frameInfo.scene.each<PointLightComponent>([&](WrpEntity, PointLightComponent& pointLight, TransformComponent& transform) {
+        // копируем текущие данные об объекте Point Light'а, радиус влияния определяется его яркостью
+        glm::vec3 position = glm::vec3(transform.modelMatrix()[3]);
+        PointLight light{};
+        light.position = glm::vec4(position,
+            WrpClusteredLighting::lightRadius(pointLight.color, pointLight.lightIntensity));
+        light.color = glm::vec4(pointLight.color, pointLight.lightIntensity);
+        // the light buffer holds MAX_LIGHTS, the lights over it don't light the scene but their billboards are drawn
+        if (lights.size() < MAX_LIGHTS) {
+            lights.push_back(light);
+        }
+        else {
+            droppedCount++;
+        }
+
+        // радиус видимого билборда хранится в X-компоненте scale'а
+        PointLightBillboard billboard{};
+        billboard.position = glm::vec4(position, transform.scale.x);
+        billboard.color = light.color;
+        billboards.push_back(billboard);
+    });
+
+    if (droppedCount > 0 && !lightLimitWarned)
     {
-        auto& obj = kv.second;
-        if (obj.pointLight == nullptr) continue;
+        std::cout << "Point lights exceed the maximum of " << MAX_LIGHTS << ", " << droppedCount
+            << " of them are ignored." << std::endl;
+        lightLimitWarned = true;
+    }
+}
 
-        // вычисление дистанции до камеры
-        auto offset = frameInfo.camera.getPosition() - obj.transform.translation;
-        float disSquared = glm::dot(offset, offset);
-        sorted[disSquared] = obj.getId();
+void PointLightSystem::render(FrameInfo& frameInfo, WrpRenderQueue& renderQueue)
+{
+    uint32_t count = static_cast<uint32_t>(billboards.size());
+    if (count == 0) return;
+
+    // Билборды поинт лайтов сортируются по их дистанции до камеры, начиная с дальних, для правильного
+    // смешивания цветов в ColorBlend этапе. Сортировка устойчивая, билборды на равной дистанции не теряются.
+    billboardDistances.resize(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        billboardDistances[i] = glm::length(frameInfo.camera.getPosition() - glm::vec3(billboards[i].position));
+    }
+    depthSorter.sortBackToFront(billboardDistances.data(), count);
+
+    FrameBuffers& frame = frames[frameInfo.frameIndex];
+    reserve(frame, count);
+    const std::vector<uint32_t>& order = depthSorter.getOrder();
+    PointLightBillboard* sortedBillboards = static_cast<PointLightBillboard*>(frame.billboards->getMappedMemory());
+    for (uint32_t i = 0; i < count; ++i) {
+        sortedBillboards[i] = billboards[order[i]];
     }
+    frame.billboards->flush();
+
+    // all billboards are one draw, it's ordered among the translucent draws by the farthest billboard
+    WrpDrawItem item{};
+    item.pipeline = wrpPipelineVariantCache.get(pipelineKey)->getPipeline();
+    item.pipelineLayout = pipelineLayout;
+    item.descriptorSets[0] = frameInfo.globalDescriptorSet;
+    item.dynamicOffsets[0] = frameInfo.globalUboOffset;
+    item.dynamicOffsetSets = 1u << 0;
+    item.descriptorSets[1] = frame.descriptorSet;
+    item.descriptorSetCount = 2;
+    item.command = WrpDrawItem::Command::Draw;
+    item.count = 6;
+    item.instanceCount = count;
+    item.sortKey = WrpRenderQueue::makeSortKey(WrpRenderQueue::PASS_TRANSLUCENT, renderQueue.pipelineId(item.pipeline),
+        0, 0, WrpRenderQueue::backToFrontDepth(billboardDistances[order[0]]));
+    renderQueue.submit(item);
+}
 
-    // render objects
-    wrpPipeline->bind(frameInfo.commandBuffer);  // прикрепление графического пайплайна к буферу команд
-
-    // привязываем набор дескрипторов к пайплайну
-    vkCmdBindDescriptorSets(
-        frameInfo.commandBuffer,
-        VK_PIPELINE_BIND_POINT_GRAPHICS,
-        pipelineLayout,
-        0,
-        1,
-        &frameInfo.globalDescriptorSet,
-        0,
-        nullptr
-    );
+// The buffers of a frame aren't used by GPU anymore when its frame index comes around again,
+// so they can be recreated right away.
+void PointLightSystem::reserve(FrameBuffers& frame, uint32_t count)
+{
+    if (frame.capacity >= count) return;
 
-    // Отрисовываем билборды поинт лайтов в обратном порядке (от самого дальнего, до самого близкого к камере)
-    for (auto it = sorted.rbegin(); it != sorted.rend(); ++it)
-    {
-        auto& obj = frameInfo.sceneObjects.at(it->second);
-
-        PointLightPushConstants push{};
-        push.position = glm::vec4(obj.transform.translation, 1.f);
-        push.color = glm::vec4(obj.color, obj.pointLight->lightIntensity);
-        push.radius = obj.transform.scale.x;
-
-        vkCmdPushConstants(
-            frameInfo.commandBuffer,
-            pipelineLayout,
-            VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-            0,
-            sizeof(PointLightPushConstants),
-            &push
-        );
-        vkCmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
-    }
+    frame.capacity = std::max({count, frame.capacity * 2, MIN_BILLBOARD_CAPACITY});
+    frame.billboards = std::make_unique<WrpBuffer>(
+        wrpDevice,
+        sizeof(PointLightBillboard),
+        frame.capacity,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    frame.billboards->map();
+
+    VkDescriptorBufferInfo billboardsInfo = frame.billboards->descriptorInfo();
+    WrpDescriptorWriter writer(*billboardSetLayout, *descriptorAllocator);
+    writer.writeBuffer(0, &billboardsInfo);
+    if (frame.descriptorSet == VK_NULL_HANDLE) writer.build(frame.descriptorSet);
+    else writer.overwrite(frame.descriptorSet);
 }
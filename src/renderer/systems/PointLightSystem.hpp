@@ -1,19 +1,29 @@
 #pragma once
 
+#include "../Buffer.hpp"
+#include "../DepthSorter.hpp"
+#include "../Descriptors.hpp"
 #include "../Pipeline.hpp"
+#include "../PipelineVariantCache.hpp"
 #include "../Device.hpp"
-#include "../SceneObject.hpp"
+#include "../Scene.hpp"
 #include "../FrameInfo.hpp"
 #include "../Camera.hpp"
+#include "../RenderQueue.hpp"
+#include "../ClusteredLighting.hpp"
 
 // std
 #include <memory>
 #include <vector>
 
+// Moves the demo carousel, collects the point lights for WrpClusteredLighting and draws their billboards.
+// All billboards are one instanced draw: they're sorted back to front by WrpDepthSorter and written into
+// the frame's storage buffer (set 1), PointLight.vert reads them by gl_InstanceIndex.
 class PointLightSystem
 {
 public:
-    PointLightSystem(WrpDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
+    PointLightSystem(WrpDevice& device, WrpPipelineVariantCache& pipelineVariantCache, uint32_t framesInFlight,
+        VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
     ~PointLightSystem();
 
     // Избавляемся от copy operator и copy constrcutor, т.к. PointLightSystem хранит в себе указатели
@@ -21,15 +31,48 @@ public:
     PointLightSystem(const PointLightSystem&) = delete;
     PointLightSystem& operator=(const PointLightSystem&) = delete;
 
-    void update(FrameInfo& frameInfo, GlobalUbo& ubo);
-    void render(FrameInfo& frameInfo);
+    // moves the lights of the carousel, before the transforms are updated
+    void moveCarousel(FrameInfo& frameInfo);
+    // collects the scene's point lights at their world positions, after the transforms are updated; see getLights()
+    void update(FrameInfo& frameInfo);
+    // sorts the billboards back to front and submits them to the queue as one translucent instanced draw
+    void render(FrameInfo& frameInfo, WrpRenderQueue& renderQueue);
+    // blocks until the pipeline is created
+    void awaitPipelines();
+
+    // the lights collected by the last update(), at most MAX_LIGHTS, uploaded by WrpClusteredLighting::update()
+    const std::vector<PointLight>& getLights() const { return lights; }
 
 private:
+    static constexpr uint32_t MIN_BILLBOARD_CAPACITY = 64;
+
+    // the billboards of a frame in flight, sorted back to front
+    struct FrameBuffers
+    {
+        std::unique_ptr<WrpBuffer> billboards;
+        uint32_t capacity = 0;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    };
+
     void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
-    void createPipeline(VkRenderPass renderPass);
+    void createPipelineKey(VkRenderPass renderPass);
+    // grows the billboard buffer of the frame and rewrites its descriptor set
+    void reserve(FrameBuffers& frame, uint32_t count);
 
     WrpDevice& wrpDevice;
+    WrpPipelineVariantCache& wrpPipelineVariantCache;
 
-    std::unique_ptr<WrpPipeline> wrpPipeline;
+    PipelineVariantKey pipelineKey{};
     VkPipelineLayout pipelineLayout;
+
+    std::unique_ptr<WrpDescriptorSetLayout> billboardSetLayout;
+    std::unique_ptr<WrpDescriptorAllocator> descriptorAllocator;
+    std::vector<FrameBuffers> frames; // indexed by frame index
+
+    std::vector<PointLight> lights; // up to MAX_LIGHTS
+    bool lightLimitWarned = false;  // the dropped lights are reported once
+    // the billboards collected by update() and their distances to the camera
+    std::vector<PointLightBillboard> billboards;
+    std::vector<float> billboardDistances;
+    WrpDepthSorter depthSorter;
 };
@@ -11,18 +11,25 @@
 #include <cassert>
 #include <array>
 
-SimpleRenderSystem::SimpleRenderSystem(WrpDevice& device, WrpRenderer& renderer,
+SimpleRenderSystem::SimpleRenderSystem(WrpDevice& device, WrpRenderer& renderer, WrpPipelineVariantCache& pipelineVariantCache,
     VkDescriptorSetLayout globalDescriptorSetLayout)
-    : wrpDevice{device}, wrpRenderer{renderer}
+    : wrpDevice{device}, wrpRenderer{renderer}, wrpPipelineVariantCache{pipelineVariantCache},
+    drawBatcher{device, renderer.getFramesInFlight(), globalDescriptorSetLayout},
+    occlusionCulling{device, drawBatcher, renderer.getFramesInFlight(), globalDescriptorSetLayout}
 {
     createPipelineLayout(globalDescriptorSetLayout);
-    wrpPipelineLambertian = createPipeline(renderer.getSwapChainRenderPass(), 0, 0);
-    wrpPipelineBlinnPhong = createPipeline(renderer.getSwapChainRenderPass(), 1, 0);
-    wrpPipelineTorranceSparrow = createPipeline(renderer.getSwapChainRenderPass(), 2, 0);
+
+    // pipelines for the default settings are compiled in background and awaited before the first use
+    std::vector<PipelineVariantKey> keys;
+    for (int reflectionModel = 0; reflectionModel < 3; ++reflectionModel) {
+        keys.push_back(pipelineKey(reflectionModel, VK_POLYGON_MODE_FILL));
+    }
+    wrpPipelineVariantCache.prewarm(keys);
 }
 
 SimpleRenderSystem::~SimpleRenderSystem()
 {
+    wrpPipelineVariantCache.releaseLayout(pipelineLayout);
     vkDestroyPipelineLayout(wrpDevice.device(), pipelineLayout, nullptr);
 }
 
@@ -30,12 +37,13 @@ void SimpleRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalDescri
 {
     // описание диапазона пуш-констант
     VkPushConstantRange pushConstantRange{};
-    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT; // доступ к данным констант из обоих шейдеров
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT; // индекс первой отрисовки читается только вершинным шейдером
     pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(SimplePushConstantData);
+    pushConstantRange.size = sizeof(DrawPushConstants);
 
     // используемые схемы наборов дескрипторов
-    std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalDescriptorSetLayout};
+    std::vector<VkDescriptorSetLayout> descriptorSetLayouts{
+        globalDescriptorSetLayout, drawBatcher.getDescriptorSetLayout()};
 
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -54,78 +62,156 @@ void SimpleRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalDescri
     }
 }
 
-std::unique_ptr<WrpPipeline>
-SimpleRenderSystem::createPipeline(VkRenderPass renderPass, int reflectionModel, int polygonFillMode)
+PipelineVariantKey SimpleRenderSystem::pipelineKey(int reflectionModel, int polygonFillMode, bool depthPrepass) const
 {
     assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout.");
 
-    PipelineConfigInfo pipelineConfig{};
-    WrpPipeline::defaultPipelineConfigInfo(pipelineConfig);
-    pipelineConfig.renderPass = renderPass;
-    pipelineConfig.pipelineLayout = pipelineLayout;
-    pipelineConfig.rasterizationInfo.polygonMode = (VkPolygonMode)polygonFillMode;
-
-    std::string vertPath = "NoTexture.vert";
-    std::string fragPath;
-    if (reflectionModel == 0) fragPath = "NoTextureLambertian.frag";
-    else if (reflectionModel == 1) fragPath = "NoTextureBlinnPhong.frag";
-    else if (reflectionModel == 2) fragPath = "NoTextureTorranceSparrow.frag";
+    PipelineVariantKey key{};
+    key.vertShader = "NoTexture.vert";
+    if (reflectionModel == 0) key.fragShader = "NoTextureLambertian.frag";
+    else if (reflectionModel == 1) key.fragShader = "NoTextureBlinnPhong.frag";
+    else if (reflectionModel == 2) key.fragShader = "NoTextureTorranceSparrow.frag";
+    key.pipelineLayout = pipelineLayout;
+    key.renderPass = wrpRenderer.getSwapChainRenderPass();
+    key.polygonMode = (VkPolygonMode)polygonFillMode;
+    if (depthPrepass)
+    {
+        // the depth is written by the pre-pass, only the nearest fragment of every pixel is shaded
+        key.depthWrite = false;
+        key.depthCompareOp = VK_COMPARE_OP_EQUAL;
+    }
+    return key;
+}
 
-    return std::make_unique<WrpPipeline>(wrpDevice, vertPath, fragPath, pipelineConfig);
+PipelineVariantKey SimpleRenderSystem::depthPrepassKey(int polygonFillMode) const
+{
+    PipelineVariantKey key{};
+    key.vertShader = "NoTextureDepth.vert";
+    key.fragShader = "DepthOnly.frag";
+    key.pipelineLayout = pipelineLayout;
+    key.renderPass = wrpRenderer.getSwapChainRenderPass();
+    key.polygonMode = (VkPolygonMode)polygonFillMode;
+    key.positionOnly = true;
+    key.colorWrite = false;
+    return key;
 }
 
-void SimpleRenderSystem::renderSceneObjects(FrameInfo& frameInfo)
+void SimpleRenderSystem::awaitPipelines()
 {
-    // recreate pipelines with rendering settings changes
-    if (curPlgnFillMode != frameInfo.renderingSettings.polygonFillMode) {
-        // wait for graphics queue to complete before recreating new pipelines
-        vkQueueWaitIdle(wrpDevice.graphicsQueue());
-        int polygonFillMode = frameInfo.renderingSettings.polygonFillMode;
-        wrpPipelineLambertian = createPipeline(wrpRenderer.getSwapChainRenderPass(), 0, polygonFillMode);
-        wrpPipelineBlinnPhong = createPipeline(wrpRenderer.getSwapChainRenderPass(), 1, polygonFillMode);
-        wrpPipelineTorranceSparrow = createPipeline(wrpRenderer.getSwapChainRenderPass(), 2, polygonFillMode);
-        curPlgnFillMode = polygonFillMode;
+    for (int reflectionModel = 0; reflectionModel < 3; ++reflectionModel) {
+        wrpPipelineVariantCache.get(pipelineKey(reflectionModel, VK_POLYGON_MODE_FILL));
     }
+}
 
-    // прикрепление графического пайплайна к буферу команд
-    if (frameInfo.renderingSettings.reflectionModel == 0)
-        wrpPipelineLambertian->bind(frameInfo.commandBuffer);
-    else if (frameInfo.renderingSettings.reflectionModel == 1)
-        wrpPipelineBlinnPhong->bind(frameInfo.commandBuffer);
-    else if (frameInfo.renderingSettings.reflectionModel == 2)
-        wrpPipelineTorranceSparrow->bind(frameInfo.commandBuffer);
-
-    // привязываем набор дескрипторов к пайплайну
-    vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-        pipelineLayout, 0, 1, &frameInfo.globalDescriptorSet, 0, nullptr);
+void SimpleRenderSystem::prewarmPipelineVariants()
+{
+    std::vector<PipelineVariantKey> keys;
+    for (int polygonFillMode : {VK_POLYGON_MODE_LINE, VK_POLYGON_MODE_POINT}) {
+        for (int reflectionModel = 0; reflectionModel < 3; ++reflectionModel) {
+            keys.push_back(pipelineKey(reflectionModel, polygonFillMode));
+        }
+    }
+    keys.push_back(depthPrepassKey(VK_POLYGON_MODE_FILL));
+    for (int reflectionModel = 0; reflectionModel < 3; ++reflectionModel) {
+        keys.push_back(pipelineKey(reflectionModel, VK_POLYGON_MODE_FILL, true));
+    }
+    wrpPipelineVariantCache.prewarm(keys);
+}
 
-    for (auto& kv : frameInfo.sceneObjects)
-    {
-        auto& obj = kv.second; // ссылка на объект из мапы
+void SimpleRenderSystem::prepareSceneObjects(FrameInfo& frameInfo)
+{
+    // плоскости пирамиды видимости камеры для отсечения объектов на CPU
+    std::array<glm::vec4, 6> frustumPlanes = frameInfo.camera.getFrustumPlanes();
+    const std::array<glm::vec4, 6>* cullingFrustum = frameInfo.renderingSettings.cpuCulling ? &frustumPlanes : nullptr;
 
+    drawBatcher.begin();
+    auto addObject = [this](WrpEntity entity, ModelComponent& component, TransformComponent& transform) {
         // В данной системе рендерятся только объекты с моделями без материала (и, соответственно, текстур)
-        if (obj.model == nullptr || obj.model->hasTextures == true) continue;
-
-        SimplePushConstantData push{};
-        push.modelMatrix = obj.transform.modelMatrix();
-        push.normalMatrix = obj.transform.normalMatrix();
-
-        for (auto& info : obj.model->getSubMeshesInfos())
-        {
-            push.diffuseColor = info.diffuseColor;
-
-            vkCmdPushConstants(
-                frameInfo.commandBuffer,
-                pipelineLayout,
-                VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-                0,
-                sizeof(SimplePushConstantData),
-                &push);
-
-            // прикрепление буфера вершин (модели) и буфера индексов к буферу команд (создание привязки)
-            obj.model->bind(frameInfo.commandBuffer);
-            // отрисовка буфера вершин
-            obj.model->drawIndexed(frameInfo.commandBuffer, info.indexCount, info.indexStart);
+        if (component.model == nullptr || component.model->hasTextures == true) return;
+        drawBatcher.add(entity, *component.model, transform);
+    };
+    WrpScene& scene = frameInfo.scene;
+    if (cullingFrustum && frameInfo.sceneBvh)
+    {
+        // объекты вне пирамиды видимости отсекаются целиком по BVH, их сабмеши не проверяются
+        frameInfo.sceneBvh->queryFrustum(frustumPlanes, [&](uint64_t userData) {
+            WrpEntity entity = static_cast<WrpEntity>(userData);
+            if (ModelComponent* component = scene.models.find(entity)) {
+                addObject(entity, *component, scene.getTransform(entity));
+            }
+        });
+    }
+    else
+    {
+        // модели сцены хранятся подряд в своём массиве
+        scene.each<ModelComponent>(addObject);
+    }
+    drawBatcher.upload(frameInfo.frameIndex, [](WrpModel& model, uint32_t subMeshIndex) {
+        DrawMaterialData material{};
+        material.diffuseColor = glm::vec4(model.getSubMeshesInfos()[subMeshIndex].diffuseColor, 1.f);
+        return material;
+    }, cullingFrustum);
+
+    // невидимые копии отбрасываются вычислительным шейдером до начала прохода рендера
+    occlusionCulled = false;
+    if (frameInfo.renderingSettings.gpuCulling && frameInfo.renderingSettings.instancing)
+    {
+        if (frameInfo.depthPyramid) {
+            occlusionCulling.cullEarly(frameInfo.commandBuffer, frameInfo.globalDescriptorSet, frameInfo.globalUboOffset,
+                frameInfo.frameIndex, frustumPlanes);
+            occlusionCulled = true;
         }
+        else {
+            drawBatcher.cull(frameInfo.commandBuffer, frameInfo.globalDescriptorSet, frameInfo.globalUboOffset,
+                frameInfo.frameIndex, frustumPlanes);
+        }
+    }
+}
+
+void SimpleRenderSystem::prepareLateSceneObjects(FrameInfo& frameInfo)
+{
+    occlusionCulling.cullLate(frameInfo.commandBuffer, frameInfo.globalDescriptorSet, frameInfo.globalUboOffset,
+        frameInfo.frameIndex, *frameInfo.depthPyramid);
+}
+
+void SimpleRenderSystem::renderSceneObjects(FrameInfo& frameInfo, WrpRenderQueue& renderQueue)
+{
+    if (drawBatcher.isEmpty()) return; // nothing to draw
+
+    // Pipeline variant for the current rendering settings. Until it's compiled the previous variant is used,
+    // so switching the settings doesn't stall the frame or the GPU queue.
+    // The pipelines of the depth pre-pass and of the colour pass with the EQUAL test are switched to together.
+    const RenderingSettings& settings = frameInfo.renderingSettings;
+    PipelineVariantKey key = pipelineKey(settings.reflectionModel, settings.polygonFillMode, settings.depthPrepass);
+    std::optional<PipelineVariantKey> depthKey;
+    if (settings.depthPrepass) {
+        depthKey = depthPrepassKey(settings.polygonFillMode);
+    }
+    bool keyReady = wrpPipelineVariantCache.isReady(key);
+    bool depthKeyReady = !depthKey || wrpPipelineVariantCache.isReady(*depthKey);
+    if (!boundPipelineKey || (keyReady && depthKeyReady))
+    {
+        boundPipelineKey = key;
+        boundDepthPipelineKey = depthKey;
+    }
+    // графический пайплайн и набор дескрипторов, привязываемые очередью перед вызовами отрисовки
+    WrpDrawItem state{};
+    state.pipeline = wrpPipelineVariantCache.get(*boundPipelineKey)->getPipeline();
+    state.pipelineLayout = pipelineLayout;
+    state.descriptorSets[0] = frameInfo.globalDescriptorSet;
+    state.dynamicOffsets[0] = frameInfo.globalUboOffset;
+    state.dynamicOffsetSets = 1u << 0;
+    state.descriptorSetCount = 1;
+
+    // все копии и сабмеши модели рисуются одним непрямым вызовом
+    drawBatcher.submit(renderQueue, state, frameInfo.frameIndex, settings.instancing, frameInfo.camera.getPosition());
+
+    // the same draws with the depth-only pipeline are sorted before all the colour draws
+    if (boundDepthPipelineKey)
+    {
+        WrpDrawItem depthState = state;
+        depthState.pipeline = wrpPipelineVariantCache.get(*boundDepthPipelineKey)->getPipeline();
+        drawBatcher.submit(renderQueue, depthState, frameInfo.frameIndex, settings.instancing,
+            frameInfo.camera.getPosition(), WrpRenderQueue::PASS_DEPTH_PREPASS);
     }
 }
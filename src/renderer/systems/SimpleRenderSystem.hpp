@@ -1,40 +1,94 @@
 #pragma once
 
 #include "../Pipeline.hpp"
+#include "../PipelineVariantCache.hpp"
 #include "../Device.hpp"
-#include "../SceneObject.hpp"
+#include "../Scene.hpp"
 #include "../Camera.hpp"
 #include "../FrameInfo.hpp"
 #include "../Renderer.hpp"
+#include "../DrawBatcher.hpp"
+#include "../OcclusionCulling.hpp"
 
 // std
 #include <memory>
+#include <optional>
 #include <vector>
 
 class SimpleRenderSystem
 {
 public:
-    SimpleRenderSystem(WrpDevice& device, WrpRenderer& renderer,
+    SimpleRenderSystem(WrpDevice& device, WrpRenderer& renderer, WrpPipelineVariantCache& pipelineVariantCache,
         VkDescriptorSetLayout globalSetLayout);
     ~SimpleRenderSystem();
 
     SimpleRenderSystem(const SimpleRenderSystem&) = delete;
     SimpleRenderSystem& operator=(const SimpleRenderSystem&) = delete;
 
-    void renderSceneObjects(FrameInfo& frameInfo);
+    // Collects and uploads the objects of the frame and records their culling pass.
+    // It's called before the render pass begins, renderSceneObjects() then submits their draws.
+    // With FrameInfo::depthPyramid it's the early pass of the occlusion culling.
+    void prepareSceneObjects(FrameInfo& frameInfo);
+    // Records the late pass of the occlusion culling against FrameInfo::depthPyramid, it's called after the pyramid
+    // is built from the depth of the early pass. The next renderSceneObjects() draws the objects that were missed.
+    void prepareLateSceneObjects(FrameInfo& frameInfo);
+    // submits the draws of the objects to the queue of the render pass
+    void renderSceneObjects(FrameInfo& frameInfo, WrpRenderQueue& renderQueue);
+    // blocks until the pipelines needed for the first frame are created
+    void awaitPipelines();
+    // starts background creation of the pipelines for the other rendering settings
+    void prewarmPipelineVariants();
+
+    // compares the GPU culling results with a CPU reference, see WrpDrawBatcher::setCullingValidation()
+    // and WrpOcclusionCulling::setCullingValidation()
+    void setCullingValidation(bool enabled)
+    {
+        drawBatcher.setCullingValidation(enabled);
+        occlusionCulling.setCullingValidation(enabled);
+    }
+    void finishCullingValidation()
+    {
+        drawBatcher.finishCullingValidation();
+        occlusionCulling.finishCullingValidation();
+    }
+    uint64_t getCullingMismatchCount() const
+    {
+        return drawBatcher.getCullingMismatchCount() + occlusionCulling.getCullingMismatchCount();
+    }
+    uint64_t getValidatedCullingFrameCount() const
+    {
+        return drawBatcher.getValidatedFrameCount() + occlusionCulling.getValidatedFrameCount();
+    }
+
+    // draw calls submitted since the last prepareSceneObjects(), instances and triangles uploaded by it
+    uint32_t getDrawCallCount() const { return drawBatcher.getDrawCallCount(); }
+    uint32_t getInstanceCount() const { return drawBatcher.getInstanceCount(); }
+    uint64_t getTriangleCount() const { return drawBatcher.getTriangleCount(); }
+    // CPU culling results of the last prepareSceneObjects()
+    uint32_t getVisibleSubMeshCount() const { return drawBatcher.getCpuVisibleCount(); }
+    uint32_t getCulledSubMeshCount() const { return drawBatcher.getCpuCulledCount(); }
+    float getCullingCpuMs() const { return drawBatcher.getCpuCullingMs(); }
+    // occlusion culling results of a previous frame, see WrpOcclusionCulling::getOccludedCount();
+    // zero if the last prepareSceneObjects() wasn't the early pass
+    uint32_t getEarlyVisibleSubMeshCount() const { return occlusionCulled ? occlusionCulling.getEarlyVisibleCount() : 0; }
+    uint32_t getLateVisibleSubMeshCount() const { return occlusionCulled ? occlusionCulling.getLateVisibleCount() : 0; }
+    uint32_t getOccludedSubMeshCount() const { return occlusionCulled ? occlusionCulling.getOccludedCount() : 0; }
 
 private:
     void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
-    std::unique_ptr<WrpPipeline> createPipeline(
-        VkRenderPass renderPass, int reflectionModel, int polygonFillMode);
+    // with depthPrepass the colour pass only tests the depth written by the pre-pass for equality
+    PipelineVariantKey pipelineKey(int reflectionModel, int polygonFillMode, bool depthPrepass = false) const;
+    PipelineVariantKey depthPrepassKey(int polygonFillMode) const;
 
     WrpDevice& wrpDevice;
     WrpRenderer& wrpRenderer;
+    WrpPipelineVariantCache& wrpPipelineVariantCache;
+    WrpDrawBatcher drawBatcher; // object data in storage buffers, drawn by indirect draws
+    WrpOcclusionCulling occlusionCulling; // culling passes of drawBatcher with FrameInfo::depthPyramid
+    bool occlusionCulled = false;
 
-    int curPlgnFillMode = 0;
-
-    std::unique_ptr<WrpPipeline> wrpPipelineLambertian;
-    std::unique_ptr<WrpPipeline> wrpPipelineBlinnPhong;
-    std::unique_ptr<WrpPipeline> wrpPipelineTorranceSparrow;
+    // variant bound in the previous frame, it's used while the variant for the new settings is compiling
+    std::optional<PipelineVariantKey> boundPipelineKey;
+    std::optional<PipelineVariantKey> boundDepthPipelineKey; // bound together with boundPipelineKey, if it has EQUAL test
     VkPipelineLayout pipelineLayout;
 };
@@ -6,43 +6,53 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE   // GLM будет ожидать интервал нашего буфера глубины от 0 до 1 (например, для OpenGL используется интервал от -1 до 1)
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
-#include "shaderc/shaderc.h"
 
 // std
 #include <stdexcept>
 #include <cassert>
 #include <array>
-#include <iostream>
-#include <fstream>
 
-TextureRenderSystem::TextureRenderSystem(WrpDevice& device, WrpRenderer& renderer,
-    VkDescriptorSetLayout globalSetLayout, FrameInfo frameInfo) : wrpDevice{device}, wrpRenderer{renderer}, globalSetLayout{globalSetLayout}
+// index of the model's texture in the bindless array, -1 if the submesh has no such texture (or the heap is full)
+static int heapTextureIndex(const std::vector<uint32_t>& textureSlots, int modelTextureIndex)
 {
-    prevModelCount = fillModelsIds(frameInfo.sceneObjects);
-    systemDescriptorSets.resize(wrpRenderer.getSwapChainImageCount());
-    createDescriptorSets(frameInfo);
+    if (modelTextureIndex == -1 || textureSlots[modelTextureIndex] == WrpTextureHeap::INVALID_SLOT) return -1;
+    return static_cast<int>(textureSlots[modelTextureIndex]);
+}
+
+TextureRenderSystem::TextureRenderSystem(WrpDevice& device, WrpRenderer& renderer, WrpPipelineVariantCache& pipelineVariantCache,
+    VkDescriptorSetLayout globalSetLayout, FrameInfo frameInfo)
+    : wrpDevice{device}, wrpRenderer{renderer}, wrpPipelineVariantCache{pipelineVariantCache},
+    drawBatcher{device, renderer.getFramesInFlight(), globalSetLayout},
+    occlusionCulling{device, drawBatcher, renderer.getFramesInFlight(), globalSetLayout}, globalSetLayout{globalSetLayout}
+{
+    textureHeap = std::make_unique<WrpTextureHeap>(wrpDevice, wrpRenderer.getFramesInFlight());
+    fillModelsIds(frameInfo.scene);
+    updateTextureHeap(frameInfo);
     createPipelineLayout(globalSetLayout);
-    wrpPipelineLambertian = createPipeline(wrpRenderer.getSwapChainRenderPass(), 0, 0);
-    wrpPipelineBlinnPhong = createPipeline(wrpRenderer.getSwapChainRenderPass(), 1, 0);
-    wrpPipelineTorranceSparrow = createPipeline(wrpRenderer.getSwapChainRenderPass(), 2, 0);
+
+    // pipelines for the default settings are compiled in background and awaited before the first use
+    std::vector<PipelineVariantKey> keys;
+    for (int reflectionModel = 0; reflectionModel < 3; ++reflectionModel) {
+        keys.push_back(pipelineKey(reflectionModel, VK_POLYGON_MODE_FILL));
+    }
+    wrpPipelineVariantCache.prewarm(keys);
 }
 
 TextureRenderSystem::~TextureRenderSystem()
 {
+    wrpPipelineVariantCache.releaseLayout(pipelineLayout);
     vkDestroyPipelineLayout(wrpDevice.device(), pipelineLayout, nullptr);
 }
 
 void TextureRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
 {
-    // destroy the old one if it exists
-    if (pipelineLayout != nullptr) vkDestroyPipelineLayout(wrpDevice.device(), pipelineLayout, nullptr);
-
     VkPushConstantRange pushConstantRange{};
-    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT; // access to push constant from both VS and FS 
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT; // the first draw index is read by VS only
     pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(TextureSystemPushConstantData);
+    pushConstantRange.size = sizeof(DrawPushConstants);
 
-    std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout, systemDescriptorSetLayout->getDescriptorSetLayout()};
+    std::vector<VkDescriptorSetLayout> descriptorSetLayouts{
+        globalSetLayout, textureHeap->getDescriptorSetLayout(), drawBatcher.getDescriptorSetLayout()};
 
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -56,214 +66,226 @@ void TextureRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLa
     }
 }
 
-std::unique_ptr<WrpPipeline>
-TextureRenderSystem::createPipeline(VkRenderPass renderPass, int reflectionModel, int polygonFillMode)
+PipelineVariantKey TextureRenderSystem::pipelineKey(int reflectionModel, int polygonFillMode, bool depthPrepass) const
 {
     assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 
-    PipelineConfigInfo pipelineConfig{};
-    WrpPipeline::defaultPipelineConfigInfo(pipelineConfig);
-    pipelineConfig.renderPass = renderPass;
-    pipelineConfig.pipelineLayout = pipelineLayout;
-    pipelineConfig.rasterizationInfo.polygonMode = (VkPolygonMode)polygonFillMode;
+    PipelineVariantKey key{};
+    key.vertShader = "Texture.vert";
+    if (reflectionModel == 0) key.fragShader = "TextureLambertian.frag";
+    else if (reflectionModel == 1) key.fragShader = "TextureBlinnPhong.frag";
+    else if (reflectionModel == 2) key.fragShader = "TextureTorranceSparrow.frag";
+    key.pipelineLayout = pipelineLayout;
+    key.renderPass = wrpRenderer.getSwapChainRenderPass();
+    key.polygonMode = (VkPolygonMode)polygonFillMode;
+    // the shader array covers the whole heap, so the pipelines don't depend on the textures count
+    key.fragSpecializationConstants = { static_cast<int32_t>(textureHeap->getCapacity()) }; // TEXTURES_COUNT
+    if (depthPrepass)
+    {
+        // the depth is written by the pre-pass, only the nearest fragment of every pixel is shaded
+        key.depthWrite = false;
+        key.depthCompareOp = VK_COMPARE_OP_EQUAL;
+    }
+    return key;
+}
 
-    std::string vertPath = "Texture.vert";
-    ShaderModule* fragShaderModule;
-    if (reflectionModel == 0) fragShaderModule = fsModuleLambertian;
-    else if (reflectionModel == 1) fragShaderModule = fsModuleBlinnPhong;
-    else if (reflectionModel == 2) fragShaderModule = fsModuleTorranceSparrow;
+PipelineVariantKey TextureRenderSystem::depthPrepassKey(int polygonFillMode) const
+{
+    PipelineVariantKey key{};
+    key.vertShader = "TextureDepth.vert";
+    key.fragShader = "DepthOnly.frag";
+    key.pipelineLayout = pipelineLayout;
+    key.renderPass = wrpRenderer.getSwapChainRenderPass();
+    key.polygonMode = (VkPolygonMode)polygonFillMode;
+    key.positionOnly = true;
+    key.colorWrite = false;
+    return key;
+}
 
-    return std::make_unique<WrpPipeline>(wrpDevice, vertPath, "", pipelineConfig, nullptr, fragShaderModule);
+void TextureRenderSystem::awaitPipelines()
+{
+    for (int reflectionModel = 0; reflectionModel < 3; ++reflectionModel) {
+        wrpPipelineVariantCache.get(pipelineKey(reflectionModel, VK_POLYGON_MODE_FILL));
+    }
 }
 
-int TextureRenderSystem::fillModelsIds(SceneObject::Map& sceneObjects)
+void TextureRenderSystem::prewarmPipelineVariants()
+{
+    std::vector<PipelineVariantKey> keys;
+    for (int polygonFillMode : {VK_POLYGON_MODE_LINE, VK_POLYGON_MODE_POINT}) {
+        for (int reflectionModel = 0; reflectionModel < 3; ++reflectionModel) {
+            keys.push_back(pipelineKey(reflectionModel, polygonFillMode));
+        }
+    }
+    keys.push_back(depthPrepassKey(VK_POLYGON_MODE_FILL));
+    for (int reflectionModel = 0; reflectionModel < 3; ++reflectionModel) {
+        keys.push_back(pipelineKey(reflectionModel, VK_POLYGON_MODE_FILL, true));
+    }
+    wrpPipelineVariantCache.prewarm(keys);
+}
+
+int TextureRenderSystem::fillModelsIds(WrpScene& scene)
 {
     modelObjectsIds.clear();
-    for (auto& kv : sceneObjects)
+    const std::vector<WrpEntity>& entities = scene.models.entities();
+    const std::vector<ModelComponent>& models = scene.models.data();
+    for (size_t i = 0; i < models.size(); ++i)
     {
-        auto& obj = kv.second; // ссылка на объект из мапы
-        if (obj.model != nullptr && obj.model->hasTextures == true) {
-            modelObjectsIds.push_back(kv.first); // в этой системе рендерятся только объекты с текстурами
+        if (models[i].model != nullptr && models[i].model->hasTextures == true) {
+            modelObjectsIds.push_back(entities[i]); // в этой системе рендерятся только объекты с текстурами
         }
     }
     return static_cast<int>(modelObjectsIds.size());
 }
 
-void TextureRenderSystem::createDescriptorSets(FrameInfo& frameInfo)
+// Adds textures of the models that appeared in the scene to the bindless heap and frees slots
+// of the models that are not used anymore. Each change is a single descriptor write, no pipeline is recreated.
+void TextureRenderSystem::updateTextureHeap(FrameInfo& frameInfo)
 {
-    int texturesCount = 0;
-    std::vector<VkDescriptorImageInfo> descriptorImageInfos;
+    textureHeap->nextFrame();
+
+    for (auto& kv : modelTextureSlots) {
+        kv.second.isInScene = false;
+    }
 
     for (auto& id : modelObjectsIds)
     {
-        texturesCount += frameInfo.sceneObjects[id].model->getTextures().size();
-
-        // Заполнение информации по дескрипторам текстур для каждой модели
-        for (auto& texture : frameInfo.sceneObjects.at(id).model->getTextures())
+        std::shared_ptr<WrpModel>& model = frameInfo.scene.models.get(id).model;
+        auto it = modelTextureSlots.find(model.get());
+        if (it != modelTextureSlots.end() && it->second.model.lock() != model)
         {
-            VkDescriptorImageInfo imageInfo = texture->descriptorInfo();
-            descriptorImageInfos.push_back(imageInfo);
+            // the previous model at this address was destroyed
+            for (uint32_t slot : it->second.slots) textureHeap->remove(slot);
+            modelTextureSlots.erase(it);
+            it = modelTextureSlots.end();
         }
-    }
-
-    // wait for all of commands in graphics queue to complete before creating new descriptor pool and graphics pipeline eventually
-    vkQueueWaitIdle(wrpDevice.graphicsQueue());
-
-    WrpDescriptorPool::Builder poolBuilder = WrpDescriptorPool::Builder(wrpDevice)
-        .setMaxSets(wrpRenderer.getSwapChainImageCount());
-    if (texturesCount != 0) {
-        poolBuilder.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, wrpRenderer.getSwapChainImageCount() * texturesCount);
-    }
-    systemDescriptorPool = poolBuilder.build();
 
-    WrpDescriptorSetLayout::Builder setLayoutBuilder = WrpDescriptorSetLayout::Builder(wrpDevice);
-    if (texturesCount != 0) {
-        setLayoutBuilder.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, texturesCount);
+        if (it == modelTextureSlots.end())
+        {
+            ModelTextureSlots entry{};
+            entry.model = model;
+            for (auto& texture : model->getTextures()) {
+                entry.slots.push_back(textureHeap->add(texture->descriptorInfo()));
+            }
+            it = modelTextureSlots.emplace(model.get(), std::move(entry)).first;
+        }
+        it->second.isInScene = true;
     }
-    systemDescriptorSetLayout = setLayoutBuilder.build();
 
-    for (int i = 0; i < systemDescriptorSets.size(); ++i)
+    for (auto it = modelTextureSlots.begin(); it != modelTextureSlots.end();)
     {
-        WrpDescriptorWriter descriptorWriter = WrpDescriptorWriter(*systemDescriptorSetLayout, *systemDescriptorPool);
-        if (texturesCount != 0) {
-            descriptorWriter.writeImage(0, descriptorImageInfos.data(), texturesCount);
+        if (!it->second.isInScene)
+        {
+            for (uint32_t slot : it->second.slots) textureHeap->remove(slot);
+            it = modelTextureSlots.erase(it);
         }
-        descriptorWriter.build(systemDescriptorSets[i]);
+        else ++it;
     }
-
-    std::string name0 = "TextureLambertian.frag";
-    std::string name1 = "TextureBlinnPhong.frag";
-    std::string name2 = "TextureTorranceSparrow.frag";
-    rewriteAndRecompileFragShader(fsModuleLambertian, name0, texturesCount);
-    rewriteAndRecompileFragShader(fsModuleBlinnPhong, name1, texturesCount);
-    rewriteAndRecompileFragShader(fsModuleTorranceSparrow, name2, texturesCount);
 }
 
-void TextureRenderSystem::rewriteAndRecompileFragShader(
-    ShaderModule*& shaderModule, std::string fragShaderName, int texturesCount)
+void TextureRenderSystem::prepareSceneObjects(FrameInfo& frameInfo)
 {
-    std::string fragShaderPath = SHADERS_DIR + fragShaderName;
-    std::fstream shaderFile;
-    std::string shaderContent;
-    std::string line;
-    std::string macros = "#define TEXTURES_COUNT ";
-    bool isTexturesDefined = false;
-
-    shaderFile.open(fragShaderPath, std::ios::in | std::ios::app);
-    if (shaderFile.is_open())
+    // Текстуры объектов хранятся в bindless массиве, поэтому добавление и удаление объектов
+    // не требует пересоздания наборов дескрипторов и пайплайнов.
+    fillModelsIds(frameInfo.scene);
+    updateTextureHeap(frameInfo);
+
+    // плоскости пирамиды видимости камеры для отсечения объектов на CPU
+    std::array<glm::vec4, 6> frustumPlanes = frameInfo.camera.getFrustumPlanes();
+    const std::array<glm::vec4, 6>* cullingFrustum = frameInfo.renderingSettings.cpuCulling ? &frustumPlanes : nullptr;
+
+    WrpScene& scene = frameInfo.scene;
+    drawBatcher.begin();
+    if (cullingFrustum && frameInfo.sceneBvh)
     {
-        while (std::getline(shaderFile, line))
-        {
-            if (!isTexturesDefined && line.find(macros) != std::string::npos)
-            {
-                // replacing TEXTURES_COUNT
-                macros += std::to_string(texturesCount);
-                line.replace(0, line.length(), macros);
-                shaderContent += line + '\n';
-
-                // single-time adding TEXTURES define and sampler2D array to activate code with texturing
-                if (texturesCount != 0) {
-                    shaderContent += "#define TEXTURES\n";
-                    shaderContent += "layout(set = 1, binding = 0) uniform sampler2D texSampler[TEXTURES_COUNT]; // Combined Image Sampler descriptors\n";
-                }
-
-                std::cout << line << std::endl;
-                isTexturesDefined = true;
-            }
-            else
-            {
-                shaderContent += line + '\n';
+        // объекты вне пирамиды видимости отсекаются целиком по BVH, их сабмеши не проверяются
+        frameInfo.sceneBvh->queryFrustum(frustumPlanes, [&](uint64_t userData) {
+            WrpEntity entity = static_cast<WrpEntity>(userData);
+            ModelComponent* component = scene.models.find(entity);
+            if (component != nullptr && component->model != nullptr && component->model->hasTextures) {
+                drawBatcher.add(entity, *component->model, scene.getTransform(entity));
             }
+        });
+    }
+    else
+    {
+        for (WrpEntity entity : modelObjectsIds) {
+            drawBatcher.add(entity, *scene.models.get(entity).model, scene.getTransform(entity));
         }
     }
-    else std::cerr << "Shader rewriting: Your shader file couldn't be opened.";
-    shaderFile.close();
-
-    // generated shader are rewriting every time with the new textures count
-    shaderFile.open(ENGINE_DIR"src/shaders/Texture_Generated.frag", std::ios::out | std::ios::trunc);
-    if (shaderFile.is_open())
+    // Материал каждого сабмеша с индексами его текстур в bindless массиве
+    drawBatcher.upload(frameInfo.frameIndex, [this](WrpModel& model, uint32_t subMeshIndex) {
+        const std::vector<uint32_t>& textureSlots = modelTextureSlots.at(&model).slots;
+        auto& subMesh = model.getSubMeshesInfos()[subMeshIndex];
+
+        DrawMaterialData material{};
+        material.diffuseColor = glm::vec4(subMesh.diffuseColor, 1.f);
+        material.diffuseTextureIndex = heapTextureIndex(textureSlots, subMesh.diffuseTextureIndex);
+        material.specularTextureIndex = heapTextureIndex(textureSlots, subMesh.specularTextureIndex);
+        return material;
+    }, cullingFrustum);
+
+    // невидимые копии отбрасываются вычислительным шейдером до начала прохода рендера
+    occlusionCulled = false;
+    if (frameInfo.renderingSettings.gpuCulling && frameInfo.renderingSettings.instancing)
     {
-        shaderFile << shaderContent;
+        if (frameInfo.depthPyramid) {
+            occlusionCulling.cullEarly(frameInfo.commandBuffer, frameInfo.globalDescriptorSet, frameInfo.globalUboOffset,
+                frameInfo.frameIndex, frustumPlanes);
+            occlusionCulled = true;
+        }
+        else {
+            drawBatcher.cull(frameInfo.commandBuffer, frameInfo.globalDescriptorSet, frameInfo.globalUboOffset,
+                frameInfo.frameIndex, frustumPlanes);
+        }
     }
-    shaderFile.close();
-
-    shaderModule = new ShaderModule(wrpDevice, "Texture_Generated.frag");
 }
 
-void TextureRenderSystem::renderSceneObjects(FrameInfo& frameInfo)
+void TextureRenderSystem::prepareLateSceneObjects(FrameInfo& frameInfo)
 {
-    // Заполняется вектор идентификаторов объектов с текстурами, и если их кол-во изменилось, то
-    // наборы дескрипторов для этих объектов пересоздаются, а вместе с ними и пайплайн, т.к. изменяется его схема.
-    if (prevModelCount != fillModelsIds(frameInfo.sceneObjects) ||
-        curPlgnFillMode != frameInfo.renderingSettings.polygonFillMode)
-    {
-        int polygonFillMode = frameInfo.renderingSettings.polygonFillMode;
-
-        createDescriptorSets(frameInfo);
-        createPipelineLayout(globalSetLayout);
-        wrpPipelineLambertian = createPipeline(wrpRenderer.getSwapChainRenderPass(), 0, polygonFillMode);
-        wrpPipelineBlinnPhong = createPipeline(wrpRenderer.getSwapChainRenderPass(), 1, polygonFillMode);
-        wrpPipelineTorranceSparrow = createPipeline(wrpRenderer.getSwapChainRenderPass(), 2, polygonFillMode);
-
-        curPlgnFillMode = polygonFillMode;
-        prevModelCount = modelObjectsIds.size();
-    }
+    occlusionCulling.cullLate(frameInfo.commandBuffer, frameInfo.globalDescriptorSet, frameInfo.globalUboOffset,
+        frameInfo.frameIndex, *frameInfo.depthPyramid);
+}
 
-    // прикрепление графического пайплайна к буферу команд
-    if (frameInfo.renderingSettings.reflectionModel == 0) {
-        wrpPipelineLambertian->bind(frameInfo.commandBuffer);
-    }
-    else if (frameInfo.renderingSettings.reflectionModel == 1) {
-        wrpPipelineBlinnPhong->bind(frameInfo.commandBuffer);
+void TextureRenderSystem::renderSceneObjects(FrameInfo& frameInfo, WrpRenderQueue& renderQueue)
+{
+    if (drawBatcher.isEmpty()) return; // nothing to draw
+
+    // Pipeline variant for the current rendering settings. Until it's compiled the previous variant is used,
+    // so switching the settings doesn't stall the frame or the GPU queue.
+    // The pipelines of the depth pre-pass and of the colour pass with the EQUAL test are switched to together.
+    const RenderingSettings& settings = frameInfo.renderingSettings;
+    PipelineVariantKey key = pipelineKey(settings.reflectionModel, settings.polygonFillMode, settings.depthPrepass);
+    std::optional<PipelineVariantKey> depthKey;
+    if (settings.depthPrepass) {
+        depthKey = depthPrepassKey(settings.polygonFillMode);
     }
-    else if (frameInfo.renderingSettings.reflectionModel == 2) {
-        wrpPipelineTorranceSparrow->bind(frameInfo.commandBuffer);
+    bool keyReady = wrpPipelineVariantCache.isReady(key);
+    bool depthKeyReady = !depthKey || wrpPipelineVariantCache.isReady(*depthKey);
+    if (!boundPipelineKey || (keyReady && depthKeyReady))
+    {
+        boundPipelineKey = key;
+        boundDepthPipelineKey = depthKey;
     }
-
-    std::vector<VkDescriptorSet> descriptorSets{ frameInfo.globalDescriptorSet, systemDescriptorSets[frameInfo.frameIndex] };
-    // Привязываем наборы дескрипторов к пайплайну
-    vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
-        0, 2, descriptorSets.data(), 0, nullptr
-    );
-
-    int textureIndexOffset = 0; // отступ в массиве текстур для текущего объекта
-    for (auto& id : modelObjectsIds)
+    // Графический пайплайн и наборы дескрипторов, привязываемые очередью перед вызовами отрисовки
+    WrpDrawItem state{};
+    state.pipeline = wrpPipelineVariantCache.get(*boundPipelineKey)->getPipeline();
+    state.pipelineLayout = pipelineLayout;
+    state.descriptorSets[0] = frameInfo.globalDescriptorSet;
+    state.dynamicOffsets[0] = frameInfo.globalUboOffset;
+    state.dynamicOffsetSets = 1u << 0;
+    state.descriptorSets[1] = textureHeap->getDescriptorSet();
+    state.descriptorSetCount = 2;
+
+    // Все копии и подобъекты .obj модели рисуются одним непрямым вызовом
+    drawBatcher.submit(renderQueue, state, frameInfo.frameIndex, settings.instancing, frameInfo.camera.getPosition());
+
+    // the same draws with the depth-only pipeline are sorted before all the colour draws
+    if (boundDepthPipelineKey)
     {
-        auto& obj = frameInfo.sceneObjects[id];
-
-        TextureSystemPushConstantData push{};
-        push.modelMatrix = obj.transform.modelMatrix();
-        push.normalMatrix = obj.transform.normalMatrix();
-
-        // прикрепление буфера вершин (модели) и буфера индексов к буферу команд (создание привязки)
-        obj.model->bind(frameInfo.commandBuffer);
-
-        // Отрисовка каждого подобъекта .obj модели по отдельности с передачей своего индекса текстуры
-        for (auto& subMesh : obj.model->getSubMeshesInfos())
-        {
-            if (subMesh.diffuseTextureIndex != -1) {
-                push.diffTexIndex = textureIndexOffset + subMesh.diffuseTextureIndex;
-            }
-            else {
-                push.diffTexIndex = -1;
-            }
-
-            if (subMesh.specularTextureIndex != -1) {
-                push.specTexIndex = textureIndexOffset + subMesh.specularTextureIndex;
-            }
-            else {
-                push.specTexIndex = -1;
-            }
-            push.diffuseColor = subMesh.diffuseColor;	
-
-            vkCmdPushConstants(frameInfo.commandBuffer, pipelineLayout,
-                VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-                0, sizeof(TextureSystemPushConstantData), &push
-            );
-
-            // отрисовка буфера вершин
-            obj.model->drawIndexed(frameInfo.commandBuffer, subMesh.indexCount, subMesh.indexStart);
-        }
-        textureIndexOffset += obj.model->getTextures().size();
+        WrpDrawItem depthState = state;
+        depthState.pipeline = wrpPipelineVariantCache.get(*boundDepthPipelineKey)->getPipeline();
+        drawBatcher.submit(renderQueue, depthState, frameInfo.frameIndex, settings.instancing,
+            frameInfo.camera.getPosition(), WrpRenderQueue::PASS_DEPTH_PREPASS);
     }
 }
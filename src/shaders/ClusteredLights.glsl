@@ -0,0 +1,53 @@
+#ifndef CLUSTERED_LIGHTS_GLSL
+#define CLUSTERED_LIGHTS_GLSL
+
+// Point lights of the fragment's cluster for the fragment shaders. The lights are binned into view-space froxel
+// clusters by LightCulling.comp; with clustering off (globalUbo.clusterCount.w == 0) every light is iterated.
+
+#include <GlobalUbo.glsl>
+
+layout(std430, set = 0, binding = 1) readonly buffer LightBuffer {
+    PointLight lights[];
+} lightBuffer;
+
+struct LightCluster {
+    uint offset; // первый индекс источника кластера в lightIndexBuffer
+    uint count;
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer LightClusterBuffer {
+    LightCluster clusters[];
+} lightClusterBuffer;
+
+layout(std430, set = 0, binding = 3) readonly buffer LightIndexBuffer {
+    uint indices[];
+} lightIndexBuffer;
+
+LightCluster getLightCluster(vec3 posWorld) {
+    if (globalUbo.clusterCount.w == 0) {
+        return LightCluster(0, uint(globalUbo.numLights));
+    }
+
+    uvec3 count = globalUbo.clusterCount.xyz;
+    uvec2 tile = min(uvec2(gl_FragCoord.xy / globalUbo.clusterTileSize.xy), count.xy - 1);
+    float viewDepth = max((globalUbo.view * vec4(posWorld, 1.0)).z, 1e-4);
+    float slice = floor(log(viewDepth) * globalUbo.clusterSlicing.x - globalUbo.clusterSlicing.y);
+    uint z = uint(clamp(slice, 0.0, float(count.z - 1)));
+    return lightClusterBuffer.clusters[tile.x + count.x * (tile.y + count.y * z)];
+}
+
+PointLight getClusterLight(LightCluster cluster, uint i) {
+    uint index = globalUbo.clusterCount.w != 0 ? lightIndexBuffer.indices[cluster.offset + i] : i;
+    return lightBuffer.lights[index];
+}
+
+// Inverse square falloff, smoothly brought to zero at the light's radius, so the lights outside of a cluster
+// don't contribute to it. toLight is the unnormalized vector from the fragment to the light.
+float lightAttenuation(vec3 toLight, float radius) {
+    float distanceSquared = dot(toLight, toLight);
+    float ratio = distanceSquared / (radius * radius);
+    float window = clamp(1.0 - ratio * ratio, 0.0, 1.0);
+    return window * window / distanceSquared;
+}
+
+#endif
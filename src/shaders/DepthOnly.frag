@@ -0,0 +1,5 @@
+#version 450
+
+// Fragment stage of the depth pre-pass: only the depth is written, the colour attachment is masked by the pipeline.
+void main() {
+}
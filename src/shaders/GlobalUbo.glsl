@@ -0,0 +1,30 @@
+#ifndef GLOBAL_UBO_GLSL
+#define GLOBAL_UBO_GLSL
+
+// Глобальный uniform буфер кадра (GlobalUbo в FrameInfo.hpp), общий для всех шейдеров.
+// Точечные источники света хранятся в storage буфере, см. ClusteredLights.glsl.
+
+struct PointLight {
+    vec4 position; // w - радиус влияния источника
+    vec4 color;    // w - интенсивность цвета
+};
+
+layout(set = 0, binding = 0) uniform GlobalUBO {
+    mat4 projection;
+    mat4 view;
+    mat4 invView;
+    vec4 ambientLightColor;
+    float directionalLightIntensity;
+    vec4 directionalLightPosition;
+    int numLights;
+    float diffuseProportion;
+    float roughness;
+    float indexOfRefraction;
+    vec4 frustumPlanes[6]; // xyz - нормаль внутрь пирамиды видимости, w - расстояние
+    // сетка кластеров освещения (WrpClusteredLighting)
+    uvec4 clusterCount;    // xyz - число кластеров по осям; w - 0, если каждый фрагмент перебирает все источники
+    vec4 clusterTileSize;  // xy - размер тайла кластера в пикселях, zw - размер экрана в пикселях
+    vec4 clusterSlicing;   // x, y - масштаб и сдвиг логарифма глубины для индекса слоя кластеров
+} globalUbo;
+
+#endif
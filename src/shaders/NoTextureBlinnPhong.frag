@@ -8,30 +8,7 @@ layout(location = 3) in vec2 fragUv;
 
 layout(location = 0) out vec4 outColor;
 
-struct PointLight {
-    vec4 position; // w - игнорируется
-    vec4 color;    // w - интенсивность цвета
-};
-
-layout(push_constant) uniform Push {
-    mat4 modelMatrix;
-    mat4 normalMatrix;
-    vec3 diffuseColor;
-} push;
-
-layout(set = 0, binding = 0) uniform GlobalUBO {
-    mat4 projection;
-    mat4 view;
-    mat4 invView;
-    vec4 ambientLightColor;
-    float directionalLightIntensity;
-    vec4 directionalLightPosition;
-    PointLight pointLights[10];
-    int numLights;
-    float diffuseProportion;
-    float roughness;
-    float indexOfRefraction;
-} globalUbo;
+#include <ClusteredLights.glsl>
 
 // Source of directional light
 vec3 DIRECTION_TO_LIGHT = normalize(globalUbo.directionalLightPosition.xyz);
@@ -50,12 +27,14 @@ void main() {
     // Вклад направленного источника света в рассеянное освещение
     diffuseLight += max(dot(surfaceNormal, DIRECTION_TO_LIGHT), 0) * globalUbo.directionalLightIntensity;
 
-    for (int i = 0; i < globalUbo.numLights; ++i) {
-        PointLight light = globalUbo.pointLights[i];
+    // only the lights of the fragment's cluster can reach it
+    LightCluster cluster = getLightCluster(fragPosWorld);
+    for (uint i = 0; i < cluster.count; ++i) {
+        PointLight light = getClusterLight(cluster, i);
 
         // --- diffuse term ---
         vec3 directionToLight = light.position.xyz - fragPosWorld; // ещё ненормализованное направление к ист. света
-        float attenuation = 1.0 / dot(directionToLight, directionToLight); // фактор ослабевания интенсивности света = 1 / квадрат расстояния до источника
+        float attenuation = lightAttenuation(directionToLight, light.position.w); // фактор ослабевания: 1 / квадрат расстояния, обнуляемый к радиусу источника
         directionToLight = normalize(directionToLight);
         float NdotL = max(dot(surfaceNormal, directionToLight), 0); // cosine of the angle of incidence
         vec3 intensity = light.color.xyz * light.color.w * attenuation;
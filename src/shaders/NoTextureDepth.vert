@@ -0,0 +1,26 @@
+#version 450
+
+// Vertex stage of the depth pre-pass for the objects of NoTexture.vert. Only the position attribute is read.
+// gl_Position is computed by the same expression in both shaders and is invariant, so the colour pass finds
+// exactly the same depth with the EQUAL test.
+
+layout(location = 0) in vec3 position;
+
+invariant gl_Position;
+
+#include <GlobalUbo.glsl>
+
+struct InstanceData {
+    mat4 modelMatrix;
+    mat4 normalMatrix;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer InstanceBuffer {
+    InstanceData instances[];
+} instanceBuffer;
+
+void main() {
+    InstanceData instance = instanceBuffer.instances[gl_InstanceIndex];
+    vec4 positionWorld = instance.modelMatrix * vec4(position, 1.0);
+    gl_Position = globalUbo.projection * globalUbo.view * positionWorld;
+}
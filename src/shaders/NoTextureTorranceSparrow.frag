@@ -7,30 +7,7 @@ layout(location = 3) in vec2 fragUv;
 
 layout(location = 0) out vec4 outColor;
 
-struct PointLight {
-    vec4 position; // w - ignored
-    vec4 color;    // w - color intensity
-};
-
-layout(push_constant) uniform Push {
-    mat4 modelMatrix;
-    mat4 normalMatrix;
-    vec3 diffuseColor;
-} push;
-
-layout(set = 0, binding = 0) uniform GlobalUBO {
-    mat4 projection;
-    mat4 view;
-    mat4 invView;
-    vec4 ambientLightColor;
-    float directionalLightIntensity;
-    vec4 directionalLightPosition;
-    PointLight pointLights[10];
-    int numLights;
-    float diffuseProportion;
-    float roughness;
-    float indexOfRefraction;
-} globalUbo;
+#include <ClusteredLights.glsl>
 
 // --- Functions ---
 // Geometrical attenuation - Schlick-GGX
@@ -62,11 +39,13 @@ void main() {
     // Directional light contribution
     diffuseLight += max(dot(surfaceNormal, DIRECTION_TO_LIGHT), 0) * globalUbo.directionalLightIntensity;
 
-    for (int i = 0; i < globalUbo.numLights; ++i) {
-        PointLight light = globalUbo.pointLights[i];
+    // only the lights of the fragment's cluster can reach it
+    LightCluster cluster = getLightCluster(fragPosWorld);
+    for (uint i = 0; i < cluster.count; ++i) {
+        PointLight light = getClusterLight(cluster, i);
 
         vec3 directionToLight = light.position.xyz - fragPosWorld;
-        float attenuation = 1.0 / dot(directionToLight, directionToLight); // intensity attenuation factor
+        float attenuation = lightAttenuation(directionToLight, light.position.w); // intensity attenuation factor
         directionToLight = normalize(directionToLight);
         float NdotL = max(dot(surfaceNormal, directionToLight), 0.0); // cosine of the angle of incidence 
         vec3 intensity = light.color.xyz * light.color.w * attenuation;
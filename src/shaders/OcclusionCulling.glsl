@@ -0,0 +1,73 @@
+#ifndef OCCLUSION_CULLING_GLSL
+#define OCCLUSION_CULLING_GLSL
+
+// Declarations of the two-phase occlusion culling passes (WrpOcclusionCulling). A thread per (object, submesh) pair
+// appends the visible instance to the draw's slots of the culled instances through the culling set of the batcher
+// (the bindings of FrustumCulling.comp), phase 1 of FrustumCulling.comp then writes the commands.
+
+#include <GlobalUbo.glsl>
+
+struct InstanceData {
+    mat4 modelMatrix;
+    mat4 normalMatrix;
+};
+
+struct CullItem {
+    uint instance;
+    uint draw;
+    uint padding0;
+    uint padding1;
+};
+
+struct DrawCullData {
+    vec4 boundingSphere; // xyz - центр в пространстве модели, w - радиус
+    uint indexCount;
+    uint firstIndex;
+    uint culledFirstInstance;
+    uint groupIndex;
+    uint groupFirstDraw;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer InstanceBuffer { InstanceData instances[]; } instanceBuffer;
+layout(std430, set = 1, binding = 2) readonly buffer DrawCullBuffer { DrawCullData draws[]; } drawCullBuffer;
+layout(std430, set = 1, binding = 3) readonly buffer CullItemBuffer { CullItem items[]; } cullItemBuffer;
+layout(std430, set = 1, binding = 4) buffer VisibleCountBuffer { uint counts[]; } visibleCountBuffer;
+layout(std430, set = 1, binding = 6) writeonly buffer CulledInstanceBuffer { InstanceData instances[]; } culledInstanceBuffer;
+
+layout(std430, set = 2, binding = 0) buffer VisibilityBuffer { uint visible[]; } visibilityBuffer;
+// видимость пары в прошлом кадре: visibilityBuffer.visible[itemSlotBuffer.slots[номер пары]]
+layout(std430, set = 2, binding = 1) readonly buffer ItemSlotBuffer { uint slots[]; } itemSlotBuffer;
+layout(std430, set = 2, binding = 2) buffer OcclusionStatsBuffer {
+    uint earlyVisible;
+    uint lateVisible;
+    uint occluded;
+} occlusionStats;
+
+layout(push_constant) uniform Push {
+    uint count;
+} push;
+
+bool isSphereVisible(vec3 center, float radius) {
+    for (int i = 0; i < 6; ++i) {
+        vec4 plane = globalUbo.frustumPlanes[i];
+        if (dot(plane.xyz, center) + plane.w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// сфера переводится в мировое пространство, радиус умножается на наибольший масштаб по осям
+vec4 worldBoundingSphere(InstanceData instance, DrawCullData draw) {
+    vec3 center = (instance.modelMatrix * vec4(draw.boundingSphere.xyz, 1.0)).xyz;
+    float scale = max(max(length(instance.modelMatrix[0].xyz), length(instance.modelMatrix[1].xyz)),
+        length(instance.modelMatrix[2].xyz));
+    return vec4(center, draw.boundingSphere.w * scale);
+}
+
+void appendInstance(InstanceData instance, uint drawIndex, DrawCullData draw) {
+    uint slot = atomicAdd(visibleCountBuffer.counts[drawIndex], 1);
+    culledInstanceBuffer.instances[draw.culledFirstInstance + slot] = instance;
+}
+
+#endif
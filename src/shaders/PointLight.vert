@@ -13,51 +13,41 @@ const vec2 OFFSETS[6] = vec2[](
 
 // Выходная переменная отступа, которая будет линейно интерполирована во frag шейдере
 layout (location = 0) out vec2 fragOffset;
+layout (location = 1) flat out vec4 fragColor;
  
-struct PointLight {
-    vec4 position; // w - игнорируется
-    vec4 color;    // w - интенсивность цвета
+// Ubo объект такой же как и в simple shader
+#include <GlobalUbo.glsl>
+
+// Билборды всех точечных источников, отсортированные от дальних к ближним (PointLightBillboard)
+struct PointLightBillboard {
+    vec4 position; // w - радиус билборда
+    vec4 color;    // w - интенсивность
 };
 
-// Ubo объект такой же как и в simple shader
-layout(set = 0, binding = 0) uniform GlobalUBO {
-    mat4 projection;
-    mat4 view;
-    mat4 invView;
-    vec4 ambientLightColor;
-    PointLight pointLights[10];
-    int numLights;
-    float diffuseProportion;
-    float roughness;
-    float indexOfRefraction;
-} ubo;
-
-// Пришедшая структура пуш-констант
-layout(push_constant) uniform Push {
-    vec4 position;
-    vec4 color;
-    float radius;
-} push;
+layout(std430, set = 1, binding = 0) readonly buffer BillboardBuffer { PointLightBillboard billboards[]; } billboardBuffer;
 
 void main() {
     fragOffset = OFFSETS[gl_VertexIndex]; // gl_VertexIndex хранит индекс текущей обрабатываемой вершины
+    PointLightBillboard billboard = billboardBuffer.billboards[gl_InstanceIndex]; // один инстанс на билборд
+    fragColor = billboard.color;
 
     // Извелечение векторов "вверх" и "вправо" из View матрицы (в данный момент это World Space)
-    vec3 cameraRightWorld = {ubo.view[0][0], ubo.view[1][0], ubo.view[2][0]};
-    vec3 cameraUpWorld = {ubo.view[0][1], ubo.view[1][1], ubo.view[2][1]};
+    vec3 cameraRightWorld = {globalUbo.view[0][0], globalUbo.view[1][0], globalUbo.view[2][0]};
+    vec3 cameraUpWorld = {globalUbo.view[0][1], globalUbo.view[1][1], globalUbo.view[2][1]};
 
     // Вычисление позиции вершины билборда в мировом пространстве
-    vec3 positionWorld = push.position.xyz + push.radius * fragOffset.x * cameraRightWorld
-        + push.radius * fragOffset.y * cameraUpWorld;
+    float radius = billboard.position.w;
+    vec3 positionWorld = billboard.position.xyz + radius * fragOffset.x * cameraRightWorld
+        + radius * fragOffset.y * cameraUpWorld;
 
     // Перевод положения полученной вершины Point Light билборда в каноническое пространство
-    gl_Position = ubo.projection * ubo.view * vec4(positionWorld, 1.0);
+    gl_Position = globalUbo.projection * globalUbo.view * vec4(positionWorld, 1.0);
 
     /* Альтернативный вариант вычисления позиции вершины.
        Сначала позиция Point Light'а преобразуется в пространство камеры, затем
        в этом пространстве на неё применяется отступ и мы получаем позицию вершины
        в пространстве камеры. В конце полученная вершина преобразуется в каноническое пространство. */
-//	vec4 lightInCameraSpace = ubo.view * vec4(ubo.lightPosition, 1.0);
+//	vec4 lightInCameraSpace = globalUbo.view * vec4(globalUbo.lightPosition, 1.0);
 //	vec4 positionInCameraSpace = lightInCameraSpace + LIGHT_RADIUS * vec4(fragOffset, 0.0, 0.0);
-//	gl_Position = ubo.projection * positionInCameraSpace;
+//	gl_Position = globalUbo.projection * positionInCameraSpace;
 }
@@ -1,4 +1,5 @@
 #version 450
+#extension GL_ARB_shader_draw_parameters : require
 
 /*
 vec2 positions[3] = vec2[] (
@@ -21,42 +22,51 @@ layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec3 fragPosWorld;
 layout(location = 2) out vec3 fragNormalWorld;
 layout(location = 3) out vec2 fragUv;
+layout(location = 4) flat out vec3 fragDiffuseColor;       // материал сабмеша
+layout(location = 5) flat out ivec2 fragTextureIndices;    // индексы diffuse и specular текстур в bindless массиве, -1 если нет
 
-struct PointLight {
-    vec4 position; // w - игнорируется
-    vec4 color;    // w - интенсивность цвета
-};
+// позиция вычисляется так же, как в шейдере прохода глубины (TextureDepth.vert), и должна совпадать с ней бит в бит
+invariant gl_Position;
 
 // Тип, который получает данные из унифицированного буфера с ubo объектом внутри.
 // Такой read only buffer передаётся через набор дескрипторов, в котором он содержится
 // по указанной привязке.
-layout(set = 0, binding = 0) uniform GlobalUBO {
-    mat4 projection;
-    mat4 view;
-    mat4 invView;
-    vec4 ambientLightColor;
-    float directionalLightIntensity;
-    vec4 directionalLightPosition;
-    PointLight pointLights[10];
-    int numLights;
-    float diffuseProportion;
-    float roughness;
-    float indexOfRefraction;
-} globalUbo;
+#include <GlobalUbo.glsl>
+
+// Данные объектов и материалов записываются в storage буферы и читаются по индексам:
+// gl_InstanceIndex (включает firstInstance непрямой команды) - объект, drawBase + gl_DrawIDARB - сабмеш модели.
+struct InstanceData {
+    mat4 modelMatrix;
+    mat4 normalMatrix;
+};
+
+struct DrawData {
+    vec4 diffuseColor;
+    int diffuseTextureIndex;
+    int specularTextureIndex;
+};
+
+layout(std430, set = 2, binding = 0) readonly buffer InstanceBuffer {
+    InstanceData instances[];
+} instanceBuffer;
+
+layout(std430, set = 2, binding = 1) readonly buffer DrawBuffer {
+    DrawData draws[];
+} drawBuffer;
 
 // Блок, который получает значения из структуры пуш-констант. Блок пуш-констант должен быть
 // только один для одного шейдера, а его порядок полей должен совпадать со структурой, записанной в буфере команд.
 layout(push_constant) uniform Push {
-    mat4 modelMatrix;
-    mat4 normalMatrix;
-    int textureIndex;
-    vec3 diffuseColor;
+    uint drawBase; // индекс первой отрисовки вызова, gl_DrawIDARB отсчитывается от него
 } push;
 
 void main() {
+    InstanceData instance = instanceBuffer.instances[gl_InstanceIndex];
+    DrawData draw = drawBuffer.draws[push.drawBase + gl_DrawIDARB];
+
     // Если вектор обозначает направление, то однородную координату нужно заменить на 0,
     // чтобы на вектор не применился сдвиг (translation).
-    vec4 positionWorld = push.modelMatrix * vec4(position, 1.0); // перевод позиции вершины в мировое пространство
+    vec4 positionWorld = instance.modelMatrix * vec4(position, 1.0); // перевод позиции вершины в мировое пространство
 
     // Дополнительное применение аффинного преобразования (projectionViewMatrix * positionWorld).
     gl_Position = globalUbo.projection * globalUbo.view * positionWorld;
@@ -71,10 +81,12 @@ void main() {
     //vec3 normalWorldSpace = normalize(normalMatrix * normal);
     // Нахождение матрицы нормали было вынесено на сторону хоста.
 
-    fragNormalWorld = normalize(mat3(push.normalMatrix) * normal);
+    fragNormalWorld = normalize(mat3(instance.normalMatrix) * normal);
     fragPosWorld = positionWorld.xyz;
     fragColor = color;
     fragUv = uv;
+    fragDiffuseColor = draw.diffuseColor.rgb;
+    fragTextureIndices = ivec2(draw.diffuseTextureIndex, draw.specularTextureIndex);
 
     // прежние строки
     //gl_Position = vec4(push.transform * position + push.offset, 0.0, 1.0);
@@ -1,40 +1,22 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
-#define TEXTURES_COUNT 0
+// Bindless texture array. Its size is the heap capacity set by the pipeline through the specialization constant;
+// only the slots holding textures are written (the binding is partially bound).
+// Fragments of different indirect draws can be in one subgroup, so the indices are non-uniform.
+layout (constant_id = 0) const int TEXTURES_COUNT = 1;
+layout (set = 1, binding = 0) uniform sampler2D texSampler[TEXTURES_COUNT];
 
 layout (location = 0) in vec3 fragColor;
 layout (location = 1) in vec3 fragPosWorld;
 layout (location = 2) in vec3 fragNormalWorld;
 layout (location = 3) in vec2 fragUv;
+layout (location = 4) flat in vec3 fragDiffuseColor;
+layout (location = 5) flat in ivec2 fragTextureIndices; // x - diffuse, y - specular, -1 if absent
 
 layout (location = 0) out vec4 outColor;
 
-struct PointLight {
-    vec4 position; // w - ignored
-    vec4 color;    // w - color intensity
-};
-
-layout(push_constant) uniform Push {
-    mat4 modelMatrix;
-    mat4 normalMatrix;
-    int diffTexIndex;
-    int specTexIndex;
-    vec3 diffuseColor;
-} push;
-
-layout(set = 0, binding = 0) uniform GlobalUBO {
-    mat4 projection;
-    mat4 view;
-    mat4 invView;
-    vec4 ambientLightColor;
-    float directionalLightIntensity;
-    vec4 directionalLightPosition;
-    PointLight pointLights[10];
-    int numLights;
-    float diffuseProportion;
-    float roughness;
-    float indexOfRefraction;
-} globalUbo;
+#include <ClusteredLights.glsl>
 
 // --- Functions ---
 // Geometrical attenuation - Schlick-GGX
@@ -66,11 +48,13 @@ void main() {
     // Directional light contribution
     diffuseLight += max(dot(surfaceNormal, DIRECTION_TO_LIGHT), 0) * globalUbo.directionalLightIntensity;
 
-    for (int i = 0; i < globalUbo.numLights; ++i) {
-        PointLight light = globalUbo.pointLights[i];
+    // only the lights of the fragment's cluster can reach it
+    LightCluster cluster = getLightCluster(fragPosWorld);
+    for (uint i = 0; i < cluster.count; ++i) {
+        PointLight light = getClusterLight(cluster, i);
 
         vec3 directionToLight = light.position.xyz - fragPosWorld;
-        float attenuation = 1.0 / dot(directionToLight, directionToLight); // intensity attenuation factor
+        float attenuation = lightAttenuation(directionToLight, light.position.w); // intensity attenuation factor
         directionToLight = normalize(directionToLight);
         float NdotL = max(dot(surfaceNormal, directionToLight), 0.0); // cosine of the angle of incidence 
         vec3 intensity = light.color.xyz * light.color.w * attenuation;
@@ -100,18 +84,14 @@ void main() {
     // and materials diffuse color otherwise.
     vec4 sampleTextureColor = vec4(0.8, 0.1, 0.1, 1);
     vec4 specularColor = vec4(0.0, 0.0, 0.0, 1);
-    if (push.diffTexIndex != -1) {
-#ifdef TEXTURES
-        sampleTextureColor = texture(texSampler[push.diffTexIndex], fragUv);
-#endif
+    if (fragTextureIndices.x != -1) {
+        sampleTextureColor = texture(texSampler[nonuniformEXT(fragTextureIndices.x)], fragUv);
     } else {
-        sampleTextureColor = vec4(push.diffuseColor, 1.0);
+        sampleTextureColor = vec4(fragDiffuseColor, 1.0);
     }
 
-    if (push.specTexIndex != -1) {
-#ifdef TEXTURES
-        specularColor = texture(texSampler[push.specTexIndex], fragUv);
-#endif
+    if (fragTextureIndices.y != -1) {
+        specularColor = texture(texSampler[nonuniformEXT(fragTextureIndices.y)], fragUv);
     } else {
         specularColor = sampleTextureColor;
     }